@@ -0,0 +1,205 @@
+#include "AhoCorasick.h"
+#include <map>
+#include <string>
+#include <cstring>
+
+constexpr uint32_t NO_STATE = 0xFFFFFFFFu;
+constexpr int MAX_SKIP_START_BYTES = 4;
+constexpr uint32_t OUTPUT_BIT = 0x80000000u;  // в переходе: в целевом состоянии есть вхождения
+
+uint64_t HashBytes(const void* data, size_t size) {
+    // FNV-1a
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+AhoCorasick::AhoCorasick() : skipRoot(false), numClasses(1), patternCount(0) {
+    memset(byteClass, 0, sizeof(byteClass));
+    memset(leavesRoot, 0, sizeof(leavesRoot));
+}
+
+bool AhoCorasick::Build(const std::vector<PatternRef>& patterns) {
+    patternCount = patterns.size();
+    alias.assign(patternCount, -1);
+    lengths.clear();
+
+    // Одинаковые образцы считаются один раз
+    std::map<std::string, int32_t> unique;
+    for (size_t i = 0; i < patternCount; i++) {
+        if (patterns[i].length == 0) {
+            continue;
+        }
+        std::string pattern(patterns[i].data, patterns[i].length);
+        auto it = unique.find(pattern);
+        if (it == unique.end()) {
+            it = unique.insert(std::make_pair(pattern, (int32_t)lengths.size())).first;
+            lengths.push_back((uint32_t)pattern.size());
+        }
+        alias[i] = it->second;
+    }
+
+    // Байты, которых нет в образцах, ведут в корень: общий класс 0
+    bool used[256] = {};
+    uint32_t distinct = 0;
+    for (const auto& entry : unique) {
+        for (unsigned char c : entry.first) {
+            if (!used[c]) {
+                used[c] = true;
+                distinct++;
+            }
+        }
+    }
+
+    numClasses = distinct < 256 ? 1 : 0;
+    for (int c = 0; c < 256; c++) {
+        byteClass[c] = used[c] ? (uint8_t)numClasses++ : 0;
+    }
+
+    transitions.assign(numClasses, NO_STATE);
+    patternAt.assign(1, -1);
+
+    for (const auto& entry : unique) {
+        uint32_t state = 0;
+        for (unsigned char c : entry.first) {
+            uint32_t& next = transitions[(size_t)state * numClasses + byteClass[c]];
+            if (next == NO_STATE) {
+                next = (uint32_t)patternAt.size();
+                patternAt.push_back(-1);
+                transitions.resize(transitions.size() + numClasses, NO_STATE);
+            }
+            state = transitions[(size_t)state * numClasses + byteClass[c]];
+        }
+        patternAt[state] = entry.second;
+    }
+
+    // Обход в ширину: суффиксные ссылки и достройка переходов до ДКА
+    size_t stateCount = patternAt.size();
+    std::vector<uint32_t> fail(stateCount, 0);
+    std::vector<uint32_t> order;
+    order.reserve(stateCount);
+    order.push_back(0);
+    outputLink.assign(stateCount, -1);
+    hasOutput.assign(stateCount, 0);
+
+    for (size_t head = 0; head < order.size(); head++) {
+        uint32_t state = order[head];
+        uint32_t* row = &transitions[(size_t)state * numClasses];
+        const uint32_t* failRow = &transitions[(size_t)fail[state] * numClasses];
+
+        for (uint32_t c = 0; c < numClasses; c++) {
+            if (row[c] == NO_STATE) {
+                row[c] = state == 0 ? 0 : failRow[c];
+                continue;
+            }
+
+            uint32_t child = row[c];
+            uint32_t link = state == 0 ? 0 : failRow[c];
+            fail[child] = link;
+            outputLink[child] = patternAt[link] != -1 ? (int32_t)link : outputLink[link];
+            hasOutput[child] = patternAt[child] != -1 || outputLink[child] != -1;
+            order.push_back(child);
+        }
+    }
+
+    // Переход хранит смещение строки целевого состояния и флаг вхождений,
+    // чтобы в цикле поиска не было ни умножения, ни второй таблицы
+    for (uint32_t& next : transitions) {
+        next = next * numClasses | (hasOutput[next] ? OUTPUT_BIT : 0);
+    }
+
+    int startBytes = 0;
+    for (int c = 0; c < 256; c++) {
+        leavesRoot[c] = transitions[byteClass[c]] != 0;
+        startBytes += leavesRoot[c];
+    }
+    // При многих начальных байтах пропуск только добавляет ветвлений
+    skipRoot = startBytes <= MAX_SKIP_START_BYTES;
+
+    return true;
+}
+
+void AhoCorasick::Count(const char* text, size_t length, uint32_t* counts) const {
+    size_t uniqueCount = lengths.size();
+    std::vector<uint32_t> found(uniqueCount, 0);
+    std::vector<size_t> nextStart(uniqueCount, 0);  // для непересекающихся вхождений
+
+    const uint32_t* table = transitions.data();
+    uint32_t row = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        // В корне переходы зависят только от байта: пропускаем без
+        // цепочки зависимостей по состоянию до первого возможного начала
+        if (row == 0 && skipRoot) {
+            while (i < length && !leavesRoot[(unsigned char)text[i]]) {
+                i++;
+            }
+            if (i == length) {
+                break;
+            }
+        }
+
+        uint32_t next = table[row + byteClass[(unsigned char)text[i]]];
+        row = next & ~OUTPUT_BIT;
+        if (!(next & OUTPUT_BIT)) {
+            continue;
+        }
+
+        uint32_t state = row / numClasses;
+        int32_t match = patternAt[state] != -1 ? (int32_t)state : outputLink[state];
+        while (match != -1) {
+            int32_t pattern = patternAt[match];
+            size_t start = i + 1 - lengths[pattern];
+            if (start >= nextStart[pattern]) {
+                found[pattern]++;
+                nextStart[pattern] = i + 1;
+            }
+            match = outputLink[match];
+        }
+    }
+
+    for (size_t i = 0; i < patternCount; i++) {
+        counts[i] = alias[i] >= 0 ? found[alias[i]] : 0;
+    }
+}
+
+size_t AhoCorasick::MemoryUsage() const {
+    return transitions.size() * sizeof(uint32_t) +
+        patternAt.size() * (sizeof(int32_t) * 2 + sizeof(uint8_t));
+}
+
+AutomatonCache::AutomatonCache(size_t maxEntries) : capacity(maxEntries), hits(0), misses(0) {}
+
+std::shared_ptr<AhoCorasick> AutomatonCache::Get(const char* key, size_t keySize,
+    const std::vector<PatternRef>& patterns) {
+    uint64_t hash = HashBytes(key, keySize);
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->hash == hash && it->key.size() == keySize && memcmp(it->key.data(), key, keySize) == 0) {
+            entries.splice(entries.begin(), entries, it);
+            hits++;
+            return entries.front().automaton;
+        }
+    }
+
+    misses++;
+    std::shared_ptr<AhoCorasick> automaton(new AhoCorasick());
+    if (!automaton->Build(patterns)) {
+        return nullptr;
+    }
+
+    Entry entry;
+    entry.hash = hash;
+    entry.key.assign(key, key + keySize);
+    entry.automaton = automaton;
+    entries.push_front(std::move(entry));
+    if (entries.size() > capacity) {
+        entries.pop_back();
+    }
+    return automaton;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// Образец для построения автомата
+struct PatternRef {
+    const char* data;
+    size_t length;
+};
+
+// Автомат Ахо-Корасик в виде полного ДКА над классами байтов:
+// один проход по тексту даёт число вхождений каждого образца.
+// Вхождения одного образца считаются без перекрытий, как в CountSubstring
+class AhoCorasick {
+private:
+    uint8_t byteClass[256];             // байт -> столбец таблицы переходов
+    uint8_t leavesRoot[256];            // байт, с которого начинается какой-то образец
+    bool skipRoot;                      // таких байтов мало, стоит пропускать остальные
+    uint32_t numClasses;
+    std::vector<uint32_t> transitions;  // [state * numClasses + class] = смещение строки | OUTPUT_BIT
+    std::vector<int32_t> patternAt;     // образец, оканчивающийся в состоянии
+    std::vector<int32_t> outputLink;    // ближайший суффикс с образцом
+    std::vector<uint8_t> hasOutput;
+    std::vector<uint32_t> lengths;      // по уникальным образцам
+    std::vector<int32_t> alias;         // номер образца -> уникальный образец
+    size_t patternCount;
+
+public:
+    AhoCorasick();
+
+    bool Build(const std::vector<PatternRef>& patterns);
+    // counts - по одному счётчику на каждый образец из Build
+    void Count(const char* text, size_t length, uint32_t* counts) const;
+
+    size_t PatternCount() const { return patternCount; }
+    size_t StateCount() const { return patternAt.size(); }
+    size_t MemoryUsage() const;
+};
+
+// Кэш скомпилированных автоматов по хешу набора образцов (LRU).
+// Общий для потоков: автомат после Build только читается
+class AutomatonCache {
+private:
+    struct Entry {
+        uint64_t hash;
+        std::vector<char> key;  // набор образцов целиком, для проверки коллизий
+        std::shared_ptr<AhoCorasick> automaton;
+    };
+
+    std::list<Entry> entries;   // в начале - последние использованные
+    size_t capacity;
+    uint64_t hits;
+    uint64_t misses;
+    std::mutex lock;
+
+public:
+    explicit AutomatonCache(size_t maxEntries = 32);
+
+    // key - сериализованный набор образцов, по нему строится хеш
+    std::shared_ptr<AhoCorasick> Get(const char* key, size_t keySize, const std::vector<PatternRef>& patterns);
+
+    uint64_t Hits() const { return hits; }
+    uint64_t Misses() const { return misses; }
+};
+
+uint64_t HashBytes(const void* data, size_t size);
@@ -0,0 +1,1744 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Scheduler.h"
+#include "Substring.h"
+#include "AhoCorasick.h"
+#include "Chunking.h"
+#include "BufferPool.h"
+#include "Image.h"
+#include "Sort.h"
+#include "Crc32.h"
+#include "Primes.h"
+#include "Gemm.h"
+#include "Fft.h"
+#include "Stats.h"
+#include "Rle.h"
+#include "Graph.h"
+#include "BigInt.h"
+#include "Xor.h"
+
+// Смешанная нагрузка для моделирования планировщика
+struct SimTask {
+    double arrival;     // мкс
+    double service;     // фактическое время обработки, мкс
+    uint32_t payloadSize;
+};
+
+static double Percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(p / 100.0 * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+static void PrintLatencies(const std::string& name, const std::vector<double>& latencies) {
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(1)
+        << " p50 " << std::setw(10) << Percentile(latencies, 50)
+        << " p99 " << std::setw(10) << Percentile(latencies, 99)
+        << " p99.9 " << std::setw(10) << Percentile(latencies, 99.9)
+        << " max " << std::setw(10) << Percentile(latencies, 100) << " us" << std::endl;
+}
+
+// 90% мелких задач по 1 КБ, 10% крупных от 64 КБ до 1 МБ; пуассоновский поток
+static std::vector<SimTask> GenerateMixedWorkload(int count, int numWorkers, double load, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_int_distribution<uint32_t> largeSize(64 * 1024, MAX_DATA_SIZE);
+    std::uniform_real_distribution<double> noise(0.8, 1.2);
+
+    std::vector<SimTask> tasks(count);
+    double totalService = 0;
+    for (SimTask& task : tasks) {
+        task.payloadSize = unit(rng) < 0.9 ? 1024 : largeSize(rng);
+        // 1 единица стоимости = 1 нс, реальное время отличается от оценки
+        task.service = Scheduler::EstimateCost(MessageType::TASK_SUBSTRING, task.payloadSize) / 1000.0 * noise(rng);
+        totalService += task.service;
+    }
+
+    double meanGap = totalService / count / numWorkers / load;
+    std::exponential_distribution<double> gap(1.0 / meanGap);
+    double now = 0;
+    for (SimTask& task : tasks) {
+        now += gap(rng);
+        task.arrival = now;
+    }
+    return tasks;
+}
+
+// Исходная логика Browser::Run: первый свободный воркер, а если заняты
+// все - дождаться всех и отдать задачу воркеру 0
+static std::vector<double> SimulateFirstFree(const std::vector<SimTask>& tasks, int numWorkers) {
+    std::vector<double> busyUntil(numWorkers, 0);
+    std::vector<double> latencies;
+    double browserTime = 0;
+
+    for (const SimTask& task : tasks) {
+        browserTime = std::max(browserTime, task.arrival);
+
+        int workerId = -1;
+        for (int i = 0; i < numWorkers; i++) {
+            if (busyUntil[i] <= browserTime) {
+                workerId = i;
+                break;
+            }
+        }
+
+        if (workerId == -1) {
+            for (int i = 0; i < numWorkers; i++) {
+                browserTime = std::max(browserTime, busyUntil[i]);
+            }
+            workerId = 0;
+        }
+
+        busyUntil[workerId] = browserTime + task.service;
+        latencies.push_back(busyUntil[workerId] - task.arrival);
+    }
+    return latencies;
+}
+
+// Событийная модель воркеров с окном maxInFlight задач
+class WorkerSim {
+private:
+    struct Event {
+        double time;
+        int kind;   // 0 - поступление, 1 - завершение
+        int index;  // номер задачи или воркера
+        bool operator>(const Event& other) const { return time > other.time; }
+    };
+
+    const std::vector<SimTask>& tasks;
+    int numWorkers;
+    int maxInFlight;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    std::vector<std::deque<int>> inFlight;
+
+public:
+    std::vector<double> latencies;
+
+    WorkerSim(const std::vector<SimTask>& simTasks, int workers, int window)
+        : tasks(simTasks), numWorkers(workers), maxInFlight(window), inFlight(workers) {}
+
+    void Run(const std::function<void(int)>& onArrival,
+        const std::function<void(int, int)>& onCompleted,
+        const std::function<int(int)>& nextFor) {
+        for (int i = 0; i < (int)tasks.size(); i++) {
+            events.push({ tasks[i].arrival, 0, i });
+        }
+
+        while (!events.empty()) {
+            Event event = events.top();
+            events.pop();
+
+            if (event.kind == 0) {
+                onArrival(event.index);
+            }
+            else {
+                int workerId = event.index;
+                int taskIndex = inFlight[workerId].front();
+                inFlight[workerId].pop_front();
+                latencies.push_back(event.time - tasks[taskIndex].arrival);
+                onCompleted(workerId, taskIndex);
+                if (!inFlight[workerId].empty()) {
+                    events.push({ event.time + tasks[inFlight[workerId].front()].service, 1, workerId });
+                }
+            }
+
+            for (int i = 0; i < numWorkers; i++) {
+                while ((int)inFlight[i].size() < maxInFlight) {
+                    int taskIndex = nextFor(i);
+                    if (taskIndex < 0) {
+                        break;
+                    }
+                    inFlight[i].push_back(taskIndex);
+                    if (inFlight[i].size() == 1) {
+                        events.push({ event.time + tasks[taskIndex].service, 1, i });
+                    }
+                }
+            }
+        }
+    }
+
+    int InFlight(int workerId) const { return (int)inFlight[workerId].size(); }
+};
+
+// Логика из Dispatcher: общая очередь, воркер с наименьшим числом задач в полёте
+static std::vector<double> SimulateLeastInFlight(const std::vector<SimTask>& tasks, int numWorkers, int maxInFlight) {
+    WorkerSim sim(tasks, numWorkers, maxInFlight);
+    std::deque<int> queue;
+
+    sim.Run(
+        [&](int taskIndex) { queue.push_back(taskIndex); },
+        [&](int, int) {},
+        [&](int workerId) {
+            if (queue.empty()) {
+                return -1;
+            }
+            for (int i = 0; i < numWorkers; i++) {
+                if (sim.InFlight(i) < sim.InFlight(workerId)) {
+                    return -1;
+                }
+            }
+            int taskIndex = queue.front();
+            queue.pop_front();
+            return taskIndex;
+        });
+    return sim.latencies;
+}
+
+static std::vector<double> SimulateScheduler(const std::vector<SimTask>& tasks, int numWorkers, int maxInFlight,
+    uint64_t& stolen) {
+    WorkerSim sim(tasks, numWorkers, maxInFlight);
+    Scheduler scheduler;
+    scheduler.Configure(numWorkers);
+
+    sim.Run(
+        [&](int taskIndex) {
+            ScheduledTask task;
+            task.header = MakeTaskHeader(MessageType::TASK_SUBSTRING, taskIndex, tasks[taskIndex].payloadSize);
+            task.cost = 0;
+            scheduler.Enqueue(std::move(task));
+        },
+        [&](int workerId, int taskIndex) { scheduler.OnCompleted(workerId, taskIndex); },
+        [&](int workerId) {
+            ScheduledTask task;
+            if (!scheduler.NextFor(workerId, task)) {
+                return -1;
+            }
+            scheduler.OnDispatched(workerId, task.header.taskId, task.cost);
+            return (int)task.header.taskId;
+        });
+
+    stolen = scheduler.Stolen();
+    return sim.latencies;
+}
+
+static int BenchScheduler(int argc, char* argv[]) {
+    int numWorkers = argc > 0 ? atoi(argv[0]) : 8;
+    int maxInFlight = argc > 1 ? atoi(argv[1]) : 4;
+    int count = argc > 2 ? atoi(argv[2]) : 200000;
+
+    std::cout << "Scheduler simulation: " << numWorkers << " workers, " << maxInFlight
+        << " in flight, " << count << " tasks (90% 1 KB, 10% 64 KB - 1 MB)" << std::endl;
+
+    for (double load : { 0.5, 0.7, 0.9 }) {
+        std::vector<SimTask> tasks = GenerateMixedWorkload(count, numWorkers, load, 42);
+        uint64_t stolen = 0;
+
+        std::cout << "\nLoad " << (int)(load * 100) << "%" << std::endl;
+        PrintLatencies("first-free (legacy)", SimulateFirstFree(tasks, numWorkers));
+        PrintLatencies("least-in-flight", SimulateLeastInFlight(tasks, numWorkers, maxInFlight));
+        PrintLatencies("scheduler", SimulateScheduler(tasks, numWorkers, maxInFlight, stolen));
+        std::cout << "stolen: " << stolen << std::endl;
+    }
+    return 0;
+}
+
+// Исходная реализация из Worker.cpp: копии в std::string и strstr
+static uint32_t LegacyCountSubstring(const char* payload, uint32_t payloadSize) {
+    const char* dataPtr = payload;
+    const char* dataEnd = payload + payloadSize;
+    std::string text(dataPtr, strnlen(dataPtr, dataEnd - dataPtr));
+    dataPtr += text.length() < payloadSize ? text.length() + 1 : text.length();
+    std::string pattern(dataPtr, strnlen(dataPtr, dataEnd - dataPtr));
+
+    if (pattern.empty()) return 0;
+
+    uint32_t count = 0;
+    const char* pos = text.c_str();
+    size_t len = pattern.length();
+
+    while ((pos = strstr(pos, pattern.c_str())) != nullptr) {
+        count++;
+        pos += len;
+    }
+    return count;
+}
+
+// Среднее время одного вызова в мкс; итераций столько, чтобы набрать ~50 мс
+static double TimeCall(const std::function<uint32_t()>& call, uint32_t& result) {
+    using Clock = std::chrono::steady_clock;
+    int iterations = 1;
+
+    while (true) {
+        auto start = Clock::now();
+        for (int i = 0; i < iterations; i++) {
+            result = call();
+        }
+        double elapsed = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        if (elapsed > 50000 || iterations >= (1 << 24)) {
+            return elapsed / iterations;
+        }
+        iterations *= elapsed < 5000 ? 10 : 2;
+    }
+}
+
+static int BenchSubstring() {
+    SimdLevel level = DetectSimdLevel();
+    std::cout << "Substring counting, CPU supports: " << SimdLevelName(level) << std::endl;
+    std::cout << "Throughput in GB/s (text bytes per second)" << std::endl;
+
+    std::mt19937_64 rng(7);
+    // Текст на естественном языке: много совпадений первого байта
+    const char* words[] = { "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ",
+        "hello ", "world ", "test ", "data ", "pipe ", "worker " };
+
+    std::cout << std::left << std::setw(10) << "text" << std::setw(9) << "pattern" << std::right
+        << std::setw(10) << "legacy" << std::setw(10) << "scalar" << std::setw(10) << "sse2"
+        << std::setw(10) << "avx2" << std::setw(10) << "count" << std::endl;
+
+    for (size_t textSize : { (size_t)1024, (size_t)64 * 1024, (size_t)MAX_DATA_SIZE - 1024 }) {
+        std::string text;
+        while (text.size() < textSize) {
+            text += words[rng() % (sizeof(words) / sizeof(words[0]))];
+        }
+        text.resize(textSize);
+
+        for (size_t patternLength : { 1, 2, 4, 8, 16, 64 }) {
+            // Образец из середины текста, чтобы вхождения были
+            size_t offset = (rng() % (textSize - patternLength));
+            std::string pattern = text.substr(offset, patternLength);
+
+            std::vector<char> legacyPayload(text.begin(), text.end());
+            legacyPayload.push_back('\0');
+            legacyPayload.insert(legacyPayload.end(), pattern.begin(), pattern.end());
+            legacyPayload.push_back('\0');
+
+            uint32_t expected, scalar, sse2 = 0, avx2 = 0;
+            double legacyUs = TimeCall([&]() {
+                return LegacyCountSubstring(legacyPayload.data(), (uint32_t)legacyPayload.size());
+            }, expected);
+            double scalarUs = TimeCall([&]() {
+                return CountSubstringScalar(text.data(), text.size(), pattern.data(), pattern.size());
+            }, scalar);
+            double sse2Us = 0;
+            double avx2Us = 0;
+            if (level != SimdLevel::SCALAR) {
+                sse2Us = TimeCall([&]() {
+                    return CountSubstringSse2(text.data(), text.size(), pattern.data(), pattern.size());
+                }, sse2);
+            }
+            if (level == SimdLevel::AVX2) {
+                avx2Us = TimeCall([&]() {
+                    return CountSubstringAvx2(text.data(), text.size(), pattern.data(), pattern.size());
+                }, avx2);
+            }
+
+            if (scalar != expected || (sse2Us > 0 && sse2 != expected) || (avx2Us > 0 && avx2 != expected)) {
+                std::cerr << "Count mismatch: legacy " << expected << ", scalar " << scalar
+                    << ", sse2 " << sse2 << ", avx2 " << avx2 << std::endl;
+                return 1;
+            }
+
+            auto gbps = [&](double us) { return us > 0 ? textSize / us / 1000.0 : 0.0; };
+            std::cout << std::left << std::setw(10) << textSize << std::setw(9) << patternLength
+                << std::right << std::fixed << std::setprecision(2)
+                << std::setw(10) << gbps(legacyUs) << std::setw(10) << gbps(scalarUs)
+                << std::setw(10) << gbps(sse2Us) << std::setw(10) << gbps(avx2Us)
+                << std::setw(10) << expected << std::endl;
+        }
+    }
+    return 0;
+}
+
+// K образцов по одному тексту: K проходов CountSubstring против одного
+// прохода автомата, с построением и из кэша
+static int BenchMultiPattern() {
+    std::mt19937_64 rng(11);
+    const char* words[] = { "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ",
+        "hello ", "world ", "test ", "data ", "pipe ", "worker " };
+    const size_t wordCount = sizeof(words) / sizeof(words[0]);
+
+    std::string text;
+    while (text.size() < (size_t)MAX_DATA_SIZE - 64 * 1024) {
+        text += words[rng() % wordCount];
+    }
+
+    std::cout << "Multi-pattern counting over " << text.size() << " bytes, CPU: "
+        << SimdLevelName(DetectSimdLevel()) << std::endl;
+    std::cout << std::left << std::setw(10) << "patterns" << std::right
+        << std::setw(14) << "K x simd us" << std::setw(14) << "build us" << std::setw(14) << "cold us"
+        << std::setw(14) << "cached us" << std::setw(10) << "states" << std::endl;
+
+    for (size_t patternCount : { 1, 2, 5, 16, 64, 256 }) {
+        std::vector<std::string> patterns;
+        for (size_t i = 0; i < patternCount; i++) {
+            size_t length = 3 + rng() % 10;
+            size_t offset = rng() % (text.size() - length);
+            patterns.push_back(text.substr(offset, length));
+        }
+
+        MessageBuffer key;
+        AppendMultiPatternPayload(key, std::string(), patterns);
+        std::vector<PatternRef> refs;
+        const char* cursor = key.Data();
+        for (const std::string& pattern : patterns) {
+            refs.push_back({ cursor, pattern.size() });
+            cursor += pattern.size();
+        }
+
+        std::vector<uint32_t> expected(patternCount), counts(patternCount);
+        uint32_t unused;
+        double simdUs = TimeCall([&]() {
+            for (size_t i = 0; i < patternCount; i++) {
+                expected[i] = CountSubstring(text.data(), text.size(), patterns[i].data(), patterns[i].size());
+            }
+            return expected[0];
+        }, unused);
+
+        size_t states = 0;
+        double buildUs = TimeCall([&]() {
+            AhoCorasick automaton;
+            automaton.Build(refs);
+            states = automaton.StateCount();
+            return (uint32_t)states;
+        }, unused);
+
+        AhoCorasick automaton;
+        automaton.Build(refs);
+        double countUs = TimeCall([&]() {
+            automaton.Count(text.data(), text.size(), counts.data());
+            return counts[0];
+        }, unused);
+
+        AutomatonCache cache;
+        cache.Get(key.Data(), key.Size(), refs);
+        double cachedUs = TimeCall([&]() {
+            cache.Get(key.Data(), key.Size(), refs)->Count(text.data(), text.size(), counts.data());
+            return counts[0];
+        }, unused);
+
+        if (counts != expected) {
+            std::cerr << "Count mismatch for " << patternCount << " patterns" << std::endl;
+            return 1;
+        }
+
+        std::cout << std::left << std::setw(10) << patternCount << std::right << std::fixed << std::setprecision(1)
+            << std::setw(14) << simdUs << std::setw(14) << buildUs << std::setw(14) << buildUs + countUs
+            << std::setw(14) << cachedUs << std::setw(10) << states << std::endl;
+    }
+    return 0;
+}
+
+// Поток, нарезанный на фрагменты: сумма по фрагментам в случайном порядке
+// ответов должна совпасть с одним проходом по всему тексту
+static int BenchChunked() {
+    std::mt19937_64 rng(13);
+    const char* words[] = { "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ",
+        "hello ", "world ", "test ", "data ", "pipe ", "worker " };
+    const size_t textSize = 16 * 1024 * 1024;
+
+    std::string wordText;
+    while (wordText.size() < textSize) {
+        wordText += words[rng() % (sizeof(words) / sizeof(words[0]))];
+    }
+    std::string periodicText;
+    while (periodicText.size() < textSize) {
+        periodicText += rng() % 64 ? "abaab" : "b";
+    }
+
+    std::cout << "Chunked counting over " << textSize / (1024 * 1024) << " MB" << std::endl;
+    std::cout << std::left << std::setw(10) << "text" << std::setw(12) << "pattern" << std::setw(10) << "chunk"
+        << std::right << std::setw(8) << "tables" << std::setw(12) << "count" << std::setw(10) << "GB/s" << std::endl;
+
+    struct Case { const char* name; const std::string* text; const char* pattern; };
+    const Case cases[] = {
+        { "words", &wordText, "hello" },
+        { "words", &wordText, "o" },
+        { "periodic", &periodicText, "aba" },
+        { "periodic", &periodicText, "abaababaab" },
+        { "periodic", &periodicText, "bb" },
+    };
+
+    for (const Case& c : cases) {
+        std::string pattern = c.pattern;
+        uint64_t expected = CountSubstring(c.text->data(), c.text->size(), pattern.data(), pattern.size());
+
+        for (size_t chunkSize : { (size_t)7, (size_t)4096, (size_t)256 * 1024 }) {
+            std::istringstream input(*c.text);
+            ChunkReader reader(input, chunkSize, pattern.size() - 1);
+            std::vector<std::vector<char>> results;
+            MessageBuffer chunk;
+            std::vector<ChunkEntry> entries;
+            size_t tables = 0;
+
+            auto start = std::chrono::steady_clock::now();
+            while (reader.Next(chunk)) {
+                CountSubstringChunk(chunk.Data(), chunk.Size(), pattern.data(), pattern.size(), entries);
+                uint32_t entryCount = (uint32_t)entries.size();
+                std::vector<char> result((const char*)&entryCount, (const char*)&entryCount + sizeof(entryCount));
+                result.insert(result.end(), (const char*)entries.data(),
+                    (const char*)entries.data() + entries.size() * sizeof(ChunkEntry));
+                results.push_back(std::move(result));
+                tables += entryCount > 1;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            // Ответы воркеров приходят в произвольном порядке
+            std::vector<size_t> order(results.size());
+            for (size_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            std::shuffle(order.begin(), order.end(), rng);
+
+            ChunkReducer reducer(chunkSize);
+            for (size_t index : order) {
+                if (!reducer.Add(index, results[index].data(), results[index].size())) {
+                    std::cerr << "Malformed chunk result " << index << std::endl;
+                    return 1;
+                }
+            }
+
+            if (reducer.Reduced() != results.size() || reducer.Total() != expected) {
+                std::cerr << "Count mismatch for \"" << pattern << "\" with " << chunkSize << "-byte chunks: "
+                    << reducer.Total() << " instead of " << expected << std::endl;
+                return 1;
+            }
+
+            std::cout << std::left << std::setw(10) << c.name << std::setw(12) << pattern << std::setw(10) << chunkSize
+                << std::right << std::setw(8) << tables << std::setw(12) << expected << std::fixed << std::setprecision(2)
+                << std::setw(10) << c.text->size() / seconds / 1e9 << std::endl;
+        }
+    }
+
+    // Заход длиннее ядра: вхождение накрывает фрагменты целиком. Короткие
+    // тексты из двух букв, ответы по порядку и против полного прохода
+    uint64_t longOverlaps = 0;
+    for (int round = 0; round < 20000; round++) {
+        std::string text(1 + rng() % 64, 'a');
+        for (char& ch : text) {
+            ch = rng() % 3 ? 'a' : 'b';
+        }
+        std::string pattern(2 + rng() % 12, 'a');
+        for (char& ch : pattern) {
+            ch = rng() % 3 ? 'a' : 'b';
+        }
+        size_t chunkSize = 1 + rng() % (pattern.size() + 2);
+        uint64_t expected = CountSubstring(text.data(), text.size(), pattern.data(), pattern.size());
+
+        std::istringstream input(text);
+        ChunkReader reader(input, chunkSize, pattern.size() - 1);
+        ChunkReducer reducer(chunkSize);
+        MessageBuffer chunk;
+        std::vector<ChunkEntry> entries;
+        uint64_t index = 0;
+        bool ok = true;
+        while (ok && reader.Next(chunk)) {
+            CountSubstringChunk(chunk.Data(), chunk.Size(), pattern.data(), pattern.size(), entries);
+            uint32_t entryCount = (uint32_t)entries.size();
+            std::vector<char> result((const char*)&entryCount, (const char*)&entryCount + sizeof(entryCount));
+            result.insert(result.end(), (const char*)entries.data(),
+                (const char*)entries.data() + entries.size() * sizeof(ChunkEntry));
+            ok = reducer.Add(index++, result.data(), result.size());
+        }
+
+        if (!ok || reducer.Total() != expected) {
+            std::cerr << "Count mismatch for \"" << pattern << "\" in \"" << text << "\" with " << chunkSize
+                << "-byte chunks: " << reducer.Total() << " instead of " << expected << std::endl;
+            return 1;
+        }
+        longOverlaps += pattern.size() - 1 > chunkSize;
+    }
+    std::cout << "20000 short texts checked, " << longOverlaps << " with overlap longer than the chunk" << std::endl;
+    return 0;
+}
+
+// Буферы сообщений: malloc/free против пула. Окно из BUFFER_WINDOW живых
+// буферов, как у задач в полёте; в режиме fill буфер заполняется целиком
+constexpr size_t BUFFER_WINDOW = 16;
+constexpr int BUFFER_ROUNDS = 20000;
+
+template <typename Allocate, typename Free>
+static double TimeBufferWindow(size_t size, bool fill, Allocate allocate, Free free) {
+    std::vector<char*> window(BUFFER_WINDOW, nullptr);
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < BUFFER_ROUNDS; i++) {
+        char*& slot = window[i % BUFFER_WINDOW];
+        if (slot) {
+            free(slot);
+        }
+        slot = allocate(size);
+        if (fill) {
+            memset(slot, i, size);
+        }
+        else {
+            slot[0] = (char)i;
+        }
+    }
+    for (char* block : window) {
+        if (block) {
+            free(block);
+        }
+    }
+
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BUFFER_ROUNDS;
+}
+
+// Буфер берёт один поток, отпускает другой (чтение канала -> вычисления)
+template <typename Allocate, typename Free>
+static double TimeBufferHandoff(size_t size, Allocate allocate, Free free) {
+    std::deque<char*> queue;
+    std::mutex lock;
+    std::condition_variable changed;
+    bool done = false;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&]() {
+        while (true) {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&]() { return !queue.empty() || done; });
+            if (queue.empty()) {
+                return;
+            }
+            char* block = queue.front();
+            queue.pop_front();
+            guard.unlock();
+            changed.notify_one();
+            free(block);
+        }
+    });
+
+    for (int i = 0; i < BUFFER_ROUNDS; i++) {
+        char* block = allocate(size);
+        block[0] = (char)i;
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [&]() { return queue.size() < BUFFER_WINDOW; });
+        queue.push_back(block);
+        guard.unlock();
+        changed.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        done = true;
+    }
+    changed.notify_one();
+    consumer.join();
+
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BUFFER_ROUNDS;
+}
+
+static int BenchBuffers() {
+    std::cout << "Message buffers, ns per acquire+release (window " << BUFFER_WINDOW << ")" << std::endl;
+    std::cout << std::left << std::setw(10) << "size" << std::right
+        << std::setw(10) << "malloc" << std::setw(10) << "pool"
+        << std::setw(12) << "malloc+fill" << std::setw(12) << "pool+fill"
+        << std::setw(12) << "malloc x-th" << std::setw(10) << "pool x-th" << std::endl;
+
+    auto mallocBlock = [](size_t size) { return (char*)malloc(size); };
+    auto freeBlock = [](char* block) { free(block); };
+    auto poolBlock = [](size_t size) { return AcquireBuffer(BufferSizeClass(size)); };
+    int poolClass = 0;
+    auto releaseBlock = [&poolClass](char* block) { ReleaseBuffer(block, poolClass); };
+
+    for (size_t size : { (size_t)64, (size_t)4 * 1024, (size_t)64 * 1024, (size_t)256 * 1024, (size_t)MAX_DATA_SIZE }) {
+        poolClass = BufferSizeClass(size);
+        // Прогрев: плиты пула и арены malloc уже выделены
+        TimeBufferWindow(size, true, mallocBlock, freeBlock);
+        TimeBufferWindow(size, true, poolBlock, releaseBlock);
+
+        double mallocNs = TimeBufferWindow(size, false, mallocBlock, freeBlock);
+        double poolNs = TimeBufferWindow(size, false, poolBlock, releaseBlock);
+        double mallocFillNs = TimeBufferWindow(size, true, mallocBlock, freeBlock);
+        double poolFillNs = TimeBufferWindow(size, true, poolBlock, releaseBlock);
+        double mallocHandoffNs = TimeBufferHandoff(size, mallocBlock, freeBlock);
+        double poolHandoffNs = TimeBufferHandoff(size, poolBlock, releaseBlock);
+
+        std::cout << std::left << std::setw(10) << size << std::right << std::fixed << std::setprecision(0)
+            << std::setw(10) << mallocNs << std::setw(10) << poolNs
+            << std::setw(12) << mallocFillNs << std::setw(12) << poolFillNs
+            << std::setw(12) << mallocHandoffNs << std::setw(10) << poolHandoffNs << std::endl;
+    }
+
+    BufferPoolStats stats = GetBufferPoolStats();
+    std::cout << "Pool: " << stats.slabs << " slabs, " << stats.slabBytes / 1024 << " KB, "
+        << stats.hugePageSlabs << " on huge pages, " << stats.refills << " refills" << std::endl;
+    return 0;
+}
+
+// Сепия в плавающей точке: эталон, от которого отсчитывается погрешность
+static void SepiaFloat(const char* src, char* dst, uint32_t width, uint32_t rows, uint32_t stride, uint32_t bpp) {
+    for (uint32_t y = 0; y < rows; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const uint8_t* in = (const uint8_t*)src + (size_t)y * stride + x * bpp;
+            uint8_t* out = (uint8_t*)dst + (size_t)y * stride + x * bpp;
+            float r = in[0], g = in[1], b = in[2];
+            float values[3] = {
+                0.393f * r + 0.769f * g + 0.189f * b,
+                0.349f * r + 0.686f * g + 0.168f * b,
+                0.272f * r + 0.534f * g + 0.131f * b
+            };
+            for (int c = 0; c < 3; c++) {
+                out[c] = (uint8_t)(values[c] > 255.0f ? 255.0f : values[c]);
+            }
+            if (bpp == 4) {
+                out[3] = in[3];
+            }
+        }
+    }
+}
+
+static int BenchImage() {
+    SimdLevel level = DetectSimdLevel();
+    const uint32_t width = 1920;
+    const uint32_t height = 1080;
+    std::cout << "Image kernels " << width << "x" << height << ", CPU supports: " << SimdLevelName(level) << std::endl;
+    std::cout << "Throughput in MPix/s" << std::endl;
+    std::cout << std::left << std::setw(8) << "op" << std::setw(8) << "format" << std::right
+        << std::setw(10) << "float" << std::setw(10) << "scalar" << std::setw(10) << "sse2"
+        << std::setw(10) << "avx2" << std::setw(10) << "max diff" << std::endl;
+
+    std::mt19937 rng(11);
+    typedef bool (*Kernel)(ImageOp, PixelFormat, const char*, char*, uint32_t, uint32_t, uint32_t);
+
+    for (ImageOp op : { ImageOp::SEPIA, ImageOp::INVERT }) {
+        for (PixelFormat format : { PixelFormat::RGB24, PixelFormat::RGBA32 }) {
+            uint32_t bpp = (uint32_t)format;
+            uint32_t stride = width * bpp;
+            std::vector<char> image((size_t)height * stride);
+            for (char& byte : image) {
+                byte = (char)rng();
+            }
+            std::vector<char> expected(image.size());
+            std::vector<char> output(image.size());
+
+            auto run = [&](Kernel kernel) {
+                uint32_t ignored;
+                double us = TimeCall([&]() {
+                    return (uint32_t)kernel(op, format, image.data(), output.data(), width, height, stride);
+                }, ignored);
+                return (double)width * height / us;
+            };
+
+            double floatRate = 0;
+            int maxDiff = 0;
+            if (op == ImageOp::SEPIA) {
+                uint32_t ignored;
+                double us = TimeCall([&]() {
+                    SepiaFloat(image.data(), expected.data(), width, height, stride, bpp);
+                    return 0u;
+                }, ignored);
+                floatRate = (double)width * height / us;
+            }
+
+            double scalarRate = run(ProcessImageRowsScalar);
+            if (op == ImageOp::SEPIA) {
+                for (size_t i = 0; i < output.size(); i++) {
+                    int diff = abs((int)(uint8_t)output[i] - (int)(uint8_t)expected[i]);
+                    maxDiff = diff > maxDiff ? diff : maxDiff;
+                }
+            }
+            expected = output;
+
+            double sse2Rate = 0;
+            double avx2Rate = 0;
+            if (level != SimdLevel::SCALAR) {
+                sse2Rate = run(ProcessImageRowsSse2);
+                if (output != expected) {
+                    std::cerr << "SSE2 output differs from scalar" << std::endl;
+                    return 1;
+                }
+            }
+            if (level == SimdLevel::AVX2) {
+                avx2Rate = run(ProcessImageRowsAvx2);
+                if (output != expected) {
+                    std::cerr << "AVX2 output differs from scalar" << std::endl;
+                    return 1;
+                }
+            }
+
+            std::cout << std::left << std::setw(8) << (op == ImageOp::SEPIA ? "sepia" : "invert")
+                << std::setw(8) << (format == PixelFormat::RGB24 ? "rgb" : "rgba")
+                << std::right << std::fixed << std::setprecision(0)
+                << std::setw(10) << floatRate << std::setw(10) << scalarRate
+                << std::setw(10) << sse2Rate << std::setw(10) << avx2Rate
+                << std::setw(10) << maxDiff << std::endl;
+        }
+    }
+    return 0;
+}
+
+// Поразрядная сортировка против std::sort одного задания
+template <typename Key>
+static bool BenchSortType(const char* name, SortKey type, std::mt19937_64& rng) {
+    SortScratch scratch;
+    for (size_t count : { (size_t)1024, (size_t)64 * 1024, MAX_DATA_SIZE / sizeof(Key) }) {
+        std::vector<Key> keys(count);
+        for (Key& key : keys) {
+            uint64_t bits = rng();
+            memcpy(&key, &bits, sizeof(Key));
+            if (key != key) {
+                key = Key();   // без NaN, чтобы сравнивать с std::sort
+            }
+        }
+        std::vector<Key> sorted(count);
+        std::vector<Key> expected(count);
+
+        uint32_t ignored;
+        double stdUs = TimeCall([&]() {
+            expected = keys;
+            std::sort(expected.begin(), expected.end());
+            return 0u;
+        }, ignored);
+        double radixUs = TimeCall([&]() {
+            RadixSortKeys(type, (const char*)keys.data(), (char*)sorted.data(), count, scratch);
+            return 0u;
+        }, ignored);
+
+        for (size_t i = 0; i < count; i++) {
+            if (SortableBits(sorted[i]) != SortableBits(expected[i]) && sorted[i] != expected[i]) {
+                std::cerr << name << ": radix sort differs from std::sort at " << i << std::endl;
+                return false;
+            }
+        }
+
+        std::cout << std::left << std::setw(10) << name << std::setw(10) << count << std::right
+            << std::fixed << std::setprecision(1)
+            << std::setw(12) << count / stdUs << std::setw(12) << count / radixUs << std::endl;
+    }
+    return true;
+}
+
+static int BenchSort() {
+    std::mt19937_64 rng(17);
+    std::cout << "Sorting one task, Mkeys/s" << std::endl;
+    std::cout << std::left << std::setw(10) << "key" << std::setw(10) << "count" << std::right
+        << std::setw(12) << "std::sort" << std::setw(12) << "radix" << std::endl;
+    if (!BenchSortType<uint32_t>("uint32", SortKey::UINT32, rng) ||
+        !BenchSortType<int32_t>("int32", SortKey::INT32, rng) ||
+        !BenchSortType<float>("float", SortKey::FLOAT32, rng) ||
+        !BenchSortType<uint64_t>("uint64", SortKey::UINT64, rng) ||
+        !BenchSortType<double>("double", SortKey::FLOAT64, rng)) {
+        return 1;
+    }
+
+    // Слияние k серий: дерево проигравших против двоичной кучи
+    const size_t total = 4 * 1024 * 1024;
+    std::cout << "\nMerging " << total << " uint32 keys, Mkeys/s" << std::endl;
+    std::cout << std::left << std::setw(10) << "runs" << std::right
+        << std::setw(12) << "heap" << std::setw(12) << "loser tree" << std::endl;
+
+    for (size_t k : { (size_t)2, (size_t)8, (size_t)32, (size_t)128 }) {
+        std::vector<uint32_t> keys(total);
+        for (uint32_t& key : keys) {
+            key = (uint32_t)rng();
+        }
+        std::vector<KeyRun> runs;
+        for (size_t i = 0; i < k; i++) {
+            size_t begin = total * i / k;
+            size_t end = total * (i + 1) / k;
+            std::sort(keys.begin() + begin, keys.begin() + end);
+            KeyRun run;
+            run.data = (const char*)(keys.data() + begin);
+            run.count = end - begin;
+            runs.push_back(run);
+        }
+
+        std::vector<uint32_t> heapOut(total);
+        std::vector<uint32_t> treeOut(total);
+        uint32_t ignored;
+        double heapUs = TimeCall([&]() {
+            typedef std::pair<uint32_t, size_t> Head;
+            std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heap;
+            std::vector<size_t> cursor(k);
+            for (size_t i = 0; i < k; i++) {
+                heap.push(Head(((const uint32_t*)runs[i].data)[0], i));
+            }
+            size_t produced = 0;
+            while (!heap.empty()) {
+                Head head = heap.top();
+                heap.pop();
+                heapOut[produced++] = head.first;
+                if (++cursor[head.second] < runs[head.second].count) {
+                    heap.push(Head(((const uint32_t*)runs[head.second].data)[cursor[head.second]], head.second));
+                }
+            }
+            return 0u;
+        }, ignored);
+        double treeUs = TimeCall([&]() {
+            MergeKeyRuns(SortKey::UINT32, runs, (char*)treeOut.data());
+            return 0u;
+        }, ignored);
+
+        if (heapOut != treeOut) {
+            std::cerr << "Loser tree merge differs from heap merge" << std::endl;
+            return 1;
+        }
+        std::cout << std::left << std::setw(10) << k << std::right << std::fixed << std::setprecision(1)
+            << std::setw(12) << total / heapUs << std::setw(12) << total / treeUs << std::endl;
+    }
+    return 0;
+}
+
+static int BenchCrc() {
+    uint32_t features = DetectCpuFeatures();
+    std::cout << "CRC, CPU supports:" << ((features & CPU_FEATURE_SSE42) ? " sse4.2" : "")
+        << ((features & CPU_FEATURE_PCLMUL) ? " pclmul" : "") << std::endl;
+    std::cout << "Throughput in GB/s on one thread" << std::endl;
+    std::cout << std::left << std::setw(8) << "crc" << std::setw(10) << "size" << std::right
+        << std::setw(10) << "bytewise" << std::setw(10) << "slice8" << std::setw(10) << "sse4.2"
+        << std::setw(10) << "pclmul" << std::setw(10) << "combine" << std::endl;
+
+    std::mt19937_64 rng(19);
+    for (CrcKind kind : { CrcKind::CRC32, CrcKind::CRC32C }) {
+        for (size_t size : { (size_t)64, (size_t)4096, (size_t)256 * 1024, (size_t)MAX_DATA_SIZE }) {
+            std::vector<uint8_t> data(size);
+            for (uint8_t& byte : data) {
+                byte = (uint8_t)rng();
+            }
+
+            // Побайтно по одной таблице - как до slicing-by-8
+            uint32_t poly = kind == CrcKind::CRC32C ? 0x82F63B78u : 0xEDB88320u;
+            uint32_t table[256];
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++) {
+                    crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+                }
+                table[i] = crc;
+            }
+
+            uint32_t expected;
+            uint32_t result;
+            double bytewiseUs = TimeCall([&]() {
+                uint32_t reg = ~0u;
+                for (size_t i = 0; i < size; i++) {
+                    reg = (reg >> 8) ^ table[(reg ^ data[i]) & 0xFF];
+                }
+                return ~reg;
+            }, expected);
+            double scalarUs = TimeCall([&]() { return Crc32Scalar(kind, 0, data.data(), size); }, result);
+            bool ok = result == expected;
+            double sse42Us = 0;
+            double pclmulUs = 0;
+            if (kind == CrcKind::CRC32C && (features & CPU_FEATURE_SSE42)) {
+                sse42Us = TimeCall([&]() { return Crc32Sse42(kind, 0, data.data(), size); }, result);
+                ok = ok && result == expected;
+            }
+            if (features & CPU_FEATURE_PCLMUL) {
+                pclmulUs = TimeCall([&]() { return Crc32Pclmul(kind, 0, data.data(), size); }, result);
+                ok = ok && result == expected;
+            }
+
+            // Склейка двух половин: от размера зависит только логарифмически
+            uint32_t first = Crc32(kind, 0, data.data(), size / 2);
+            uint32_t second = Crc32(kind, 0, data.data() + size / 2, size - size / 2);
+            double combineUs = TimeCall([&]() { return Crc32Combine(kind, first, second, size - size / 2); }, result);
+            ok = ok && result == expected;
+
+            if (!ok) {
+                std::cerr << "CRC mismatch for " << size << " bytes" << std::endl;
+                return 1;
+            }
+
+            auto gbps = [size](double us) { return us > 0 ? size / us / 1000.0 : 0.0; };
+            std::cout << std::left << std::setw(8) << (kind == CrcKind::CRC32C ? "crc32c" : "crc32")
+                << std::setw(10) << size << std::right << std::fixed << std::setprecision(2)
+                << std::setw(10) << gbps(bytewiseUs) << std::setw(10) << gbps(scalarUs)
+                << std::setw(10) << gbps(sse42Us) << std::setw(10) << gbps(pclmulUs)
+                << std::setw(8) << std::setprecision(0) << combineUs * 1000.0 << "ns" << std::endl;
+        }
+    }
+    return 0;
+}
+
+static int BenchPrimes() {
+    std::cout << "Prime sieve throughput in M numbers/s on one thread" << std::endl;
+    std::cout << std::left << std::setw(18) << "lo" << std::setw(12) << "span" << std::right
+        << std::setw(12) << "count" << std::setw(10) << "bytes" << std::setw(12) << "segmented"
+        << std::setw(10) << "list" << std::setw(10) << "MB list" << std::endl;
+
+    const uint64_t ranges[][2] = {
+        { 0, 10000000 },
+        { 0, 100000000 },
+        { 0, 1000000000 },
+        { 1000000000000ull, 100000000 },
+        { 1000000000000000ull, 100000000 },
+    };
+
+    BasePrimes base;
+    SieveScratch scratch;
+    for (const auto& range : ranges) {
+        uint64_t lo = range[0];
+        uint64_t hi = lo + range[1];
+
+        // Байт на число без сегментов: память растёт вместе с диапазоном,
+        // поэтому только для небольших hi
+        uint32_t expected = 0;
+        double bytewiseUs = 0;
+        if (hi <= 100000000) {
+            bytewiseUs = TimeCall([&]() {
+                std::vector<char> composite(hi, 0);
+                uint32_t found = 0;
+                for (uint64_t n = 2; n < hi; n++) {
+                    if (composite[n]) {
+                        continue;
+                    }
+                    found += n >= lo;
+                    for (uint64_t m = n * n; m < hi; m += n) {
+                        composite[m] = 1;
+                    }
+                }
+                return found;
+            }, expected);
+        }
+
+        uint32_t result;
+        double segmentedUs = TimeCall([&]() {
+            uint64_t count = 0;
+            SievePrimes(lo, hi, base, scratch, count, nullptr);
+            return (uint32_t)count;
+        }, result);
+        bool ok = bytewiseUs == 0 || result == expected;
+
+        MessageBuffer list;
+        uint32_t listed;
+        double listUs = TimeCall([&]() {
+            uint64_t count = 0;
+            list.Clear();
+            SievePrimes(lo, hi, base, scratch, count, &list);
+            return (uint32_t)count;
+        }, listed);
+        ok = ok && listed == result;
+
+        if (!ok) {
+            std::cerr << "Prime count mismatch for [" << lo << ", " << hi << ")" << std::endl;
+            return 1;
+        }
+
+        auto rate = [range](double us) { return us > 0 ? range[1] / us : 0.0; };
+        std::cout << std::left << std::setw(18) << lo << std::setw(12) << range[1] << std::right
+            << std::setw(12) << result << std::fixed << std::setprecision(1)
+            << std::setw(10) << rate(bytewiseUs) << std::setw(12) << rate(segmentedUs)
+            << std::setw(10) << rate(listUs) << std::setw(10) << list.Size() / 1e6 << std::endl;
+    }
+    return 0;
+}
+
+template <typename T>
+static bool BenchGemmCase(const char* name, MatrixType type, uint32_t size, bool avx2) {
+    std::mt19937_64 rng(23);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    std::vector<T> a((size_t)size * size);
+    std::vector<T> b((size_t)size * size);
+    for (T& value : a) {
+        value = (T)uniform(rng);
+    }
+    for (T& value : b) {
+        value = (T)uniform(rng);
+    }
+
+    std::vector<T> naive((size_t)size * size);
+    uint32_t result;
+    double naiveUs = TimeCall([&]() {
+        for (uint32_t i = 0; i < size; i++) {
+            for (uint32_t j = 0; j < size; j++) {
+                T sum = 0;
+                for (uint32_t k = 0; k < size; k++) {
+                    sum += a[(size_t)i * size + k] * b[(size_t)k * size + j];
+                }
+                naive[(size_t)i * size + j] = sum;
+            }
+        }
+        return 0u;
+    }, result);
+
+    PackedMatrix packed;
+    double packUs = TimeCall([&]() {
+        PackMatrix(type, (const char*)b.data(), size, size, packed);
+        return 0u;
+    }, result);
+
+    GemmScratch scratch;
+    MessageBuffer out;
+    double tolerance = (sizeof(T) == sizeof(float) ? 1e-6 : 1e-14) * size;
+    auto run = [&](void (*multiply)(const char*, uint32_t, const PackedMatrix&, GemmScratch&, MessageBuffer&),
+        bool& ok) {
+        double us = TimeCall([&]() {
+            out.Clear();
+            multiply((const char*)a.data(), size, packed, scratch, out);
+            return 0u;
+        }, result);
+        const T* c = (const T*)out.Data();
+        for (size_t i = 0; ok && i < naive.size(); i++) {
+            ok = std::fabs((double)c[i] - (double)naive[i]) <= tolerance;
+        }
+        return us;
+    };
+
+    bool ok = true;
+    double scalarUs = run(MultiplyPackedScalar, ok);
+    double avx2Us = avx2 ? run(MultiplyPackedAvx2, ok) : 0;
+    if (!ok) {
+        std::cerr << "GEMM mismatch for " << name << " " << size << std::endl;
+        return false;
+    }
+
+    double flops = 2.0 * size * size * size;
+    auto gflops = [flops](double us) { return us > 0 ? flops / us / 1000.0 : 0.0; };
+    std::cout << std::left << std::setw(8) << name << std::setw(8) << size << std::right << std::fixed
+        << std::setprecision(2) << std::setw(10) << gflops(naiveUs) << std::setw(10) << gflops(scalarUs)
+        << std::setw(10) << gflops(avx2Us) << std::setw(10) << packUs / 1000.0 << std::endl;
+    return true;
+}
+
+static int BenchGemm() {
+    bool avx2 = DetectSimdLevel() == SimdLevel::AVX2 && (DetectCpuFeatures() & CPU_FEATURE_FMA);
+    std::cout << "GEMM C = A x B (square), CPU supports: " << (avx2 ? "avx2+fma" : "scalar only") << std::endl;
+    std::cout << "GFLOP/s on one thread, packing B in ms" << std::endl;
+    std::cout << std::left << std::setw(8) << "type" << std::setw(8) << "size" << std::right
+        << std::setw(10) << "naive" << std::setw(10) << "scalar" << std::setw(10) << "avx2" << std::setw(10)
+        << "pack" << std::endl;
+
+    for (uint32_t size : { 64u, 128u, 256u, 512u, 1024u }) {
+        if (!BenchGemmCase<float>("float", MatrixType::FLOAT32, size, avx2)) {
+            return 1;
+        }
+    }
+    for (uint32_t size : { 64u, 128u, 256u, 512u }) {
+        if (!BenchGemmCase<double>("double", MatrixType::FLOAT64, size, avx2)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int BenchFourier() {
+    std::cout << "FFT, microseconds per transform on one thread" << std::endl;
+    std::cout << std::left << std::setw(8) << "size" << std::right << std::setw(12) << "direct DFT"
+        << std::setw(12) << "new plan" << std::setw(12) << "cached" << std::setw(12) << "real"
+        << std::setw(12) << "Msamples/s" << std::endl;
+
+    std::mt19937_64 rng(29);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    FftPlanCache plans;
+    std::vector<FftComplex> scratch;
+
+    for (uint32_t size : { 64u, 256u, 1024u, 4096u, 65536u }) {
+        std::vector<FftComplex> signal(size);
+        for (FftComplex& value : signal) {
+            value.re = uniform(rng);
+            value.im = uniform(rng);
+        }
+        std::vector<FftComplex> spectrum(size);
+        std::vector<FftComplex> work(size);
+        uint32_t result;
+
+        // Прямое O(n^2) с табличными синусами
+        double directUs = 0;
+        if (size <= 4096) {
+            std::vector<FftComplex> roots(size);
+            for (uint32_t i = 0; i < size; i++) {
+                roots[i].re = (float)std::cos(-2.0 * 3.14159265358979323846 * i / size);
+                roots[i].im = (float)std::sin(-2.0 * 3.14159265358979323846 * i / size);
+            }
+            directUs = TimeCall([&]() {
+                for (uint32_t k = 0; k < size; k++) {
+                    float re = 0;
+                    float im = 0;
+                    for (uint32_t j = 0, r = 0; j < size; j++, r = (r + k) & (size - 1)) {
+                        re += signal[j].re * roots[r].re - signal[j].im * roots[r].im;
+                        im += signal[j].re * roots[r].im + signal[j].im * roots[r].re;
+                    }
+                    spectrum[k].re = re;
+                    spectrum[k].im = im;
+                }
+                return 0u;
+            }, result);
+        }
+
+        // План на каждый вызов - так выглядела бы задача без кэша
+        double newPlanUs = TimeCall([&]() {
+            FftPlan plan(size);
+            std::copy(signal.begin(), signal.end(), work.begin());
+            FftTransform(plan, work.data(), false);
+            return 0u;
+        }, result);
+
+        double cachedUs = TimeCall([&]() {
+            FourierTransform(FourierMode::FORWARD, size, 1, (const char*)signal.data(), (char*)work.data(),
+                plans, scratch);
+            return 0u;
+        }, result);
+
+        bool ok = true;
+        for (uint32_t k = 0; directUs > 0 && k < size; k++) {
+            ok = ok && std::fabs(work[k].re - spectrum[k].re) + std::fabs(work[k].im - spectrum[k].im) <
+                1e-5 * size;
+        }
+
+        std::vector<float> samples(size);
+        for (float& value : samples) {
+            value = uniform(rng);
+        }
+        std::vector<FftComplex> bins(size / 2 + 1);
+        double realUs = TimeCall([&]() {
+            FourierTransform(FourierMode::REAL_FORWARD, size, 1, (const char*)samples.data(), (char*)bins.data(),
+                plans, scratch);
+            return 0u;
+        }, result);
+
+        if (!ok) {
+            std::cerr << "FFT mismatch for size " << size << std::endl;
+            return 1;
+        }
+
+        std::cout << std::left << std::setw(8) << size << std::right << std::fixed << std::setprecision(2)
+            << std::setw(12) << directUs << std::setw(12) << newPlanUs << std::setw(12) << cachedUs
+            << std::setw(12) << realUs << std::setw(12) << (cachedUs > 0 ? size / cachedUs : 0.0) << std::endl;
+    }
+    std::cout << "plan cache: " << plans.Hits() << " hits, " << plans.Misses() << " misses" << std::endl;
+    return 0;
+}
+
+static int BenchStats() {
+    const size_t count = 1 << 20;
+    std::mt19937_64 rng(31);
+    std::normal_distribution<double> normal(100.0, 10.0);
+    uint32_t result;
+
+    std::cout << "Stats of " << count << " values, Mvalues/s on one thread" << std::endl;
+    std::cout << std::left << std::setw(10) << "type" << std::right << std::setw(12) << "two-pass"
+        << std::setw(12) << "scalar" << std::setw(12) << "AVX2" << std::endl;
+
+    std::vector<uint8_t> bytes(count);
+    std::vector<float> floats(count);
+    std::vector<double> doubles(count);
+    for (size_t i = 0; i < count; i++) {
+        doubles[i] = normal(rng);
+        floats[i] = (float)doubles[i];
+        bytes[i] = (uint8_t)doubles[i];
+    }
+
+    const SampleType types[] = { SampleType::UINT8, SampleType::FLOAT32, SampleType::FLOAT64 };
+    const char* names[] = { "uint8", "float32", "float64" };
+    const char* data[] = { (const char*)bytes.data(), (const char*)floats.data(), (const char*)doubles.data() };
+    bool avx2 = DetectSimdLevel() == SimdLevel::AVX2;
+
+    for (int t = 0; t < 3; t++) {
+        // Два полных прохода по памяти double: так считали бы без блоков
+        double mean = 0;
+        double naiveUs = TimeCall([&]() {
+            double sum = 0;
+            for (size_t i = 0; i < count; i++) {
+                sum += doubles[i];
+            }
+            mean = sum / count;
+            double m2 = 0;
+            for (size_t i = 0; i < count; i++) {
+                m2 += (doubles[i] - mean) * (doubles[i] - mean);
+            }
+            return (uint32_t)m2;
+        }, result);
+
+        StatsPartial scalar = EmptyStats();
+        double scalarUs = TimeCall([&]() {
+            scalar = EmptyStats();
+            ComputeStatsScalar(types[t], data[t], count, scalar);
+            return (uint32_t)scalar.count;
+        }, result);
+
+        StatsPartial vector = EmptyStats();
+        double avx2Us = avx2 ? TimeCall([&]() {
+            vector = EmptyStats();
+            ComputeStatsAvx2(types[t], data[t], count, vector);
+            return (uint32_t)vector.count;
+        }, result) : 0;
+
+        if (avx2 && (vector.count != scalar.count || vector.min != scalar.min || vector.max != scalar.max ||
+            std::fabs(vector.m2 - scalar.m2) > 1e-9 * scalar.m2)) {
+            std::cerr << "Stats mismatch for " << names[t] << std::endl;
+            return 1;
+        }
+
+        std::cout << std::left << std::setw(10) << names[t] << std::right << std::fixed << std::setprecision(2)
+            << std::setw(12) << (naiveUs > 0 ? count / naiveUs : 0.0)
+            << std::setw(12) << (scalarUs > 0 ? count / scalarUs : 0.0)
+            << std::setw(12) << (avx2Us > 0 ? count / avx2Us : 0.0) << std::endl;
+    }
+
+    // Все значения в одной корзине - худший случай для одной таблицы:
+    // каждый инкремент ждёт предыдущий
+    std::cout << "\nHistogram of " << count << " values, Mvalues/s on one thread" << std::endl;
+    std::cout << std::left << std::setw(18) << "data" << std::right << std::setw(12) << "one table"
+        << std::setw(12) << "4 tables" << std::setw(12) << "AVX2" << std::endl;
+
+    std::vector<float> same(count, 42.5f);
+    std::vector<uint8_t> zeros(count, 0);
+    HistogramSpec floatSpec = { 1000, 0.0, 200.0 };
+    HistogramSpec byteSpec = { 256, 0.0, 256.0 };
+    struct HistogramCase {
+        const char* name;
+        SampleType type;
+        const HistogramSpec* spec;
+        const char* data;
+    } cases[] = {
+        { "float32 normal", SampleType::FLOAT32, &floatSpec, (const char*)floats.data() },
+        { "float32 constant", SampleType::FLOAT32, &floatSpec, (const char*)same.data() },
+        { "uint8 normal", SampleType::UINT8, &byteSpec, (const char*)bytes.data() },
+        { "uint8 constant", SampleType::UINT8, &byteSpec, (const char*)zeros.data() },
+    };
+
+    HistogramScratch scratch;
+    for (const HistogramCase& test : cases) {
+        const HistogramSpec& spec = *test.spec;
+        std::vector<uint64_t> single(spec.bins + 2);
+        double singleUs = TimeCall([&]() {
+            std::fill(single.begin(), single.end(), 0);
+            double scale = spec.bins / (spec.hi - spec.lo);
+            for (size_t i = 0; i < count; i++) {
+                if (test.type == SampleType::UINT8) {
+                    single[(uint8_t)test.data[i]]++;
+                    continue;
+                }
+                float x;
+                memcpy(&x, test.data + i * sizeof(x), sizeof(x));
+                if (x < spec.lo) {
+                    single[spec.bins]++;
+                }
+                else if (!(x < spec.hi)) {
+                    single[spec.bins + 1]++;
+                }
+                else {
+                    uint32_t bin = (uint32_t)((x - spec.lo) * scale);
+                    single[bin < spec.bins ? bin : spec.bins - 1]++;
+                }
+            }
+            return 0u;
+        }, result);
+
+        std::vector<uint64_t> split(spec.bins + 2);
+        double splitUs = TimeCall([&]() {
+            std::fill(split.begin(), split.end(), 0);
+            ComputeHistogramScalar(test.type, spec, test.data, count, scratch, split.data());
+            return 0u;
+        }, result);
+
+        std::vector<uint64_t> vector(spec.bins + 2);
+        double avx2Us = avx2 ? TimeCall([&]() {
+            std::fill(vector.begin(), vector.end(), 0);
+            ComputeHistogramAvx2(test.type, spec, test.data, count, scratch, vector.data());
+            return 0u;
+        }, result) : 0;
+
+        if (split != single || (avx2 && vector != single)) {
+            std::cerr << "Histogram mismatch for " << test.name << std::endl;
+            return 1;
+        }
+
+        std::cout << std::left << std::setw(18) << test.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(12) << (singleUs > 0 ? count / singleUs : 0.0)
+            << std::setw(12) << (splitUs > 0 ? count / splitUs : 0.0)
+            << std::setw(12) << (avx2Us > 0 ? count / avx2Us : 0.0) << std::endl;
+    }
+    return 0;
+}
+
+static int BenchRle() {
+    const size_t size = 1 << 20;
+    std::mt19937_64 rng(37);
+
+    // Маска с короткими и длинными сериями, разреженный массив double
+    // и шум, который сжимать не стоит
+    std::vector<char> mask(size, 0);
+    for (size_t i = 0; i < size;) {
+        size_t run = 1 + rng() % 400;
+        char value = (char)(rng() % 2 ? 0xFF : 0);
+        for (size_t k = 0; k < run && i < size; k++, i++) {
+            mask[i] = value;
+        }
+    }
+    std::vector<double> sparse(size / sizeof(double), 0.0);
+    for (size_t i = 0; i < sparse.size(); i += 1 + rng() % 64) {
+        sparse[i] = (double)(rng() % 1000) / 7.0;
+    }
+    std::vector<char> noise(size);
+    for (char& value : noise) {
+        value = (char)rng();
+    }
+
+    struct RleCase {
+        const char* name;
+        const char* data;
+    } cases[] = {
+        { "mask", mask.data() },
+        { "sparse double", (const char*)sparse.data() },
+        { "noise", noise.data() },
+    };
+
+    std::cout << "RLE of 1 MB, GB/s on one thread" << std::endl;
+    std::cout << std::left << std::setw(16) << "data" << std::right << std::setw(10) << "ratio"
+        << std::setw(10) << "estimate" << std::setw(12) << "enc scalar" << std::setw(12) << "enc AVX2"
+        << std::setw(12) << "decode" << std::setw(12) << "estimate us" << std::endl;
+
+    bool avx2 = DetectSimdLevel() == SimdLevel::AVX2;
+    uint32_t result;
+    for (const RleCase& test : cases) {
+        MessageBuffer scalar;
+        double scalarUs = TimeCall([&]() {
+            scalar.Clear();
+            RleEncodeScalar(test.data, size, scalar);
+            return (uint32_t)scalar.Size();
+        }, result);
+
+        MessageBuffer vector;
+        double avx2Us = avx2 ? TimeCall([&]() {
+            vector.Clear();
+            RleEncodeAvx2(test.data, size, vector);
+            return (uint32_t)vector.Size();
+        }, result) : 0;
+
+        MessageBuffer decoded;
+        double decodeUs = TimeCall([&]() {
+            decoded.Clear();
+            RleDecode(scalar.Data(), scalar.Size(), size, decoded);
+            return (uint32_t)decoded.Size();
+        }, result);
+
+        double estimate = 0;
+        double estimateUs = TimeCall([&]() {
+            estimate = EstimateRleRatio(test.data, size);
+            return 0u;
+        }, result);
+
+        if (decoded.Size() != size || memcmp(decoded.Data(), test.data, size) != 0 ||
+            (avx2 && (vector.Size() != scalar.Size() || memcmp(vector.Data(), scalar.Data(), scalar.Size()) != 0))) {
+            std::cerr << "RLE mismatch for " << test.name << std::endl;
+            return 1;
+        }
+
+        std::cout << std::left << std::setw(16) << test.name << std::right << std::fixed << std::setprecision(3)
+            << std::setw(10) << (double)scalar.Size() / size << std::setw(10) << estimate << std::setprecision(2)
+            << std::setw(12) << (scalarUs > 0 ? size / scalarUs / 1e3 : 0.0)
+            << std::setw(12) << (avx2Us > 0 ? size / avx2Us / 1e3 : 0.0)
+            << std::setw(12) << (decodeUs > 0 ? size / decodeUs / 1e3 : 0.0)
+            << std::setw(12) << estimateUs << std::endl;
+    }
+    return 0;
+}
+
+// Дейкстра на std::priority_queue - для сравнения с RadixHeap
+static uint64_t HeapDijkstra(const CsrGraph& graph, uint32_t source, uint32_t target, std::vector<uint64_t>& distance) {
+    typedef std::pair<uint64_t, uint32_t> Item;
+    distance.assign(graph.vertices, GRAPH_UNREACHABLE);
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> heap;
+    distance[source] = 0;
+    heap.push(Item(0, source));
+    while (!heap.empty()) {
+        Item item = heap.top();
+        heap.pop();
+        if (item.first != distance[item.second]) {
+            continue;
+        }
+        if (item.second == target) {
+            break;
+        }
+        for (uint32_t e = graph.offsets[item.second]; e < graph.offsets[item.second + 1]; e++) {
+            uint64_t candidate = item.first + graph.weights[e];
+            if (candidate < distance[graph.targets[e]]) {
+                distance[graph.targets[e]] = candidate;
+                heap.push(Item(candidate, graph.targets[e]));
+            }
+        }
+    }
+    return distance[target];
+}
+
+static int BenchGraph() {
+    const uint32_t side = 512;
+    const int queries = 64;
+    std::mt19937_64 rng(41);
+
+    CsrGraph grid;
+    grid.vertices = side * side;
+    grid.offsets.push_back(0);
+    for (uint32_t y = 0; y < side; y++) {
+        for (uint32_t x = 0; x < side; x++) {
+            const int dx[] = { 1, -1, 0, 0 };
+            const int dy[] = { 0, 0, 1, -1 };
+            for (int d = 0; d < 4; d++) {
+                int nx = (int)x + dx[d];
+                int ny = (int)y + dy[d];
+                if (nx >= 0 && ny >= 0 && nx < (int)side && ny < (int)side) {
+                    grid.targets.push_back((uint32_t)ny * side + nx);
+                    grid.weights.push_back(1 + (uint32_t)(rng() % 100));
+                }
+            }
+            grid.offsets.push_back((uint32_t)grid.targets.size());
+        }
+    }
+    CsrGraph unweighted = grid;
+    unweighted.weights.clear();
+
+    std::vector<GraphQuery> pairs(queries);
+    for (GraphQuery& pair : pairs) {
+        pair.source = (uint32_t)(rng() % grid.vertices);
+        pair.target = (uint32_t)(rng() % grid.vertices);
+    }
+
+    GraphScratch scratch;
+    GraphPath path;
+    std::vector<uint64_t> distance;
+    uint64_t heapSum = 0;
+    uint64_t radixSum = 0;
+    uint32_t result;
+
+    double bfsUs = TimeCall([&]() {
+        uint32_t hops = 0;
+        for (const GraphQuery& pair : pairs) {
+            ShortestPath(unweighted, pair.source, pair.target, scratch, path, nullptr);
+            hops += path.hops;
+        }
+        return hops;
+    }, result);
+    double heapUs = TimeCall([&]() {
+        heapSum = 0;
+        for (const GraphQuery& pair : pairs) {
+            heapSum += HeapDijkstra(grid, pair.source, pair.target, distance);
+        }
+        return (uint32_t)heapSum;
+    }, result);
+    double radixUs = TimeCall([&]() {
+        radixSum = 0;
+        for (const GraphQuery& pair : pairs) {
+            ShortestPath(grid, pair.source, pair.target, scratch, path, nullptr);
+            radixSum += path.distance;
+        }
+        return (uint32_t)radixSum;
+    }, result);
+
+    if (heapSum != radixSum) {
+        std::cerr << "Dijkstra mismatch: " << heapSum << " vs " << radixSum << std::endl;
+        return 1;
+    }
+
+    std::cout << queries << " point-to-point queries on a " << side << "x" << side << " grid, us per query"
+        << std::endl;
+    std::cout << std::left << std::setw(28) << "BFS (unweighted)" << std::right << std::fixed
+        << std::setprecision(1) << std::setw(12) << bfsUs / queries << std::endl;
+    std::cout << std::left << std::setw(28) << "Dijkstra, binary heap" << std::right
+        << std::setw(12) << heapUs / queries << std::endl;
+    std::cout << std::left << std::setw(28) << "Dijkstra, radix heap" << std::right
+        << std::setw(12) << radixUs / queries << std::endl;
+    return 0;
+}
+
+static int BenchBigInt() {
+    std::mt19937_64 rng(43);
+    uint32_t result;
+
+    std::cout << "Multiplication of two n-limb numbers, us" << std::endl;
+    std::cout << std::setw(8) << "limbs" << std::setw(14) << "schoolbook" << std::setw(14) << "Karatsuba"
+        << std::endl;
+    const size_t sizes[] = { 32, 128, 512, 2048, 8192 };
+    for (size_t size : sizes) {
+        std::vector<uint32_t> a(size);
+        std::vector<uint32_t> b(size);
+        for (size_t i = 0; i < size; i++) {
+            a[i] = (uint32_t)rng();
+            b[i] = (uint32_t)rng();
+        }
+        std::vector<uint32_t> school(2 * size);
+        std::vector<uint32_t> karatsuba(2 * size);
+        double schoolUs = TimeCall([&]() {
+            BigMultiplySchoolbook(a.data(), size, b.data(), size, school.data());
+            return school[0];
+        }, result);
+        double karatsubaUs = TimeCall([&]() {
+            BigMultiplyKaratsuba(a.data(), size, b.data(), size, karatsuba.data());
+            return karatsuba[0];
+        }, result);
+        if (school != karatsuba) {
+            std::cerr << "Multiplication mismatch at " << size << " limbs" << std::endl;
+            return 1;
+        }
+        std::cout << std::setw(8) << size << std::fixed << std::setprecision(1) << std::setw(14) << schoolUs
+            << std::setw(14) << karatsubaUs << std::endl;
+    }
+
+    // n! по одному множителю против дерева произведений
+    const uint64_t n = 50000;
+    std::vector<uint32_t> sequential;
+    double sequentialUs = TimeCall([&]() {
+        sequential.assign(1, 1);
+        for (uint64_t k = 2; k <= n; k++) {
+            uint64_t carry = 0;
+            for (uint32_t& limb : sequential) {
+                uint64_t t = limb * k + carry;
+                limb = (uint32_t)t;
+                carry = t >> 32;
+            }
+            if (carry) {
+                sequential.push_back((uint32_t)carry);
+            }
+        }
+        return (uint32_t)sequential.size();
+    }, result);
+    BigInt tree;
+    double treeUs = TimeCall([&]() {
+        RangeProduct(1, n + 1, tree);
+        return (uint32_t)tree.limbs.size();
+    }, result);
+    std::string decimal;
+    double decimalUs = TimeCall([&]() {
+        BigToDecimal(tree, decimal);
+        return (uint32_t)decimal.size();
+    }, result);
+
+    BigInt reference;
+    reference.limbs = sequential;
+    std::string expected;
+    BigToDecimal(reference, expected);
+    if (decimal != expected) {
+        std::cerr << "Factorial mismatch" << std::endl;
+        return 1;
+    }
+
+    std::cout << n << "!, ms: sequential " << std::setprecision(2) << sequentialUs / 1000.0 << ", product tree "
+        << treeUs / 1000.0 << ", to decimal " << decimalUs / 1000.0 << " (" << decimal.size() << " digits)"
+        << std::endl;
+    return 0;
+}
+
+static int BenchXor() {
+    const size_t size = 16 * 1024 * 1024;
+    std::mt19937_64 rng(47);
+    std::vector<char> data(size);
+    for (char& value : data) {
+        value = (char)rng();
+    }
+    std::vector<uint8_t> key(4096);
+    for (uint8_t& value : key) {
+        value = (uint8_t)rng();
+    }
+    std::vector<char> scalar(size);
+    std::vector<char> vector(size);
+
+    std::cout << "XOR of 16 MB out of place, GB/s on one thread" << std::endl;
+    std::cout << std::left << std::setw(16) << "key" << std::right << std::setw(10) << "scalar"
+        << std::setw(10) << "AVX2" << std::endl;
+
+    bool avx2 = DetectSimdLevel() == SimdLevel::AVX2;
+    const size_t keyLengths[] = { 1, 7, 32, 37, 4096, 0 };
+    uint32_t result;
+    for (size_t keyLength : keyLengths) {
+        double scalarUs = TimeCall([&]() {
+            if (keyLength > 0) {
+                XorRepeatingScalar(data.data(), scalar.data(), size, key.data(), keyLength, 3);
+            }
+            else {
+                XorCounterScalar(data.data(), scalar.data(), size, 0x5EEDull, 3);
+            }
+            return (uint32_t)scalar[0];
+        }, result);
+        double avx2Us = avx2 ? TimeCall([&]() {
+            if (keyLength > 0) {
+                XorRepeatingAvx2(data.data(), vector.data(), size, key.data(), keyLength, 3);
+            }
+            else {
+                XorCounterAvx2(data.data(), vector.data(), size, 0x5EEDull, 3);
+            }
+            return (uint32_t)vector[0];
+        }, result) : 0;
+
+        if (avx2 && scalar != vector) {
+            std::cerr << "XOR mismatch for key length " << keyLength << std::endl;
+            return 1;
+        }
+
+        std::string name = keyLength > 0 ? std::to_string(keyLength) + " bytes" : "counter";
+        std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(2)
+            << std::setw(10) << (scalarUs > 0 ? size / scalarUs / 1e3 : 0.0)
+            << std::setw(10) << (avx2Us > 0 ? size / avx2Us / 1e3 : 0.0) << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+
+    if (mode == "scheduler") {
+        return BenchScheduler(argc - 2, argv + 2);
+    }
+    if (mode == "substring") {
+        return BenchSubstring();
+    }
+    if (mode == "multipattern") {
+        return BenchMultiPattern();
+    }
+    if (mode == "chunked") {
+        return BenchChunked();
+    }
+    if (mode == "buffers") {
+        return BenchBuffers();
+    }
+    if (mode == "image") {
+        return BenchImage();
+    }
+    if (mode == "sort") {
+        return BenchSort();
+    }
+    if (mode == "crc") {
+        return BenchCrc();
+    }
+    if (mode == "primes") {
+        return BenchPrimes();
+    }
+    if (mode == "gemm") {
+        return BenchGemm();
+    }
+    if (mode == "fft") {
+        return BenchFourier();
+    }
+    if (mode == "stats") {
+        return BenchStats();
+    }
+    if (mode == "rle") {
+        return BenchRle();
+    }
+    if (mode == "graph") {
+        return BenchGraph();
+    }
+    if (mode == "bigint") {
+        return BenchBigInt();
+    }
+    if (mode == "xor") {
+        return BenchXor();
+    }
+
+    std::cerr << "Usage: Bench <mode> [args]" << std::endl;
+    std::cerr << "  scheduler [workers] [inFlight] [tasks]" << std::endl;
+    std::cerr << "  substring" << std::endl;
+    std::cerr << "  multipattern" << std::endl;
+    std::cerr << "  chunked" << std::endl;
+    std::cerr << "  buffers" << std::endl;
+    std::cerr << "  image" << std::endl;
+    std::cerr << "  sort" << std::endl;
+    std::cerr << "  crc" << std::endl;
+    std::cerr << "  primes" << std::endl;
+    std::cerr << "  gemm" << std::endl;
+    std::cerr << "  fft" << std::endl;
+    std::cerr << "  stats" << std::endl;
+    std::cerr << "  rle" << std::endl;
+    std::cerr << "  graph" << std::endl;
+    std::cerr << "  bigint" << std::endl;
+    std::cerr << "  xor" << std::endl;
+    return 1;
+}
@@ -0,0 +1,349 @@
+#include "BigInt.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+
+constexpr uint64_t BINARY_BASE = 1ull << 32;
+constexpr uint64_t DECIMAL_BASE = 1000000000ull;    // 10^9 - девять цифр в limb
+constexpr size_t DECIMAL_SPLIT_LIMBS = 64;          // короче - делением на 10^9
+
+// Все операции над limbs - в основании BASE: 2^32 для двоичных чисел,
+// 10^9 для склейки десятичной записи
+
+template <uint64_t BASE>
+static void MulSchool(const uint32_t* a, size_t an, const uint32_t* b, size_t bn, uint32_t* r) {
+    std::fill(r, r + an + bn, 0);
+    for (size_t i = 0; i < an; i++) {
+        uint64_t x = a[i];
+        uint64_t carry = 0;
+        if (x == 0) {
+            continue;
+        }
+        for (size_t j = 0; j < bn; j++) {
+            uint64_t t = x * b[j] + r[i + j] + carry;
+            r[i + j] = (uint32_t)(t % BASE);
+            carry = t / BASE;
+        }
+        r[i + bn] = (uint32_t)carry;
+    }
+}
+
+// r[0, n) += a[0, an), an <= n; возвращает перенос из старшего limb
+template <uint64_t BASE>
+static uint32_t AddTo(uint32_t* r, size_t n, const uint32_t* a, size_t an) {
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < an; i++) {
+        uint64_t t = (uint64_t)r[i] + a[i] + carry;
+        carry = t >= BASE;
+        r[i] = (uint32_t)(carry ? t - BASE : t);
+    }
+    for (; carry && i < n; i++) {
+        uint64_t t = (uint64_t)r[i] + 1;
+        carry = t >= BASE;
+        r[i] = (uint32_t)(carry ? t - BASE : t);
+    }
+    return (uint32_t)carry;
+}
+
+// r[0, n) -= a[0, an), r >= a
+template <uint64_t BASE>
+static void SubFrom(uint32_t* r, size_t n, const uint32_t* a, size_t an) {
+    uint64_t borrow = 0;
+    size_t i = 0;
+    for (; i < an; i++) {
+        uint64_t t = (uint64_t)a[i] + borrow;
+        borrow = r[i] < t;
+        r[i] = (uint32_t)(borrow ? r[i] + BASE - t : r[i] - t);
+    }
+    for (; borrow && i < n; i++) {
+        borrow = r[i] == 0;
+        r[i] = (uint32_t)(borrow ? BASE - 1 : r[i] - 1);
+    }
+}
+
+// out = |x - y| в h limbs (xn, yn <= h); true - x < y
+template <uint64_t BASE>
+static bool Difference(const uint32_t* x, size_t xn, const uint32_t* y, size_t yn, size_t h, uint32_t* out) {
+    int order = 0;
+    for (size_t i = h; i-- > 0 && order == 0;) {
+        uint32_t xi = i < xn ? x[i] : 0;
+        uint32_t yi = i < yn ? y[i] : 0;
+        order = xi < yi ? -1 : xi > yi ? 1 : 0;
+    }
+    if (order < 0) {
+        std::swap(x, y);
+        std::swap(xn, yn);
+    }
+    std::copy(x, x + xn, out);
+    std::fill(out + xn, out + h, 0);
+    SubFrom<BASE>(out, h, y, yn);
+    return order < 0;
+}
+
+// r (2n limbs) = a * b для a, b по n limbs. Средний член - через
+// (a0 - a1)(b1 - b0): разности не длиннее половин, лишнего limb переноса
+// в рекурсии нет. scratch - не меньше 6n + 512 limbs
+template <uint64_t BASE>
+static void Karatsuba(const uint32_t* a, const uint32_t* b, size_t n, uint32_t* r, uint32_t* scratch) {
+    if (n < KARATSUBA_THRESHOLD) {
+        MulSchool<BASE>(a, n, b, n, r);
+        return;
+    }
+
+    size_t m = n / 2;
+    size_t h = n - m;
+    uint32_t* da = scratch;
+    uint32_t* db = da + h;
+    uint32_t* product = db + h;
+    uint32_t* middle = product + 2 * h;
+    uint32_t* next = middle + 2 * h + 1;
+
+    bool negative = Difference<BASE>(a, m, a + m, h, h, da) != Difference<BASE>(b + m, h, b, m, h, db);
+
+    Karatsuba<BASE>(a, b, m, r, next);
+    Karatsuba<BASE>(a + m, b + m, h, r + 2 * m, next);
+    Karatsuba<BASE>(da, db, h, product, next);
+
+    // a0 b1 + a1 b0 = a0 b0 + a1 b1 + (a0 - a1)(b1 - b0)
+    std::fill(middle, middle + 2 * h + 1, 0);
+    AddTo<BASE>(middle, 2 * h + 1, r, 2 * m);
+    AddTo<BASE>(middle, 2 * h + 1, r + 2 * m, 2 * h);
+    if (negative) {
+        SubFrom<BASE>(middle, 2 * h + 1, product, 2 * h);
+    }
+    else {
+        AddTo<BASE>(middle, 2 * h + 1, product, 2 * h);
+    }
+    AddTo<BASE>(r + m, 2 * n - m, middle, 2 * h + 1);
+}
+
+// Неравные длины: длинный множитель режется на куски длины короткого
+template <uint64_t BASE>
+static void MultiplyLimbs(const uint32_t* a, size_t an, const uint32_t* b, size_t bn, uint32_t* r) {
+    if (an < bn) {
+        std::swap(a, b);
+        std::swap(an, bn);
+    }
+    if (bn < KARATSUBA_THRESHOLD) {
+        MulSchool<BASE>(a, an, b, bn, r);
+        return;
+    }
+
+    std::vector<uint32_t> scratch(6 * bn + 512);
+    std::vector<uint32_t> piece(2 * bn);
+    std::fill(r, r + an + bn, 0);
+    for (size_t i = 0; i < an; i += bn) {
+        size_t length = an - i < bn ? an - i : bn;
+        if (length == bn) {
+            Karatsuba<BASE>(a + i, b, bn, piece.data(), scratch.data());
+        }
+        else {
+            MultiplyLimbs<BASE>(b, bn, a + i, length, piece.data());
+        }
+        AddTo<BASE>(r + i, an + bn - i, piece.data(), bn + length);
+    }
+}
+
+static void Trim(std::vector<uint32_t>& limbs) {
+    size_t size = limbs.size();
+    while (size > 0 && limbs[size - 1] == 0) {
+        size--;
+    }
+    limbs.resize(size);
+}
+
+void BigMultiplySchoolbook(const uint32_t* a, size_t aSize, const uint32_t* b, size_t bSize, uint32_t* out) {
+    MulSchool<BINARY_BASE>(a, aSize, b, bSize, out);
+}
+
+void BigMultiplyKaratsuba(const uint32_t* a, size_t aSize, const uint32_t* b, size_t bSize, uint32_t* out) {
+    MultiplyLimbs<BINARY_BASE>(a, aSize, b, bSize, out);
+}
+
+void BigMultiply(const BigInt& a, const BigInt& b, BigInt& out) {
+    if (a.limbs.empty() || b.limbs.empty()) {
+        out.limbs.clear();
+        out.shift = 0;
+        return;
+    }
+    out.limbs.resize(a.limbs.size() + b.limbs.size());
+    MultiplyLimbs<BINARY_BASE>(a.limbs.data(), a.limbs.size(), b.limbs.data(), b.limbs.size(), out.limbs.data());
+    Trim(out.limbs);
+    out.shift = a.shift + b.shift;
+}
+
+// Лист дерева: слова подряд умножаются на накопленное число
+static void ProductOfWords(const uint32_t* words, size_t count, std::vector<uint32_t>& out) {
+    if (count <= PRODUCT_LEAF_WORDS) {
+        out.assign(1, 1);
+        for (size_t i = 0; i < count; i++) {
+            uint64_t carry = 0;
+            for (uint32_t& limb : out) {
+                uint64_t t = (uint64_t)limb * words[i] + carry;
+                limb = (uint32_t)t;
+                carry = t >> 32;
+            }
+            if (carry) {
+                out.push_back((uint32_t)carry);
+            }
+        }
+        return;
+    }
+
+    std::vector<uint32_t> left;
+    std::vector<uint32_t> right;
+    ProductOfWords(words, count / 2, left);
+    ProductOfWords(words + count / 2, count - count / 2, right);
+    out.resize(left.size() + right.size());
+    MultiplyLimbs<BINARY_BASE>(left.data(), left.size(), right.data(), right.size(), out.data());
+    Trim(out);
+}
+
+void RangeProduct(uint64_t lo, uint64_t hi, BigInt& out) {
+    out.shift = 0;
+    if (lo == 0 && hi > lo) {
+        out.limbs.clear();
+        return;
+    }
+
+    // Нечётные части множителей по несколько в слово: первые уровни
+    // дерева - умножения uint64_t без обращения к памяти
+    std::vector<uint32_t> words;
+    uint64_t word = 1;
+    for (uint64_t k = lo; k < hi; k++) {
+        uint64_t odd = k;
+        while ((odd & 1) == 0) {
+            odd >>= 1;
+            out.shift++;
+        }
+        if (word * odd > UINT32_MAX) {
+            words.push_back((uint32_t)word);
+            word = odd;
+        }
+        else {
+            word *= odd;
+        }
+    }
+    if (word > 1 || words.empty()) {
+        words.push_back((uint32_t)word);
+    }
+
+    ProductOfWords(words.data(), words.size(), out.limbs);
+}
+
+static void ProductOfParts(BigInt* parts, size_t count, BigInt& out) {
+    if (count == 1) {
+        out = std::move(parts[0]);
+        return;
+    }
+    BigInt left;
+    BigInt right;
+    ProductOfParts(parts, count / 2, left);
+    ProductOfParts(parts + count / 2, count - count / 2, right);
+    BigMultiply(left, right, out);
+}
+
+void ProductOf(std::vector<BigInt>& parts, BigInt& out) {
+    if (parts.empty()) {
+        out.limbs.assign(1, 1);
+        out.shift = 0;
+        return;
+    }
+    ProductOfParts(parts.data(), parts.size(), out);
+}
+
+double RangeProductBits(uint64_t lo, uint64_t hi) {
+    if (hi <= lo || lo == 0) {
+        return 0;
+    }
+    // lgamma(k) = ln (k - 1)!
+    return (std::lgamma((double)hi) - std::lgamma((double)lo)) / std::log(2.0) + 64;
+}
+
+// Короткое число - делением на 10^9 в столбик, младшие цифры первыми
+static void ToDecimalLimbsSchool(const uint32_t* x, size_t n, std::vector<uint32_t>& out) {
+    std::vector<uint32_t> rest(x, x + n);
+    out.clear();
+    while (!rest.empty()) {
+        uint64_t remainder = 0;
+        for (size_t i = rest.size(); i-- > 0;) {
+            uint64_t t = (remainder << 32) | rest[i];
+            rest[i] = (uint32_t)(t / DECIMAL_BASE);
+            remainder = t % DECIMAL_BASE;
+        }
+        out.push_back((uint32_t)remainder);
+        Trim(rest);
+    }
+}
+
+// x = hi * 2^(32 m) + lo, m = 2^k: половины переводятся рекурсивно,
+// powers[k] - 2^(32 * 2^k) в основании 10^9
+static void ToDecimalLimbs(const uint32_t* x, size_t n, std::vector<std::vector<uint32_t>>& powers,
+    std::vector<uint32_t>& out) {
+    while (n > 0 && x[n - 1] == 0) {
+        n--;
+    }
+    if (n <= DECIMAL_SPLIT_LIMBS) {
+        ToDecimalLimbsSchool(x, n, out);
+        return;
+    }
+
+    size_t k = 0;
+    while (((size_t)2 << k) < n) {
+        k++;
+    }
+    size_t m = (size_t)1 << k;
+    while (powers.size() <= k) {
+        std::vector<uint32_t>& last = powers.back();
+        std::vector<uint32_t> square(2 * last.size());
+        MultiplyLimbs<DECIMAL_BASE>(last.data(), last.size(), last.data(), last.size(), square.data());
+        Trim(square);
+        powers.push_back(std::move(square));
+    }
+
+    std::vector<uint32_t> high;
+    std::vector<uint32_t> low;
+    ToDecimalLimbs(x + m, n - m, powers, high);
+    ToDecimalLimbs(x, m, powers, low);
+
+    const std::vector<uint32_t>& power = powers[k];
+    out.assign(high.size() + power.size() + 1, 0);
+    if (!high.empty()) {
+        MultiplyLimbs<DECIMAL_BASE>(high.data(), high.size(), power.data(), power.size(), out.data());
+    }
+    AddTo<DECIMAL_BASE>(out.data(), out.size(), low.data(), low.size());
+    Trim(out);
+}
+
+void BigToDecimal(const BigInt& value, std::string& out) {
+    out.clear();
+    if (value.limbs.empty()) {
+        out = "0";
+        return;
+    }
+
+    // Сдвиг на shift бит - в самих limbs
+    size_t limbShift = (size_t)(value.shift / 32);
+    int bitShift = (int)(value.shift % 32);
+    std::vector<uint32_t> binary(limbShift + value.limbs.size() + 1, 0);
+    for (size_t i = 0; i < value.limbs.size(); i++) {
+        uint64_t shifted = (uint64_t)value.limbs[i] << bitShift;
+        binary[limbShift + i] |= (uint32_t)shifted;
+        binary[limbShift + i + 1] = (uint32_t)(shifted >> 32);
+    }
+
+    std::vector<std::vector<uint32_t>> powers(1);
+    powers[0].push_back((uint32_t)(BINARY_BASE % DECIMAL_BASE));
+    powers[0].push_back((uint32_t)(BINARY_BASE / DECIMAL_BASE));
+    std::vector<uint32_t> digits;
+    ToDecimalLimbs(binary.data(), binary.size(), powers, digits);
+
+    char group[16];
+    out.reserve(digits.size() * 9);
+    for (size_t i = digits.size(); i-- > 0;) {
+        snprintf(group, sizeof(group), i + 1 == digits.size() ? "%u" : "%09u", digits[i]);
+        out += group;
+    }
+}
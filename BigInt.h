@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+
+constexpr size_t KARATSUBA_THRESHOLD = 40;     // limbs; короче - умножение в столбик
+constexpr size_t PRODUCT_LEAF_WORDS = 16;      // слов множителей в листе дерева
+
+// Натуральное число limbs * 2^shift; limbs - uint32_t от младшего, без
+// старших нулей. Ноль - пустой limbs
+struct BigInt {
+    std::vector<uint32_t> limbs;
+    uint64_t shift = 0;
+};
+
+// out = a * b; out не совпадает с a и b
+void BigMultiply(const BigInt& a, const BigInt& b, BigInt& out);
+
+// Отдельные реализации (для бенчмарка): out - aSize + bSize limbs
+void BigMultiplySchoolbook(const uint32_t* a, size_t aSize, const uint32_t* b, size_t bSize, uint32_t* out);
+void BigMultiplyKaratsuba(const uint32_t* a, size_t aSize, const uint32_t* b, size_t bSize, uint32_t* out);
+
+// Произведение целых из [lo, hi), lo >= 1. Двойки выносятся в shift,
+// нечётные части множителей упаковываются в слова, слова перемножаются
+// деревом: соседние произведения близки по длине, и Карацуба окупается
+void RangeProduct(uint64_t lo, uint64_t hi, BigInt& out);
+
+// Произведение всех чисел parts тем же деревом; parts портится
+void ProductOf(std::vector<BigInt>& parts, BigInt& out);
+
+// Оценка сверху числа бит произведения [lo, hi) по lgamma
+double RangeProductBits(uint64_t lo, uint64_t hi);
+
+// Десятичная запись: число делится пополам по степеням 2^32, половины
+// переводятся отдельно и склеиваются умножением в основании 10^9
+void BigToDecimal(const BigInt& value, std::string& out);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+// Очередь между потоками. capacity = 0 - без ограничения. После Close()
+// Push отказывает, а Pop отдаёт оставшееся и затем возвращает false
+template <typename T>
+class BlockingQueue {
+private:
+    std::deque<T> items;
+    std::mutex lock;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    size_t capacity;
+    bool closed;
+
+public:
+    explicit BlockingQueue(size_t maxItems = 0) : capacity(maxItems), closed(false) {}
+
+    BlockingQueue(const BlockingQueue&) = delete;
+    BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+    bool Push(T item) {
+        std::unique_lock<std::mutex> guard(lock);
+        notFull.wait(guard, [this]() { return closed || capacity == 0 || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        guard.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> guard(lock);
+        notEmpty.wait(guard, [this]() { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        guard.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Ждёт хотя бы один элемент и забирает до maxItems; 0 - очередь закрыта
+    size_t PopSome(std::vector<T>& out, size_t maxItems) {
+        std::unique_lock<std::mutex> guard(lock);
+        notEmpty.wait(guard, [this]() { return closed || !items.empty(); });
+        size_t taken = 0;
+        while (!items.empty() && taken < maxItems) {
+            out.push_back(std::move(items.front()));
+            items.pop_front();
+            taken++;
+        }
+        guard.unlock();
+        notFull.notify_all();
+        return taken;
+    }
+
+    void Close() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            closed = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+};
@@ -3,8 +3,15 @@
 #include <thread>
 #include <chrono>
 #include <sstream>
+#include <fstream>
+#include <random>
+#include <map>
+#include <queue>
+#include <cmath>
+#include <limits>
 
-Browser::Browser() : numWorkers(0), numTasks(0) {}
+Browser::Browser() : numWorkers(0), numTasks(0), maxInFlight(1), instance((uint32_t)CurrentProcessId()),
+    nextMatrixHandle(1), nextGraphHandle(1), nextSharedBuffer(1) {}
 
 Browser::~Browser() {
     Cleanup();
@@ -23,228 +30,572 @@ void Browser::GetUserInput() {
         std::cin >> numTasks;
     } while (numTasks < 1 || numTasks > 100);
 
+    do {
+        std::cout << "Enter tasks in flight per worker (1-" << MAX_IN_FLIGHT << "): ";
+        std::cin >> maxInFlight;
+    } while (maxInFlight < 1 || maxInFlight > MAX_IN_FLIGHT);
+
+    Configure(numWorkers, maxInFlight);
+}
+
+void Browser::Configure(int workerCount, int inFlight) {
+    numWorkers = workerCount;
+    maxInFlight = inFlight;
+
     workers.resize(numWorkers);
     for (int i = 0; i < numWorkers; i++) {
         workers[i].id = i;
         workers[i].isBusy = false;
-        workers[i].hProcess = INVALID_HANDLE_VALUE;
-        workers[i].hInputPipe = INVALID_HANDLE_VALUE;
-        workers[i].hOutputPipe = INVALID_HANDLE_VALUE;
+        workers[i].capabilities = 0;
+        workers[i].taskTypes = 0;
+        workers[i].computeThreads = 1;
+        workers[i].hProcess = INVALID_PROCESS_HANDLE;
     }
 }
 
-bool Browser::CreatePipes() {
-    SECURITY_ATTRIBUTES sa;
-    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
-    sa.bInheritHandle = TRUE;
-    sa.lpSecurityDescriptor = NULL;
-
+bool Browser::CreateEndpoints() {
     for (int i = 0; i < numWorkers; i++) {
-        std::string inputPipeName = GetInputPipeName(i);
-        std::string outputPipeName = GetOutputPipeName(i);
-
-        workers[i].hInputPipe = CreateNamedPipeA(
-            inputPipeName.c_str(),
-            PIPE_ACCESS_OUTBOUND,
-            PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT,
-            1,
-            sizeof(TaskMessage) + 1024,
-            sizeof(TaskMessage) + 1024,
-            0,
-            &sa
-        );
-
-        if (workers[i].hInputPipe == INVALID_HANDLE_VALUE) {
-            std::cerr << "Failed to create input pipe for worker " << i
-                << ". Error: " << GetLastError() << std::endl;
+        workers[i].endpoint.reset(new TransportEndpoint());
+        if (!workers[i].endpoint->Create(instance, i)) {
             return false;
         }
 
-        workers[i].hOutputPipe = CreateNamedPipeA(
-            outputPipeName.c_str(),
-            PIPE_ACCESS_INBOUND,
-            PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT,
-            1,
-            sizeof(ResultMessage) + 1024,
-            sizeof(ResultMessage) + 1024,
-            0,
-            &sa
-        );
-
-        if (workers[i].hOutputPipe == INVALID_HANDLE_VALUE) {
-            std::cerr << "Failed to create output pipe for worker " << i
-                << ". Error: " << GetLastError() << std::endl;
-            CloseHandle(workers[i].hInputPipe);
-            return false;
+        workers[i].ring.reset(new ShmRing());
+        if (!workers[i].ring->Create(GetRingName(instance, i), SHM_RING_SIZE)) {
+            std::cerr << "Shared memory unavailable for worker " << i
+                << ", large payloads will go through the pipe" << std::endl;
+            workers[i].ring.reset();
         }
 
-        std::cout << "Created pipes for worker " << i << std::endl;
+        std::cout << "Created endpoint for worker " << i << std::endl;
     }
 
     return true;
 }
 
-void Browser::CreateWorkerProcess(int workerId) {
-    STARTUPINFOA si;
-    PROCESS_INFORMATION pi;
-
-    ZeroMemory(&si, sizeof(si));
-    si.cb = sizeof(si);
-    ZeroMemory(&pi, sizeof(pi));
-
-    std::string cmdLine = "Worker.exe " + std::to_string(workerId);
-
-    char* cmdLineCopy = new char[cmdLine.length() + 1];
-    strcpy_s(cmdLineCopy, cmdLine.length() + 1, cmdLine.c_str());
-
-    if (!CreateProcessA(
-        NULL,
-        cmdLineCopy,
-        NULL,
-        NULL,
-        FALSE,
-        CREATE_NO_WINDOW,
-        NULL,
-        NULL,
-        &si,
-        &pi
-    )) {
-        std::cerr << "Failed to create worker process " << workerId
-            << ". Error: " << GetLastError() << std::endl;
-        delete[] cmdLineCopy;
-        return;
-    }
+bool Browser::CreateWorkerProcess(int workerId) {
+    unsigned long processId = 0;
+    // Ядра делятся между воркерами поровну
+    int cores = (int)std::thread::hardware_concurrency();
+    int threads = cores > numWorkers ? cores / numWorkers : 1;
+    std::vector<std::string> args = { std::to_string(workerId), std::to_string(instance), std::to_string(threads) };
 
-    delete[] cmdLineCopy;
-    workers[workerId].hProcess = pi.hProcess;
-    CloseHandle(pi.hThread);
+    if (!LaunchProcess(GetWorkerExecutable(), args, workers[workerId].hProcess, processId)) {
+        std::cerr << "Failed to create worker process " << workerId << std::endl;
+        return false;
+    }
 
-    std::cout << "Worker process " << workerId << " started (PID: " << pi.dwProcessId << ")" << std::endl;
+    std::cout << "Worker process " << workerId << " started (PID: " << processId << ")" << std::endl;
+    return true;
 }
 
-bool Browser::SendTaskToWorker(int workerId, const TaskMessage* task) {
-    WorkerInfo& worker = workers[workerId];
-
-    if (!ConnectNamedPipe(worker.hInputPipe, NULL)) {
-        DWORD err = GetLastError();
-        if (err != ERROR_PIPE_CONNECTED) {
-            std::cerr << "Failed to connect to worker " << workerId
-                << " input pipe. Error: " << err << std::endl;
+bool Browser::LaunchWorkerProcesses() {
+    // Все процессы стартуют сразу, подключения принимаются потом:
+    // точки подключения уже созданы, так что воркеры не ждут друг друга
+    for (int i = 0; i < numWorkers; i++) {
+        if (!CreateWorkerProcess(i)) {
             return false;
         }
     }
+    return true;
+}
+
+bool Browser::ConnectToWorker(int workerId, int timeoutMs) {
+    WorkerInfo& worker = workers[workerId];
 
-    uint32_t totalSize = sizeof(TaskMessage) + task->dataSize;
-    DWORD bytesWritten;
+    worker.transport = worker.endpoint->Accept(timeoutMs);
+    worker.endpoint.reset();
+    if (!worker.transport) {
+        return false;
+    }
 
-    if (!WriteFile(worker.hInputPipe, task, totalSize, &bytesWritten, NULL)) {
-        std::cerr << "Failed to send task to worker " << workerId
-            << ". Error: " << GetLastError() << std::endl;
+    WorkerHello hello;
+    if (!worker.transport->Receive(&hello, sizeof(hello))) {
+        std::cerr << "Worker " << workerId << " closed the connection before READY" << std::endl;
         return false;
     }
 
-    if (bytesWritten != totalSize) {
-        std::cerr << "Partial write to worker " << workerId << std::endl;
+    if (hello.magic != WORKER_HELLO_MAGIC || hello.version != PROTOCOL_VERSION ||
+        hello.workerId != (uint32_t)workerId) {
+        std::cerr << "Worker " << workerId << " sent an invalid READY (version "
+            << hello.version << ", id " << hello.workerId << ")" << std::endl;
         return false;
     }
 
-    FlushFileBuffers(worker.hInputPipe);
-    worker.isBusy = true;
+    worker.capabilities = hello.capabilities;
+    worker.taskTypes = hello.taskTypes;
 
-    return true;
+    // Воркер не смог открыть кольцо: крупные нагрузки идут через канал
+    if (!(hello.capabilities & WORKER_CAP_SHM_RING)) {
+        worker.ring.reset();
+    }
+
+    worker.computeThreads = hello.computeThreads > 0 ? (int)hello.computeThreads : 1;
+    scheduler.SetTaskTypes(workerId, hello.taskTypes);
+    scheduler.SetParallelism(workerId, (uint32_t)worker.computeThreads);
+
+    std::cout << "Worker " << workerId << " ready (PID: " << hello.processId
+        << ", threads: " << worker.computeThreads
+        << ", capabilities: 0x" << std::hex << hello.capabilities
+        << ", task types: 0x" << hello.taskTypes << std::dec << ")" << std::endl;
+
+    return dispatcher.Attach(workerId, worker.transport.get(),
+        (hello.capabilities & WORKER_CAP_BATCH) != 0, worker.computeThreads);
 }
 
-bool Browser::ReceiveResultFromWorker(int workerId) {
-    WorkerInfo& worker = workers[workerId];
+int Browser::WindowFor(int workerId) const {
+    return maxInFlight * workers[workerId].computeThreads;
+}
+
+int Browser::TotalWindow() const {
+    int window = 0;
+    for (int i = 0; i < numWorkers; i++) {
+        window += WindowFor(i);
+    }
+    return window;
+}
 
-    if (!ConnectNamedPipe(worker.hOutputPipe, NULL)) {
-        DWORD err = GetLastError();
-        if (err != ERROR_PIPE_CONNECTED) {
-            std::cerr << "Failed to connect to worker " << workerId
-                << " output pipe. Error: " << err << std::endl;
-            worker.isBusy = false;
+size_t Browser::BalancedShare(size_t count) const {
+    size_t parts = (size_t)numWorkers * 4;
+    return (count + parts - 1) / parts;
+}
+
+bool Browser::RequireTaskType(MessageType type, const char* name) const {
+    for (const WorkerInfo& worker : workers) {
+        if (!(worker.taskTypes & TaskTypeBit(type))) {
+            std::cerr << "Worker " << worker.id << " does not support " << name << std::endl;
             return false;
         }
     }
+    return true;
+}
 
-    ResultMessage header;
-    DWORD bytesRead;
+bool Browser::RequireCapability(uint32_t capability, const char* name) const {
+    for (const WorkerInfo& worker : workers) {
+        if (!(worker.capabilities & capability)) {
+            std::cerr << "Worker " << worker.id << " does not support " << name << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
 
-    if (!ReadFile(worker.hOutputPipe, &header, sizeof(ResultMessage), &bytesRead, NULL)) {
-        DWORD err = GetLastError();
-        std::cerr << "Failed to read result header from worker " << workerId
-            << ". Error: " << err << std::endl;
-        worker.isBusy = false;
+bool Browser::RunScatterGather(const char* what, uint32_t base, uint64_t count, const TaskMaker& makeTask,
+    const ResultHandler& onResult, uint64_t* made) {
+    // taskId операции - [base, 2 * base)
+    if (count != SCATTER_UNTIL_DONE && count > base) {
+        std::cerr << "Too many tasks: " << count << " of " << what << std::endl;
         return false;
     }
 
-    if (bytesRead != sizeof(ResultMessage)) {
-        std::cerr << "Incomplete result header from worker " << workerId << std::endl;
-        worker.isBusy = false;
-        return false;
+    int window = TotalWindow();
+    uint64_t next = 0;
+    uint64_t received = 0;
+    int outstanding = 0;
+    bool more = true;
+    bool ok = true;
+
+    while (true) {
+        while (ok && more && next < count && outstanding < window) {
+            ScheduledTask task;
+            task.cost = 0;
+            if (!makeTask((uint32_t)next, task)) {
+                more = false;
+                break;
+            }
+            if (next >= base) {
+                std::cerr << "Too many tasks: " << what << " " << next << " is past the task id range" << std::endl;
+                ok = false;
+                break;
+            }
+            task.header.taskId = base + (uint32_t)next;
+            task.enqueued = std::chrono::steady_clock::now();
+
+            if (scheduler.Enqueue(std::move(task)) == -1) {
+                std::cerr << "No worker accepts " << what << " " << next << std::endl;
+                ok = false;
+                break;
+            }
+            next++;
+            outstanding++;
+        }
+
+        if (outstanding == 0) {
+            break;
+        }
+
+        DispatchPending();
+
+        Completion completion;
+        if (!ReceiveNextResult(completion)) {
+            std::cerr << "No live workers left." << std::endl;
+            ok = false;
+            break;
+        }
+        outstanding--;
+
+        uint32_t index = completion.taskId - base;
+        if (!completion.ok || index >= next || !onResult(index, completion)) {
+            std::cerr << "Worker " << completion.workerId << " failed " << what << " " << index << std::endl;
+            ok = false;
+            continue;
+        }
+        received++;
+    }
+
+    if (made) {
+        *made = next;
     }
+    return ok && received == next;
+}
 
-    uint32_t totalSize = sizeof(ResultMessage) + header.resultSize;
-    ResultMessage* fullResult = (ResultMessage*)malloc(totalSize);
-    if (!fullResult) {
-        std::cerr << "Memory allocation failed!" << std::endl;
-        worker.isBusy = false;
+bool Browser::BroadcastPinned(const char* what, MessageType type, uint32_t base, uint32_t pieces,
+    const PieceMaker& makePiece, const AckHandler& onAck, std::vector<int>* targets) {
+    // Задачи закреплены: воркер, на котором кусок выполнится, известен заранее
+    std::vector<uint32_t> sent(numWorkers, pieces);
+    std::vector<uint32_t> acked(numWorkers, pieces);
+    std::vector<int> outstanding(numWorkers, 0);
+    std::map<uint32_t, std::pair<int, uint32_t>> taskPiece;   // taskId -> воркер и кусок
+    uint64_t total = 0;
+    if (targets) {
+        targets->clear();
+    }
+    for (int i = 0; i < numWorkers; i++) {
+        if (dispatcher.IsAlive(i) && (workers[i].taskTypes & TaskTypeBit(type))) {
+            sent[i] = 0;
+            acked[i] = 0;
+            total += pieces;
+            if (targets) {
+                targets->push_back(i);
+            }
+        }
+    }
+    if (total > base) {
+        std::cerr << "Too many tasks: " << total << " of " << what << std::endl;
         return false;
     }
 
-    memcpy(fullResult, &header, sizeof(ResultMessage));
+    uint32_t sequence = 0;
+    bool ok = true;
+
+    while (true) {
+        for (int i = 0; ok && i < numWorkers; i++) {
+            while (sent[i] < pieces && outstanding[i] < WindowFor(i)) {
+                ScheduledTask task;
+                task.cost = 0;
+                makePiece(sent[i], task);
+                task.header.taskId = base + sequence;
+                task.enqueued = std::chrono::steady_clock::now();
+
+                if (scheduler.EnqueueTo(i, std::move(task)) == -1) {
+                    std::cerr << "Worker " << i << " does not accept " << what << std::endl;
+                    ok = false;
+                    break;
+                }
+                taskPiece[base + sequence] = std::make_pair(i, sent[i]);
+                sequence++;
+                sent[i]++;
+                outstanding[i]++;
+            }
+        }
 
-    if (header.resultSize > 0) {
-        if (!ReadFile(worker.hOutputPipe, fullResult->data, header.resultSize, &bytesRead, NULL)) {
-            std::cerr << "Failed to read result data from worker " << workerId << std::endl;
-            free(fullResult);
-            worker.isBusy = false;
-            return false;
+        if (taskPiece.empty()) {
+            break;
         }
 
-        if (bytesRead != header.resultSize) {
-            std::cerr << "Incomplete result data from worker " << workerId << std::endl;
-            free(fullResult);
-            worker.isBusy = false;
+        DispatchPending();
+
+        Completion completion;
+        if (!ReceiveNextResult(completion)) {
+            std::cerr << "No live workers left." << std::endl;
             return false;
         }
+
+        auto target = taskPiece.find(completion.taskId);
+        if (target == taskPiece.end()) {
+            std::cerr << "Unexpected " << what << " task " << completion.taskId << std::endl;
+            ok = false;
+            continue;
+        }
+        int workerId = target->second.first;
+        uint32_t piece = target->second.second;
+        taskPiece.erase(target);
+        outstanding[workerId]--;
+
+        if (!completion.ok || (onAck && !onAck(workerId, piece, completion))) {
+            std::cerr << "Worker " << workerId << " failed " << what << " " << piece << std::endl;
+            ok = false;
+            continue;
+        }
+        acked[workerId]++;
+    }
+
+    for (int i = 0; ok && i < numWorkers; i++) {
+        ok = acked[i] == pieces;
+    }
+    return ok;
+}
+
+void Browser::DispatchPending() {
+    for (int i = 0; i < numWorkers; i++) {
+        while (dispatcher.IsAlive(i) && dispatcher.InFlight(i) < WindowFor(i)) {
+            ScheduledTask task;
+            if (!scheduler.NextFor(i, task)) {
+                break;
+            }
+
+            TraceStamps stamps = {};
+            bool traced = tracer.Enabled() && (workers[i].capabilities & WORKER_CAP_TRACE);
+            if (traced) {
+                stamps.enqueued = TraceTime(task.enqueued);
+                stamps.sent = TraceClock();
+                tracer.OnSent(task.header.taskId, task.header.type);
+            }
+
+            if (!SendTaskToWorker(i, task.header, task.payload.Data(), traced ? &stamps : nullptr)) {
+                std::cerr << "Failed to send task " << task.header.taskId
+                    << " to worker " << i << std::endl;
+                std::vector<uint32_t> lost;
+                scheduler.MarkDead(i, lost);
+                uint32_t taskId = task.header.taskId;
+                if (scheduler.Enqueue(std::move(task)) == -1) {
+                    lost.push_back(taskId);
+                }
+                FailTasks(lost);
+                break;
+            }
+
+            scheduler.OnDispatched(i, task.header.taskId, task.cost);
+        }
+    }
+}
+
+bool Browser::SubmitToWorker(int workerId, TaskMessage header, const void* payload, const TraceStamps* trace) {
+    if (!trace) {
+        return dispatcher.Submit(workerId, header, payload);
+    }
+    // Отметки уходят отдельным фрагментом кадра, нагрузка не копируется;
+    // воркер принимает задачу длиннее MAX_DATA_SIZE на их размер
+    header.dataSize += sizeof(*trace);
+    header.flags |= TASK_FLAG_TRACE;
+    return dispatcher.Submit(workerId, header, payload, trace, sizeof(*trace));
+}
+
+bool Browser::SendTaskToWorker(int workerId, const TaskMessage& header, const void* payload,
+    const TraceStamps* trace) {
+    WorkerInfo& worker = workers[workerId];
+
+    // Крупная нагрузка копируется из буфера задачи в кольцо один раз; по каналу
+    // идёт только дескриптор, и воркер читает нагрузку на месте
+    if (worker.ring && header.dataSize >= SHM_THRESHOLD && header.type != MessageType::TERMINATE) {
+        ShmDescriptor descriptor;
+        char* slot = worker.ring->Allocate(header.taskId, header.dataSize, descriptor);
+        if (slot) {
+            memcpy(slot, payload, header.dataSize);
+            TaskMessage shmHeader = header;
+            shmHeader.dataSize = sizeof(descriptor);
+            shmHeader.flags |= TASK_FLAG_SHM_PAYLOAD;
+
+            if (!SubmitToWorker(workerId, shmHeader, &descriptor, trace)) {
+                worker.ring->Release(header.taskId);
+                return false;
+            }
+
+            worker.isBusy = true;
+            return true;
+        }
+    }
+
+    // Через канал: повторяющиеся нагрузки уходят сжатыми, если выборка
+    // обещает выигрыш и кадр действительно вышел меньше
+    TaskMessage wireHeader = header;
+    const void* wirePayload = payload;
+    if ((worker.capabilities & WORKER_CAP_RLE) && header.type != MessageType::TERMINATE &&
+        RleWorthTrying((const char*)payload, header.dataSize)) {
+        packedPayload.Clear();
+        if (RleEncode((const char*)payload, header.dataSize, packedPayload,
+            (size_t)(header.dataSize * RLE_MAX_RATIO))) {
+            wireHeader.dataSize = (uint32_t)packedPayload.Size();
+            wireHeader.flags |= TASK_FLAG_RLE;
+            wirePayload = packedPayload.Data();
+            taskWire.compressed++;
+        }
+    }
+    taskWire.messages++;
+    taskWire.rawBytes += header.dataSize;
+    taskWire.wireBytes += wireHeader.dataSize;
+
+    if (!SubmitToWorker(workerId, wireHeader, wirePayload, trace)) {
+        return false;
+    }
+
+    workers[workerId].isBusy = true;
+    return true;
+}
+
+bool Browser::ReceiveNextResult(Completion& completion, int timeoutMs) {
+    if (!cachedCompletions.empty()) {
+        completion = std::move(cachedCompletions.front());
+        cachedCompletions.pop_front();
+        return true;
     }
 
-    if (header.resultSize == sizeof(uint32_t)) {
-        uint32_t count = *(uint32_t*)fullResult->data;
-        std::cout << "Browser: Received result for task " << fullResult->taskId
-            << " from worker " << workerId
-            << ": count = " << count << std::endl;
+    if (!dispatcher.WaitCompletion(completion, timeoutMs)) {
+        return false;
+    }
+    if (tracer.Enabled()) {
+        tracer.OnCompleted(completion);
+    }
+    completion.flags &= ~RESULT_FLAG_TRACE;
+
+    WorkerInfo& worker = workers[completion.workerId];
+    worker.isBusy = dispatcher.InFlight(completion.workerId) > 0;
+    if (worker.ring) {
+        // Результат на месте нагрузки забираем до освобождения места
+        ShmDescriptor descriptor;
+        if ((completion.flags & RESULT_FLAG_IN_PLACE) && completion.data.Empty() &&
+            worker.ring->Lookup(completion.taskId, descriptor)) {
+            completion.data.Append(worker.ring->Slot(descriptor), descriptor.size);
+        }
+        worker.ring->Release(completion.taskId);
     }
 
-    free(fullResult);
-    worker.isBusy = false;
+    if (completion.ok && !(completion.flags & RESULT_FLAG_IN_PLACE)) {
+        resultWire.messages++;
+        resultWire.wireBytes += completion.data.Size();
+        if (completion.flags & RESULT_FLAG_RLE) {
+            MessageBuffer unpacked;
+            resultWire.compressed++;
+            completion.ok = RleDecode(completion.data.Data(), completion.data.Size(), MAX_FRAME_SIZE, unpacked);
+            if (!completion.ok) {
+                std::cerr << "Corrupt compressed result for task " << completion.taskId
+                    << " from worker " << completion.workerId << std::endl;
+            }
+            completion.data = std::move(unpacked);
+            completion.flags &= ~RESULT_FLAG_RLE;
+        }
+        resultWire.rawBytes += completion.data.Size();
+    }
 
-    DisconnectNamedPipe(worker.hInputPipe);
-    DisconnectNamedPipe(worker.hOutputPipe);
+    scheduler.OnCompleted(completion.workerId, completion.taskId);
+    if (!dispatcher.IsAlive(completion.workerId)) {
+        std::vector<uint32_t> lost;
+        scheduler.MarkDead(completion.workerId, lost);
+        FailTasks(lost);
+    }
 
+    ShareResult(completion);
     return true;
 }
 
+void Browser::EnableResultCache(size_t maxBytes) {
+    resultCache.SetCapacity(maxBytes);
+}
+
+int Browser::EnqueueCached(ScheduledTask&& task) {
+    if (!resultCache.Enabled()) {
+        return scheduler.Enqueue(std::move(task));
+    }
+
+    uint32_t taskId = task.header.taskId;
+    Completion completion;
+    completion.workerId = -1;
+    completion.taskId = taskId;
+    completion.ok = true;
+    completion.flags = 0;
+
+    switch (resultCache.Begin(MakeResultKey(task.header, task.payload), task.payload, taskId,
+        completion.data, completion.flags)) {
+    case CacheOutcome::HIT:
+        completion.flags |= RESULT_FLAG_CACHED;
+        cachedCompletions.push_back(std::move(completion));
+        return RESULT_CACHED;
+    case CacheOutcome::JOINED:
+        return RESULT_CACHED;
+    case CacheOutcome::MISS:
+        break;
+    }
+
+    int workerId = scheduler.Enqueue(std::move(task));
+    if (workerId == -1) {
+        resultCache.Abandon(taskId);
+    }
+    return workerId;
+}
+
+// Задачи без живого исполнителя: ответ-ошибка, как от отвалившегося
+// воркера, чтобы отправитель не ждал их вечно
+void Browser::FailTasks(const std::vector<uint32_t>& taskIds) {
+    for (uint32_t taskId : taskIds) {
+        std::cerr << "No live worker accepts task " << taskId << std::endl;
+        Completion completion;
+        completion.workerId = -1;
+        completion.taskId = taskId;
+        completion.ok = false;
+        completion.flags = 0;
+        ShareResult(completion);
+        cachedCompletions.push_back(std::move(completion));
+    }
+}
+
+// Ответ ведущей задачи кэша - копия каждой ждавшей его, с тем же
+// исходом: воркер отвалился - повторы тоже не выполнены
+void Browser::ShareResult(const Completion& completion) {
+    std::vector<uint32_t> followers;
+    if (!resultCache.Complete(completion.taskId, completion.ok, completion.data, completion.flags, followers)) {
+        return;
+    }
+
+    for (uint32_t taskId : followers) {
+        Completion copy;
+        copy.workerId = completion.workerId;
+        copy.taskId = taskId;
+        copy.ok = completion.ok;
+        copy.flags = completion.flags | RESULT_FLAG_CACHED;
+        copy.data.Append(completion.data.Data(), completion.data.Size());
+        cachedCompletions.push_back(std::move(copy));
+    }
+}
+
 bool Browser::Initialize() {
     std::cout << "Initializing Browser..." << std::endl;
 
-    if (!CreatePipes()) {
-        std::cerr << "Failed to create pipes." << std::endl;
+    if (!CreateEndpoints()) {
+        std::cerr << "Failed to create endpoints." << std::endl;
+        return false;
+    }
+
+    scheduler.Configure(numWorkers);
+
+    auto startTime = std::chrono::steady_clock::now();
+    auto deadline = startTime + std::chrono::milliseconds(WORKER_START_TIMEOUT_MS);
+
+    if (!LaunchWorkerProcesses()) {
         return false;
     }
 
     for (int i = 0; i < numWorkers; i++) {
-        CreateWorkerProcess(i);
-        Sleep(1000);
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        int timeoutMs = remaining.count() > 0 ? (int)remaining.count() : 0;
+
+        if (!ConnectToWorker(i, timeoutMs)) {
+            std::cerr << "Failed to connect to worker " << i << "." << std::endl;
+            return false;
+        }
     }
 
+    auto startupTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime);
+    std::cout << "All " << numWorkers << " workers ready in " << startupTime.count() << " ms" << std::endl;
+
     return true;
 }
 
 void Browser::Run() {
     std::cout << "\n=== Starting task distribution ===" << std::endl;
-    std::cout << "Workers: " << numWorkers << ", Tasks: " << numTasks << std::endl;
+    std::cout << "Workers: " << numWorkers << ", Tasks: " << numTasks
+        << ", In flight per worker: " << maxInFlight << std::endl;
 
     auto startTime = std::chrono::high_resolution_clock::now();
 
@@ -258,138 +609,2489 @@ void Browser::Run() {
 
     std::vector<std::string> patterns = { "hello", "test", "aaa", "fox", "cat" };
 
-    for (int taskId = 0; taskId < numTasks; taskId++) {
-        int workerId = -1;
-        for (int i = 0; i < numWorkers; i++) {
-            if (!workers[i].isBusy) {
-                workerId = i;
-                break;
-            }
-        }
-
-        if (workerId == -1) {
-            for (int i = 0; i < numWorkers; i++) {
-                if (workers[i].isBusy) {
-                    ReceiveResultFromWorker(i);
-                }
-            }
-            workerId = 0;
-        }
+    int rejectedTasks = 0;
 
+    for (int taskId = 0; taskId < numTasks; taskId++) {
         int stringIndex = taskId % testStrings.size();
         int patternIndex = taskId % patterns.size();
 
         std::string text = testStrings[stringIndex];
         std::string pattern = patterns[patternIndex];
 
+        ScheduledTask task;
+        task.payload.Append(text.data(), text.size());
+        task.payload.Append(pattern.data(), pattern.size());
+        task.header = MakeTaskHeader(MessageType::TASK_SUBSTRING, taskId,
+            static_cast<uint32_t>(task.payload.Size()), static_cast<uint32_t>(pattern.size()));
+        task.cost = 0;
+        task.enqueued = std::chrono::steady_clock::now();
+
+        int workerId = EnqueueCached(std::move(task));
+
         std::cout << "\n--- Task " << taskId << " ---" << std::endl;
         std::cout << "Text: \"" << text << "\"" << std::endl;
         std::cout << "Pattern: \"" << pattern << "\"" << std::endl;
+        if (workerId == -1) {
+            std::cerr << "No worker accepts task " << taskId << std::endl;
+            rejectedTasks++;
+            continue;
+        }
+        if (workerId == RESULT_CACHED) {
+            std::cout << "Worker: cached" << std::endl;
+            continue;
+        }
         std::cout << "Worker: " << workerId << std::endl;
+    }
 
-        std::vector<char> buffer;
-        buffer.insert(buffer.end(), text.begin(), text.end());
-        buffer.push_back('\0');
-        buffer.insert(buffer.end(), pattern.begin(), pattern.end());
-        buffer.push_back('\0');
-
-        TaskMessage* task = CreateTaskMessage(
-            MessageType::TASK_SUBSTRING,
-            taskId,
-            buffer.data(),
-            static_cast<uint32_t>(buffer.size())
-        );
-
-        if (!task) {
-            std::cerr << "Failed to create task " << taskId << std::endl;
-            continue;
+    // Все образцы по каждому тексту - одной задачей, если воркеры это умеют
+    int totalTasks = numTasks;
+    bool multiPattern = true;
+    for (const WorkerInfo& worker : workers) {
+        multiPattern = multiPattern && (worker.capabilities & WORKER_CAP_MULTI_PATTERN);
+    }
+
+    for (size_t i = 0; multiPattern && i < testStrings.size(); i++) {
+        ScheduledTask task;
+        AppendMultiPatternPayload(task.payload, testStrings[i], patterns);
+        task.header = MakeTaskHeader(MessageType::TASK_SUBSTRING, totalTasks,
+            static_cast<uint32_t>(task.payload.Size()), static_cast<uint32_t>(patterns.size()));
+        task.header.flags |= TASK_FLAG_MULTI_PATTERN;
+        task.cost = 0;
+        task.enqueued = std::chrono::steady_clock::now();
+
+        std::cout << "\n--- Task " << totalTasks << " (all patterns) ---" << std::endl;
+        std::cout << "Text: \"" << testStrings[i] << "\"" << std::endl;
+        if (EnqueueCached(std::move(task)) == -1) {
+            std::cerr << "No worker accepts task " << totalTasks << std::endl;
+            rejectedTasks++;
         }
+        totalTasks++;
+    }
 
-        std::cout << "Sending task to worker " << workerId << std::endl;
-        if (!SendTaskToWorker(workerId, task)) {
-            std::cerr << "Failed to send task " << taskId << std::endl;
-            FreeTaskMessage(task);
-            continue;
+    int completedTasks = 0;
+
+    while (completedTasks + rejectedTasks < totalTasks) {
+        DispatchPending();
+
+        Completion completion;
+        if (!ReceiveNextResult(completion)) {
+            std::cerr << "No live workers left." << std::endl;
+            break;
         }
+        completedTasks++;
 
-        FreeTaskMessage(task);
+        std::ostringstream source;
+        if (completion.workerId == -1) {
+            source << (completion.ok ? "cache" : "scheduler");
+        }
+        else {
+            source << "worker " << completion.workerId;
+            if (completion.flags & RESULT_FLAG_CACHED) {
+                source << " (shared)";
+            }
+        }
 
-        if (!ReceiveResultFromWorker(workerId)) {
-            std::cerr << "Failed to get result for task " << taskId << std::endl;
+        if (!completion.ok) {
+            std::cerr << "Failed to get result for task " << completion.taskId
+                << " from " << source.str() << std::endl;
+        }
+        else if (completion.data.Size() == sizeof(uint32_t)) {
+            uint32_t count;
+            memcpy(&count, completion.data.Data(), sizeof(count));
+            std::cout << "Browser: Received result for task " << completion.taskId
+                << " from " << source.str()
+                << ": count = " << count << std::endl;
+        }
+        else if (completion.data.Size() == patterns.size() * sizeof(uint32_t)) {
+            std::cout << "Browser: Received result for task " << completion.taskId
+                << " from " << source.str() << ":";
+            for (size_t i = 0; i < patterns.size(); i++) {
+                uint32_t count;
+                memcpy(&count, completion.data.Data() + i * sizeof(count), sizeof(count));
+                std::cout << " " << patterns[i] << " = " << count;
+            }
+            std::cout << std::endl;
         }
     }
 
+    std::cout << "Tasks stolen by idle workers: " << scheduler.Stolen() << std::endl;
+    if (resultCache.Enabled()) {
+        const ResultCacheStats& stats = resultCache.Stats();
+        std::cout << "Result cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+            << stats.joined << " shared in flight, " << stats.evictions << " evictions, "
+            << stats.entries << " entries (" << stats.bytes << " bytes)" << std::endl;
+    }
+
     auto endTime = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
 
     std::cout << "\n=== All tasks completed ===" << std::endl;
     std::cout << "Total time: " << duration.count() << " ms" << std::endl;
-    std::cout << "Average time per task: " << duration.count() / (double)numTasks << " ms" << std::endl;
+    std::cout << "Average time per task: " << duration.count() / (double)totalTasks << " ms" << std::endl;
 
-    std::cout << "\n=== Sending termination commands ===" << std::endl;
-    for (int i = 0; i < numWorkers; i++) {
-        TaskMessage* termTask = CreateTaskMessage(MessageType::TERMINATE, 0, nullptr, 0);
-        if (termTask) {
-            if (SendTaskToWorker(i, termTask)) {
-                ReceiveResultFromWorker(i);
+}
+
+bool Browser::RunLoadBenchmark(const LoadSpec& spec) {
+    for (const LoadMixEntry& entry : spec.mix) {
+        if (!RequireTaskType(entry.type, (entry.name + " tasks").c_str())) {
+            return false;
+        }
+    }
+
+    std::mt19937_64 rng(spec.seed);
+    std::vector<char> source;
+    FillLoadSource(source, rng);
+
+    std::vector<double> weights;
+    for (const LoadMixEntry& entry : spec.mix) {
+        weights.push_back(entry.weight);
+    }
+    std::discrete_distribution<size_t> pickType(weights.begin(), weights.end());
+    std::exponential_distribution<double> gap(spec.rate > 0 ? spec.rate : 1.0);
+
+    int window = TotalWindow();
+    bool openLoop = spec.rate > 0;
+    uint64_t concurrency = spec.concurrency > 0 ? (uint64_t)spec.concurrency : (uint64_t)window;
+    uint64_t total = spec.warmup + spec.tasks;
+
+    LoadReport report;
+    report.types.resize(spec.mix.size());
+    report.concurrency = openLoop ? 0 : (int)concurrency;
+
+    std::cout << "\n=== Load benchmark: " << spec.warmup << " warm-up + " << spec.tasks << " tasks, ";
+    if (openLoop) {
+        std::cout << "open loop at " << spec.rate << " tasks/s" << (spec.poisson ? " (Poisson)" : "");
+    }
+    else {
+        std::cout << "closed loop, " << concurrency << " outstanding";
+    }
+    std::cout << " ===" << std::endl;
+
+    bool tracing = !spec.tracePath.empty();
+    if (tracing) {
+        tracer.Clear();
+        tracer.Enable(true);
+    }
+
+    // Задержка считается от назначенного прихода задачи, а не от её
+    // отправки: отставший генератор не прячет очередь
+    struct Outstanding {
+        size_t type;
+        uint32_t bytes;
+        std::chrono::steady_clock::time_point start;
+    };
+    std::map<uint32_t, Outstanding> outstanding;
+    uint64_t issued = 0;
+    uint64_t finished = 0;
+    bool ok = true;
+
+    auto nextArrival = std::chrono::steady_clock::now();
+    auto measureStart = nextArrival;
+    auto measureEnd = nextArrival;
+
+    while (finished < total) {
+        auto now = std::chrono::steady_clock::now();
+        while (issued < total && (openLoop ? nextArrival <= now : issued - finished < concurrency)) {
+            auto start = openLoop ? nextArrival : now;
+            if (issued == spec.warmup) {
+                measureStart = start;
+            }
+            if (openLoop) {
+                double seconds = spec.poisson ? gap(rng) : 1.0 / spec.rate;
+                nextArrival += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(seconds));
+            }
+
+            size_t type = pickType(rng);
+            uint32_t taskId = (uint32_t)issued++;
+            ScheduledTask task;
+            MakeLoadTask(spec.mix[type].type, taskId, spec.mix[type].size.Sample(rng), source, rng,
+                task.header, task.payload);
+            task.cost = Scheduler::EstimateCost(task.header.type, task.header.dataSize);
+            task.enqueued = now;
+
+            Outstanding record = { type, task.header.dataSize, start };
+            if (scheduler.Enqueue(std::move(task)) == -1) {
+                std::cerr << "No worker accepts task " << taskId << std::endl;
+                report.types[type].errors += taskId >= spec.warmup;
+                finished++;
+                continue;
             }
-            FreeTaskMessage(termTask);
+            outstanding[taskId] = record;
         }
+        DispatchPending();
 
-        if (workers[i].hInputPipe != INVALID_HANDLE_VALUE) {
-            CloseHandle(workers[i].hInputPipe);
-            workers[i].hInputPipe = INVALID_HANDLE_VALUE;
+        int timeoutMs = -1;
+        if (openLoop && issued < total) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+                nextArrival - std::chrono::steady_clock::now());
+            timeoutMs = wait.count() > 0 ? (int)wait.count() : 0;
+        }
+
+        Completion completion;
+        if (!ReceiveNextResult(completion, timeoutMs)) {
+            // Открытый цикл: пора ставить следующие задачи или ждать их прихода
+            if (timeoutMs < 0 || (dispatcher.TotalInFlight() == 0 && !outstanding.empty())) {
+                std::cerr << "No live workers left." << std::endl;
+                ok = false;
+                break;
+            }
+            if (dispatcher.TotalInFlight() == 0) {
+                std::this_thread::sleep_until(nextArrival);
+            }
+            continue;
         }
 
-        if (workers[i].hOutputPipe != INVALID_HANDLE_VALUE) {
-            CloseHandle(workers[i].hOutputPipe);
-            workers[i].hOutputPipe = INVALID_HANDLE_VALUE;
+        auto done = std::chrono::steady_clock::now();
+        auto it = outstanding.find(completion.taskId);
+        if (it == outstanding.end()) {
+            continue;
         }
-    }
-    WaitForAllWorkers();
-}
+        finished++;
 
-void Browser::WaitForAllWorkers() {
-    for (auto& worker : workers) {
-        if (worker.hProcess != INVALID_HANDLE_VALUE) {
-            WaitForSingleObject(worker.hProcess, INFINITE);
-            CloseHandle(worker.hProcess);
-            worker.hProcess = INVALID_HANDLE_VALUE;
+        if (completion.taskId >= spec.warmup) {
+            LoadResult& result = report.types[it->second.type];
+            if (!completion.ok || completion.data.Empty()) {
+                result.errors++;
+            }
+            else {
+                result.completed++;
+                result.bytesIn += it->second.bytes;
+                result.bytesOut += completion.data.Size();
+                result.latency.Record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    done - it->second.start).count());
+            }
+            measureEnd = done;
         }
+        outstanding.erase(it);
     }
-}
 
-void Browser::Cleanup() {
-    std::cout << "Cleaning up..." << std::endl;
+    report.seconds = std::chrono::duration<double>(measureEnd - measureStart).count();
+    for (const LoadResult& result : report.types) {
+        report.total.latency.Merge(result.latency);
+        report.total.completed += result.completed;
+        report.total.errors += result.errors;
+        report.total.bytesIn += result.bytesIn;
+        report.total.bytesOut += result.bytesOut;
+    }
 
-    for (auto& worker : workers) {
-        if (worker.hInputPipe != INVALID_HANDLE_VALUE) {
-            CloseHandle(worker.hInputPipe);
+    if (tracing) {
+        tracer.Enable(false);
+        tracer.DropBefore((uint32_t)spec.warmup);
+        std::vector<LatencyHistogram> stages;
+        tracer.Breakdown(stages);
+        for (size_t i = 0; i < stages.size(); i++) {
+            report.stages.push_back(std::make_pair(std::string(TraceStageName((TraceStage)i)), stages[i]));
+        }
+    }
+
+    PrintLoadReport(std::cout, spec, report);
+    if (tracing) {
+        tracer.PrintBreakdown(std::cout);
+        if (tracer.WriteChromeTrace(spec.tracePath)) {
+            std::cout << "Trace written to " << spec.tracePath << std::endl;
         }
-        if (worker.hOutputPipe != INVALID_HANDLE_VALUE) {
-            CloseHandle(worker.hOutputPipe);
+        else {
+            std::cerr << "Failed to write " << spec.tracePath << std::endl;
+            ok = false;
+        }
+    }
+    if (!spec.jsonPath.empty()) {
+        if (WriteLoadReport(spec.jsonPath, spec, report)) {
+            std::cout << "Results written to " << spec.jsonPath << std::endl;
         }
-        if (worker.hProcess != INVALID_HANDLE_VALUE) {
-            CloseHandle(worker.hProcess);
+        else {
+            std::cerr << "Failed to write " << spec.jsonPath << std::endl;
+            ok = false;
         }
     }
-    workers.clear();
+
+    return ok && report.total.errors == 0;
 }
 
-int main() {
-    Browser browser;
+bool Browser::CountInStream(std::istream& input, const std::string& pattern, uint64_t& total) {
+    if (pattern.empty() || pattern.size() > STREAM_MAX_PATTERN) {
+        std::cerr << "Pattern length must be 1.." << STREAM_MAX_PATTERN << std::endl;
+        return false;
+    }
 
-    browser.GetUserInput();
+    if (!RequireCapability(WORKER_CAP_STREAM_CHUNK, "stream chunks")) {
+        return false;
+    }
 
-    if (!browser.Initialize()) {
-        std::cerr << "Failed to initialize browser." << std::endl;
-        std::cout << "Press Enter to exit...";
-        std::cin.ignore();
-        std::cin.get();
-        return 1;
+    // Фрагменты читаются, только пока есть место в окне: в памяти не
+    // больше window фрагментов, сколько бы ни весил вход
+    ChunkReader reader(input, STREAM_CHUNK_SIZE, pattern.size() - 1);
+    ChunkReducer reducer(STREAM_CHUNK_SIZE);
+    uint64_t chunks = 0;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = RunScatterGather("stream chunk", STREAM_TASK_BASE, SCATTER_UNTIL_DONE,
+        [&](uint32_t, ScheduledTask& task) {
+            if (!reader.Next(task.payload)) {
+                return false;
+            }
+            task.payload.Append(pattern.data(), pattern.size());
+            task.header = MakeTaskHeader(MessageType::TASK_SUBSTRING, 0,
+                static_cast<uint32_t>(task.payload.Size()), static_cast<uint32_t>(pattern.size()));
+            task.header.flags |= TASK_FLAG_STREAM_CHUNK;
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            return reducer.Add(index, completion.data.Data(), completion.data.Size());
+        }, &chunks);
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime);
+
+    if (!ok || reducer.Reduced() != chunks) {
+        return false;
     }
 
-    browser.Run();
+    total = reducer.Total();
+    std::cout << "Stream: " << chunks << " chunks of " << STREAM_CHUNK_SIZE / 1024
+        << " KB in " << duration.count() << " ms" << std::endl;
+    return true;
+}
+
+bool Browser::ProcessImage(MessageType type, PixelFormat format, const char* src, char* dst,
+    uint32_t width, uint32_t height, uint32_t stride) {
+    uint32_t bpp = (uint32_t)format;
+    if ((format != PixelFormat::RGB24 && format != PixelFormat::RGBA32) ||
+        (uint64_t)width * bpp > stride || stride > MAX_IMAGE_STRIDE ||
+        sizeof(ImageTile) + stride > MAX_DATA_SIZE) {
+        std::cerr << "Unsupported image layout: " << width << " pixels, stride " << stride << std::endl;
+        return false;
+    }
+
+    // Плитка - целое число строк: воркеру не нужны соседние пиксели
+    uint32_t tileRows = (uint32_t)(IMAGE_TILE_BYTES / stride);
+    if (tileRows == 0) {
+        tileRows = 1;
+    }
+    uint32_t tileCount = (height + tileRows - 1) / tileRows;
+
+    auto rowsOf = [&](uint32_t index) {
+        uint32_t firstRow = index * tileRows;
+        return height - firstRow < tileRows ? height - firstRow : tileRows;
+    };
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = RunScatterGather("image tile", IMAGE_TASK_BASE, tileCount,
+        [&](uint32_t index, ScheduledTask& task) {
+            ImageTile tile;
+            tile.width = width;
+            tile.rows = rowsOf(index);
+            task.payload.Reserve(sizeof(tile) + (size_t)tile.rows * stride);
+            task.payload.Append(&tile, sizeof(tile));
+            task.payload.Append(src + (size_t)index * tileRows * stride, (size_t)tile.rows * stride);
+            task.header = MakeTaskHeader(type, 0, static_cast<uint32_t>(task.payload.Size()),
+                MakeImageParam(format, stride));
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            size_t tileBytes = (size_t)rowsOf(index) * stride;
+            if (completion.data.Size() != sizeof(ImageTile) + tileBytes) {
+                return false;
+            }
+            memcpy(dst + (size_t)index * tileRows * stride, completion.data.Data() + sizeof(ImageTile), tileBytes);
+            return true;
+        });
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    if (!ok) {
+        return false;
+    }
+
+    std::cout << "Image: " << width << "x" << height << " in " << tileCount << " tiles, "
+        << ms << " ms, " << (double)width * height / (ms > 0 ? ms * 1000.0 : 1.0) << " MPix/s" << std::endl;
+    return true;
+}
+
+void Browser::RunImageDemo() {
+    const uint32_t width = 1920;
+    const uint32_t height = 1080;
+    const uint32_t stride = width * 4;
+
+    if (!RequireTaskType(MessageType::TASK_SEPIA, "image tasks")) {
+        return;
+    }
+
+    std::vector<char> image((size_t)height * stride);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            char* pixel = &image[(size_t)y * stride + x * 4];
+            pixel[0] = (char)(x * 255 / width);
+            pixel[1] = (char)(y * 255 / height);
+            pixel[2] = (char)((x + y) & 0xFF);
+            pixel[3] = (char)0xFF;
+        }
+    }
+
+    std::vector<char> result(image.size());
+    std::vector<char> expected(image.size());
+    const MessageType types[] = { MessageType::TASK_SEPIA, MessageType::TASK_INVERT };
+
+    for (MessageType type : types) {
+        ImageOp op = type == MessageType::TASK_SEPIA ? ImageOp::SEPIA : ImageOp::INVERT;
+        std::cout << "\n=== " << (op == ImageOp::SEPIA ? "Sepia" : "Invert") << " "
+            << width << "x" << height << " RGBA ===" << std::endl;
+
+        if (!ProcessImage(type, PixelFormat::RGBA32, image.data(), result.data(), width, height, stride)) {
+            std::cerr << "Image processing failed." << std::endl;
+            continue;
+        }
+
+        ProcessImageRows(op, PixelFormat::RGBA32, image.data(), expected.data(), width, height, stride);
+        std::cout << (result == expected ? "matches local result" : "MISMATCH with local result") << std::endl;
+    }
+}
+
+bool Browser::SortKeys(SortKey type, char* data, size_t count, SortStrategy strategy) {
+    size_t keySize = SortKeySize(type);
+    if (keySize == 0) {
+        std::cerr << "Unknown sort key type " << (uint32_t)type << std::endl;
+        return false;
+    }
+    if (count < 2) {
+        return true;
+    }
+
+    // Часть - одна задача. source - её ключи, target - куда встаёт ответ
+    struct SortPart {
+        const char* source;
+        char* target;
+        size_t count;
+    };
+    // Участок результата; из нескольких частей собирается слиянием
+    struct SortGroup {
+        size_t offset;
+        size_t count;
+        size_t firstPart;
+        size_t partCount;
+    };
+
+    int window = TotalWindow();
+
+    // Частей столько, чтобы каждая влезала в задачу и было чем занять окно
+    size_t maxTaskKeys = MAX_DATA_SIZE / keySize;
+    size_t parts = (count + maxTaskKeys - 1) / maxTaskKeys;
+    size_t wanted = count / SORT_MIN_TASK_KEYS;
+    if (wanted > (size_t)window) {
+        wanted = window;
+    }
+    if (parts < wanted) {
+        parts = wanted;
+    }
+    if (parts == 0) {
+        parts = 1;
+    }
+
+    std::vector<SortPart> sortParts;
+    std::vector<SortGroup> groups;
+    std::vector<char> staging;
+
+    auto addGroup = [&](const char* source, char* target, size_t offset, size_t groupCount, size_t pieces) {
+        SortGroup group;
+        group.offset = offset;
+        group.count = groupCount;
+        group.firstPart = sortParts.size();
+        group.partCount = pieces;
+        for (size_t i = 0; i < pieces; i++) {
+            size_t begin = groupCount * i / pieces;
+            size_t end = groupCount * (i + 1) / pieces;
+            SortPart part;
+            part.source = source + begin * keySize;
+            part.target = target + begin * keySize;
+            part.count = end - begin;
+            sortParts.push_back(part);
+        }
+        groups.push_back(group);
+    };
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    if (parts == 1) {
+        addGroup(data, data, 0, count, 1);
+    }
+    else if (strategy == SortStrategy::SAMPLE) {
+        // Корзины вдвое мельче задачи: разброс размеров выборка не убирает
+        size_t buckets = (2 * count + maxTaskKeys - 1) / maxTaskKeys;
+        if (buckets < parts) {
+            buckets = parts;
+        }
+
+        staging.resize(count * keySize);
+        std::vector<size_t> counts;
+        PartitionKeys(type, data, count, buckets, staging.data(), counts,
+            (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count());
+
+        // Корзина уже на своём месте в результате. Переполненная (много
+        // одинаковых ключей) режется на части и сливается обратно в data
+        size_t offset = 0;
+        for (size_t b = 0; b < buckets; b++) {
+            if (counts[b] == 0) {
+                continue;
+            }
+            char* bucket = staging.data() + offset * keySize;
+            size_t pieces = (counts[b] + maxTaskKeys - 1) / maxTaskKeys;
+            addGroup(bucket, pieces == 1 ? data + offset * keySize : bucket, offset, counts[b], pieces);
+            offset += counts[b];
+        }
+    }
+    else {
+        staging.resize(count * keySize);
+        addGroup(data, staging.data(), 0, count, parts);
+    }
+
+    bool ok = RunScatterGather("sort part", SORT_TASK_BASE, sortParts.size(),
+        [&](uint32_t index, ScheduledTask& task) {
+            const SortPart& part = sortParts[index];
+            task.payload.Append(part.source, part.count * keySize);
+            task.header = MakeTaskHeader(MessageType::TASK_SORT, 0, static_cast<uint32_t>(task.payload.Size()),
+                (uint32_t)type);
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            const SortPart& part = sortParts[index];
+            if (completion.data.Size() != part.count * keySize) {
+                return false;
+            }
+            memcpy(part.target, completion.data.Data(), completion.data.Size());
+            return true;
+        });
+    if (!ok) {
+        return false;
+    }
+
+    size_t merged = 0;
+    for (const SortGroup& group : groups) {
+        if (group.partCount < 2) {
+            continue;
+        }
+        std::vector<KeyRun> runs;
+        for (size_t i = 0; i < group.partCount; i++) {
+            const SortPart& part = sortParts[group.firstPart + i];
+            KeyRun run;
+            run.data = part.target;
+            run.count = part.count;
+            runs.push_back(run);
+        }
+        MergeKeyRuns(type, runs, data + group.offset * keySize);
+        merged += group.count;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Sort: " << count << " keys in " << sortParts.size() << " parts, "
+        << groups.size() << " groups, " << merged << " keys merged, " << ms << " ms, "
+        << count / (ms > 0 ? ms * 1000.0 : 1.0) << " Mkeys/s" << std::endl;
+    return true;
+}
+
+// Сортировка воркерами против std::sort по копии
+template <typename Key>
+static void RunSortCase(Browser& browser, const char* name, SortKey type, std::vector<Key> keys,
+    SortStrategy strategy) {
+    std::cout << "\n=== Sort " << keys.size() << " " << name
+        << (strategy == SortStrategy::SAMPLE ? " (sample sort)" : " (k-way merge)") << " ===" << std::endl;
+
+    std::vector<Key> expected = keys;
+    std::sort(expected.begin(), expected.end());
+
+    if (!browser.SortKeys(type, (char*)keys.data(), keys.size(), strategy)) {
+        std::cerr << "Sort failed." << std::endl;
+        return;
+    }
+    std::cout << (keys == expected ? "matches std::sort" : "MISMATCH with std::sort") << std::endl;
+}
+
+void Browser::RunSortDemo() {
+    if (!RequireTaskType(MessageType::TASK_SORT, "TASK_SORT")) {
+        return;
+    }
+
+    std::mt19937_64 rng(13);
+
+    // 32 МБ: заведомо больше одной задачи
+    std::vector<uint32_t> integers(8 * 1024 * 1024);
+    for (uint32_t& key : integers) {
+        key = (uint32_t)rng();
+    }
+    RunSortCase(*this, "uint32", SortKey::UINT32, integers, SortStrategy::SAMPLE);
+    RunSortCase(*this, "uint32", SortKey::UINT32, integers, SortStrategy::MERGE);
+
+    std::normal_distribution<double> normal(0.0, 1000.0);
+    std::vector<double> reals(2 * 1024 * 1024);
+    for (double& key : reals) {
+        key = normal(rng);
+    }
+    RunSortCase(*this, "double", SortKey::FLOAT64, reals, SortStrategy::SAMPLE);
+
+    // Четыре различных значения: корзины переполняются и сливаются
+    std::vector<int64_t> repeated(1024 * 1024);
+    for (int64_t& key : repeated) {
+        key = (int64_t)(rng() % 4) - 2;
+    }
+    RunSortCase(*this, "int64 with duplicates", SortKey::INT64, repeated, SortStrategy::SAMPLE);
+}
+
+bool Browser::ChecksumStream(std::istream& input, CrcKind kind, uint32_t& crc, uint64_t& length) {
+    if (!RequireTaskType(MessageType::TASK_CRC32, "TASK_CRC32")) {
+        return false;
+    }
+
+    ChunkReader reader(input, CRC_CHUNK_SIZE, 0);
+    CrcReducer reducer(kind);
+    std::vector<uint64_t> workerBytes(numWorkers, 0);
+    std::map<uint64_t, uint64_t> chunkLengths;   // ещё не посчитанные куски
+    uint64_t chunks = 0;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = RunScatterGather("CRC chunk", CRC_TASK_BASE, SCATTER_UNTIL_DONE,
+        [&](uint32_t index, ScheduledTask& task) {
+            if (!reader.Next(task.payload)) {
+                return false;
+            }
+            chunkLengths[index] = task.payload.Size();
+            task.header = MakeTaskHeader(MessageType::TASK_CRC32, 0, static_cast<uint32_t>(task.payload.Size()),
+                (uint32_t)kind);
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            auto chunk = chunkLengths.find(index);
+            if (chunk == chunkLengths.end() || completion.data.Size() != sizeof(uint32_t)) {
+                return false;
+            }
+            uint32_t chunkCrc;
+            memcpy(&chunkCrc, completion.data.Data(), sizeof(chunkCrc));
+            reducer.Add(index, chunkCrc, chunk->second);
+            workerBytes[completion.workerId] += chunk->second;
+            chunkLengths.erase(chunk);
+            return true;
+        }, &chunks);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (!ok || reducer.Reduced() != chunks) {
+        return false;
+    }
+
+    crc = reducer.Crc();
+    length = reducer.Length();
+
+    double gigabytes = length / 1e9;
+    std::cout << (kind == CrcKind::CRC32C ? "CRC32C" : "CRC32") << ": " << chunks << " chunks of "
+        << CRC_CHUNK_SIZE / 1024 << " KB in " << seconds * 1000.0 << " ms, "
+        << (seconds > 0 ? gigabytes / seconds : 0.0) << " GB/s" << std::endl;
+    for (int i = 0; i < numWorkers; i++) {
+        std::cout << "  worker " << i << ": " << workerBytes[i] / 1e9 << " GB, "
+            << (seconds > 0 ? workerBytes[i] / 1e9 / seconds : 0.0) << " GB/s" << std::endl;
+    }
+    return true;
+}
+
+bool Browser::CountPrimes(uint64_t lo, uint64_t hi, uint64_t& count, MessageBuffer* list) {
+    if (!RequireTaskType(MessageType::TASK_PRIMES, "TASK_PRIMES")) {
+        return false;
+    }
+    if (lo > hi || hi > PRIME_MAX_VALUE) {
+        std::cerr << "Prime range must lie within [0, " << PRIME_MAX_VALUE << "]" << std::endl;
+        return false;
+    }
+
+    int window = TotalWindow();
+
+    // Несколько частей на место в окне, чтобы быстрые воркеры брали больше;
+    // части списка ограничены размером ответа
+    uint64_t maxSpan = list ? PRIME_LIST_MAX_SPAN : 1ull << 32;
+    uint64_t span = (hi - lo) / ((uint64_t)window * 4);
+    if (span < PRIME_MIN_TASK_SPAN) {
+        span = PRIME_MIN_TASK_SPAN;
+    }
+    if (span > maxSpan) {
+        span = maxSpan;
+    }
+    uint64_t parts = (hi - lo + span - 1) / span;
+
+    PrimeMode mode = list ? PrimeMode::LIST : PrimeMode::COUNT;
+    PrimeListBuilder builder;
+    uint64_t total = 0;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = RunScatterGather("prime range part", PRIME_TASK_BASE, parts,
+        [&](uint32_t index, ScheduledTask& task) {
+            PrimeRange range;
+            range.lo = lo + index * span;
+            range.hi = hi - range.lo > span ? range.lo + span : hi;
+            task.payload.Append(&range, sizeof(range));
+            task.header = MakeTaskHeader(MessageType::TASK_PRIMES, 0, sizeof(range), (uint32_t)mode);
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            if (mode == PrimeMode::LIST) {
+                return builder.Add(index, std::move(completion.data));
+            }
+            uint64_t partCount = 0;
+            if (completion.data.Size() != sizeof(partCount)) {
+                return false;
+            }
+            memcpy(&partCount, completion.data.Data(), sizeof(partCount));
+            total += partCount;
+            return true;
+        });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (!ok || (list && builder.Reduced() != parts)) {
+        return false;
+    }
+
+    if (list) {
+        builder.Finish(*list);
+        total = builder.Count();
+    }
+    count = total;
+
+    double millions = (hi - lo) / 1e6;
+    std::cout << "Primes in [" << lo << ", " << hi << "): " << parts << " parts in " << seconds * 1000.0
+        << " ms, " << (seconds > 0 ? millions / seconds : 0.0) << " M numbers/s" << std::endl;
+    return true;
+}
+
+void Browser::RunPrimeDemo() {
+    std::cout << "\n=== Segmented sieve ===" << std::endl;
+
+    uint64_t count = 0;
+    if (CountPrimes(0, 1000000000ull, count)) {
+        std::cout << "pi(10^9) = " << count << (count == 50847534 ? " (correct)" : " (WRONG)") << std::endl;
+    }
+    else {
+        std::cerr << "Prime count failed." << std::endl;
+    }
+
+    // Список вдали от нуля: сверка с подсчётом и пробным делением
+    const uint64_t lo = 1000000000000ull;
+    const uint64_t hi = lo + 10000000;
+    MessageBuffer list;
+    uint64_t listed = 0;
+    std::vector<uint64_t> primes;
+    if (!CountPrimes(lo, hi, listed, &list) || !CountPrimes(lo, hi, count) ||
+        !DecodePrimeList(list.Data(), list.Size(), primes)) {
+        std::cerr << "Prime list failed." << std::endl;
+        return;
+    }
+
+    bool valid = primes.size() == count && listed == count;
+    for (size_t i = 0; valid && i < primes.size(); i += primes.size() / 100 + 1) {
+        uint64_t n = primes[i];
+        valid = n >= lo && n < hi && (i == 0 || n > primes[i - 1]);
+        for (uint64_t d = 3; valid && d * d <= n; d += 2) {
+            valid = n % d != 0;
+        }
+    }
+    std::cout << count << " primes in [10^12, 10^12 + 10^7), list of " << list.Size() << " bytes"
+        << (valid ? " (verified)" : " (WRONG)") << std::endl;
+}
+
+bool Browser::LoadMatrix(MatrixType type, const char* b, uint32_t rows, uint32_t cols, uint32_t& handle) {
+    if (!RequireTaskType(MessageType::TASK_MATRIX_MULT, "TASK_MATRIX_MULT")) {
+        return false;
+    }
+
+    size_t rowBytes = (size_t)cols * MatrixTypeSize(type);
+    if (rows == 0 || cols == 0 || rowBytes > MAX_DATA_SIZE - sizeof(MatrixHeader)) {
+        std::cerr << "Matrix B must have 1.." << (MAX_DATA_SIZE - sizeof(MatrixHeader)) / MatrixTypeSize(type)
+            << " columns" << std::endl;
+        return false;
+    }
+    uint32_t pieceRows = (uint32_t)((MAX_DATA_SIZE - sizeof(MatrixHeader)) / rowBytes);
+    uint32_t pieces = (rows + pieceRows - 1) / pieceRows;
+
+    handle = nextMatrixHandle++;
+
+    // Каждому живому воркеру - все куски B
+    std::vector<uint32_t> loaded(numWorkers, 0);
+    std::vector<int> targets;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = BroadcastPinned("matrix B piece", MessageType::TASK_MATRIX_MULT, MATRIX_TASK_BASE, pieces,
+        [&](uint32_t index, ScheduledTask& task) {
+            MatrixHeader piece;
+            piece.handle = handle;
+            piece.type = (uint32_t)type;
+            piece.firstRow = index * pieceRows;
+            piece.rows = rows - piece.firstRow < pieceRows ? rows - piece.firstRow : pieceRows;
+            piece.inner = rows;
+            piece.cols = cols;
+            task.payload.Reserve(sizeof(piece) + piece.rows * rowBytes);
+            task.payload.Append(&piece, sizeof(piece));
+            task.payload.Append(b + piece.firstRow * rowBytes, piece.rows * rowBytes);
+            task.header = MakeTaskHeader(MessageType::TASK_MATRIX_MULT, 0, static_cast<uint32_t>(task.payload.Size()),
+                (uint32_t)MatrixOp::LOAD_B);
+        },
+        [&](int workerId, uint32_t, Completion& completion) {
+            uint32_t loadedRows = 0;
+            if (completion.data.Size() != sizeof(loadedRows)) {
+                return false;
+            }
+            memcpy(&loadedRows, completion.data.Data(), sizeof(loadedRows));
+            loaded[workerId] = loadedRows > loaded[workerId] ? loadedRows : loaded[workerId];
+            return true;
+        }, &targets);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (ok && targets.empty()) {
+        std::cerr << "No live workers left." << std::endl;
+        ok = false;
+    }
+    for (size_t i = 0; ok && i < targets.size(); i++) {
+        ok = loaded[targets[i]] == rows;
+    }
+    if (!ok) {
+        return false;
+    }
+
+    MatrixInfo info;
+    info.type = type;
+    info.rows = rows;
+    info.cols = cols;
+    matrices[handle] = info;
+
+    std::cout << "Matrix B " << rows << "x" << cols << " loaded into " << targets.size() << " workers as handle "
+        << handle << ": " << pieces << " pieces per worker in " << seconds * 1000.0 << " ms" << std::endl;
+    return true;
+}
+
+bool Browser::MultiplyMatrix(uint32_t handle, const char* a, uint32_t rows, char* c) {
+    auto matrix = matrices.find(handle);
+    if (matrix == matrices.end()) {
+        std::cerr << "Unknown matrix handle " << handle << std::endl;
+        return false;
+    }
+    const MatrixInfo& b = matrix->second;
+    size_t elementSize = MatrixTypeSize(b.type);
+    size_t aRowBytes = (size_t)b.rows * elementSize;
+    size_t cRowBytes = (size_t)b.cols * elementSize;
+    if (aRowBytes > MAX_DATA_SIZE - sizeof(MatrixHeader)) {
+        std::cerr << "Rows of A longer than " << (MAX_DATA_SIZE - sizeof(MatrixHeader)) / elementSize
+            << " elements do not fit one task" << std::endl;
+        return false;
+    }
+
+    // Блок ограничен размером задачи и ответа, а для равномерной
+    // загрузки - несколькими блоками на воркер
+    size_t blockRows = (MAX_DATA_SIZE - sizeof(MatrixHeader)) / aRowBytes;
+    if (MAX_DATA_SIZE / cRowBytes < blockRows) {
+        blockRows = MAX_DATA_SIZE / cRowBytes;
+    }
+    size_t balanced = BalancedShare(rows);
+    if (balanced < blockRows) {
+        blockRows = balanced > 0 ? balanced : 1;
+    }
+    uint32_t blocks = (uint32_t)((rows + blockRows - 1) / blockRows);
+
+    auto rowsOf = [&](uint32_t index) {
+        size_t firstRow = (size_t)index * blockRows;
+        return rows - firstRow < blockRows ? rows - firstRow : blockRows;
+    };
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = RunScatterGather("matrix block", MATRIX_TASK_BASE, blocks,
+        [&](uint32_t index, ScheduledTask& task) {
+            MatrixHeader block;
+            block.handle = handle;
+            block.type = (uint32_t)b.type;
+            block.firstRow = (uint32_t)(index * blockRows);
+            block.rows = (uint32_t)rowsOf(index);
+            block.inner = b.rows;
+            block.cols = b.cols;
+            task.payload.Reserve(sizeof(block) + block.rows * aRowBytes);
+            task.payload.Append(&block, sizeof(block));
+            task.payload.Append(a + block.firstRow * aRowBytes, block.rows * aRowBytes);
+            task.header = MakeTaskHeader(MessageType::TASK_MATRIX_MULT, 0,
+                static_cast<uint32_t>(task.payload.Size()), (uint32_t)MatrixOp::MULTIPLY);
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            if (completion.data.Size() != rowsOf(index) * cRowBytes) {
+                return false;
+            }
+            memcpy(c + (size_t)index * blockRows * cRowBytes, completion.data.Data(), completion.data.Size());
+            return true;
+        });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (!ok) {
+        return false;
+    }
+
+    double gflops = 2.0 * rows * b.rows * b.cols / 1e9;
+    std::cout << "C = A x B, " << rows << "x" << b.rows << " by " << b.rows << "x" << b.cols << ": " << blocks
+        << " blocks of " << blockRows << " rows in " << seconds * 1000.0 << " ms, "
+        << (seconds > 0 ? gflops / seconds : 0.0) << " GFLOP/s" << std::endl;
+    return true;
+}
+
+bool Browser::ReleaseMatrix(uint32_t handle) {
+    auto matrix = matrices.find(handle);
+    if (matrix == matrices.end()) {
+        return false;
+    }
+
+    MatrixHeader release;
+    memset(&release, 0, sizeof(release));
+    release.handle = handle;
+    release.type = (uint32_t)matrix->second.type;
+    matrices.erase(matrix);
+
+    return BroadcastPinned("matrix release", MessageType::TASK_MATRIX_MULT, MATRIX_TASK_BASE, 1,
+        [&](uint32_t, ScheduledTask& task) {
+            task.payload.Append(&release, sizeof(release));
+            task.header = MakeTaskHeader(MessageType::TASK_MATRIX_MULT, 0, sizeof(release),
+                (uint32_t)MatrixOp::RELEASE);
+        }, nullptr);
+}
+
+// Умножение воркерами против тройного цикла в Browser
+template <typename T>
+static void RunMatrixCase(Browser& browser, const char* name, MatrixType type, uint32_t m, uint32_t k, uint32_t n) {
+    std::cout << "\n=== GEMM " << name << " " << m << "x" << k << " by " << k << "x" << n << " ===" << std::endl;
+
+    std::mt19937_64 rng(16);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    std::vector<T> a((size_t)m * k);
+    std::vector<T> a2((size_t)m * k);
+    std::vector<T> b((size_t)k * n);
+    for (T& value : a) {
+        value = (T)uniform(rng);
+    }
+    for (T& value : a2) {
+        value = (T)uniform(rng);
+    }
+    for (T& value : b) {
+        value = (T)uniform(rng);
+    }
+
+    uint32_t handle;
+    if (!browser.LoadMatrix(type, (const char*)b.data(), k, n, handle)) {
+        std::cerr << "Loading matrix B failed." << std::endl;
+        return;
+    }
+
+    // Второе умножение на ту же B уже без её пересылки
+    std::vector<T> c((size_t)m * n);
+    std::vector<T> c2((size_t)m * n);
+    bool multiplied = browser.MultiplyMatrix(handle, (const char*)a.data(), m, (char*)c.data()) &&
+        browser.MultiplyMatrix(handle, (const char*)a2.data(), m, (char*)c2.data());
+    browser.ReleaseMatrix(handle);
+    if (!multiplied) {
+        std::cerr << "Matrix multiplication failed." << std::endl;
+        return;
+    }
+
+    // Порядок суммирования разный: сравнение с допуском. Второе
+    // произведение проверяет B, закэшированную воркерами
+    auto maxError = [&](const std::vector<T>& left, const std::vector<T>& product) {
+        double worst = 0;
+        for (uint32_t i = 0; i < m; i++) {
+            for (uint32_t j = 0; j < n; j++) {
+                T sum = 0;
+                for (uint32_t p = 0; p < k; p++) {
+                    sum += left[(size_t)i * k + p] * b[(size_t)p * n + j];
+                }
+                double error = std::fabs((double)product[(size_t)i * n + j] - (double)sum);
+                worst = error > worst ? error : worst;
+            }
+        }
+        return worst;
+    };
+
+    auto startTime = std::chrono::steady_clock::now();
+    double error = maxError(a, c);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    double cachedError = maxError(a2, c2);
+
+    double tolerance = (sizeof(T) == sizeof(float) ? 1e-6 : 1e-14) * k;
+    std::cout << "naive triple loop in Browser: " << seconds * 1000.0 << " ms, "
+        << (seconds > 0 ? 2.0 * m * k * n / 1e9 / seconds : 0.0) << " GFLOP/s" << std::endl;
+    std::cout << "max error " << error << ", with cached B " << cachedError
+        << (error <= tolerance && cachedError <= tolerance ? " (matches)" : " (MISMATCH)") << std::endl;
+}
+
+void Browser::RunMatrixDemo() {
+    RunMatrixCase<float>(*this, "float", MatrixType::FLOAT32, 1024, 512, 512);
+    RunMatrixCase<double>(*this, "double", MatrixType::FLOAT64, 600, 384, 500);
+}
+
+bool Browser::Fourier(FourierMode mode, uint32_t size, const char* in, size_t count, char* out) {
+    if (!RequireTaskType(MessageType::TASK_FOURIER, "TASK_FOURIER")) {
+        return false;
+    }
+
+    size_t inputSize = FourierInputSize(mode, size);
+    size_t outputSize = FourierOutputSize(mode, size);
+    size_t largest = inputSize > outputSize ? inputSize : outputSize;
+    if (!IsFourierSizeValid(mode, size) || largest > MAX_DATA_SIZE - sizeof(FourierHeader)) {
+        std::cerr << "Transform size must be a power of two up to " << FOURIER_MAX_SIZE << std::endl;
+        return false;
+    }
+
+    // Сколько влезает в задачу, но не меньше нескольких задач на воркер
+    size_t perTask = (MAX_DATA_SIZE - sizeof(FourierHeader)) / largest;
+    size_t balanced = BalancedShare(count);
+    if (balanced < perTask) {
+        perTask = balanced > 0 ? balanced : 1;
+    }
+    size_t tasks = (count + perTask - 1) / perTask;
+    auto countOf = [&](uint32_t index) {
+        size_t first = (size_t)index * perTask;
+        return count - first < perTask ? count - first : perTask;
+    };
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = RunScatterGather("transform batch", FOURIER_TASK_BASE, tasks,
+        [&](uint32_t index, ScheduledTask& task) {
+            FourierHeader batch;
+            batch.size = size;
+            batch.count = (uint32_t)countOf(index);
+            task.payload.Reserve(sizeof(batch) + batch.count * inputSize);
+            task.payload.Append(&batch, sizeof(batch));
+            task.payload.Append(in + (size_t)index * perTask * inputSize, batch.count * inputSize);
+            task.header = MakeTaskHeader(MessageType::TASK_FOURIER, 0, static_cast<uint32_t>(task.payload.Size()),
+                (uint32_t)mode);
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            size_t batchCount = countOf(index);
+            if (completion.data.Size() != sizeof(FourierHeader) + batchCount * outputSize) {
+                return false;
+            }
+            memcpy(out + (size_t)index * perTask * outputSize, completion.data.Data() + sizeof(FourierHeader),
+                batchCount * outputSize);
+            return true;
+        });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (!ok) {
+        return false;
+    }
+
+    std::cout << count << " transforms of " << size << " in " << tasks << " tasks of up to " << perTask << ": "
+        << seconds * 1000.0 << " ms, " << (seconds > 0 ? count / seconds : 0.0) << " transforms/s" << std::endl;
+    return true;
+}
+
+void Browser::RunFourierDemo() {
+    std::cout << "\n=== FFT ===" << std::endl;
+
+    // Комплексные: сверка с прямым вычислением ДПФ и обратный ход
+    const uint32_t size = 256;
+    const size_t count = 2048;
+    std::mt19937_64 rng(17);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    std::vector<FftComplex> signal((size_t)size * count);
+    for (FftComplex& value : signal) {
+        value.re = uniform(rng);
+        value.im = uniform(rng);
+    }
+
+    std::vector<FftComplex> spectrum(signal.size());
+    std::vector<FftComplex> restored(signal.size());
+    if (!Fourier(FourierMode::FORWARD, size, (const char*)signal.data(), count, (char*)spectrum.data()) ||
+        !Fourier(FourierMode::INVERSE, size, (const char*)spectrum.data(), count, (char*)restored.data())) {
+        std::cerr << "Complex FFT failed." << std::endl;
+        return;
+    }
+
+    double dftError = 0;
+    for (uint32_t k = 0; k < size; k++) {
+        double re = 0;
+        double im = 0;
+        for (uint32_t j = 0; j < size; j++) {
+            double angle = -2.0 * 3.14159265358979323846 * ((uint64_t)j * k % size) / size;
+            re += signal[j].re * std::cos(angle) - signal[j].im * std::sin(angle);
+            im += signal[j].re * std::sin(angle) + signal[j].im * std::cos(angle);
+        }
+        double error = std::fabs(re - spectrum[k].re) + std::fabs(im - spectrum[k].im);
+        dftError = error > dftError ? error : dftError;
+    }
+    double roundTripError = 0;
+    for (size_t i = 0; i < signal.size(); i++) {
+        double error = std::fabs(signal[i].re - restored[i].re) + std::fabs(signal[i].im - restored[i].im);
+        roundTripError = error > roundTripError ? error : roundTripError;
+    }
+    std::cout << "error vs direct DFT " << dftError << ", round trip " << roundTripError
+        << (dftError < 1e-3 && roundTripError < 1e-5 ? " (matches)" : " (MISMATCH)") << std::endl;
+
+    // Спектр звука 48 кГц окнами по 1024 с шагом 512: тоны 1 кГц и 5 кГц
+    // с шумом, в каждом окне максимум должен быть в полосе 1 кГц
+    const double rate = 48000.0;
+    const uint32_t frameSize = 1024;
+    const uint32_t hop = 512;
+    std::vector<float> audio((size_t)rate * 10);
+    for (size_t i = 0; i < audio.size(); i++) {
+        double t = i / rate;
+        audio[i] = (float)(std::sin(2 * 3.14159265358979323846 * 1000.0 * t) +
+            0.5 * std::sin(2 * 3.14159265358979323846 * 5000.0 * t) + 0.1 * uniform(rng));
+    }
+
+    size_t frames = (audio.size() - frameSize) / hop + 1;
+    std::vector<float> windowed((size_t)frames * frameSize);
+    for (size_t f = 0; f < frames; f++) {
+        for (uint32_t i = 0; i < frameSize; i++) {
+            double hann = 0.5 - 0.5 * std::cos(2 * 3.14159265358979323846 * i / frameSize);
+            windowed[f * frameSize + i] = (float)(audio[f * hop + i] * hann);
+        }
+    }
+
+    std::vector<FftComplex> bins((size_t)frames * (frameSize / 2 + 1));
+    auto startTime = std::chrono::steady_clock::now();
+    if (!Fourier(FourierMode::REAL_FORWARD, frameSize, (const char*)windowed.data(), frames, (char*)bins.data())) {
+        std::cerr << "Real FFT failed." << std::endl;
+        return;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    uint32_t expectedBin = (uint32_t)(1000.0 / (rate / frameSize) + 0.5);
+    size_t correct = 0;
+    for (size_t f = 0; f < frames; f++) {
+        const FftComplex* frame = &bins[f * (frameSize / 2 + 1)];
+        uint32_t peak = 0;
+        float peakPower = -1;
+        for (uint32_t k = 0; k <= frameSize / 2; k++) {
+            float power = frame[k].re * frame[k].re + frame[k].im * frame[k].im;
+            if (power > peakPower) {
+                peak = k;
+                peakPower = power;
+            }
+        }
+        correct += peak == expectedBin;
+    }
+
+    std::vector<float> resynthesized(windowed.size());
+    bool inverted = Fourier(FourierMode::REAL_INVERSE, frameSize, (const char*)bins.data(), frames,
+        (char*)resynthesized.data());
+    double inverseError = 0;
+    for (size_t i = 0; inverted && i < windowed.size(); i++) {
+        double error = std::fabs(windowed[i] - resynthesized[i]);
+        inverseError = error > inverseError ? error : inverseError;
+    }
+
+    std::cout << frames << " audio frames: peak at " << expectedBin * rate / frameSize << " Hz in " << correct
+        << " frames, " << (seconds > 0 ? audio.size() / rate / seconds : 0.0) << "x real time, inverse error "
+        << inverseError << (correct == frames && inverted && inverseError < 1e-4 ? " (matches)" : " (MISMATCH)")
+        << std::endl;
+}
+
+bool Browser::ReduceSamples(std::istream& input, SampleType type, const HistogramSpec* spec,
+    StatsPartial& stats, std::vector<uint64_t>& counts) {
+    MessageType taskType = spec ? MessageType::TASK_HISTOGRAM : MessageType::TASK_STATS;
+    if (!RequireTaskType(taskType, spec ? "TASK_HISTOGRAM" : "TASK_STATS")) {
+        return false;
+    }
+    if (type > SampleType::FLOAT64 || (spec && !IsHistogramSpecValid(type, *spec))) {
+        std::cerr << "Invalid sample type or histogram bins" << std::endl;
+        return false;
+    }
+
+    size_t sampleSize = SampleTypeSize(type);
+    size_t resultSize = spec ? ((size_t)spec->bins + 2) * sizeof(uint64_t) : sizeof(StatsPartial);
+    ChunkReader reader(input, STATS_CHUNK_SIZE, 0);
+    StatsReducer reducer;
+    MessageBuffer chunk;
+    if (spec) {
+        counts.assign((size_t)spec->bins + 2, 0);
+    }
+
+    uint64_t chunks = 0;
+    uint64_t bytes = 0;
+    bool partial = false;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = RunScatterGather("sample chunk", STATS_TASK_BASE, SCATTER_UNTIL_DONE,
+        [&](uint32_t, ScheduledTask& task) {
+            if (!reader.Next(chunk)) {
+                return false;
+            }
+            // Кусок кратен размеру значения; неполное значение - только в конце потока
+            if (chunk.Size() % sampleSize != 0) {
+                std::cerr << "Stream ends with a partial value" << std::endl;
+                partial = true;
+                return false;
+            }
+            if (spec) {
+                task.payload.Append(spec, sizeof(*spec));
+            }
+            task.payload.Append(chunk.Data(), chunk.Size());
+            task.header = MakeTaskHeader(taskType, 0, static_cast<uint32_t>(task.payload.Size()), (uint32_t)type);
+            bytes += chunk.Size();
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            if (completion.data.Size() != resultSize) {
+                return false;
+            }
+            if (spec) {
+                // Сумма гистограмм не зависит от порядка ответов
+                const char* data = completion.data.Data();
+                for (size_t bin = 0; bin < counts.size(); bin++) {
+                    uint64_t count;
+                    memcpy(&count, data + bin * sizeof(count), sizeof(count));
+                    counts[bin] += count;
+                }
+            }
+            else {
+                StatsPartial part;
+                memcpy(&part, completion.data.Data(), sizeof(part));
+                reducer.Add(index, part);
+            }
+            return true;
+        }, &chunks);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (!ok || partial || (!spec && reducer.Reduced() != chunks)) {
+        return false;
+    }
+    stats = reducer.Stats();
+
+    std::cout << (spec ? "Histogram" : "Stats") << ": " << bytes / sampleSize << " values in " << chunks
+        << " chunks, " << seconds * 1000.0 << " ms, " << (seconds > 0 ? bytes / 1e9 / seconds : 0.0)
+        << " GB/s" << std::endl;
+    return true;
+}
+
+bool Browser::StreamStats(std::istream& input, SampleType type, StatsPartial& stats) {
+    std::vector<uint64_t> unused;
+    return ReduceSamples(input, type, nullptr, stats, unused);
+}
+
+bool Browser::StreamHistogram(std::istream& input, SampleType type, const HistogramSpec& spec,
+    std::vector<uint64_t>& counts) {
+    StatsPartial unused;
+    return ReduceSamples(input, type, &spec, unused, counts);
+}
+
+void Browser::RunStatsDemo() {
+    std::cout << "\n=== Stats and histograms ===" << std::endl;
+
+    // Большое среднее и малый разброс: наивная сумма квадратов здесь
+    // теряет все значащие цифры дисперсии
+    const size_t count = 4 * 1024 * 1024 + 3;
+    std::mt19937_64 rng(18);
+    std::normal_distribution<double> normal(1e9, 1.0);
+    std::vector<double> values(count);
+    for (double& value : values) {
+        value = normal(rng);
+    }
+
+    double sum = 0;
+    double lo = values[0];
+    double hi = values[0];
+    for (double value : values) {
+        sum += value;
+        lo = value < lo ? value : lo;
+        hi = value > hi ? value : hi;
+    }
+    double mean = sum / count;
+    double m2 = 0;
+    for (double value : values) {
+        m2 += (value - mean) * (value - mean);
+    }
+
+    std::istringstream stream(std::string((const char*)values.data(), values.size() * sizeof(double)));
+    StatsPartial stats;
+    if (!StreamStats(stream, SampleType::FLOAT64, stats)) {
+        std::cerr << "Stream stats failed." << std::endl;
+        return;
+    }
+    double varianceError = std::fabs(StatsVariance(stats) - m2 / count) / (m2 / count);
+    bool exact = stats.count == count && stats.min == lo && stats.max == hi &&
+        std::fabs(stats.mean - mean) <= 1e-12 * mean;
+    std::cout << "float64: mean " << std::fixed << stats.mean << std::defaultfloat << ", variance "
+        << StatsVariance(stats) << ", relative error " << varianceError
+        << (exact && varianceError < 1e-6 ? " (matches)" : " (MISMATCH)")
+        << std::endl;
+
+    // float32 по 1000 корзинам с выбросами за пределы и NaN
+    std::vector<float> samples(count);
+    std::normal_distribution<float> standard(0.0f, 1.0f);
+    for (float& sample : samples) {
+        sample = standard(rng);
+    }
+    samples[7] = std::numeric_limits<float>::quiet_NaN();
+    samples[11] = std::numeric_limits<float>::infinity();
+
+    HistogramSpec spec;
+    spec.bins = 1000;
+    spec.lo = -4.0;
+    spec.hi = 4.0;
+    std::vector<uint64_t> local((size_t)spec.bins + 2, 0);
+    double scale = spec.bins / (spec.hi - spec.lo);
+    for (float sample : samples) {
+        if (sample < spec.lo) {
+            local[spec.bins]++;
+        }
+        else if (!(sample < spec.hi)) {
+            local[spec.bins + 1]++;
+        }
+        else {
+            uint32_t bin = (uint32_t)((sample - spec.lo) * scale);
+            local[bin < spec.bins ? bin : spec.bins - 1]++;
+        }
+    }
+
+    std::istringstream floats(std::string((const char*)samples.data(), samples.size() * sizeof(float)));
+    std::vector<uint64_t> counts;
+    if (!StreamHistogram(floats, SampleType::FLOAT32, spec, counts)) {
+        std::cerr << "Stream histogram failed." << std::endl;
+        return;
+    }
+    std::cout << "float32: " << spec.bins << " bins, " << counts[spec.bins] << " below, " << counts[spec.bins + 1]
+        << " above" << (counts == local ? " (matches)" : " (MISMATCH)") << std::endl;
+}
+
+bool Browser::RunLengthStream(RleOp op, std::istream& input, std::ostream& output, uint64_t& inBytes,
+    uint64_t& outBytes) {
+    if (!RequireTaskType(MessageType::TASK_RLE, "TASK_RLE")) {
+        return false;
+    }
+
+    ChunkReader reader(input, RLE_CHUNK_SIZE, 0);
+    std::map<uint64_t, uint32_t> rawSizes;        // исходный размер ещё не записанных кусков
+    std::map<uint64_t, MessageBuffer> pending;    // пришедшие раньше предыдущих
+    uint64_t nextWrite = 0;
+    uint64_t chunks = 0;
+    bool broken = false;
+    inBytes = 0;
+    outBytes = 0;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = RunScatterGather("RLE chunk", RLE_TASK_BASE, SCATTER_UNTIL_DONE,
+        [&](uint32_t index, ScheduledTask& task) {
+            RleHeader frame;
+            if (op == RleOp::ENCODE) {
+                if (!reader.Next(task.payload)) {
+                    return false;
+                }
+                frame.rawSize = (uint32_t)task.payload.Size();
+            }
+            else {
+                // Кадры идут подряд: заголовок говорит, сколько читать дальше
+                if (!input.read((char*)&frame, sizeof(frame))) {
+                    if (input.gcount() != 0) {
+                        std::cerr << "RLE stream ends with a partial frame header" << std::endl;
+                        broken = true;
+                    }
+                    return false;
+                }
+                if (frame.rawSize > MAX_DATA_SIZE || frame.encodedSize > MAX_DATA_SIZE - sizeof(frame)) {
+                    std::cerr << "RLE frame " << index << " is too large" << std::endl;
+                    broken = true;
+                    return false;
+                }
+                task.payload.Append(&frame, sizeof(frame));
+                task.payload.Resize(sizeof(frame) + frame.encodedSize);
+                if (!input.read(task.payload.Data() + sizeof(frame), frame.encodedSize)) {
+                    std::cerr << "RLE frame " << index << " is truncated" << std::endl;
+                    broken = true;
+                    return false;
+                }
+            }
+
+            rawSizes[index] = frame.rawSize;
+            inBytes += task.payload.Size();
+            task.header = MakeTaskHeader(MessageType::TASK_RLE, 0, static_cast<uint32_t>(task.payload.Size()),
+                (uint32_t)op);
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            // Ответ ENCODE - кадр с тем же исходным размером, DECODE - ровно исходные байты
+            auto chunk = rawSizes.find(index);
+            RleHeader frame = { 0, 0 };
+            if (op == RleOp::ENCODE && completion.data.Size() >= sizeof(frame)) {
+                memcpy(&frame, completion.data.Data(), sizeof(frame));
+            }
+            bool valid = chunk != rawSizes.end() && (op == RleOp::ENCODE ?
+                frame.rawSize == chunk->second && sizeof(frame) + frame.encodedSize == completion.data.Size() :
+                completion.data.Size() == chunk->second);
+            if (!valid) {
+                return false;
+            }
+            rawSizes.erase(chunk);
+            pending[index] = std::move(completion.data);
+
+            while (!pending.empty() && pending.begin()->first == nextWrite) {
+                const MessageBuffer& data = pending.begin()->second;
+                output.write(data.Data(), data.Size());
+                outBytes += data.Size();
+                pending.erase(pending.begin());
+                nextWrite++;
+            }
+            return true;
+        }, &chunks);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (!ok || broken || nextWrite != chunks || !output) {
+        return false;
+    }
+
+    uint64_t raw = op == RleOp::ENCODE ? inBytes : outBytes;
+    std::cout << (op == RleOp::ENCODE ? "RLE encode" : "RLE decode") << ": " << chunks << " chunks, "
+        << inBytes << " -> " << outBytes << " bytes in " << seconds * 1000.0 << " ms, "
+        << (seconds > 0 ? raw / 1e9 / seconds : 0.0) << " GB/s" << std::endl;
+    return true;
+}
+
+void Browser::RunRleDemo() {
+    std::cout << "\n=== RLE ===" << std::endl;
+
+    // Маска 1920x1080 по байту на пиксель: несколько кругов на нулевом фоне,
+    // затем блок случайных байтов, которые RLE не сжать
+    const uint32_t width = 1920;
+    const uint32_t height = 1080;
+    std::string data((size_t)width * height, '\0');
+    std::mt19937_64 rng(19);
+    for (int circle = 0; circle < 12; circle++) {
+        int cx = (int)(rng() % width);
+        int cy = (int)(rng() % height);
+        int radius = 20 + (int)(rng() % 150);
+        for (int y = cy - radius; y <= cy + radius; y++) {
+            for (int x = cx - radius; x <= cx + radius; x++) {
+                if (x >= 0 && y >= 0 && x < (int)width && y < (int)height &&
+                    (x - cx) * (x - cx) + (y - cy) * (y - cy) <= radius * radius) {
+                    data[(size_t)y * width + x] = (char)0xFF;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < RLE_CHUNK_SIZE; i++) {
+        data.push_back((char)rng());
+    }
+
+    std::istringstream raw(data);
+    std::ostringstream encoded;
+    uint64_t inBytes = 0;
+    uint64_t outBytes = 0;
+    if (!RunLengthStream(RleOp::ENCODE, raw, encoded, inBytes, outBytes)) {
+        std::cerr << "RLE encode failed." << std::endl;
+        return;
+    }
+    uint64_t encodedBytes = outBytes;
+
+    std::istringstream frames(encoded.str());
+    std::ostringstream decoded;
+    if (!RunLengthStream(RleOp::DECODE, frames, decoded, inBytes, outBytes)) {
+        std::cerr << "RLE decode failed." << std::endl;
+        return;
+    }
+    std::cout << "mask + noise: " << data.size() << " -> " << encodedBytes << " bytes ("
+        << 100.0 * encodedBytes / data.size() << "%)" << (decoded.str() == data ? " (round trip matches)" :
+        " (MISMATCH)") << std::endl;
+
+    // Сжатие по каналу: строки маски по 8 KB идут мимо кольца; половина
+    // строк - шум, их выборка отбраковывает
+    WireStats before = taskWire;
+    const size_t rowBytes = 8 * 1024;
+    const uint32_t rows = 256;
+    std::vector<std::string> rowData(rows);
+    std::vector<uint32_t> rowCrc(rows);
+    for (uint32_t i = 0; i < rows; i++) {
+        rowData[i] = i % 2 == 0 ? data.substr((size_t)i * rowBytes, rowBytes) :
+            data.substr(data.size() - RLE_CHUNK_SIZE + (size_t)(i % 32) * rowBytes, rowBytes);
+    }
+
+    bool ok = RunScatterGather("mask row", CRC_TASK_BASE, rows,
+        [&](uint32_t index, ScheduledTask& task) {
+            task.payload.Append(rowData[index].data(), rowData[index].size());
+            task.header = MakeTaskHeader(MessageType::TASK_CRC32, 0, static_cast<uint32_t>(task.payload.Size()),
+                (uint32_t)CrcKind::CRC32);
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            if (completion.data.Size() != sizeof(uint32_t)) {
+                return false;
+            }
+            memcpy(&rowCrc[index], completion.data.Data(), sizeof(uint32_t));
+            return true;
+        });
+
+    uint32_t matching = 0;
+    for (uint32_t i = 0; ok && i < rows; i++) {
+        matching += rowCrc[i] == Crc32(CrcKind::CRC32, 0, rowData[i].data(), rowData[i].size());
+    }
+    std::cout << "wire: " << taskWire.messages - before.messages << " rows, "
+        << taskWire.compressed - before.compressed << " sent compressed, "
+        << taskWire.rawBytes - before.rawBytes << " -> " << taskWire.wireBytes - before.wireBytes << " bytes, "
+        << matching << " CRCs" << (matching == rows ? " (match local)" : " (MISMATCH)") << std::endl;
+    std::cout << "session: tasks " << taskWire.compressed << "/" << taskWire.messages << " compressed, "
+        << taskWire.rawBytes << " -> " << taskWire.wireBytes << " bytes; results " << resultWire.compressed << "/"
+        << resultWire.messages << " compressed, " << resultWire.rawBytes << " -> " << resultWire.wireBytes
+        << " bytes" << std::endl;
+}
+
+bool Browser::LoadGraph(uint32_t vertices, const uint32_t* offsets, const uint32_t* targets, const uint32_t* weights,
+    uint32_t& handle) {
+    if (!RequireTaskType(MessageType::TASK_GRAPH_PATH, "TASK_GRAPH_PATH")) {
+        return false;
+    }
+    if (vertices == 0 || offsets[0] != 0) {
+        std::cerr << "Graph must have vertices and offsets starting at 0" << std::endl;
+        return false;
+    }
+
+    // Куски по вершинам: степени и дуги куска помещаются в одну задачу
+    size_t maxWords = (MAX_DATA_SIZE - sizeof(GraphHeader)) / sizeof(uint32_t);
+    size_t edgeWords = weights ? 2 : 1;
+    std::vector<uint32_t> pieceStarts;
+    uint32_t vertex = 0;
+    while (vertex < vertices) {
+        pieceStarts.push_back(vertex);
+        size_t words = 0;
+        uint32_t first = vertex;
+        while (vertex < vertices && offsets[vertex + 1] >= offsets[vertex] &&
+            words + 1 + (offsets[vertex + 1] - offsets[vertex]) * edgeWords <= maxWords) {
+            words += 1 + (offsets[vertex + 1] - offsets[vertex]) * edgeWords;
+            vertex++;
+        }
+        if (vertex == first) {
+            std::cerr << "Vertex " << vertex << " has invalid offsets or too many edges for one task" << std::endl;
+            return false;
+        }
+    }
+    pieceStarts.push_back(vertices);
+    uint32_t pieces = (uint32_t)pieceStarts.size() - 1;
+    uint32_t edges = offsets[vertices];
+
+    handle = nextGraphHandle++;
+
+    // Каждому живому воркеру - все куски графа, как и матрицы B
+    std::vector<uint32_t> loaded(numWorkers, 0);
+    std::vector<int> targetWorkers;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = BroadcastPinned("graph piece", MessageType::TASK_GRAPH_PATH, GRAPH_TASK_BASE, pieces,
+        [&](uint32_t index, ScheduledTask& task) {
+            GraphHeader piece;
+            piece.handle = handle;
+            piece.vertices = vertices;
+            piece.edges = edges;
+            piece.weighted = weights ? 1 : 0;
+            piece.firstVertex = pieceStarts[index];
+            piece.count = pieceStarts[index + 1] - piece.firstVertex;
+            uint32_t firstEdge = offsets[piece.firstVertex];
+            piece.pieceEdges = offsets[piece.firstVertex + piece.count] - firstEdge;
+
+            task.payload.Reserve(sizeof(piece) + (piece.count + piece.pieceEdges * edgeWords) * sizeof(uint32_t));
+            task.payload.Append(&piece, sizeof(piece));
+            for (uint32_t v = piece.firstVertex; v < piece.firstVertex + piece.count; v++) {
+                uint32_t degree = offsets[v + 1] - offsets[v];
+                task.payload.Append(&degree, sizeof(degree));
+            }
+            task.payload.Append(targets + firstEdge, piece.pieceEdges * sizeof(uint32_t));
+            if (weights) {
+                task.payload.Append(weights + firstEdge, piece.pieceEdges * sizeof(uint32_t));
+            }
+            task.header = MakeTaskHeader(MessageType::TASK_GRAPH_PATH, 0, static_cast<uint32_t>(task.payload.Size()),
+                (uint32_t)GraphOp::LOAD);
+        },
+        [&](int workerId, uint32_t, Completion& completion) {
+            uint32_t loadedVertices = 0;
+            if (completion.data.Size() != sizeof(loadedVertices)) {
+                return false;
+            }
+            memcpy(&loadedVertices, completion.data.Data(), sizeof(loadedVertices));
+            loaded[workerId] = loadedVertices > loaded[workerId] ? loadedVertices : loaded[workerId];
+            return true;
+        }, &targetWorkers);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (ok && targetWorkers.empty()) {
+        std::cerr << "No live workers left." << std::endl;
+        ok = false;
+    }
+    for (size_t i = 0; ok && i < targetWorkers.size(); i++) {
+        ok = loaded[targetWorkers[i]] == vertices;
+    }
+    if (!ok) {
+        return false;
+    }
+
+    GraphInfo info;
+    info.vertices = vertices;
+    info.edges = edges;
+    info.weighted = weights != nullptr;
+    graphs[handle] = info;
+
+    std::cout << "Graph of " << vertices << " vertices and " << edges << (weights ? " weighted" : "")
+        << " edges loaded into " << targetWorkers.size() << " workers as handle " << handle << ": " << pieces
+        << " pieces per worker in " << seconds * 1000.0 << " ms" << std::endl;
+    return true;
+}
+
+bool Browser::ShortestPaths(uint32_t handle, const std::vector<GraphQuery>& queries, std::vector<GraphPath>& results,
+    std::vector<std::vector<uint32_t>>* paths) {
+    auto graph = graphs.find(handle);
+    if (graph == graphs.end()) {
+        std::cerr << "Unknown graph handle " << handle << std::endl;
+        return false;
+    }
+
+    // Несколько пакетов на воркер, чтобы длинные поиски не задерживали остальных
+    size_t batch = BalancedShare(queries.size());
+    batch = batch < 1 ? 1 : batch > GRAPH_MAX_QUERIES_PER_TASK ? GRAPH_MAX_QUERIES_PER_TASK : batch;
+    uint32_t batches = (uint32_t)((queries.size() + batch - 1) / batch);
+    results.assign(queries.size(), GraphPath());
+    if (paths) {
+        paths->assign(queries.size(), std::vector<uint32_t>());
+    }
+
+    auto countOf = [&](uint32_t index) {
+        size_t first = (size_t)index * batch;
+        return queries.size() - first < batch ? queries.size() - first : batch;
+    };
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = RunScatterGather("path batch", GRAPH_TASK_BASE, batches,
+        [&](uint32_t index, ScheduledTask& task) {
+            GraphQueryHeader query;
+            query.handle = handle;
+            query.count = (uint32_t)countOf(index);
+            query.flags = paths ? GRAPH_QUERY_WITH_PATH : 0;
+            task.payload.Append(&query, sizeof(query));
+            task.payload.Append(queries.data() + (size_t)index * batch, query.count * sizeof(GraphQuery));
+            task.header = MakeTaskHeader(MessageType::TASK_GRAPH_PATH, 0, static_cast<uint32_t>(task.payload.Size()),
+                (uint32_t)GraphOp::PATH);
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            // Ответ: GraphPath на запрос, с путём - вершины сразу за ним
+            size_t first = (size_t)index * batch;
+            size_t count = countOf(index);
+            const char* cursor = completion.data.Data();
+            const char* end = cursor + completion.data.Size();
+            for (size_t q = 0; q < count; q++) {
+                GraphPath& result = results[first + q];
+                if ((size_t)(end - cursor) < sizeof(result)) {
+                    return false;
+                }
+                memcpy(&result, cursor, sizeof(result));
+                cursor += sizeof(result);
+                if (paths) {
+                    size_t length = result.distance == GRAPH_UNREACHABLE ? 0 : (size_t)result.hops + 1;
+                    if ((size_t)(end - cursor) / sizeof(uint32_t) < length) {
+                        return false;
+                    }
+                    std::vector<uint32_t>& path = (*paths)[first + q];
+                    path.resize(length);
+                    memcpy(path.data(), cursor, length * sizeof(uint32_t));
+                    cursor += length * sizeof(uint32_t);
+                }
+            }
+            return cursor == end;
+        });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (!ok) {
+        return false;
+    }
+
+    std::cout << queries.size() << (graph->second.weighted ? " Dijkstra" : " BFS") << " queries in " << batches
+        << " tasks of up to " << batch << ": " << seconds * 1000.0 << " ms, "
+        << (seconds > 0 ? queries.size() / seconds : 0.0) << " queries/s" << std::endl;
+    return true;
+}
+
+bool Browser::ReleaseGraph(uint32_t handle) {
+    auto graph = graphs.find(handle);
+    if (graph == graphs.end()) {
+        return false;
+    }
+
+    GraphHeader release;
+    memset(&release, 0, sizeof(release));
+    release.handle = handle;
+    graphs.erase(graph);
+
+    return BroadcastPinned("graph release", MessageType::TASK_GRAPH_PATH, GRAPH_TASK_BASE, 1,
+        [&](uint32_t, ScheduledTask& task) {
+            task.payload.Append(&release, sizeof(release));
+            task.header = MakeTaskHeader(MessageType::TASK_GRAPH_PATH, 0, sizeof(release),
+                (uint32_t)GraphOp::RELEASE);
+        }, nullptr);
+}
+
+// Расстояния в Browser для сверки: двоичная куча или очередь BFS
+static uint64_t LocalDistance(uint32_t vertices, const std::vector<uint32_t>& offsets,
+    const std::vector<uint32_t>& targets, const std::vector<uint32_t>& weights, uint32_t source, uint32_t target) {
+    std::vector<uint64_t> distance(vertices, GRAPH_UNREACHABLE);
+    typedef std::pair<uint64_t, uint32_t> Item;
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> heap;
+    distance[source] = 0;
+    heap.push(Item(0, source));
+    while (!heap.empty()) {
+        Item item = heap.top();
+        heap.pop();
+        if (item.first != distance[item.second]) {
+            continue;
+        }
+        if (item.second == target) {
+            break;
+        }
+        for (uint32_t e = offsets[item.second]; e < offsets[item.second + 1]; e++) {
+            uint64_t candidate = item.first + (weights.empty() ? 1 : weights[e]);
+            if (candidate < distance[targets[e]]) {
+                distance[targets[e]] = candidate;
+                heap.push(Item(candidate, targets[e]));
+            }
+        }
+    }
+    return distance[target];
+}
+
+// Путь существует и его длина равна расстоянию
+static bool CheckPath(const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& targets,
+    const std::vector<uint32_t>& weights, const GraphQuery& query, const GraphPath& result,
+    const std::vector<uint32_t>& path) {
+    if (result.distance == GRAPH_UNREACHABLE) {
+        return path.empty();
+    }
+    if (path.size() != (size_t)result.hops + 1 || path.front() != query.source || path.back() != query.target) {
+        return false;
+    }
+    uint64_t length = 0;
+    for (size_t i = 0; i + 1 < path.size(); i++) {
+        uint64_t best = GRAPH_UNREACHABLE;
+        for (uint32_t e = offsets[path[i]]; e < offsets[path[i] + 1]; e++) {
+            uint64_t weight = weights.empty() ? 1 : weights[e];
+            if (targets[e] == path[i + 1] && weight < best) {
+                best = weight;
+            }
+        }
+        if (best == GRAPH_UNREACHABLE) {
+            return false;
+        }
+        length += best;
+    }
+    return length == result.distance;
+}
+
+void Browser::RunGraphDemo() {
+    std::mt19937_64 rng(20);
+
+    // Взвешенная решётка с дугами в обе стороны - как дорожная сеть
+    const uint32_t side = 256;
+    std::vector<uint32_t> gridOffsets(1, 0);
+    std::vector<uint32_t> gridTargets;
+    std::vector<uint32_t> gridWeights;
+    for (uint32_t y = 0; y < side; y++) {
+        for (uint32_t x = 0; x < side; x++) {
+            const int dx[] = { 1, -1, 0, 0 };
+            const int dy[] = { 0, 0, 1, -1 };
+            for (int d = 0; d < 4; d++) {
+                int nx = (int)x + dx[d];
+                int ny = (int)y + dy[d];
+                if (nx >= 0 && ny >= 0 && nx < (int)side && ny < (int)side) {
+                    gridTargets.push_back((uint32_t)ny * side + nx);
+                    gridWeights.push_back(1 + (uint32_t)(rng() % 100));
+                }
+            }
+            gridOffsets.push_back((uint32_t)gridTargets.size());
+        }
+    }
+
+    // Невзвешенный случайный ориентированный граф, 8 дуг из вершины
+    const uint32_t randomVertices = 200000;
+    std::vector<uint32_t> randomOffsets(1, 0);
+    std::vector<uint32_t> randomTargets;
+    for (uint32_t v = 0; v < randomVertices; v++) {
+        for (int e = 0; e < 8; e++) {
+            randomTargets.push_back((uint32_t)(rng() % randomVertices));
+        }
+        randomOffsets.push_back((uint32_t)randomTargets.size());
+    }
+
+    struct GraphCase {
+        const char* name;
+        uint32_t vertices;
+        const std::vector<uint32_t>* offsets;
+        const std::vector<uint32_t>* targets;
+        const std::vector<uint32_t>* weights;
+    } cases[] = {
+        { "weighted 256x256 grid", side * side, &gridOffsets, &gridTargets, &gridWeights },
+        { "random unweighted", randomVertices, &randomOffsets, &randomTargets, nullptr },
+    };
+
+    const std::vector<uint32_t> noWeights;
+    for (const GraphCase& test : cases) {
+        std::cout << "\n=== Shortest paths: " << test.name << " ===" << std::endl;
+
+        uint32_t handle;
+        if (!LoadGraph(test.vertices, test.offsets->data(), test.targets->data(),
+            test.weights ? test.weights->data() : nullptr, handle)) {
+            std::cerr << "Loading the graph failed." << std::endl;
+            continue;
+        }
+
+        // Два прохода запросов по одной загрузке: граф больше не пересылается
+        std::vector<GraphQuery> queries(128);
+        for (GraphQuery& query : queries) {
+            query.source = (uint32_t)(rng() % test.vertices);
+            query.target = (uint32_t)(rng() % test.vertices);
+        }
+        std::vector<GraphQuery> more(512);
+        for (GraphQuery& query : more) {
+            query.source = (uint32_t)(rng() % test.vertices);
+            query.target = (uint32_t)(rng() % test.vertices);
+        }
+
+        std::vector<GraphPath> results;
+        std::vector<GraphPath> moreResults;
+        std::vector<std::vector<uint32_t>> paths;
+        bool answered = ShortestPaths(handle, queries, results, &paths) && ShortestPaths(handle, more, moreResults);
+        ReleaseGraph(handle);
+        if (!answered) {
+            std::cerr << "Path queries failed." << std::endl;
+            continue;
+        }
+
+        const std::vector<uint32_t>& weights = test.weights ? *test.weights : noWeights;
+        size_t correct = 0;
+        size_t reachable = 0;
+        for (size_t i = 0; i < queries.size(); i++) {
+            uint64_t expected = LocalDistance(test.vertices, *test.offsets, *test.targets, weights,
+                queries[i].source, queries[i].target);
+            correct += results[i].distance == expected &&
+                CheckPath(*test.offsets, *test.targets, weights, queries[i], results[i], paths[i]);
+            reachable += expected != GRAPH_UNREACHABLE;
+        }
+        std::cout << correct << " of " << queries.size() << " distances and paths checked, " << reachable
+            << " reachable" << (correct == queries.size() ? " (matches)" : " (MISMATCH)") << std::endl;
+    }
+}
+
+bool Browser::Factorial(uint32_t n, FactorialFormat format, BigInt& value, std::string& decimal) {
+    if (!RequireTaskType(MessageType::TASK_FACTORIAL, "TASK_FACTORIAL")) {
+        return false;
+    }
+    if (n > FACTORIAL_MAX_N) {
+        std::cerr << "Factorial argument must not exceed " << FACTORIAL_MAX_N << std::endl;
+        return false;
+    }
+
+    int window = TotalWindow();
+
+    // Части с равным числом бит: цена умножения растёт с длиной, а не
+    // с числом множителей. Ответ части - не больше половины MAX_DATA_SIZE
+    double totalBits = RangeProductBits(1, (uint64_t)n + 1);
+    double maxTaskBits = MAX_DATA_SIZE / 2 * 8.0;
+    uint64_t parts = (uint64_t)window * 2;
+    if (totalBits / parts < FACTORIAL_MIN_TASK_BITS) {
+        parts = (uint64_t)(totalBits / FACTORIAL_MIN_TASK_BITS);
+    }
+    if (totalBits / parts > maxTaskBits || parts == 0) {
+        parts = (uint64_t)(totalBits / maxTaskBits) + 1;
+    }
+
+    std::vector<uint64_t> bounds(1, 1);
+    for (uint64_t i = 1; i < parts; i++) {
+        double target = totalBits * i / parts;
+        uint64_t lo = bounds.back();
+        uint64_t hi = (uint64_t)n + 1;
+        while (lo < hi) {
+            uint64_t middle = lo + (hi - lo) / 2;
+            if (RangeProductBits(1, middle) < target) {
+                lo = middle + 1;
+            }
+            else {
+                hi = middle;
+            }
+        }
+        if (lo > bounds.back() && lo < (uint64_t)n + 1) {
+            bounds.push_back(lo);
+        }
+    }
+    bounds.push_back((uint64_t)n + 1);
+    parts = bounds.size() - 1;
+
+    // Единственную часть в десятичной записи переводит сам воркер
+    FactorialFormat taskFormat = FactorialFormat::LIMBS;
+    if (format == FactorialFormat::DECIMAL && parts == 1 && totalBits * 0.30103 <= MAX_DATA_SIZE) {
+        taskFormat = FactorialFormat::DECIMAL;
+    }
+
+    std::vector<BigInt> partials(parts);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = RunScatterGather("factorial part", FACTORIAL_TASK_BASE, parts,
+        [&](uint32_t index, ScheduledTask& task) {
+            FactorialRange range;
+            range.lo = bounds[index];
+            range.hi = bounds[index + 1];
+            task.payload.Append(&range, sizeof(range));
+            task.header = MakeTaskHeader(MessageType::TASK_FACTORIAL, 0, sizeof(range), (uint32_t)taskFormat);
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            if (taskFormat == FactorialFormat::DECIMAL) {
+                decimal.assign(completion.data.Data(), completion.data.Size());
+                return !decimal.empty();
+            }
+            FactorialResult result;
+            if (completion.data.Size() < sizeof(result)) {
+                return false;
+            }
+            memcpy(&result, completion.data.Data(), sizeof(result));
+            if (completion.data.Size() != sizeof(result) + (size_t)result.limbs * sizeof(uint32_t)) {
+                return false;
+            }
+            BigInt& partial = partials[index];
+            partial.shift = result.shift;
+            partial.limbs.resize(result.limbs);
+            memcpy(partial.limbs.data(), completion.data.Data() + sizeof(result),
+                (size_t)result.limbs * sizeof(uint32_t));
+            return true;
+        });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (!ok) {
+        return false;
+    }
+
+    std::cout << n << "!: " << parts << " parts of ~" << (uint64_t)(totalBits / parts) << " bits in "
+        << seconds * 1000.0 << " ms";
+    if (taskFormat == FactorialFormat::DECIMAL) {
+        std::cout << ", " << decimal.size() << " digits from the worker" << std::endl;
+        return true;
+    }
+
+    auto combineTime = std::chrono::steady_clock::now();
+    ProductOf(partials, value);
+    std::cout << ", combined in " << std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - combineTime).count() * 1000.0 << " ms";
+
+    if (format == FactorialFormat::DECIMAL) {
+        auto decimalTime = std::chrono::steady_clock::now();
+        BigToDecimal(value, decimal);
+        std::cout << ", " << decimal.size() << " digits in " << std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - decimalTime).count() * 1000.0 << " ms";
+    }
+    std::cout << std::endl;
+    return true;
+}
+
+// Остаток limbs * 2^shift по модулю p < 2^31
+static uint64_t BigRemainder(const BigInt& value, uint64_t p) {
+    uint64_t remainder = 0;
+    for (size_t i = value.limbs.size(); i-- > 0;) {
+        remainder = ((remainder << 32) | value.limbs[i]) % p;
+    }
+    for (uint64_t i = 0; i < value.shift; i++) {
+        remainder = remainder * 2 % p;
+    }
+    return remainder;
+}
+
+void Browser::RunFactorialDemo() {
+    std::cout << "\n=== Factorial ===" << std::endl;
+
+    BigInt value;
+    std::string decimal;
+    if (Factorial(25, FactorialFormat::DECIMAL, value, decimal)) {
+        std::cout << "25! = " << decimal
+            << (decimal == "15511210043330985984000000" ? " (correct)" : " (WRONG)") << std::endl;
+    }
+    else {
+        std::cerr << "Factorial failed." << std::endl;
+    }
+
+    // Сверка limbs с умножением на множители по одному в Browser
+    const uint32_t small = 20000;
+    if (Factorial(small, FactorialFormat::LIMBS, value, decimal)) {
+        std::vector<uint32_t> expected(1, 1);
+        for (uint64_t k = 2; k <= small; k++) {
+            uint64_t carry = 0;
+            for (uint32_t& limb : expected) {
+                uint64_t t = limb * k + carry;
+                limb = (uint32_t)t;
+                carry = t >> 32;
+            }
+            if (carry) {
+                expected.push_back((uint32_t)carry);
+            }
+        }
+        BigInt reference;
+        reference.limbs = expected;
+        std::string expectedDigits;
+        BigToDecimal(value, decimal);
+        BigToDecimal(reference, expectedDigits);
+        std::cout << small << "! has " << value.limbs.size() << " limbs and 2^" << value.shift
+            << (decimal == expectedDigits ? " (matches)" : " (MISMATCH)") << std::endl;
+    }
+    else {
+        std::cerr << "Factorial failed." << std::endl;
+    }
+
+    // Большой n: число цифр, нули в конце, степень двойки по Лежандру и
+    // остатки по простым больше n против прямого счёта по модулю
+    const uint32_t large = 100000;
+    if (!Factorial(large, FactorialFormat::DECIMAL, value, decimal)) {
+        std::cerr << "Factorial failed." << std::endl;
+        return;
+    }
+
+    uint64_t digits = (uint64_t)std::floor(std::lgamma(large + 1.0) / std::log(10.0)) + 1;
+    uint64_t zeros = 0;
+    uint64_t twos = 0;
+    for (uint64_t power = 5; power <= large; power *= 5) {
+        zeros += large / power;
+    }
+    for (uint64_t power = 2; power <= large; power *= 2) {
+        twos += large / power;
+    }
+    size_t lastDigit = decimal.find_last_not_of('0');
+    bool valid = decimal.size() == digits && lastDigit != std::string::npos &&
+        decimal.size() - 1 - lastDigit == zeros && value.shift == twos;
+
+    const uint64_t moduli[] = { 1000003ull, 998244353ull, 2147483647ull };
+    for (uint64_t p : moduli) {
+        uint64_t expected = 1;
+        for (uint64_t k = 2; k <= large; k++) {
+            expected = expected * k % p;
+        }
+        uint64_t fromDigits = 0;
+        for (char c : decimal) {
+            fromDigits = (fromDigits * 10 + (uint64_t)(c - '0')) % p;
+        }
+        valid = valid && BigRemainder(value, p) == expected && fromDigits == expected;
+    }
+    std::cout << large << "! = " << decimal.substr(0, 20) << "... (" << decimal.size() << " digits, "
+        << zeros << " trailing zeros)" << (valid ? " (matches)" : " (MISMATCH)") << std::endl;
+}
+
+char* Browser::CreateSharedBuffer(size_t size, uint32_t& id) {
+    std::unique_ptr<SharedRegion> region(new SharedRegion());
+    if (size == 0 || !region->Create(GetSharedBufferName(instance, nextSharedBuffer), size)) {
+        return nullptr;
+    }
+    id = nextSharedBuffer++;
+    char* data = region->Data();
+    sharedBuffers[id] = std::move(region);
+    return data;
+}
+
+bool Browser::ReleaseSharedBuffer(uint32_t id) {
+    auto buffer = sharedBuffers.find(id);
+    if (buffer == sharedBuffers.end()) {
+        return false;
+    }
+
+    // Воркеры закрывают свои отображения, затем Browser удаляет буфер
+    XorHeader unmap;
+    memset(&unmap, 0, sizeof(unmap));
+    unmap.flags = XOR_FLAG_UNMAP;
+    unmap.buffer = id;
+
+    bool ok = BroadcastPinned("buffer unmap", MessageType::TASK_XOR, XOR_TASK_BASE, 1,
+        [&](uint32_t, ScheduledTask& task) {
+            task.payload.Append(&unmap, sizeof(unmap));
+            task.header = MakeTaskHeader(MessageType::TASK_XOR, 0, sizeof(unmap), 0);
+        }, nullptr);
+    sharedBuffers.erase(buffer);
+    return ok;
+}
+
+bool Browser::XorStream(char* data, size_t size, const uint8_t* key, uint32_t keyLength, uint64_t seed) {
+    if (!RequireTaskType(MessageType::TASK_XOR, "TASK_XOR")) {
+        return false;
+    }
+    if (keyLength > XOR_MAX_KEY_LENGTH) {
+        std::cerr << "XOR key must not exceed " << XOR_MAX_KEY_LENGTH << " bytes" << std::endl;
+        return false;
+    }
+
+    // data целиком внутри общего буфера - куски задаются смещениями
+    uint32_t bufferId = 0;
+    uint64_t bufferOffset = 0;
+    for (const auto& buffer : sharedBuffers) {
+        const char* base = buffer.second->Data();
+        if (data >= base && size <= buffer.second->Size() && (size_t)(data - base) <= buffer.second->Size() - size) {
+            bufferId = buffer.first;
+            bufferOffset = (uint64_t)(data - base);
+            break;
+        }
+    }
+    bool shared = bufferId != 0;
+
+    int window = TotalWindow();
+
+    size_t span = size / ((size_t)window * 2);
+    if (shared) {
+        span = span < XOR_MIN_SHARED_BYTES ? XOR_MIN_SHARED_BYTES : span > XOR_MAX_SHARED_BYTES ? XOR_MAX_SHARED_BYTES : span;
+    }
+    else {
+        size_t maxSpan = MAX_DATA_SIZE - sizeof(XorHeader) - keyLength;
+        span = span < XOR_MIN_TASK_BYTES ? XOR_MIN_TASK_BYTES : span;
+        span = span > maxSpan ? maxSpan : span;
+    }
+    uint64_t parts = (size + span - 1) / span;
+    auto lengthOf = [&](uint32_t index) {
+        size_t offset = (size_t)index * span;
+        return size - offset < span ? size - offset : span;
+    };
+    uint64_t sentBytes = 0;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool ok = RunScatterGather("XOR part", XOR_TASK_BASE, parts,
+        [&](uint32_t index, ScheduledTask& task) {
+            size_t offset = (size_t)index * span;
+            size_t length = lengthOf(index);
+
+            XorHeader part;
+            part.position = offset;
+            part.seed = seed;
+            part.flags = shared ? XOR_FLAG_SHARED : 0;
+            part.buffer = bufferId;
+            part.offset = bufferOffset + offset;
+            part.size = length;
+
+            task.payload.Reserve(sizeof(part) + keyLength + (shared ? 0 : length));
+            task.payload.Append(&part, sizeof(part));
+            task.payload.Append(key, keyLength);
+            if (!shared) {
+                task.payload.Append(data + offset, length);
+            }
+            task.header = MakeTaskHeader(MessageType::TASK_XOR, 0, static_cast<uint32_t>(task.payload.Size()),
+                keyLength);
+            // Цена - по байтам буфера, а не по короткой нагрузке
+            task.cost = shared ? Scheduler::EstimateCost(MessageType::TASK_XOR, (uint32_t)length) : 0;
+            sentBytes += task.payload.Size();
+            return true;
+        },
+        [&](uint32_t index, Completion& completion) {
+            // Общий буфер уже изменён; из кольца приходит нагрузка целиком,
+            // из канала - только байты
+            size_t length = lengthOf(index);
+            if (shared) {
+                uint64_t done = 0;
+                if (completion.data.Size() != sizeof(done)) {
+                    return false;
+                }
+                memcpy(&done, completion.data.Data(), sizeof(done));
+                return done == length;
+            }
+            size_t skip = (completion.flags & RESULT_FLAG_IN_PLACE) ? sizeof(XorHeader) + keyLength : 0;
+            if (completion.data.Size() != skip + length) {
+                return false;
+            }
+            memcpy(data + (size_t)index * span, completion.data.Data() + skip, length);
+            return true;
+        });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (!ok) {
+        return false;
+    }
+
+    double gigabytes = size / 1e9;
+    std::cout << "XOR of " << size / (1024 * 1024) << " MB";
+    if (keyLength > 0) {
+        std::cout << " with a " << keyLength << "-byte key";
+    }
+    else {
+        std::cout << " with a counter keystream";
+    }
+    std::cout << (shared ? " in a shared buffer: " : ": ") << parts << " parts, " << sentBytes
+        << " bytes sent, " << seconds * 1000.0 << " ms, " << (seconds > 0 ? gigabytes / seconds : 0.0)
+        << " GB/s" << std::endl;
+    return true;
+}
+
+void Browser::RunXorDemo() {
+    std::cout << "\n=== XOR ===" << std::endl;
+
+    const size_t size = 32 * 1024 * 1024;
+    uint32_t bufferId;
+    char* buffer = CreateSharedBuffer(size, bufferId);
+    if (!buffer) {
+        std::cerr << "Shared buffer failed." << std::endl;
+        return;
+    }
+
+    std::mt19937_64 rng(22);
+    std::vector<char> original(size);
+    for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+        uint64_t value = rng();
+        memcpy(original.data() + i, &value, sizeof(value));
+    }
+    std::vector<uint8_t> key(37);
+    for (uint8_t& value : key) {
+        value = (uint8_t)rng();
+    }
+    const uint64_t seed = 0x5EED0F0B5C0FA7EDull;
+
+    // Повторяющийся ключ и поток от счётчика на месте, сверка с расчётом
+    // в Browser; второй проход возвращает исходные байты
+    struct XorCase {
+        const uint8_t* key;
+        uint32_t keyLength;
+    } cases[] = {
+        { key.data(), (uint32_t)key.size() },
+        { nullptr, 0 },
+    };
+
+    std::vector<char> expected(size);
+    for (const XorCase& test : cases) {
+        memcpy(buffer, original.data(), size);
+        if (test.keyLength > 0) {
+            XorRepeating(original.data(), expected.data(), size, test.key, test.keyLength, 0);
+        }
+        else {
+            XorCounter(original.data(), expected.data(), size, seed, 0);
+        }
+
+        bool masked = XorStream(buffer, size, test.key, test.keyLength, seed);
+        bool matches = masked && memcmp(buffer, expected.data(), size) == 0;
+        bool restored = masked && XorStream(buffer, size, test.key, test.keyLength, seed) &&
+            memcmp(buffer, original.data(), size) == 0;
+        std::cout << (matches ? "masked bytes match" : "masked bytes MISMATCH") << ", "
+            << (restored ? "second pass restores the input (matches)" : "second pass MISMATCH") << std::endl;
+    }
+
+    // Обычная память: байты идут через кольцо или канал
+    std::vector<char> plain(original.begin(), original.begin() + size / 4);
+    XorRepeating(plain.data(), expected.data(), plain.size(), key.data(), key.size(), 0);
+    if (XorStream(plain.data(), plain.size(), key.data(), (uint32_t)key.size(), seed)) {
+        bool matches = memcmp(plain.data(), expected.data(), plain.size()) == 0;
+        std::cout << (matches ? "copied bytes match" : "copied bytes MISMATCH") << std::endl;
+    }
+    else {
+        std::cerr << "XOR failed." << std::endl;
+    }
+
+    ReleaseSharedBuffer(bufferId);
+}
+
+void Browser::Shutdown() {
+    std::cout << "\n=== Sending termination commands ===" << std::endl;
+    for (int i = 0; i < numWorkers; i++) {
+        TaskMessage termTask = MakeTaskHeader(MessageType::TERMINATE, 0, 0);
+        SendTaskToWorker(i, termTask, nullptr);
+    }
+
+    dispatcher.Close();
+    for (int i = 0; i < numWorkers; i++) {
+        workers[i].transport.reset();
+    }
+    WaitForAllWorkers();
+}
+
+void Browser::WaitForAllWorkers() {
+    for (auto& worker : workers) {
+        WaitProcess(worker.hProcess);
+    }
+}
+
+void Browser::Cleanup() {
+    std::cout << "Cleaning up..." << std::endl;
+
+    dispatcher.Close();
+    for (auto& worker : workers) {
+        worker.transport.reset();
+        worker.endpoint.reset();
+        worker.ring.reset();
+        CloseProcess(worker.hProcess);
+    }
+    workers.clear();
+    sharedBuffers.clear();
+    resultCache.Clear();
+    cachedCompletions.clear();
+}
+
+// Browser --bench ...: без диалога и демонстраций, только нагрузка
+static int RunLoadMode(int argc, char* argv[]) {
+    LoadSpec spec;
+    std::string error;
+    if (!ParseLoadSpec(argc, argv, spec, error)) {
+        std::cerr << error << std::endl;
+        PrintLoadUsage(std::cerr);
+        return 2;
+    }
+    if (spec.workers > MAX_WORKERS || spec.inFlight > MAX_IN_FLIGHT) {
+        std::cerr << "Workers must be 1-" << MAX_WORKERS << ", in flight 1-" << MAX_IN_FLIGHT << std::endl;
+        return 2;
+    }
+
+    Browser browser;
+    browser.Configure(spec.workers, spec.inFlight);
+    if (!browser.Initialize()) {
+        std::cerr << "Failed to initialize browser." << std::endl;
+        return 1;
+    }
+
+    bool ok = browser.RunLoadBenchmark(spec);
+    browser.Shutdown();
+    browser.Cleanup();
+    return ok ? 0 : 1;
+}
+
+struct DemoEntry {
+    const char* name;
+    void (Browser::*run)();
+};
+
+static const DemoEntry DEMOS[] = {
+    { "image", &Browser::RunImageDemo },
+    { "sort", &Browser::RunSortDemo },
+    { "primes", &Browser::RunPrimeDemo },
+    { "matrix", &Browser::RunMatrixDemo },
+    { "fourier", &Browser::RunFourierDemo },
+    { "stats", &Browser::RunStatsDemo },
+    { "rle", &Browser::RunRleDemo },
+    { "graph", &Browser::RunGraphDemo },
+    { "factorial", &Browser::RunFactorialDemo },
+    { "xor", &Browser::RunXorDemo },
+};
+constexpr size_t DEMO_COUNT = sizeof(DEMOS) / sizeof(DEMOS[0]);
+
+// --demos - все демонстрации, --demos=имя,имя - выбранные
+static bool ParseDemos(const char* arg, std::vector<bool>& selected) {
+    const char* list = strchr(arg, '=');
+    selected.assign(DEMO_COUNT, list == nullptr);
+    if (list == nullptr) {
+        return true;
+    }
+
+    std::stringstream names(list + 1);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        size_t i = 0;
+        while (i < DEMO_COUNT && name != DEMOS[i].name) {
+            i++;
+        }
+        if (i == DEMO_COUNT) {
+            std::cerr << "Unknown demo: " << name << std::endl;
+            return false;
+        }
+        selected[i] = true;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+        return RunLoadMode(argc - 2, argv + 2);
+    }
+
+    // Browser [--demos[=имя,...]] [<файл> <образец>]
+    std::vector<bool> demos(DEMO_COUNT, false);
+    if (argc >= 2 && strncmp(argv[1], "--demos", 7) == 0 && (argv[1][7] == '\0' || argv[1][7] == '=')) {
+        if (!ParseDemos(argv[1], demos)) {
+            std::cerr << "Demos: image, sort, primes, matrix, fourier, stats, rle, graph, factorial, xor" << std::endl;
+            return 1;
+        }
+        argv[1] = argv[0];
+        argc--;
+        argv++;
+    }
+
+    Browser browser;
+
+    browser.GetUserInput();
+
+    if (!browser.Initialize()) {
+        std::cerr << "Failed to initialize browser." << std::endl;
+        std::cout << "Press Enter to exit...";
+        std::cin.ignore();
+        std::cin.get();
+        return 1;
+    }
+
+    browser.EnableResultCache(RESULT_CACHE_BYTES);
+    browser.Run();
+
+    // Browser <файл> <образец>: подсчёт по файлу любого размера
+    if (argc >= 3) {
+        std::ifstream input(argv[1], std::ios::binary);
+        uint64_t total = 0;
+
+        std::cout << "\n=== Counting \"" << argv[2] << "\" in " << argv[1] << " ===" << std::endl;
+        if (!input) {
+            std::cerr << "Failed to open " << argv[1] << std::endl;
+        }
+        else if (browser.CountInStream(input, argv[2], total)) {
+            std::cout << "count = " << total << std::endl;
+        }
+        else {
+            std::cerr << "Stream count failed." << std::endl;
+        }
+
+        // CRC того же файла: куски параллельно, затем сверка с подсчётом на месте
+        const CrcKind kinds[] = { CrcKind::CRC32, CrcKind::CRC32C };
+        for (CrcKind kind : kinds) {
+            std::ifstream file(argv[1], std::ios::binary);
+            uint32_t crc = 0;
+            uint64_t length = 0;
+            std::cout << "\n=== " << (kind == CrcKind::CRC32C ? "CRC32C" : "CRC32") << " of " << argv[1]
+                << " ===" << std::endl;
+            if (!file || !browser.ChecksumStream(file, kind, crc, length)) {
+                std::cerr << "Checksum failed." << std::endl;
+                continue;
+            }
+
+            std::ifstream again(argv[1], std::ios::binary);
+            std::vector<char> block(CRC_CHUNK_SIZE);
+            uint32_t local = 0;
+            while (again.read(block.data(), block.size()) || again.gcount() > 0) {
+                local = Crc32(kind, local, block.data(), (size_t)again.gcount());
+            }
+            std::cout << std::hex << "crc = " << crc << (crc == local ? " (matches local)" : " (MISMATCH)")
+                << std::dec << ", " << length << " bytes" << std::endl;
+        }
+
+        // Гистограмма байтов файла против подсчёта на месте
+        std::cout << "\n=== Byte histogram of " << argv[1] << " ===" << std::endl;
+        std::ifstream file(argv[1], std::ios::binary);
+        HistogramSpec spec = { 256, 0.0, 256.0 };
+        std::vector<uint64_t> counts;
+        if (!file || !browser.StreamHistogram(file, SampleType::UINT8, spec, counts)) {
+            std::cerr << "Byte histogram failed." << std::endl;
+        }
+        else {
+            std::ifstream again(argv[1], std::ios::binary);
+            std::vector<uint64_t> local(counts.size(), 0);
+            char byte;
+            while (again.get(byte)) {
+                local[(uint8_t)byte]++;
+            }
+            size_t used = 0;
+            size_t common = 0;
+            for (size_t i = 0; i < 256; i++) {
+                used += counts[i] != 0;
+                common = counts[i] > counts[common] ? i : common;
+            }
+            std::cout << used << " distinct bytes, most common 0x" << std::hex << common << std::dec << " ("
+                << counts[common] << " times)" << (counts == local ? " (matches local)" : " (MISMATCH)") << std::endl;
+        }
+    }
+
+    for (size_t i = 0; i < DEMO_COUNT; i++) {
+        if (demos[i]) {
+            (browser.*DEMOS[i].run)();
+        }
+    }
+
+    browser.Shutdown();
     browser.Cleanup();
 
     std::cout << "\n=== Browser finished successfully ===" << std::endl;
@@ -1,8 +1,8 @@
 #pragma once
 
-#include <windows.h>
 #include <string>
 #include <vector>
+#include <map>
 #include <thread>
 #include <memory>
 #include <iostream>
@@ -10,79 +10,68 @@
 #include <chrono>
 #include <cstring>
 #include <algorithm>
+#include <deque>
+#include <random>
+#include <functional>
 
-constexpr int MAX_WORKERS = 10;
-constexpr int MAX_DATA_SIZE = 1024 * 1024; // 1MB
+#include "Protocol.h"
+#include "Platform.h"
+#include "Transport.h"
+#include "SharedMemory.h"
+#include "Dispatcher.h"
+#include "Scheduler.h"
+#include "Chunking.h"
+#include "Image.h"
+#include "Sort.h"
+#include "Crc32.h"
+#include "Primes.h"
+#include "Fft.h"
+#include "Stats.h"
+#include "Rle.h"
+#include "Graph.h"
+#include "BigInt.h"
+#include "Xor.h"
+#include "ResultCache.h"
+#include "LoadGen.h"
+#include "Trace.h"
 
-enum class MessageType : uint32_t {
-    TASK_SUBSTRING = 7,   //  
-    TERMINATE = 999
-};
+constexpr int MAX_WORKERS = 10;
+constexpr int MAX_IN_FLIGHT = 16;
+constexpr int WORKER_START_TIMEOUT_MS = 10000; // на запуск всех воркеров
+constexpr size_t STREAM_CHUNK_SIZE = 256 * 1024;  // ядро фрагмента потока
+// Заход образца меньше ядра, а ответ - по записи на байт захода - влезает в MAX_DATA_SIZE
+constexpr size_t STREAM_MAX_PATTERN = STREAM_CHUNK_SIZE / 4;
+constexpr uint32_t STREAM_TASK_BASE = 0x40000000u; // taskId фрагментов потока
+constexpr size_t IMAGE_TILE_BYTES = 256 * 1024;   // строк изображения в одной задаче
+constexpr uint32_t IMAGE_TASK_BASE = 0x20000000u; // taskId плиток изображения
+constexpr uint32_t SORT_TASK_BASE = 0x10000000u;  // taskId частей сортировки
+constexpr size_t CRC_CHUNK_SIZE = 512 * 1024;     // кусок потока на одну задачу CRC
+constexpr uint32_t CRC_TASK_BASE = 0x08000000u;   // taskId кусков CRC
+constexpr uint32_t PRIME_TASK_BASE = 0x04000000u; // taskId частей диапазона простых
+constexpr uint64_t PRIME_MIN_TASK_SPAN = 1ull << 20; // меньшие части не окупают пересылку
+constexpr uint32_t MATRIX_TASK_BASE = 0x02000000u; // taskId частей матриц
+constexpr uint32_t FOURIER_TASK_BASE = 0x01000000u; // taskId пакетов преобразований
+constexpr size_t STATS_CHUNK_SIZE = 512 * 1024;   // кусок потока значений на одну задачу
+constexpr uint32_t STATS_TASK_BASE = 0x00800000u; // taskId кусков статистики и гистограмм
+constexpr size_t RLE_CHUNK_SIZE = 256 * 1024;     // кусок потока на одну задачу RLE
+constexpr uint32_t RLE_TASK_BASE = 0x00400000u;   // taskId кусков RLE
+constexpr uint32_t GRAPH_TASK_BASE = 0x00200000u; // taskId кусков графов и пакетов запросов
+constexpr uint32_t GRAPH_MAX_QUERIES_PER_TASK = 64;
+constexpr uint32_t FACTORIAL_TASK_BASE = 0x00100000u; // taskId частей произведения
+constexpr double FACTORIAL_MIN_TASK_BITS = 1 << 16;  // меньшие части не окупают пересылку
+constexpr uint32_t XOR_TASK_BASE = 0x00080000u;   // taskId кусков XOR
+constexpr size_t XOR_MIN_TASK_BYTES = 64 * 1024;  // через канал или кольцо
+constexpr size_t XOR_MIN_SHARED_BYTES = 1024 * 1024;   // в общем буфере пересылается только заголовок
+constexpr size_t XOR_MAX_SHARED_BYTES = 64 * 1024 * 1024;
+// taskId операции - [BASE, 2 * BASE): каждая база вдвое больше следующей
+constexpr uint64_t SCATTER_UNTIL_DONE = ~0ull;    // задачи, пока makeTask не вернёт false
+constexpr int RESULT_CACHED = -2;                // EnqueueCached: воркер не нужен
+constexpr size_t SORT_MIN_TASK_KEYS = 16 * 1024;  // меньшие части не окупают пересылку
 
-//    
-#pragma pack(push, 1)
-struct TaskMessage {
-    MessageType type;
-    uint32_t taskId;
-    uint32_t dataSize;
-    char data[1]; //  
+enum class SortStrategy {
+    SAMPLE,   // корзины по разделителям из выборки: ответы просто встают подряд
+    MERGE     // подряд идущие куски, отсортированные серии сливаются в Browser
 };
-#pragma pack(pop)
-
-//   
-#pragma pack(push, 1)
-struct ResultMessage {
-    uint32_t taskId;
-    uint32_t resultSize;
-    char data[1]; //  
-};
-#pragma pack(pop)
-
-//  
-inline TaskMessage* CreateTaskMessage(MessageType type, uint32_t taskId,
-    const void* data, uint32_t dataSize) {
-    uint32_t totalSize = sizeof(TaskMessage) + dataSize;
-    TaskMessage* msg = (TaskMessage*)malloc(totalSize);
-    if (msg) {
-        msg->type = type;
-        msg->taskId = taskId;
-        msg->dataSize = dataSize;
-        if (data && dataSize > 0) {
-            memcpy(msg->data, data, dataSize);
-        }
-    }
-    return msg;
-}
-
-inline void FreeTaskMessage(TaskMessage* msg) {
-    free(msg);
-}
-
-inline ResultMessage* CreateResultMessage(uint32_t taskId,
-    const void* data, uint32_t dataSize) {
-    uint32_t totalSize = sizeof(ResultMessage) + dataSize;
-    ResultMessage* msg = (ResultMessage*)malloc(totalSize);
-    if (msg) {
-        msg->taskId = taskId;
-        msg->resultSize = dataSize;
-        if (data && dataSize > 0) {
-            memcpy(msg->data, data, dataSize);
-        }
-    }
-    return msg;
-}
-
-inline void FreeResultMessage(ResultMessage* msg) {
-    free(msg);
-}
-
-inline std::string GetInputPipeName(int workerId) {
-    return std::string("\\\\.\\pipe\\worker_in_") + std::to_string(workerId);
-}
-
-inline std::string GetOutputPipeName(int workerId) {
-    return std::string("\\\\.\\pipe\\worker_out_") + std::to_string(workerId);
-}
 
 inline std::vector<std::string> GenerateTestStrings() {
     return {
@@ -99,35 +88,197 @@ inline std::vector<std::string> GenerateTestStrings() {
     };
 }
 
-//  Browser
+// Класс Browser
 class Browser {
 private:
     int numWorkers;
     int numTasks;
+    int maxInFlight;    // Задач в полёте на одного воркера
+    uint32_t instance;  // PID: отличает имена каналов и памяти от других Browser
 
     struct WorkerInfo {
         int id;
-        HANDLE hProcess;
-        HANDLE hInputPipe;  //   
-        HANDLE hOutputPipe; //   
+        ProcessHandle hProcess;
+        std::unique_ptr<TransportEndpoint> endpoint; // До подключения воркера
+        std::unique_ptr<Transport> transport;        // Задачи и результаты
+        std::unique_ptr<ShmRing> ring;               // Крупные полезные нагрузки
+        uint32_t capabilities;                       // Из WorkerHello
+        uint64_t taskTypes;
+        int computeThreads;                          // Окно задач = maxInFlight * computeThreads
         bool isBusy;
     };
 
     std::vector<WorkerInfo> workers;
+    Dispatcher dispatcher;
+    Scheduler scheduler;
+
+    // Матрицы B, загруженные во все воркеры
+    struct MatrixInfo {
+        MatrixType type;
+        uint32_t rows;
+        uint32_t cols;
+    };
+    std::map<uint32_t, MatrixInfo> matrices;
+    uint32_t nextMatrixHandle;
+
+    // Графы, загруженные во все воркеры
+    struct GraphInfo {
+        uint32_t vertices;
+        uint32_t edges;
+        bool weighted;
+    };
+    std::map<uint32_t, GraphInfo> graphs;
+    uint32_t nextGraphHandle;
+
+    // Общие буферы, отображённые и в воркеры
+    std::map<uint32_t, std::unique_ptr<SharedRegion>> sharedBuffers;
+    uint32_t nextSharedBuffer;
+
+    // Сообщения, прошедшие через канал (не через кольцо): байт до и после RLE
+    struct WireStats {
+        uint64_t messages = 0;
+        uint64_t compressed = 0;
+        uint64_t rawBytes = 0;
+        uint64_t wireBytes = 0;
+    };
+    WireStats taskWire;
+    WireStats resultWire;
+    MessageBuffer packedPayload;
+
+    // Ответы на повторяющиеся задачи; готовые отдаёт ReceiveNextResult
+    // раньше ответов воркеров
+    ResultCache resultCache;
+    std::deque<Completion> cachedCompletions;
+
+    // Отметки этапов задач, если трассировка включена
+    TaskTracer tracer;
 
-    bool CreatePipes();
+    bool CreateEndpoints();
     bool LaunchWorkerProcesses();
-    void CreateWorkerProcess(int workerId);
-    bool SendTaskToWorker(int workerId, const TaskMessage* task);
-    bool ReceiveResultFromWorker(int workerId);
+    bool CreateWorkerProcess(int workerId);
+    bool ConnectToWorker(int workerId, int timeoutMs);
+    int WindowFor(int workerId) const;
+    int TotalWindow() const;
+    // Доля count при нескольких частях на воркер, чтобы быстрые брали больше
+    size_t BalancedShare(size_t count) const;
+    // Все воркеры выполняют задачи type или имеют capability; иначе сообщение с name
+    bool RequireTaskType(MessageType type, const char* name) const;
+    bool RequireCapability(uint32_t capability, const char* name) const;
+    void DispatchPending();
+    bool SendTaskToWorker(int workerId, const TaskMessage& header, const void* payload,
+        const TraceStamps* trace = nullptr);
+    // dispatcher.Submit; trace не null - с TraceStamps перед данными
+    bool SubmitToWorker(int workerId, TaskMessage header, const void* payload, const TraceStamps* trace);
+    bool ReceiveNextResult(Completion& completion, int timeoutMs = -1);
+    // Задача через кэш результатов: ответ есть - воркер не нужен, такая же
+    // задача в полёте - ответ будет общий. Иначе как scheduler.Enqueue
+    int EnqueueCached(ScheduledTask&& task);
+    void FailTasks(const std::vector<uint32_t>& taskIds);
+    void ShareResult(const Completion& completion);
     void WaitForAllWorkers();
+    // Задача index без taskId: false - задач больше нет
+    typedef std::function<bool(uint32_t index, ScheduledTask& task)> TaskMaker;
+    // Удачный ответ на задачу index: false - ответ негоден
+    typedef std::function<bool(uint32_t index, Completion& completion)> ResultHandler;
+    // Разослать до count задач с taskId base + index, держа в полёте
+    // не больше суммы окон, и собрать ответы. made - сколько задач ушло
+    bool RunScatterGather(const char* what, uint32_t base, uint64_t count, const TaskMaker& makeTask,
+        const ResultHandler& onResult, uint64_t* made = nullptr);
+    // Кусок piece рассылки без taskId
+    typedef std::function<void(uint32_t piece, ScheduledTask& task)> PieceMaker;
+    // Удачный ответ воркера на кусок piece: false - ответ негоден; пустой - годен любой
+    typedef std::function<bool(int workerId, uint32_t piece, Completion& completion)> AckHandler;
+    // Все pieces кусков каждому живому воркеру с задачами type, закреплённые
+    // за ним, в пределах его окна. targets - воркеры, которым ушла рассылка
+    bool BroadcastPinned(const char* what, MessageType type, uint32_t base, uint32_t pieces,
+        const PieceMaker& makePiece, const AckHandler& onAck, std::vector<int>* targets = nullptr);
+    // Общий ход TASK_STATS и TASK_HISTOGRAM: spec == nullptr - статистика
+    bool ReduceSamples(std::istream& input, SampleType type, const HistogramSpec* spec,
+        StatsPartial& stats, std::vector<uint64_t>& counts);
 
 public:
     Browser();
     ~Browser();
 
     void GetUserInput();
+    // То же без диалога: число воркеров и задач в полёте на поток воркера
+    void Configure(int workerCount, int inFlight);
     bool Initialize();
+    // Кэш ответов задач Run объёмом maxBytes; 0 - выключен
+    void EnableResultCache(size_t maxBytes);
+    const ResultCacheStats& CacheStats() const { return resultCache.Stats(); }
+    // Задачи уходят с TASK_FLAG_TRACE к воркерам, которые его понимают
+    void EnableTracing(bool enable) { tracer.Enable(enable); }
+    TaskTracer& Tracer() { return tracer; }
     void Run();
+    // Нагрузка по spec: смесь задач, открытый или замкнутый цикл, прогрев;
+    // задержки и пропускная способность по типам - в отчёт и JSON
+    bool RunLoadBenchmark(const LoadSpec& spec);
+    // Число вхождений pattern в потоке произвольной длины
+    bool CountInStream(std::istream& input, const std::string& pattern, uint64_t& total);
+    // TASK_SEPIA или TASK_INVERT над изображением height x stride байт,
+    // разрезанным на плитки по строкам; src и dst могут совпадать
+    bool ProcessImage(MessageType type, PixelFormat format, const char* src, char* dst,
+        uint32_t width, uint32_t height, uint32_t stride);
+    void RunImageDemo();
+    // Сортировка count ключей на месте силами воркеров; объём не ограничен
+    // MAX_DATA_SIZE. data выровнен по размеру ключа
+    bool SortKeys(SortKey type, char* data, size_t count, SortStrategy strategy = SortStrategy::SAMPLE);
+    // CRC потока любой длины: куски считаются воркерами параллельно
+    // и склеиваются через Crc32Combine
+    bool ChecksumStream(std::istream& input, CrcKind kind, uint32_t& crc, uint64_t& length);
+    void RunSortDemo();
+    // Простые в [lo, hi): диапазон режется на части по числу воркеров.
+    // list не null - туда же список в формате PrimeMode::LIST
+    bool CountPrimes(uint64_t lo, uint64_t hi, uint64_t& count, MessageBuffer* list = nullptr);
+    void RunPrimeDemo();
+    // B (rows x cols по строкам) загружается в каждый воркер один раз
+    // и дальше умножается по handle
+    bool LoadMatrix(MatrixType type, const char* b, uint32_t rows, uint32_t cols, uint32_t& handle);
+    // C = A x B: A - rows x строк B, режется на блоки строк между воркерами
+    bool MultiplyMatrix(uint32_t handle, const char* a, uint32_t rows, char* c);
+    bool ReleaseMatrix(uint32_t handle);
+    void RunMatrixDemo();
+    // count преобразований длины size подряд (форматы - FourierInputSize и
+    // FourierOutputSize); мелкие собираются по несколько в одну задачу
+    bool Fourier(FourierMode mode, uint32_t size, const char* in, size_t count, char* out);
+    void RunFourierDemo();
+    // Статистика и гистограмма потока значений type любой длины: куски
+    // считаются воркерами, частичные результаты сливаются
+    bool StreamStats(std::istream& input, SampleType type, StatsPartial& stats);
+    bool StreamHistogram(std::istream& input, SampleType type, const HistogramSpec& spec,
+        std::vector<uint64_t>& counts);
+    void RunStatsDemo();
+    // TASK_RLE над потоком: ENCODE пишет в output кадры RLE по кускам
+    // RLE_CHUNK_SIZE, DECODE читает такие кадры и пишет исходные байты
+    bool RunLengthStream(RleOp op, std::istream& input, std::ostream& output, uint64_t& inBytes,
+        uint64_t& outBytes);
+    void RunRleDemo();
+    // Граф в CSR (offsets - vertices + 1 элементов, weights - null или по
+    // весу на дугу) загружается в каждый воркер один раз под handle
+    bool LoadGraph(uint32_t vertices, const uint32_t* offsets, const uint32_t* targets, const uint32_t* weights,
+        uint32_t& handle);
+    // Кратчайшие пути по загруженному графу: запросы пакетами между
+    // воркерами, по графу пересылаются только пары вершин. paths не null -
+    // туда же вершины путей
+    bool ShortestPaths(uint32_t handle, const std::vector<GraphQuery>& queries, std::vector<GraphPath>& results,
+        std::vector<std::vector<uint32_t>>* paths = nullptr);
+    bool ReleaseGraph(uint32_t handle);
+    void RunGraphDemo();
+    // n! деревом произведений: [1, n] режется на части с равным числом
+    // бит, воркеры считают произведения частей, Browser перемножает их.
+    // LIMBS - результат в value, DECIMAL - в decimal
+    bool Factorial(uint32_t n, FactorialFormat format, BigInt& value, std::string& decimal);
+    void RunFactorialDemo();
+    // Буфер, который воркеры отображают к себе: задачи над ним передают
+    // только смещения, байты меняются на месте
+    char* CreateSharedBuffer(size_t size, uint32_t& id);
+    bool ReleaseSharedBuffer(uint32_t id);
+    // XOR data с ключом длины keyLength, повторяющимся с начала data, или,
+    // при keyLength = 0, с потоком ключа от seed. Результат - на месте data;
+    // data внутри общего буфера не пересылается вовсе
+    bool XorStream(char* data, size_t size, const uint8_t* key, uint32_t keyLength, uint64_t seed);
+    void RunXorDemo();
+    void Shutdown();
     void Cleanup();
 };
\ No newline at end of file
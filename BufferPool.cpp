@@ -0,0 +1,334 @@
+#include "BufferPool.h"
+#include <mutex>
+#include <atomic>
+#include <new>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+constexpr size_t SMALL_SLAB_SIZE = 64 * 1024;
+constexpr size_t HUGE_SLAB_SIZE = 2 * 1024 * 1024;  // одна большая страница
+constexpr size_t THREAD_CACHE_BYTES = 1024 * 1024;  // на класс в каждом потоке
+constexpr uint32_t THREAD_CACHE_MIN_BLOCKS = 4;
+
+// Свободный блок хранит ссылку на следующий в себе самом
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+// Общий список класса: излишки кэшей потоков и блоки завершившихся потоков
+struct SharedClass {
+    std::mutex lock;
+    FreeBlock* head;
+    uint32_t count;
+};
+
+static SharedClass sharedClasses[POOL_CLASS_COUNT];
+
+static std::atomic<uint64_t> refillCount(0);
+static std::atomic<uint64_t> slabCount(0);
+static std::atomic<uint64_t> slabByteCount(0);
+static std::atomic<uint64_t> hugeSlabCount(0);
+static std::atomic<uint64_t> directCount(0);
+
+static void MoveToShared(int sizeClass, FreeBlock*& head, uint32_t& count, uint32_t moveCount);
+
+// Кэш потока: выдача и возврат без блокировок
+struct ThreadCache {
+    FreeBlock* head[POOL_CLASS_COUNT];
+    uint32_t count[POOL_CLASS_COUNT];
+
+    ThreadCache() {
+        memset(head, 0, sizeof(head));
+        memset(count, 0, sizeof(count));
+    }
+
+    ~ThreadCache() {
+        for (int c = 0; c < POOL_CLASS_COUNT; c++) {
+            MoveToShared(c, head[c], count[c], count[c]);
+        }
+    }
+};
+
+static thread_local ThreadCache threadCache;
+
+static uint32_t CacheLimit(int sizeClass) {
+    uint32_t blocks = (uint32_t)(THREAD_CACHE_BYTES >> (POOL_MIN_SHIFT + sizeClass));
+    return blocks > THREAD_CACHE_MIN_BLOCKS ? blocks : THREAD_CACHE_MIN_BLOCKS;
+}
+
+int BufferSizeClass(size_t size) {
+    if (size > ((size_t)1 << POOL_MAX_SHIFT)) {
+        return POOL_DIRECT;
+    }
+    int shift = POOL_MIN_SHIFT;
+    while (((size_t)1 << shift) < size) {
+        shift++;
+    }
+    return shift - POOL_MIN_SHIFT;
+}
+
+size_t BufferClassSize(int sizeClass) {
+    return (size_t)1 << (POOL_MIN_SHIFT + sizeClass);
+}
+
+static void MoveToShared(int sizeClass, FreeBlock*& head, uint32_t& count, uint32_t moveCount) {
+    if (moveCount == 0) {
+        return;
+    }
+
+    FreeBlock* first = head;
+    FreeBlock* last = head;
+    for (uint32_t i = 1; i < moveCount; i++) {
+        last = last->next;
+    }
+    head = last->next;
+    count -= moveCount;
+
+    SharedClass& shared = sharedClasses[sizeClass];
+    std::lock_guard<std::mutex> guard(shared.lock);
+    last->next = shared.head;
+    shared.head = first;
+    shared.count += moveCount;
+}
+
+#ifdef _WIN32
+
+static std::atomic<bool> largePagesUnavailable(false);
+
+static char* AllocateSlab(size_t size, bool huge, bool& onHugePages) {
+    onHugePages = false;
+
+    // MEM_LARGE_PAGES требует права SeLockMemoryPrivilege; без него
+    // после первой неудачи берём обычные страницы
+    if (huge && !largePagesUnavailable) {
+        SIZE_T largePage = GetLargePageMinimum();
+        if (largePage != 0 && size % largePage == 0) {
+            void* slab = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (slab) {
+                onHugePages = true;
+                return (char*)slab;
+            }
+        }
+        largePagesUnavailable = true;
+    }
+
+    return (char*)VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+#else
+
+static char* AllocateSlab(size_t size, bool huge, bool& onHugePages) {
+    onHugePages = false;
+
+    size_t reserved = huge ? size * 2 : size;
+    void* mapping = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    char* slab = (char*)mapping;
+    if (huge) {
+        // Плита, выровненная по 2 МБ, может целиком лечь на одну большую страницу
+        uintptr_t aligned = ((uintptr_t)slab + size - 1) & ~(uintptr_t)(size - 1);
+        size_t head = aligned - (uintptr_t)slab;
+        if (head > 0) {
+            munmap(slab, head);
+        }
+        if (reserved - head > size) {
+            munmap((char*)aligned + size, reserved - head - size);
+        }
+        slab = (char*)aligned;
+#ifdef MADV_HUGEPAGE
+        onHugePages = madvise(slab, size, MADV_HUGEPAGE) == 0;
+#endif
+    }
+    return slab;
+}
+
+#endif
+
+// Пополняет кэш потока из общего списка или новой плиты
+static bool Refill(ThreadCache& cache, int sizeClass) {
+    refillCount++;
+
+    SharedClass& shared = sharedClasses[sizeClass];
+    {
+        std::lock_guard<std::mutex> guard(shared.lock);
+        uint32_t take = CacheLimit(sizeClass) / 2;
+        while (shared.head && take > 0) {
+            FreeBlock* block = shared.head;
+            shared.head = block->next;
+            shared.count--;
+            block->next = cache.head[sizeClass];
+            cache.head[sizeClass] = block;
+            cache.count[sizeClass]++;
+            take--;
+        }
+    }
+    if (cache.head[sizeClass]) {
+        return true;
+    }
+
+    // Плиты не возвращаются системе: пул держит столько памяти,
+    // сколько было занято в пике
+    size_t blockSize = BufferClassSize(sizeClass);
+    bool huge = blockSize >= SMALL_SLAB_SIZE;
+    size_t slabSize = huge ? HUGE_SLAB_SIZE : SMALL_SLAB_SIZE;
+    bool onHugePages;
+    char* slab = AllocateSlab(slabSize, huge, onHugePages);
+    if (!slab) {
+        return false;
+    }
+
+    slabCount++;
+    slabByteCount += slabSize;
+    if (onHugePages) {
+        hugeSlabCount++;
+    }
+
+    for (size_t offset = slabSize; offset >= blockSize; offset -= blockSize) {
+        FreeBlock* block = (FreeBlock*)(slab + offset - blockSize);
+        block->next = cache.head[sizeClass];
+        cache.head[sizeClass] = block;
+        cache.count[sizeClass]++;
+    }
+    return true;
+}
+
+char* AcquireBuffer(int sizeClass) {
+    ThreadCache& cache = threadCache;
+    if (!cache.head[sizeClass] && !Refill(cache, sizeClass)) {
+        return nullptr;
+    }
+
+    FreeBlock* block = cache.head[sizeClass];
+    cache.head[sizeClass] = block->next;
+    cache.count[sizeClass]--;
+    return (char*)block;
+}
+
+void ReleaseBuffer(char* block, int sizeClass) {
+    ThreadCache& cache = threadCache;
+    FreeBlock* node = (FreeBlock*)block;
+    node->next = cache.head[sizeClass];
+    cache.head[sizeClass] = node;
+    cache.count[sizeClass]++;
+
+    // Блоки, отпущенные не тем потоком, который их брал, копятся здесь:
+    // излишек уходит в общий список
+    if (cache.count[sizeClass] > CacheLimit(sizeClass)) {
+        MoveToShared(sizeClass, cache.head[sizeClass], cache.count[sizeClass], cache.count[sizeClass] / 2);
+    }
+}
+
+BufferPoolStats GetBufferPoolStats() {
+    BufferPoolStats stats;
+    stats.refills = refillCount;
+    stats.slabs = slabCount;
+    stats.slabBytes = slabByteCount;
+    stats.hugePageSlabs = hugeSlabCount;
+    stats.direct = directCount;
+    return stats;
+}
+
+MessageBuffer::MessageBuffer() : data(nullptr), size(0), capacity(0), sizeClass(POOL_DIRECT) {}
+
+MessageBuffer::MessageBuffer(size_t initialSize) : MessageBuffer() {
+    Resize(initialSize);
+}
+
+MessageBuffer::~MessageBuffer() {
+    Release();
+}
+
+MessageBuffer::MessageBuffer(MessageBuffer&& other) noexcept
+    : data(other.data), size(other.size), capacity(other.capacity), sizeClass(other.sizeClass) {
+    other.data = nullptr;
+    other.size = 0;
+    other.capacity = 0;
+    other.sizeClass = POOL_DIRECT;
+}
+
+MessageBuffer& MessageBuffer::operator=(MessageBuffer&& other) noexcept {
+    if (this != &other) {
+        Release();
+        data = other.data;
+        size = other.size;
+        capacity = other.capacity;
+        sizeClass = other.sizeClass;
+        other.data = nullptr;
+        other.size = 0;
+        other.capacity = 0;
+        other.sizeClass = POOL_DIRECT;
+    }
+    return *this;
+}
+
+void MessageBuffer::Reserve(size_t newCapacity) {
+    if (newCapacity <= capacity) {
+        return;
+    }
+
+    int newClass = BufferSizeClass(newCapacity);
+    char* block;
+    size_t blockSize;
+    if (newClass == POOL_DIRECT) {
+        block = new char[newCapacity];
+        blockSize = newCapacity;
+        directCount++;
+    }
+    else {
+        block = AcquireBuffer(newClass);
+        blockSize = BufferClassSize(newClass);
+        if (!block) {
+            throw std::bad_alloc();
+        }
+    }
+
+    if (size > 0) {
+        memcpy(block, data, size);
+    }
+
+    size_t keptSize = size;
+    Release();
+    data = block;
+    size = keptSize;
+    capacity = blockSize;
+    sizeClass = newClass;
+}
+
+void MessageBuffer::Resize(size_t newSize) {
+    if (newSize > capacity) {
+        Reserve(newSize > capacity * 2 ? newSize : capacity * 2);
+    }
+    size = newSize;
+}
+
+void MessageBuffer::Append(const void* bytes, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    size_t offset = size;
+    Resize(size + count);
+    memcpy(data + offset, bytes, count);
+}
+
+void MessageBuffer::Release() {
+    if (data) {
+        if (sizeClass == POOL_DIRECT) {
+            delete[] data;
+        }
+        else {
+            ReleaseBuffer(data, sizeClass);
+        }
+    }
+    data = nullptr;
+    size = 0;
+    capacity = 0;
+    sizeClass = POOL_DIRECT;
+}
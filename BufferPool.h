@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Классы размеров: степени двойки от 256 байт до 1 МБ (MAX_DATA_SIZE).
+// Классы от 64 КБ нарезаются из плит по 2 МБ на больших страницах
+constexpr int POOL_MIN_SHIFT = 8;
+constexpr int POOL_MAX_SHIFT = 20;
+constexpr int POOL_CLASS_COUNT = POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1;
+constexpr int POOL_DIRECT = -1;     // больше старшего класса: память напрямую
+
+struct BufferPoolStats {
+    uint64_t refills;       // обращений к общему списку при пустом кэше потока
+    uint64_t slabs;         // плит, взятых у системы
+    uint64_t slabBytes;
+    uint64_t hugePageSlabs; // из них на больших страницах
+    uint64_t direct;        // выделений мимо пула
+};
+
+int BufferSizeClass(size_t size);
+size_t BufferClassSize(int sizeClass);
+
+// Блок класса sizeClass; сначала из кэша текущего потока, затем из
+// общего списка, затем из новой плиты. Вернуть можно из любого потока
+char* AcquireBuffer(int sizeClass);
+void ReleaseBuffer(char* block, int sizeClass);
+
+BufferPoolStats GetBufferPoolStats();
+
+// Буфер сообщения из пула. Только перемещается; блок возвращается
+// в пул в деструкторе. Содержимое при росте сохраняется, новые байты
+// не обнуляются
+class MessageBuffer {
+private:
+    char* data;
+    size_t size;
+    size_t capacity;
+    int sizeClass;
+
+public:
+    MessageBuffer();
+    explicit MessageBuffer(size_t initialSize);
+    ~MessageBuffer();
+
+    MessageBuffer(MessageBuffer&& other) noexcept;
+    MessageBuffer& operator=(MessageBuffer&& other) noexcept;
+    MessageBuffer(const MessageBuffer&) = delete;
+    MessageBuffer& operator=(const MessageBuffer&) = delete;
+
+    char* Data() { return data; }
+    const char* Data() const { return data; }
+    size_t Size() const { return size; }
+    size_t Capacity() const { return capacity; }
+    bool Empty() const { return size == 0; }
+
+    void Reserve(size_t newCapacity);
+    void Resize(size_t newSize);
+    void Append(const void* bytes, size_t count);
+    void Clear() { size = 0; }
+    // Возвращает блок в пул
+    void Release();
+};
@@ -0,0 +1,70 @@
+#include "Chunking.h"
+#include <cstring>
+
+ChunkReader::ChunkReader(std::istream& stream, size_t coreSize, size_t overlapSize)
+    : input(stream), chunkSize(coreSize), overlap(overlapSize), started(false), finished(false) {}
+
+bool ChunkReader::Next(MessageBuffer& chunk) {
+    if (finished) {
+        return false;
+    }
+
+    chunk.Clear();
+    chunk.Append(lookahead.data(), lookahead.size());
+    size_t carried = chunk.Size();
+    chunk.Resize(chunkSize + overlap);
+
+    input.read(chunk.Data() + carried, (std::streamsize)(chunk.Size() - carried));
+    size_t read = (size_t)input.gcount();
+    chunk.Resize(carried + read);
+
+    // Перенесённые байты уже были хвостом предыдущего фрагмента, и
+    // вхождение в них не помещается: без новых данных фрагмента нет
+    if (read == 0 && started) {
+        finished = true;
+        return false;
+    }
+    started = true;
+
+    if (chunk.Size() < chunkSize + overlap) {
+        finished = true;
+        lookahead.clear();
+    }
+    else {
+        lookahead.assign(chunk.Data() + chunk.Size() - overlap, chunk.Data() + chunk.Size());
+    }
+    return !chunk.Empty();
+}
+
+ChunkReducer::ChunkReducer(size_t coreSize) : core(coreSize), nextIndex(0), carry(0), total(0), failed(false) {}
+
+bool ChunkReducer::Add(uint64_t index, const char* data, size_t size) {
+    uint32_t entryCount;
+    if (failed || size < sizeof(entryCount)) {
+        failed = true;
+        return false;
+    }
+
+    memcpy(&entryCount, data, sizeof(entryCount));
+    if (entryCount == 0 || size != sizeof(entryCount) + (uint64_t)entryCount * sizeof(ChunkEntry)) {
+        failed = true;
+        return false;
+    }
+
+    std::vector<ChunkEntry>& entries = pending[index];
+    entries.resize(entryCount);
+    memcpy(entries.data(), data + sizeof(entryCount), entryCount * sizeof(ChunkEntry));
+
+    auto it = pending.begin();
+    while (it != pending.end() && it->first == nextIndex) {
+        // Одна запись - ответ не зависит от захода
+        const std::vector<ChunkEntry>& ready = it->second;
+        const ChunkEntry& entry = carry < ready.size() ? ready[carry] : ready[0];
+        total += entry.count;
+        // Без вхождений во фрагменте заход переходит дальше за его ядро
+        carry = entry.count > 0 ? entry.spill : carry > core ? carry - core : 0;
+        nextIndex++;
+        it = pending.erase(it);
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <istream>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+
+// Нарезка потока на фрагменты: ядро chunkSize байт и overlap байт
+// следующего фрагмента. В памяти только текущий фрагмент
+class ChunkReader {
+private:
+    std::istream& input;
+    size_t chunkSize;
+    size_t overlap;
+    std::vector<char> lookahead;  // начало следующего фрагмента
+    bool started;
+    bool finished;
+
+public:
+    ChunkReader(std::istream& stream, size_t coreSize, size_t overlapSize);
+
+    // false, когда новых данных больше нет
+    bool Next(MessageBuffer& chunk);
+};
+
+// Свёртка ответов фрагментов по порядку; ответы, пришедшие раньше
+// предыдущих, ждут в pending
+class ChunkReducer {
+private:
+    std::map<uint64_t, std::vector<ChunkEntry>> pending;
+    size_t core;        // ядро фрагмента, кроме последнего
+    uint64_t nextIndex;
+    uint64_t carry;     // заход последнего вхождения в текущий фрагмент
+    uint64_t total;
+    bool failed;
+
+public:
+    // coreSize - как у ChunkReader: вхождение без ответа фрагмента может
+    // накрыть его ядро и зайти в следующий
+    explicit ChunkReducer(size_t coreSize);
+
+    // data - результат задачи TASK_FLAG_STREAM_CHUNK
+    bool Add(uint64_t index, const char* data, size_t size);
+
+    uint64_t Total() const { return total; }
+    uint64_t Reduced() const { return nextIndex; }
+    size_t Pending() const { return pending.size(); }
+};
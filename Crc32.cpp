@@ -0,0 +1,312 @@
+#include "Crc32.h"
+#include <cstring>
+
+// Полиномы в отражённом виде: старший бит слова - x^0
+constexpr uint32_t CRC32_POLY = 0xEDB88320u;
+constexpr uint32_t CRC32C_POLY = 0x82F63B78u;
+
+constexpr size_t PCLMUL_MIN_LENGTH = 64;   // одна строка кэша: четыре блока свёртки
+constexpr size_t PCLMUL_MIN_LENGTH_SSE42 = 256; // короче инструкция crc32 быстрее свёртки
+
+struct CrcTables {
+    uint32_t poly;
+    uint32_t slice[8][256];    // slicing-by-8
+    uint32_t powers[64];       // x^(2^k) mod P для склейки
+    // Константы свёртки PCLMULQDQ: x^n mod P, сдвинутые на бит влево
+    uint64_t fold4[2];         // x^(4*128+32), x^(4*128-32): через 64 байта
+    uint64_t fold1[2];         // x^(128+32), x^(128-32): через 16 байт
+    uint64_t fold64;           // x^64
+    uint64_t barrett[2];       // P' и u' = x^64 div P, отражённые в 33 битах
+};
+
+// a * b mod P в отражённом виде; a не ноль
+static uint32_t MultModP(uint32_t a, uint32_t b, uint32_t poly) {
+    uint32_t m = 1u << 31;
+    uint32_t p = 0;
+    while (true) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ poly : b >> 1;
+    }
+    return p;
+}
+
+// x^n mod P
+static uint32_t XPowModP(const uint32_t* powers, uint32_t poly, uint64_t n) {
+    uint32_t p = 1u << 31;
+    for (int k = 0; n != 0; k++, n >>= 1) {
+        if (n & 1) {
+            p = MultModP(powers[k], p, poly);
+        }
+    }
+    return p;
+}
+
+static uint64_t Reflect(uint64_t value, int bits) {
+    uint64_t result = 0;
+    for (int i = 0; i < bits; i++) {
+        result = (result << 1) | ((value >> i) & 1);
+    }
+    return result;
+}
+
+static CrcTables BuildTables(uint32_t poly) {
+    CrcTables t;
+    t.poly = poly;
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+        }
+        t.slice[0][i] = crc;
+    }
+    for (int s = 1; s < 8; s++) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t prev = t.slice[s - 1][i];
+            t.slice[s][i] = (prev >> 8) ^ t.slice[0][prev & 0xFF];
+        }
+    }
+
+    t.powers[0] = 1u << 30;     // x^1
+    for (int k = 1; k < 64; k++) {
+        t.powers[k] = MultModP(t.powers[k - 1], t.powers[k - 1], poly);
+    }
+
+    t.fold4[0] = (uint64_t)XPowModP(t.powers, poly, 4 * 128 + 32) << 1;
+    t.fold4[1] = (uint64_t)XPowModP(t.powers, poly, 4 * 128 - 32) << 1;
+    t.fold1[0] = (uint64_t)XPowModP(t.powers, poly, 128 + 32) << 1;
+    t.fold1[1] = (uint64_t)XPowModP(t.powers, poly, 128 - 32) << 1;
+    t.fold64 = (uint64_t)XPowModP(t.powers, poly, 64) << 1;
+
+    // Деление x^64 на P в обычном порядке бит; старший бит частного (x^32)
+    // учтён сразу, остаток дальше помещается в 64 бита
+    uint64_t normal = Reflect(poly, 32);
+    uint64_t quotient = 1ull << 32;
+    uint64_t rest = normal << 32;
+    for (int i = 63; i >= 32; i--) {
+        if (rest & (1ull << i)) {
+            quotient |= 1ull << (i - 32);
+            rest ^= (normal | (1ull << 32)) << (i - 32);
+        }
+    }
+    t.barrett[0] = ((uint64_t)poly << 1) | 1;
+    t.barrett[1] = Reflect(quotient, 33);
+    return t;
+}
+
+static const CrcTables& TablesFor(CrcKind kind) {
+    static const CrcTables crc32Tables = BuildTables(CRC32_POLY);
+    static const CrcTables crc32cTables = BuildTables(CRC32C_POLY);
+    return kind == CrcKind::CRC32C ? crc32cTables : crc32Tables;
+}
+
+// Обновление регистра без начальной и конечной инверсии
+static uint32_t UpdateScalar(const CrcTables& t, uint32_t reg, const uint8_t* p, size_t length) {
+    // Восемь байт за шаг: каждый байт - своя таблица, зависимость
+    // между шагами только через reg
+    while (length >= 8) {
+        uint32_t low;
+        uint32_t high;
+        memcpy(&low, p, 4);
+        memcpy(&high, p + 4, 4);
+        low ^= reg;
+        reg = t.slice[7][low & 0xFF] ^ t.slice[6][(low >> 8) & 0xFF] ^
+            t.slice[5][(low >> 16) & 0xFF] ^ t.slice[4][low >> 24] ^
+            t.slice[3][high & 0xFF] ^ t.slice[2][(high >> 8) & 0xFF] ^
+            t.slice[1][(high >> 16) & 0xFF] ^ t.slice[0][high >> 24];
+        p += 8;
+        length -= 8;
+    }
+    while (length > 0) {
+        reg = (reg >> 8) ^ t.slice[0][(reg ^ *p++) & 0xFF];
+        length--;
+    }
+    return reg;
+}
+
+uint32_t Crc32Scalar(CrcKind kind, uint32_t crc, const void* data, size_t length) {
+    return ~UpdateScalar(TablesFor(kind), ~crc, (const uint8_t*)data, length);
+}
+
+#ifdef SIMD_X86
+
+TARGET_SSE42
+static uint32_t UpdateSse42(uint32_t reg, const uint8_t* p, size_t length) {
+#if defined(_M_X64) || defined(__x86_64__)
+    uint64_t wide = reg;
+    while (length >= 8) {
+        uint64_t value;
+        memcpy(&value, p, 8);
+        wide = _mm_crc32_u64(wide, value);
+        p += 8;
+        length -= 8;
+    }
+    reg = (uint32_t)wide;
+#endif
+    while (length >= 4) {
+        uint32_t value;
+        memcpy(&value, p, 4);
+        reg = _mm_crc32_u32(reg, value);
+        p += 4;
+        length -= 4;
+    }
+    while (length > 0) {
+        reg = _mm_crc32_u8(reg, *p++);
+        length--;
+    }
+    return reg;
+}
+
+uint32_t Crc32Sse42(CrcKind kind, uint32_t crc, const void* data, size_t length) {
+    if (kind != CrcKind::CRC32C) {
+        return Crc32Scalar(kind, crc, data, length);
+    }
+    return ~UpdateSse42(~crc, (const uint8_t*)data, length);
+}
+
+TARGET_PCLMUL
+static inline __m128i Fold(__m128i value, __m128i constants, __m128i next) {
+    __m128i low = _mm_clmulepi64_si128(value, constants, 0x00);
+    __m128i high = _mm_clmulepi64_si128(value, constants, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(low, high), next);
+}
+
+// Свёртка четырёх 128-битных потоков умножением без переносов, затем
+// сведение к 32 битам редукцией Барретта. length >= 64 и кратна 16
+TARGET_PCLMUL
+static uint32_t UpdatePclmul(const CrcTables& t, uint32_t reg, const uint8_t* p, size_t length) {
+    __m128i x0 = _mm_loadu_si128((const __m128i*)p);
+    __m128i x1 = _mm_loadu_si128((const __m128i*)(p + 16));
+    __m128i x2 = _mm_loadu_si128((const __m128i*)(p + 32));
+    __m128i x3 = _mm_loadu_si128((const __m128i*)(p + 48));
+    x0 = _mm_xor_si128(x0, _mm_cvtsi32_si128((int)reg));
+    p += 64;
+    length -= 64;
+
+    __m128i constants = _mm_set_epi64x((long long)t.fold4[1], (long long)t.fold4[0]);
+    while (length >= 64) {
+        x0 = Fold(x0, constants, _mm_loadu_si128((const __m128i*)p));
+        x1 = Fold(x1, constants, _mm_loadu_si128((const __m128i*)(p + 16)));
+        x2 = Fold(x2, constants, _mm_loadu_si128((const __m128i*)(p + 32)));
+        x3 = Fold(x3, constants, _mm_loadu_si128((const __m128i*)(p + 48)));
+        p += 64;
+        length -= 64;
+    }
+
+    constants = _mm_set_epi64x((long long)t.fold1[1], (long long)t.fold1[0]);
+    x0 = Fold(x0, constants, x1);
+    x0 = Fold(x0, constants, x2);
+    x0 = Fold(x0, constants, x3);
+    while (length >= 16) {
+        x0 = Fold(x0, constants, _mm_loadu_si128((const __m128i*)p));
+        p += 16;
+        length -= 16;
+    }
+
+    // 128 -> 64 бит, заодно дописываются 32 нулевых бита
+    x0 = _mm_xor_si128(_mm_srli_si128(x0, 8), _mm_clmulepi64_si128(x0, constants, 0x10));
+
+    // 64 -> 32 бит
+    const __m128i mask32 = _mm_set_epi32(0, 0, 0, -1);
+    __m128i folded = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32),
+        _mm_set_epi64x(0, (long long)t.fold64), 0x00);
+    x0 = _mm_xor_si128(_mm_srli_si128(x0, 4), folded);
+
+    // Барретт: q = (x mod x^32) * u', остаток = x - q * P
+    __m128i barrett = _mm_set_epi64x((long long)t.barrett[1], (long long)t.barrett[0]);
+    __m128i q = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), barrett, 0x10);
+    q = _mm_clmulepi64_si128(_mm_and_si128(q, mask32), barrett, 0x00);
+    x0 = _mm_xor_si128(x0, q);
+    return (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(x0, 4));
+}
+
+uint32_t Crc32Pclmul(CrcKind kind, uint32_t crc, const void* data, size_t length) {
+    static const bool sse42 = (DetectCpuFeatures() & CPU_FEATURE_SSE42) != 0;
+    const CrcTables& t = TablesFor(kind);
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t reg = ~crc;
+    bool hardwareTail = kind == CrcKind::CRC32C && sse42;
+
+    if (length >= (hardwareTail ? PCLMUL_MIN_LENGTH_SSE42 : PCLMUL_MIN_LENGTH)) {
+        size_t block = length & ~(size_t)15;
+        reg = UpdatePclmul(t, reg, p, block);
+        p += block;
+        length -= block;
+    }
+
+    if (hardwareTail) {
+        reg = UpdateSse42(reg, p, length);
+    }
+    else {
+        reg = UpdateScalar(t, reg, p, length);
+    }
+    return ~reg;
+}
+
+#else
+
+uint32_t Crc32Sse42(CrcKind kind, uint32_t crc, const void* data, size_t length) {
+    return Crc32Scalar(kind, crc, data, length);
+}
+
+uint32_t Crc32Pclmul(CrcKind kind, uint32_t crc, const void* data, size_t length) {
+    return Crc32Scalar(kind, crc, data, length);
+}
+
+#endif
+
+typedef uint32_t (*Crc32Fn)(CrcKind, uint32_t, const void*, size_t);
+
+static Crc32Fn SelectCrc32(CrcKind kind) {
+    uint32_t features = DetectCpuFeatures();
+    if (features & CPU_FEATURE_PCLMUL) {
+        return Crc32Pclmul;
+    }
+    if (kind == CrcKind::CRC32C && (features & CPU_FEATURE_SSE42)) {
+        return Crc32Sse42;
+    }
+    return Crc32Scalar;
+}
+
+uint32_t Crc32(CrcKind kind, uint32_t crc, const void* data, size_t length) {
+    static const Crc32Fn crc32Impl = SelectCrc32(CrcKind::CRC32);
+    static const Crc32Fn crc32cImpl = SelectCrc32(CrcKind::CRC32C);
+    return (kind == CrcKind::CRC32C ? crc32cImpl : crc32Impl)(kind, crc, data, length);
+}
+
+const char* Crc32ImplementationName(CrcKind kind) {
+    Crc32Fn impl = SelectCrc32(kind);
+    if (impl == Crc32Pclmul) {
+        return "pclmul";
+    }
+    if (impl == Crc32Sse42) {
+        return "sse4.2";
+    }
+    return "slicing-by-8";
+}
+
+uint32_t Crc32Combine(CrcKind kind, uint32_t crc1, uint32_t crc2, uint64_t length2) {
+    const CrcTables& t = TablesFor(kind);
+    // CRC(A || B) = CRC(A) * x^(8 * |B|) + CRC(B)
+    return MultModP(XPowModP(t.powers, t.poly, length2 * 8), crc1, t.poly) ^ crc2;
+}
+
+CrcReducer::CrcReducer(CrcKind crcKind) : kind(crcKind), nextIndex(0), crc(0), length(0) {}
+
+void CrcReducer::Add(uint64_t index, uint32_t chunkCrc, uint64_t chunkLength) {
+    pending[index] = std::make_pair(chunkCrc, chunkLength);
+
+    auto it = pending.begin();
+    while (it != pending.end() && it->first == nextIndex) {
+        crc = Crc32Combine(kind, crc, it->second.first, it->second.second);
+        length += it->second.second;
+        it = pending.erase(it);
+        nextIndex++;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <map>
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+#include "Simd.h"
+
+// Продолжает CRC crc по length байтам (для первого куска crc = 0).
+// Реализация выбирается по CPUID при первом вызове
+uint32_t Crc32(CrcKind kind, uint32_t crc, const void* data, size_t length);
+
+// Отдельные реализации (для бенчмарка). Sse42 умеет только CRC32C,
+// для CRC32 она сводится к Scalar; Pclmul и Sse42 вызывать только при
+// наличии соответствующих CPU_FEATURE_*
+uint32_t Crc32Scalar(CrcKind kind, uint32_t crc, const void* data, size_t length);
+uint32_t Crc32Sse42(CrcKind kind, uint32_t crc, const void* data, size_t length);
+uint32_t Crc32Pclmul(CrcKind kind, uint32_t crc, const void* data, size_t length);
+
+const char* Crc32ImplementationName(CrcKind kind);
+
+// CRC склейки A и B по CRC частей и длине B, за O(log length2)
+uint32_t Crc32Combine(CrcKind kind, uint32_t crc1, uint32_t crc2, uint64_t length2);
+
+// Склейка CRC кусков потока по порядку; куски, пришедшие раньше
+// предыдущих, ждут в pending
+class CrcReducer {
+private:
+    CrcKind kind;
+    std::map<uint64_t, std::pair<uint32_t, uint64_t>> pending;  // crc, длина
+    uint64_t nextIndex;
+    uint32_t crc;
+    uint64_t length;
+
+public:
+    explicit CrcReducer(CrcKind crcKind);
+
+    void Add(uint64_t index, uint32_t chunkCrc, uint64_t chunkLength);
+
+    uint32_t Crc() const { return crc; }
+    uint64_t Length() const { return length; }
+    uint64_t Reduced() const { return nextIndex; }
+    size_t Pending() const { return pending.size(); }
+};
@@ -0,0 +1,551 @@
+#include "Dispatcher.h"
+#include "Platform.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+constexpr size_t INITIAL_READ_BUFFER = 64 * 1024;
+constexpr int MAX_EVENTS = 16;
+
+#ifdef _WIN32
+Dispatcher::Dispatcher() : hPort(NULL), totalInFlight(0), nextBatchId(0) {}
+#else
+Dispatcher::Dispatcher() : epollFd(-1), totalInFlight(0), nextBatchId(0) {}
+#endif
+
+Dispatcher::~Dispatcher() {
+    Close();
+}
+
+bool Dispatcher::Attach(int workerId, Transport* transport, bool batching, int parallelism) {
+#ifdef _WIN32
+    if (hPort == NULL) {
+        hPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+        if (hPort == NULL) {
+            std::cerr << "Failed to create completion port. Error: " << GetLastError() << std::endl;
+            return false;
+        }
+    }
+#else
+    if (epollFd < 0) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0) {
+            std::cerr << "Failed to create epoll instance. Error: " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+#endif
+
+    if (workerId >= (int)channels.size()) {
+        channels.resize(workerId + 1);
+    }
+
+    std::unique_ptr<Channel> channel(new Channel());
+    channel->workerId = workerId;
+    channel->transport = transport;
+    channel->buffer.resize(INITIAL_READ_BUFFER);
+    channel->filled = 0;
+    channel->broken = false;
+    channel->batchTarget = 1;
+    channel->batching = batching;
+    channel->parallelism = parallelism;
+    channel->inFlight = 0;
+
+#ifdef _WIN32
+    ZeroMemory(&channel->overlapped, sizeof(channel->overlapped));
+    channel->readPending = false;
+
+    if (CreateIoCompletionPort(transport->ReceiveHandle(), hPort, (ULONG_PTR)channel.get(), 0) == NULL) {
+        std::cerr << "Failed to attach worker " << workerId
+            << " to completion port. Error: " << GetLastError() << std::endl;
+        return false;
+    }
+
+    channels[workerId] = std::move(channel);
+    return PostRead(*channels[workerId]);
+#else
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = channel.get();
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, transport->ReceiveHandle(), &event) < 0) {
+        std::cerr << "Failed to attach worker " << workerId
+            << " to epoll. Error: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    channels[workerId] = std::move(channel);
+    return true;
+#endif
+}
+
+void Dispatcher::ReserveBuffer(Channel& channel) {
+    size_t needed = channel.filled + RESULT_HEADER_SIZE;
+    if (channel.filled >= RESULT_HEADER_SIZE) {
+        const ResultMessage* header = (const ResultMessage*)channel.buffer.data();
+        needed = RESULT_HEADER_SIZE + header->resultSize;
+    }
+    if (channel.buffer.size() < needed) {
+        channel.buffer.resize(needed);
+    }
+    if (channel.filled == channel.buffer.size()) {
+        channel.buffer.resize(channel.buffer.size() * 2);
+    }
+}
+
+bool Dispatcher::PostRead(Channel& channel) {
+    if (channel.broken) {
+        return false;
+    }
+
+    ReserveBuffer(channel);
+    char* target = channel.buffer.data() + channel.filled;
+    size_t space = channel.buffer.size() - channel.filled;
+
+#ifdef _WIN32
+    ZeroMemory(&channel.overlapped, sizeof(channel.overlapped));
+    if (!ReadFile(channel.transport->ReceiveHandle(), target, (DWORD)space, NULL, &channel.overlapped)) {
+        DWORD err = GetLastError();
+        if (err != ERROR_IO_PENDING) {
+            std::cerr << "Failed to read results from worker " << channel.workerId
+                << ". Error: " << err << std::endl;
+            FailChannel(channel);
+            return false;
+        }
+    }
+
+    channel.readPending = true;
+    return true;
+#else
+    ssize_t bytesRead = recv(channel.transport->ReceiveHandle(), target, space, MSG_DONTWAIT);
+    if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return true;
+    }
+    if (bytesRead <= 0) {
+        std::cerr << "Worker " << channel.workerId << " disconnected." << std::endl;
+        FailChannel(channel);
+        return false;
+    }
+
+    channel.filled += bytesRead;
+    ExtractResults(channel);
+    return true;
+#endif
+}
+
+void Dispatcher::CompleteTask(Channel& channel, Channel::Frame& frame, const ResultMessage& result) {
+    uint32_t taskId = result.taskId;
+    auto it = std::find(frame.taskIds.begin(), frame.taskIds.end(), taskId);
+    if (it == frame.taskIds.end()) {
+        std::cerr << "Unexpected result for task " << taskId
+            << " from worker " << channel.workerId << std::endl;
+        return;
+    }
+
+    *it = frame.taskIds.back();
+    frame.taskIds.pop_back();
+    channel.inFlight--;
+    totalInFlight--;
+
+    Completion completion;
+    completion.workerId = channel.workerId;
+    completion.taskId = taskId;
+    completion.ok = true;
+    completion.flags = result.flags;
+
+    const char* data = result.data;
+    uint32_t size = result.resultSize;
+    if (result.flags & RESULT_FLAG_TRACE) {
+        if (size < sizeof(TraceStamps)) {
+            std::cerr << "Truncated trace for task " << taskId
+                << " from worker " << channel.workerId << std::endl;
+            completion.ok = false;
+            size = 0;
+        }
+        else {
+            memcpy(&completion.trace, data, sizeof(TraceStamps));
+            completion.received = TraceClock();
+            data += sizeof(TraceStamps);
+            size -= sizeof(TraceStamps);
+        }
+    }
+    completion.data.Append(data, size);
+    ready.push_back(std::move(completion));
+}
+
+void Dispatcher::ExtractResults(Channel& channel) {
+    size_t offset = 0;
+    bool frameCompleted = false;
+
+    while (channel.filled - offset >= RESULT_HEADER_SIZE) {
+        const ResultMessage* header = (const ResultMessage*)(channel.buffer.data() + offset);
+        if (header->resultSize > MAX_FRAME_SIZE) {
+            std::cerr << "Malformed result header from worker " << channel.workerId << std::endl;
+            FailChannel(channel);
+            return;
+        }
+
+        size_t frameSize = RESULT_HEADER_SIZE + header->resultSize;
+        if (channel.filled - offset < frameSize) {
+            break;
+        }
+
+        auto frame = std::find_if(channel.frames.begin(), channel.frames.end(),
+            [header](const Channel::Frame& f) { return f.frameId == header->taskId; });
+
+        if (frame == channel.frames.end()) {
+            std::cerr << "Unexpected result frame " << header->taskId
+                << " from worker " << channel.workerId << std::endl;
+        }
+        else {
+            if (header->flags & RESULT_FLAG_BATCH) {
+                const char* cursor = header->data;
+                const char* end = header->data + header->resultSize;
+                while ((size_t)(end - cursor) >= RESULT_HEADER_SIZE) {
+                    const ResultMessage* sub = (const ResultMessage*)cursor;
+                    if (sub->resultSize > (size_t)(end - cursor) - RESULT_HEADER_SIZE) {
+                        break;
+                    }
+                    CompleteTask(channel, *frame, *sub);
+                    cursor += RESULT_HEADER_SIZE + sub->resultSize;
+                }
+            }
+            else {
+                CompleteTask(channel, *frame, *header);
+            }
+
+            // Подзадачи, на которые воркер не ответил, считаем проваленными
+            for (uint32_t taskId : frame->taskIds) {
+                Completion completion;
+                completion.workerId = channel.workerId;
+                completion.taskId = taskId;
+                completion.ok = false;
+                completion.flags = 0;
+                ready.push_back(std::move(completion));
+                channel.inFlight--;
+                totalInFlight--;
+            }
+
+            if (frame + 1 != channel.frames.end()) {
+                *frame = std::move(channel.frames.back());
+            }
+            channel.frames.pop_back();
+            frameCompleted = true;
+        }
+
+        offset += frameSize;
+    }
+
+    if (offset > 0) {
+        memmove(channel.buffer.data(), channel.buffer.data() + offset, channel.filled - offset);
+        channel.filled -= offset;
+    }
+
+    // У воркера освободился поток: накопленный пакет отправляем сразу
+    if (frameCompleted && (int)channel.frames.size() < channel.parallelism) {
+        FlushBatch(channel);
+    }
+}
+
+void Dispatcher::FailChannel(Channel& channel) {
+    if (channel.broken) {
+        return;
+    }
+    channel.broken = true;
+
+#ifndef _WIN32
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, channel.transport->ReceiveHandle(), NULL);
+#endif
+
+    std::vector<uint32_t> failed;
+    for (const Channel::Frame& frame : channel.frames) {
+        failed.insert(failed.end(), frame.taskIds.begin(), frame.taskIds.end());
+    }
+    failed.insert(failed.end(), channel.batchTasks.begin(), channel.batchTasks.end());
+
+    for (uint32_t taskId : failed) {
+        Completion completion;
+        completion.workerId = channel.workerId;
+        completion.taskId = taskId;
+        completion.ok = false;
+        completion.flags = 0;
+        ready.push_back(std::move(completion));
+    }
+
+    totalInFlight -= channel.inFlight;
+    channel.inFlight = 0;
+    channel.frames.clear();
+    channel.batch.clear();
+    channel.batchTasks.clear();
+}
+
+bool Dispatcher::FlushBatch(Channel& channel) {
+    if (channel.batchTasks.empty() || channel.broken) {
+        return !channel.broken;
+    }
+
+    Channel::Frame frame;
+    bool sent;
+
+    if (channel.batchTasks.size() == 1) {
+        frame.frameId = channel.batchTasks[0];
+        IoSlice slice = { channel.batch.data(), channel.batch.size() };
+        sent = channel.transport->Send(&slice, 1);
+    }
+    else {
+        frame.frameId = BATCH_ID_BIT | (nextBatchId++ & ~BATCH_ID_BIT);
+        TaskMessage header = MakeTaskHeader(MessageType::TASK_BATCH, frame.frameId,
+            (uint32_t)channel.batch.size(), (uint32_t)channel.batchTasks.size());
+        sent = channel.transport->SendFrame(&header, TASK_HEADER_SIZE,
+            channel.batch.data(), channel.batch.size());
+    }
+
+    frame.taskIds.swap(channel.batchTasks);
+    channel.batchTasks.clear();
+    channel.batch.clear();
+    channel.frames.push_back(std::move(frame));
+
+    if (!sent) {
+        std::cerr << "Failed to send tasks to worker " << channel.workerId << std::endl;
+        FailChannel(channel);
+        return false;
+    }
+    return true;
+}
+
+void Dispatcher::FlushExpiredBatches(int& timeoutMs) {
+    auto now = std::chrono::steady_clock::now();
+
+    for (auto& channel : channels) {
+        if (!channel || channel->batchTasks.empty()) {
+            continue;
+        }
+
+        auto age = std::chrono::duration_cast<std::chrono::milliseconds>(now - channel->batchStart);
+        int remaining = policy.maxDelayMs - (int)age.count();
+
+        if (remaining <= 0) {
+            // Пакет не набрался за отведённое время: уменьшаем цель
+            if (channel->batchTarget > 1) {
+                channel->batchTarget /= 2;
+            }
+            FlushBatch(*channel);
+        }
+        else if (timeoutMs < 0 || remaining < timeoutMs) {
+            timeoutMs = remaining;
+        }
+    }
+}
+
+// Заголовок, префикс и нагрузка задачи одним кадром; пустые части пропускаются
+static size_t TaskSlices(IoSlice slices[3], const TaskMessage& header, const void* prefix, uint32_t prefixSize,
+    const void* payload) {
+    size_t count = 0;
+    slices[count++] = { &header, TASK_HEADER_SIZE };
+    if (prefixSize > 0) {
+        slices[count++] = { prefix, prefixSize };
+    }
+    if (header.dataSize > prefixSize) {
+        slices[count++] = { payload, header.dataSize - prefixSize };
+    }
+    return count;
+}
+
+bool Dispatcher::Submit(int workerId, const TaskMessage& header, const void* payload, const void* prefix,
+    uint32_t prefixSize) {
+    if (workerId < 0 || workerId >= (int)channels.size() || !channels[workerId]) {
+        return false;
+    }
+
+    Channel& channel = *channels[workerId];
+    if (channel.broken) {
+        return false;
+    }
+
+    IoSlice slices[3];
+    if (header.type == MessageType::TERMINATE) {
+        if (!FlushBatch(channel)) {
+            return false;
+        }
+        if (!channel.transport->Send(slices, TaskSlices(slices, header, prefix, prefixSize, payload))) {
+            FailChannel(channel);
+            return false;
+        }
+        return true;
+    }
+
+    uint32_t recordSize = TASK_HEADER_SIZE + header.dataSize;
+
+    // Крупные задачи уходят отдельным кадром без копирования в пакет
+    if (recordSize > policy.maxBytes || policy.maxTasks <= 1 || !channel.batching) {
+        if (!FlushBatch(channel)) {
+            return false;
+        }
+
+        if (!channel.transport->Send(slices, TaskSlices(slices, header, prefix, prefixSize, payload))) {
+            std::cerr << "Failed to send task to worker " << workerId << std::endl;
+            FailChannel(channel);
+            return false;
+        }
+
+        Channel::Frame frame;
+        frame.frameId = header.taskId;
+        frame.taskIds.push_back(header.taskId);
+        channel.frames.push_back(std::move(frame));
+        channel.inFlight++;
+        totalInFlight++;
+        return true;
+    }
+
+    if (channel.batch.size() + recordSize > policy.maxBytes && !FlushBatch(channel)) {
+        return false;
+    }
+
+    if (channel.batchTasks.empty()) {
+        channel.batchStart = std::chrono::steady_clock::now();
+    }
+
+    const char* headerBytes = (const char*)&header;
+    channel.batch.insert(channel.batch.end(), headerBytes, headerBytes + TASK_HEADER_SIZE);
+    if (prefixSize > 0) {
+        const char* prefixBytes = (const char*)prefix;
+        channel.batch.insert(channel.batch.end(), prefixBytes, prefixBytes + prefixSize);
+    }
+    if (header.dataSize > prefixSize) {
+        const char* payloadBytes = (const char*)payload;
+        channel.batch.insert(channel.batch.end(), payloadBytes, payloadBytes + (header.dataSize - prefixSize));
+    }
+    channel.batchTasks.push_back(header.taskId);
+    channel.inFlight++;
+    totalInFlight++;
+
+    // У воркера есть свободный поток - ждать нечего
+    if ((int)channel.frames.size() < channel.parallelism) {
+        FlushBatch(channel);
+    }
+    else if ((int)channel.batchTasks.size() >= channel.batchTarget) {
+        // Пакет набрался, пока воркер был занят: в следующий раз копим больше
+        if (channel.batchTarget < policy.maxTasks) {
+            channel.batchTarget *= 2;
+            if (channel.batchTarget > policy.maxTasks) {
+                channel.batchTarget = policy.maxTasks;
+            }
+        }
+        FlushBatch(channel);
+    }
+
+    return true;
+}
+
+bool Dispatcher::WaitCompletion(Completion& completion, int timeoutMs) {
+    while (ready.empty()) {
+        if (totalInFlight == 0) {
+            return false;
+        }
+
+        int waitMs = timeoutMs;
+        FlushExpiredBatches(waitMs);
+        bool batchTimer = waitMs != timeoutMs;
+        if (!ready.empty()) {
+            break;
+        }
+
+#ifdef _WIN32
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        LPOVERLAPPED overlapped = NULL;
+        BOOL ok = GetQueuedCompletionStatus(hPort, &bytes, &key, &overlapped,
+            waitMs < 0 ? INFINITE : (DWORD)waitMs);
+
+        if (overlapped == NULL) {
+            if (batchTimer) {
+                continue;
+            }
+            return false;
+        }
+
+        Channel& channel = *(Channel*)key;
+        channel.readPending = false;
+
+        if (!ok || bytes == 0) {
+            std::cerr << "Worker " << channel.workerId << " disconnected. Error: "
+                << GetLastError() << std::endl;
+            FailChannel(channel);
+            continue;
+        }
+
+        channel.filled += bytes;
+        ExtractResults(channel);
+        PostRead(channel);
+#else
+        epoll_event events[MAX_EVENTS];
+        int count = epoll_wait(epollFd, events, MAX_EVENTS, waitMs);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count == 0 && batchTimer) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+
+        for (int i = 0; i < count; i++) {
+            PostRead(*(Channel*)events[i].data.ptr);
+        }
+#endif
+    }
+
+    completion = std::move(ready.front());
+    ready.pop_front();
+    return true;
+}
+
+void Dispatcher::Close() {
+#ifdef _WIN32
+    for (auto& channel : channels) {
+        if (channel && channel->readPending) {
+            DWORD bytes;
+            HANDLE hPipe = channel->transport->ReceiveHandle();
+            CancelIoEx(hPipe, &channel->overlapped);
+            GetOverlappedResult(hPipe, &channel->overlapped, &bytes, TRUE);
+            channel->readPending = false;
+        }
+    }
+#endif
+    channels.clear();
+    ready.clear();
+    totalInFlight = 0;
+
+#ifdef _WIN32
+    if (hPort != NULL) {
+        CloseHandle(hPort);
+        hPort = NULL;
+    }
+#else
+    if (epollFd >= 0) {
+        close(epollFd);
+        epollFd = -1;
+    }
+#endif
+}
+
+int Dispatcher::InFlight(int workerId) const {
+    if (workerId < 0 || workerId >= (int)channels.size() || !channels[workerId]) {
+        return 0;
+    }
+    return channels[workerId]->inFlight;
+}
+
+bool Dispatcher::IsAlive(int workerId) const {
+    return workerId >= 0 && workerId < (int)channels.size() &&
+        channels[workerId] && !channels[workerId]->broken;
+}
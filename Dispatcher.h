@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <chrono>
+
+#include "Protocol.h"
+#include "Transport.h"
+
+// Результат задачи, полученный от воркера
+struct Completion {
+    int workerId;
+    uint32_t taskId;
+    bool ok;                  // false, если воркер отвалился до ответа
+    uint32_t flags;           // RESULT_FLAG_* ответа на задачу
+    MessageBuffer data;       // полезная нагрузка ResultMessage
+    TraceStamps trace = {};   // RESULT_FLAG_TRACE: отметки, снятые с начала data
+    uint64_t received = 0;    // RESULT_FLAG_TRACE: TraceClock() при разборе ответа
+};
+
+// Политика пакетирования: пока воркер занят, мелкие задачи копятся
+// в пакет, но не дольше maxDelayMs
+struct BatchPolicy {
+    int maxTasks = 64;
+    uint32_t maxBytes = 64 * 1024;
+    int maxDelayMs = 1;
+};
+
+// Асинхронный диспетчер: задачи пишутся в транспорт без ожидания ответа,
+// результаты собираются по мере поступления (IOCP в Windows, epoll в Linux)
+class Dispatcher {
+private:
+    struct Channel {
+        int workerId;
+        Transport* transport;
+#ifdef _WIN32
+        OVERLAPPED overlapped;
+        bool readPending;
+#endif
+        std::vector<char> buffer;
+        size_t filled;
+        bool broken;
+
+        struct Frame {
+            uint32_t frameId;               // taskId или идентификатор пакета
+            std::vector<uint32_t> taskIds;
+        };
+        std::vector<Frame> frames;          // отправленные, ждут ответа
+        std::vector<char> batch;            // накопленные подзадачи
+        std::vector<uint32_t> batchTasks;
+        std::chrono::steady_clock::time_point batchStart;
+        int batchTarget;                    // адаптивный размер пакета
+        bool batching;                      // воркер понимает TASK_BATCH
+        int parallelism;                    // кадров, которые воркер считает одновременно
+        int inFlight;
+    };
+
+#ifdef _WIN32
+    HANDLE hPort;
+#else
+    int epollFd;
+#endif
+    std::vector<std::unique_ptr<Channel>> channels;
+    std::deque<Completion> ready;
+    int totalInFlight;
+    uint32_t nextBatchId;
+    BatchPolicy policy;
+
+    bool FlushBatch(Channel& channel);
+    void FlushExpiredBatches(int& timeoutMs);
+    void CompleteTask(Channel& channel, Channel::Frame& frame, const ResultMessage& result);
+    void ReserveBuffer(Channel& channel);
+    bool PostRead(Channel& channel);
+    void ExtractResults(Channel& channel);
+    void FailChannel(Channel& channel);
+
+public:
+    Dispatcher();
+    ~Dispatcher();
+
+    void SetBatchPolicy(const BatchPolicy& batchPolicy) { policy = batchPolicy; }
+    bool Attach(int workerId, Transport* transport, bool batching = true, int parallelism = 1);
+    // prefix - prefixSize байт перед payload в том же кадре (отметки
+    // трассировки); header.dataSize учитывает и их
+    bool Submit(int workerId, const TaskMessage& header, const void* payload, const void* prefix = nullptr,
+        uint32_t prefixSize = 0);
+    bool WaitCompletion(Completion& completion, int timeoutMs = -1);
+    void Close();
+
+    int InFlight(int workerId) const;
+    int TotalInFlight() const { return totalInFlight; }
+    bool IsAlive(int workerId) const;
+};
@@ -0,0 +1,276 @@
+#include "Fft.h"
+#include <cmath>
+#include <cstring>
+
+static const double FFT_PI = 3.14159265358979323846;
+
+static inline FftComplex Polar(double angle) {
+    FftComplex w;
+    w.re = (float)std::cos(angle);
+    w.im = (float)std::sin(angle);
+    return w;
+}
+
+static inline FftComplex Add(FftComplex a, FftComplex b) {
+    FftComplex r = { a.re + b.re, a.im + b.im };
+    return r;
+}
+
+static inline FftComplex Sub(FftComplex a, FftComplex b) {
+    FftComplex r = { a.re - b.re, a.im - b.im };
+    return r;
+}
+
+// w * a; для обратного преобразования - сопряжённый множитель
+template <bool Inverse>
+static inline FftComplex Twiddle(FftComplex w, FftComplex a) {
+    FftComplex r;
+    if (Inverse) {
+        r.re = w.re * a.re + w.im * a.im;
+        r.im = w.re * a.im - w.im * a.re;
+    }
+    else {
+        r.re = w.re * a.re - w.im * a.im;
+        r.im = w.re * a.im + w.im * a.re;
+    }
+    return r;
+}
+
+// Умножение на W_4 = -i (прямое) или +i (обратное)
+template <bool Inverse>
+static inline FftComplex RotateQuarter(FftComplex a) {
+    FftComplex r;
+    if (Inverse) {
+        r.re = -a.im;
+        r.im = a.re;
+    }
+    else {
+        r.re = a.im;
+        r.im = -a.re;
+    }
+    return r;
+}
+
+FftPlan::FftPlan(uint32_t fftSize) : size(fftSize), log2Size(0) {
+    while ((1u << log2Size) < size) {
+        log2Size++;
+    }
+
+    reverse.resize(size);
+    for (uint32_t i = 0; i < size; i++) {
+        uint32_t reversed = 0;
+        for (uint32_t bit = 0; bit < log2Size; bit++) {
+            reversed |= ((i >> bit) & 1) << (log2Size - 1 - bit);
+        }
+        reverse[i] = reversed;
+    }
+
+    // Этапы radix-4 объединяют подпреобразования длины h в длину 4h;
+    // при нечётном log2Size первый этап - radix-2
+    for (uint32_t h = (log2Size & 1) ? 2 : 1; h < size; h *= 4) {
+        for (uint32_t j = 0; j < h; j++) {
+            double angle = -2.0 * FFT_PI * j / (4.0 * h);
+            twiddles.push_back(Polar(angle));
+            twiddles.push_back(Polar(2.0 * angle));
+            twiddles.push_back(Polar(3.0 * angle));
+        }
+    }
+
+    realTwiddles.resize((size_t)size + 1);
+    for (uint32_t k = 0; k <= size; k++) {
+        realTwiddles[k] = Polar(-FFT_PI * k / size);
+    }
+}
+
+template <bool Inverse>
+static void Transform(const FftPlan& plan, FftComplex* x) {
+    uint32_t n = plan.size;
+    const uint32_t* reverse = plan.reverse.data();
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t j = reverse[i];
+        if (i < j) {
+            FftComplex t = x[i];
+            x[i] = x[j];
+            x[j] = t;
+        }
+    }
+
+    uint32_t h = 1;
+    if (plan.log2Size & 1) {
+        for (uint32_t i = 0; i < n; i += 2) {
+            FftComplex a = x[i];
+            FftComplex b = x[i + 1];
+            x[i] = Add(a, b);
+            x[i + 1] = Sub(a, b);
+        }
+        h = 2;
+    }
+
+    // Два этапа radix-2 за проход: три умножения на четыре точки
+    // вместо четырёх и вдвое меньше проходов по памяти
+    const FftComplex* w = plan.twiddles.data();
+    for (; h < n; h *= 4) {
+        for (uint32_t group = 0; group < n; group += 4 * h) {
+            FftComplex* p = x + group;
+            for (uint32_t j = 0; j < h; j++) {
+                FftComplex a0 = p[j];
+                FftComplex p1 = Twiddle<Inverse>(w[3 * j + 1], p[j + h]);
+                FftComplex p2 = Twiddle<Inverse>(w[3 * j], p[j + 2 * h]);
+                FftComplex p3 = Twiddle<Inverse>(w[3 * j + 2], p[j + 3 * h]);
+
+                FftComplex even0 = Add(a0, p1);
+                FftComplex even1 = Sub(a0, p1);
+                FftComplex odd0 = Add(p2, p3);
+                FftComplex odd1 = RotateQuarter<Inverse>(Sub(p2, p3));
+
+                p[j] = Add(even0, odd0);
+                p[j + h] = Add(even1, odd1);
+                p[j + 2 * h] = Sub(even0, odd0);
+                p[j + 3 * h] = Sub(even1, odd1);
+            }
+        }
+        w += 3 * h;
+    }
+}
+
+void FftTransform(const FftPlan& plan, FftComplex* data, bool inverse) {
+    if (inverse) {
+        Transform<true>(plan, data);
+    }
+    else {
+        Transform<false>(plan, data);
+    }
+}
+
+// Z = FFT(x[2k] + i x[2k+1]); чётная и нечётная части:
+// E[k] = (Z[k] + conj Z[m-k]) / 2, O[k] = (Z[k] - conj Z[m-k]) / 2i,
+// X[k] = E[k] + W^k O[k]; X[m-k] строится из тех же двух отсчётов
+void RealFft(const FftPlan& half, FftComplex* data) {
+    uint32_t m = half.size;
+    Transform<false>(half, data);
+
+    const FftComplex* w = half.realTwiddles.data();
+    FftComplex z0 = data[0];
+    data[0].re = z0.re + z0.im;
+    data[0].im = 0;
+    data[m].re = z0.re - z0.im;
+    data[m].im = 0;
+
+    for (uint32_t k = 1; k <= m / 2; k++) {
+        FftComplex a = data[k];
+        FftComplex b = data[m - k];
+        FftComplex even = { (a.re + b.re) * 0.5f, (a.im - b.im) * 0.5f };
+        FftComplex odd = { (a.im + b.im) * 0.5f, (b.re - a.re) * 0.5f };
+        FftComplex evenConj = { even.re, -even.im };
+        FftComplex oddConj = { odd.re, -odd.im };
+
+        data[k] = Add(even, Twiddle<false>(w[k], odd));
+        data[m - k] = Add(evenConj, Twiddle<false>(w[m - k], oddConj));
+    }
+}
+
+// Обратный ход: E и O из X[k] и conj X[m-k], Z = E + iO, обратное
+// комплексное половинной длины
+void RealInverseFft(const FftPlan& half, FftComplex* data) {
+    uint32_t m = half.size;
+    const FftComplex* w = half.realTwiddles.data();
+
+    for (uint32_t k = 0; k <= m / 2; k++) {
+        uint32_t mirror = m - k;
+        FftComplex a = data[k];
+        FftComplex b = data[mirror];
+
+        // E[k] = (a + conj b) / 2, O[k] = (a - conj b) * conj W^k / 2
+        FftComplex even = { (a.re + b.re) * 0.5f, (a.im - b.im) * 0.5f };
+        FftComplex odd = Twiddle<true>(w[k], { (a.re - b.re) * 0.5f, (a.im + b.im) * 0.5f });
+        // Для m - k те же отсчёты с ролями наоборот
+        FftComplex evenMirror = { even.re, -even.im };
+        FftComplex oddMirror = Twiddle<true>(w[mirror], { (b.re - a.re) * 0.5f, (b.im + a.im) * 0.5f });
+
+        data[k].re = even.re - odd.im;
+        data[k].im = even.im + odd.re;
+        if (mirror < m) {
+            data[mirror].re = evenMirror.re - oddMirror.im;
+            data[mirror].im = evenMirror.im + oddMirror.re;
+        }
+    }
+
+    Transform<true>(half, data);
+
+    float scale = 1.0f / m;
+    for (uint32_t k = 0; k < m; k++) {
+        data[k].re *= scale;
+        data[k].im *= scale;
+    }
+}
+
+FftPlanCache::FftPlanCache(size_t maxPlans) : capacity(maxPlans), hits(0), misses(0) {}
+
+std::shared_ptr<const FftPlan> FftPlanCache::Get(uint32_t size) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (auto it = plans.begin(); it != plans.end(); ++it) {
+        if ((*it)->size == size) {
+            plans.splice(plans.begin(), plans, it);
+            hits++;
+            return plans.front();
+        }
+    }
+
+    misses++;
+    std::shared_ptr<const FftPlan> plan(new FftPlan(size));
+    plans.push_front(plan);
+    if (plans.size() > capacity) {
+        plans.pop_back();
+    }
+    return plan;
+}
+
+bool IsFourierSizeValid(FourierMode mode, uint32_t size) {
+    if (size == 0 || size > FOURIER_MAX_SIZE || (size & (size - 1)) != 0) {
+        return false;
+    }
+    bool real = mode == FourierMode::REAL_FORWARD || mode == FourierMode::REAL_INVERSE;
+    return !real || size >= 2;
+}
+
+bool FourierTransform(FourierMode mode, uint32_t size, uint32_t count, const char* in, char* out,
+    FftPlanCache& plans, std::vector<FftComplex>& scratch) {
+    if (!IsFourierSizeValid(mode, size) || mode > FourierMode::REAL_INVERSE) {
+        return false;
+    }
+
+    bool real = mode == FourierMode::REAL_FORWARD || mode == FourierMode::REAL_INVERSE;
+    std::shared_ptr<const FftPlan> plan = plans.Get(real ? size / 2 : size);
+    size_t inputSize = FourierInputSize(mode, size);
+    size_t outputSize = FourierOutputSize(mode, size);
+    scratch.resize(real ? (size_t)size / 2 + 1 : size);
+
+    float scale = 1.0f / size;
+    for (uint32_t t = 0; t < count; t++) {
+        // Через буфер: полезная нагрузка не выровнена
+        memcpy(scratch.data(), in + t * inputSize, inputSize);
+
+        switch (mode) {
+        case FourierMode::FORWARD:
+            Transform<false>(*plan, scratch.data());
+            break;
+        case FourierMode::INVERSE:
+            Transform<true>(*plan, scratch.data());
+            for (uint32_t i = 0; i < size; i++) {
+                scratch[i].re *= scale;
+                scratch[i].im *= scale;
+            }
+            break;
+        case FourierMode::REAL_FORWARD:
+            RealFft(*plan, scratch.data());
+            break;
+        default:
+            RealInverseFft(*plan, scratch.data());
+            break;
+        }
+
+        memcpy(out + t * outputSize, scratch.data(), outputSize);
+    }
+    return true;
+}
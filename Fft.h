@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+
+struct FftComplex {
+    float re;
+    float im;
+};
+
+// Всё, что зависит только от длины: перестановка и поворачивающие
+// множители считаются один раз и дальше только читаются
+struct FftPlan {
+    uint32_t size;
+    uint32_t log2Size;
+    std::vector<uint32_t> reverse;         // бит-реверсная перестановка
+    std::vector<FftComplex> twiddles;      // тройки W^j, W^2j, W^3j по этапам radix-4
+    std::vector<FftComplex> realTwiddles;  // W_2size^k, k = 0..size: для вещественных длины 2 * size
+
+    explicit FftPlan(uint32_t fftSize);
+};
+
+// Комплексное преобразование на месте, длина - plan.size.
+// Обратное без деления на size
+void FftTransform(const FftPlan& plan, FftComplex* data, bool inverse);
+
+// Вещественные длины 2 * half.size через комплексное половинной длины,
+// на месте: 2 * half.size вещественных занимают те же байты, что
+// half.size комплексных, место в data - под half.size + 1 отсчётов.
+// Обратное делит на 2 * half.size
+void RealFft(const FftPlan& half, FftComplex* data);
+void RealInverseFft(const FftPlan& half, FftComplex* data);
+
+// Планы по длине (LRU). Общий для потоков
+class FftPlanCache {
+private:
+    std::list<std::shared_ptr<const FftPlan>> plans;   // в начале - последние использованные
+    size_t capacity;
+    uint64_t hits;
+    uint64_t misses;
+    std::mutex lock;
+
+public:
+    explicit FftPlanCache(size_t maxPlans = 16);
+
+    std::shared_ptr<const FftPlan> Get(uint32_t size);
+
+    uint64_t Hits() const { return hits; }
+    uint64_t Misses() const { return misses; }
+};
+
+bool IsFourierSizeValid(FourierMode mode, uint32_t size);
+
+// count преобразований подряд: in и out по FourierInputSize и
+// FourierOutputSize, выравнивание не требуется. in и out совпадают
+// только в комплексных режимах. Один план на весь пакет
+bool FourierTransform(FourierMode mode, uint32_t size, uint32_t count, const char* in, char* out,
+    FftPlanCache& plans, std::vector<FftComplex>& scratch);
@@ -0,0 +1,390 @@
+#include "Gemm.h"
+#include <cstring>
+
+template <typename T>
+using GemmKernel = void (*)(size_t kc, const T* a, const T* b, T* c, size_t ldc, bool accumulate);
+
+template <typename T>
+static void PackPanels(const char* src, uint32_t rows, uint32_t cols, std::vector<T>& dst) {
+    constexpr uint32_t NR = GemmPanelWidth<T>();
+    uint32_t panels = (cols + NR - 1) / NR;
+    dst.assign((size_t)panels * rows * NR, 0);
+
+    for (uint32_t p = 0; p < panels; p++) {
+        uint32_t width = cols - p * NR < NR ? cols - p * NR : NR;
+        for (uint32_t k = 0; k < rows; k++) {
+            memcpy(&dst[((size_t)p * rows + k) * NR], src + ((size_t)k * cols + p * NR) * sizeof(T),
+                width * sizeof(T));
+        }
+    }
+}
+
+void PackMatrix(MatrixType type, const char* src, uint32_t rows, uint32_t cols, PackedMatrix& packed) {
+    packed.type = type;
+    packed.rows = rows;
+    packed.cols = cols;
+    packed.f32.clear();
+    packed.f64.clear();
+    if (type == MatrixType::FLOAT64) {
+        PackPanels(src, rows, cols, packed.f64);
+    }
+    else {
+        PackPanels(src, rows, cols, packed.f32);
+    }
+}
+
+// Блок A rows x kc (строка через lda элементов) - микропанелями по
+// GEMM_MR строк, внутри по столбцам; недостающие строки нулевые
+template <typename T>
+static void PackBlockA(const char* a, size_t lda, uint32_t rows, uint32_t kc, T* dst) {
+    for (uint32_t ir = 0; ir < rows; ir += GEMM_MR) {
+        uint32_t mr = rows - ir < GEMM_MR ? rows - ir : GEMM_MR;
+        for (uint32_t k = 0; k < kc; k++) {
+            for (uint32_t r = 0; r < GEMM_MR; r++) {
+                if (r < mr) {
+                    memcpy(&dst[k * GEMM_MR + r], a + ((ir + r) * lda + k) * sizeof(T), sizeof(T));
+                }
+                else {
+                    dst[k * GEMM_MR + r] = 0;
+                }
+            }
+        }
+        dst += (size_t)kc * GEMM_MR;
+    }
+}
+
+// Циклы как у GotoBLAS: блок глубины GEMM_KC, в нём блок A из GEMM_MC
+// строк (лежит в L2), панель B шириной NR (в L1) проходит по всем
+// микропанелям блока A
+template <typename T>
+static void Gemm(const char* a, uint32_t rows, const T* b, uint32_t inner, uint32_t cols,
+    std::vector<T>& packA, std::vector<T>& c, GemmKernel<T> kernel) {
+    constexpr uint32_t NR = GemmPanelWidth<T>();
+    uint32_t panels = (cols + NR - 1) / NR;
+    T tile[GEMM_MR * NR];
+
+    c.assign((size_t)rows * cols, 0);
+    packA.resize((size_t)GEMM_MC * GEMM_KC);
+
+    for (uint32_t pc = 0; pc < inner; pc += GEMM_KC) {
+        uint32_t kc = inner - pc < GEMM_KC ? inner - pc : GEMM_KC;
+
+        for (uint32_t ic = 0; ic < rows; ic += GEMM_MC) {
+            uint32_t mc = rows - ic < GEMM_MC ? rows - ic : GEMM_MC;
+            PackBlockA<T>(a + ((size_t)ic * inner + pc) * sizeof(T), inner, mc, kc, packA.data());
+
+            for (uint32_t jp = 0; jp < panels; jp++) {
+                const T* bp = b + ((size_t)jp * inner + pc) * NR;
+                uint32_t nr = cols - jp * NR < NR ? cols - jp * NR : NR;
+
+                for (uint32_t ir = 0; ir < mc; ir += GEMM_MR) {
+                    uint32_t mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+                    const T* ap = packA.data() + (size_t)ir * kc;
+                    T* ct = c.data() + (size_t)(ic + ir) * cols + jp * NR;
+
+                    if (mr == GEMM_MR && nr == NR) {
+                        kernel(kc, ap, bp, ct, cols, pc > 0);
+                        continue;
+                    }
+
+                    // Край матрицы: полная плитка во временный буфер
+                    kernel(kc, ap, bp, tile, NR, false);
+                    for (uint32_t r = 0; r < mr; r++) {
+                        for (uint32_t j = 0; j < nr; j++) {
+                            ct[(size_t)r * cols + j] += tile[r * NR + j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+static void KernelScalar(size_t kc, const T* a, const T* b, T* c, size_t ldc, bool accumulate) {
+    constexpr uint32_t NR = GemmPanelWidth<T>();
+    T acc[GEMM_MR][NR] = {};
+
+    for (size_t k = 0; k < kc; k++) {
+        for (uint32_t r = 0; r < GEMM_MR; r++) {
+            T ar = a[r];
+            for (uint32_t j = 0; j < NR; j++) {
+                acc[r][j] += ar * b[j];
+            }
+        }
+        a += GEMM_MR;
+        b += NR;
+    }
+
+    for (uint32_t r = 0; r < GEMM_MR; r++) {
+        for (uint32_t j = 0; j < NR; j++) {
+            c[r * ldc + j] = accumulate ? c[r * ldc + j] + acc[r][j] : acc[r][j];
+        }
+    }
+}
+
+void MultiplyPackedScalar(const char* a, uint32_t rows, const PackedMatrix& b, GemmScratch& scratch, MessageBuffer& out) {
+    if (b.type == MatrixType::FLOAT64) {
+        Gemm<double>(a, rows, b.f64.data(), b.rows, b.cols, scratch.a64, scratch.c64, KernelScalar<double>);
+        out.Append(scratch.c64.data(), scratch.c64.size() * sizeof(double));
+    }
+    else {
+        Gemm<float>(a, rows, b.f32.data(), b.rows, b.cols, scratch.a32, scratch.c32, KernelScalar<float>);
+        out.Append(scratch.c32.data(), scratch.c32.size() * sizeof(float));
+    }
+}
+
+#ifdef SIMD_X86
+
+static TARGET_FMA inline void StoreRow(float* c, __m256 lo, __m256 hi, bool accumulate) {
+    if (accumulate) {
+        lo = _mm256_add_ps(lo, _mm256_loadu_ps(c));
+        hi = _mm256_add_ps(hi, _mm256_loadu_ps(c + 8));
+    }
+    _mm256_storeu_ps(c, lo);
+    _mm256_storeu_ps(c + 8, hi);
+}
+
+static TARGET_FMA inline void StoreRow(double* c, __m256d lo, __m256d hi, bool accumulate) {
+    if (accumulate) {
+        lo = _mm256_add_pd(lo, _mm256_loadu_pd(c));
+        hi = _mm256_add_pd(hi, _mm256_loadu_pd(c + 4));
+    }
+    _mm256_storeu_pd(c, lo);
+    _mm256_storeu_pd(c + 4, hi);
+}
+
+// Плитка 6 x 16: 12 аккумуляторов, 2 регистра B и 1 для a - 15 из 16 YMM
+static TARGET_FMA void KernelAvx2(size_t kc, const float* a, const float* b, float* c, size_t ldc, bool accumulate) {
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+    for (size_t k = 0; k < kc; k++) {
+        __m256 b0 = _mm256_loadu_ps(b);
+        __m256 b1 = _mm256_loadu_ps(b + 8);
+        __m256 ar;
+
+        ar = _mm256_broadcast_ss(a + 0);
+        c00 = _mm256_fmadd_ps(ar, b0, c00);
+        c01 = _mm256_fmadd_ps(ar, b1, c01);
+        ar = _mm256_broadcast_ss(a + 1);
+        c10 = _mm256_fmadd_ps(ar, b0, c10);
+        c11 = _mm256_fmadd_ps(ar, b1, c11);
+        ar = _mm256_broadcast_ss(a + 2);
+        c20 = _mm256_fmadd_ps(ar, b0, c20);
+        c21 = _mm256_fmadd_ps(ar, b1, c21);
+        ar = _mm256_broadcast_ss(a + 3);
+        c30 = _mm256_fmadd_ps(ar, b0, c30);
+        c31 = _mm256_fmadd_ps(ar, b1, c31);
+        ar = _mm256_broadcast_ss(a + 4);
+        c40 = _mm256_fmadd_ps(ar, b0, c40);
+        c41 = _mm256_fmadd_ps(ar, b1, c41);
+        ar = _mm256_broadcast_ss(a + 5);
+        c50 = _mm256_fmadd_ps(ar, b0, c50);
+        c51 = _mm256_fmadd_ps(ar, b1, c51);
+
+        a += GEMM_MR;
+        b += 16;
+    }
+
+    StoreRow(c, c00, c01, accumulate);
+    StoreRow(c + ldc, c10, c11, accumulate);
+    StoreRow(c + 2 * ldc, c20, c21, accumulate);
+    StoreRow(c + 3 * ldc, c30, c31, accumulate);
+    StoreRow(c + 4 * ldc, c40, c41, accumulate);
+    StoreRow(c + 5 * ldc, c50, c51, accumulate);
+}
+
+// Плитка 6 x 8 тем же числом регистров
+static TARGET_FMA void KernelAvx2(size_t kc, const double* a, const double* b, double* c, size_t ldc, bool accumulate) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+
+    for (size_t k = 0; k < kc; k++) {
+        __m256d b0 = _mm256_loadu_pd(b);
+        __m256d b1 = _mm256_loadu_pd(b + 4);
+        __m256d ar;
+
+        ar = _mm256_broadcast_sd(a + 0);
+        c00 = _mm256_fmadd_pd(ar, b0, c00);
+        c01 = _mm256_fmadd_pd(ar, b1, c01);
+        ar = _mm256_broadcast_sd(a + 1);
+        c10 = _mm256_fmadd_pd(ar, b0, c10);
+        c11 = _mm256_fmadd_pd(ar, b1, c11);
+        ar = _mm256_broadcast_sd(a + 2);
+        c20 = _mm256_fmadd_pd(ar, b0, c20);
+        c21 = _mm256_fmadd_pd(ar, b1, c21);
+        ar = _mm256_broadcast_sd(a + 3);
+        c30 = _mm256_fmadd_pd(ar, b0, c30);
+        c31 = _mm256_fmadd_pd(ar, b1, c31);
+        ar = _mm256_broadcast_sd(a + 4);
+        c40 = _mm256_fmadd_pd(ar, b0, c40);
+        c41 = _mm256_fmadd_pd(ar, b1, c41);
+        ar = _mm256_broadcast_sd(a + 5);
+        c50 = _mm256_fmadd_pd(ar, b0, c50);
+        c51 = _mm256_fmadd_pd(ar, b1, c51);
+
+        a += GEMM_MR;
+        b += 8;
+    }
+
+    StoreRow(c, c00, c01, accumulate);
+    StoreRow(c + ldc, c10, c11, accumulate);
+    StoreRow(c + 2 * ldc, c20, c21, accumulate);
+    StoreRow(c + 3 * ldc, c30, c31, accumulate);
+    StoreRow(c + 4 * ldc, c40, c41, accumulate);
+    StoreRow(c + 5 * ldc, c50, c51, accumulate);
+}
+
+void MultiplyPackedAvx2(const char* a, uint32_t rows, const PackedMatrix& b, GemmScratch& scratch, MessageBuffer& out) {
+    if (b.type == MatrixType::FLOAT64) {
+        Gemm<double>(a, rows, b.f64.data(), b.rows, b.cols, scratch.a64, scratch.c64, KernelAvx2);
+        out.Append(scratch.c64.data(), scratch.c64.size() * sizeof(double));
+    }
+    else {
+        Gemm<float>(a, rows, b.f32.data(), b.rows, b.cols, scratch.a32, scratch.c32, KernelAvx2);
+        out.Append(scratch.c32.data(), scratch.c32.size() * sizeof(float));
+    }
+}
+
+#else
+
+void MultiplyPackedAvx2(const char* a, uint32_t rows, const PackedMatrix& b, GemmScratch& scratch, MessageBuffer& out) {
+    MultiplyPackedScalar(a, rows, b, scratch, out);
+}
+
+#endif
+
+typedef void (*MultiplyFn)(const char*, uint32_t, const PackedMatrix&, GemmScratch&, MessageBuffer&);
+
+static MultiplyFn SelectMultiply() {
+    if (DetectSimdLevel() == SimdLevel::AVX2 && (DetectCpuFeatures() & CPU_FEATURE_FMA)) {
+        return MultiplyPackedAvx2;
+    }
+    return MultiplyPackedScalar;
+}
+
+void MultiplyPacked(const char* a, uint32_t rows, const PackedMatrix& b, GemmScratch& scratch, MessageBuffer& out) {
+    static const MultiplyFn impl = SelectMultiply();
+    impl(a, rows, b, scratch, out);
+}
+
+const char* GemmImplementationName() {
+    return SelectMultiply() == MultiplyPackedAvx2 ? "avx2+fma" : "scalar";
+}
+
+MatrixCache::MatrixCache(size_t maxBytes) : capacity(maxBytes), bytes(0) {}
+
+size_t MatrixCache::EntryBytes(const Entry& entry) {
+    return entry.staging.size() + entry.rowLoaded.size() + (entry.packed ? entry.packed->Bytes() : 0);
+}
+
+void MatrixCache::Evict(uint32_t keepHandle) {
+    while (bytes > capacity && entries.size() > 1 && entries.back().handle != keepHandle) {
+        bytes -= EntryBytes(entries.back());
+        entries.pop_back();
+    }
+}
+
+bool MatrixCache::Load(const MatrixHeader& header, const char* data, uint32_t& loadedRows) {
+    if (header.type > (uint32_t)MatrixType::FLOAT64 || header.inner == 0 || header.cols == 0 ||
+        header.firstRow >= header.inner || header.rows > header.inner - header.firstRow) {
+        return false;
+    }
+    MatrixType type = (MatrixType)header.type;
+    size_t rowBytes = (size_t)header.cols * MatrixTypeSize(type);
+    if ((uint64_t)header.inner * rowBytes > capacity) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto it = entries.begin();
+    while (it != entries.end() && it->handle != header.handle) {
+        ++it;
+    }
+    if (it != entries.end() && (it->type != type || it->rows != header.inner || it->cols != header.cols)) {
+        bytes -= EntryBytes(*it);
+        entries.erase(it);
+        it = entries.end();
+    }
+
+    if (it == entries.end()) {
+        entries.push_front(Entry());
+    }
+    else {
+        entries.splice(entries.begin(), entries, it);
+    }
+    Entry& entry = entries.front();
+    bytes -= EntryBytes(entry);
+
+    // Новая загрузка или повторная загрузка уже упакованной B
+    if (it == entries.end() || entry.packed) {
+        entry.handle = header.handle;
+        entry.type = type;
+        entry.rows = header.inner;
+        entry.cols = header.cols;
+        entry.loadedRows = 0;
+        entry.staging.assign(header.inner * rowBytes, 0);
+        entry.rowLoaded.assign(header.inner, 0);
+        entry.packed.reset();
+    }
+
+    memcpy(entry.staging.data() + header.firstRow * rowBytes, data, header.rows * rowBytes);
+    for (uint32_t r = header.firstRow; r < header.firstRow + header.rows; r++) {
+        if (!entry.rowLoaded[r]) {
+            entry.rowLoaded[r] = 1;
+            entry.loadedRows++;
+        }
+    }
+
+    if (entry.loadedRows == entry.rows) {
+        std::shared_ptr<PackedMatrix> packed(new PackedMatrix());
+        PackMatrix(type, entry.staging.data(), entry.rows, entry.cols, *packed);
+        entry.packed = packed;
+        std::vector<char>().swap(entry.staging);
+        std::vector<char>().swap(entry.rowLoaded);
+    }
+
+    loadedRows = entry.loadedRows;
+    bytes += EntryBytes(entry);
+    Evict(header.handle);
+    return true;
+}
+
+std::shared_ptr<const PackedMatrix> MatrixCache::Get(uint32_t handle, MatrixType type, uint32_t rows, uint32_t cols) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->handle != handle) {
+            continue;
+        }
+        if (!it->packed || it->type != type || it->rows != rows || it->cols != cols) {
+            return nullptr;
+        }
+        entries.splice(entries.begin(), entries, it);
+        return entries.front().packed;
+    }
+    return nullptr;
+}
+
+bool MatrixCache::Release(uint32_t handle) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->handle == handle) {
+            bytes -= EntryBytes(*it);
+            entries.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+#include "Simd.h"
+
+constexpr uint32_t GEMM_MR = 6;       // строк C в микроядре
+constexpr uint32_t GEMM_KC = 256;     // глубина блока: панели A и B в L1/L2
+constexpr uint32_t GEMM_MC = 96;      // строк A в упакованном блоке (L2)
+constexpr size_t MATRIX_CACHE_BYTES = 256 * 1024 * 1024;
+
+// Столбцов C в микроядре: два регистра YMM
+template <typename T>
+constexpr uint32_t GemmPanelWidth() {
+    return 64 / sizeof(T);
+}
+
+// B, упакованная панелями по GemmPanelWidth столбцов: внутри панели
+// элементы идут по строкам, хвост последней панели дополнен нулями
+struct PackedMatrix {
+    MatrixType type;
+    uint32_t rows;
+    uint32_t cols;
+    std::vector<float> f32;
+    std::vector<double> f64;
+
+    size_t Bytes() const { return f32.size() * sizeof(float) + f64.size() * sizeof(double); }
+};
+
+// src - rows x cols по строкам, выравнивание не требуется
+void PackMatrix(MatrixType type, const char* src, uint32_t rows, uint32_t cols, PackedMatrix& packed);
+
+// Упакованный блок A и результат одного потока; переиспользуются
+struct GemmScratch {
+    std::vector<float> a32;
+    std::vector<double> a64;
+    std::vector<float> c32;
+    std::vector<double> c64;
+};
+
+// C = A x B: a - rows x b.rows по строкам, C дописывается в out по строкам.
+// Ядро выбирается по CPUID при первом вызове
+void MultiplyPacked(const char* a, uint32_t rows, const PackedMatrix& b, GemmScratch& scratch, MessageBuffer& out);
+
+// Отдельные ядра (для бенчмарка); Avx2 вызывать только при AVX2 и FMA
+void MultiplyPackedScalar(const char* a, uint32_t rows, const PackedMatrix& b, GemmScratch& scratch, MessageBuffer& out);
+void MultiplyPackedAvx2(const char* a, uint32_t rows, const PackedMatrix& b, GemmScratch& scratch, MessageBuffer& out);
+
+const char* GemmImplementationName();
+
+// Матрицы B воркера по handle (LRU по объёму). Строки приходят частями
+// в любом порядке, упаковка - после последней. Общий для потоков:
+// упакованная матрица только читается
+class MatrixCache {
+private:
+    struct Entry {
+        uint32_t handle;
+        MatrixType type;
+        uint32_t rows;
+        uint32_t cols;
+        uint32_t loadedRows;
+        std::vector<char> staging;      // строки до упаковки
+        std::vector<char> rowLoaded;
+        std::shared_ptr<const PackedMatrix> packed;
+    };
+
+    std::list<Entry> entries;   // в начале - последние использованные
+    size_t capacity;
+    size_t bytes;
+    std::mutex lock;
+
+    static size_t EntryBytes(const Entry& entry);
+    void Evict(uint32_t keepHandle);
+
+public:
+    explicit MatrixCache(size_t maxBytes = MATRIX_CACHE_BYTES);
+
+    // Строки B из LOAD_B; loadedRows - сколько строк B уже есть.
+    // Заголовок с другими размерами под тем же handle начинает загрузку заново
+    bool Load(const MatrixHeader& header, const char* data, uint32_t& loadedRows);
+    // Полностью загруженная B с указанными размерами или nullptr
+    std::shared_ptr<const PackedMatrix> Get(uint32_t handle, MatrixType type, uint32_t rows, uint32_t cols);
+    bool Release(uint32_t handle);
+};
@@ -0,0 +1,349 @@
+#include "Graph.h"
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline int HighestBit64(uint64_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, mask);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(mask);
+#endif
+}
+
+RadixHeap::RadixHeap() : last(0), size(0) {}
+
+int RadixHeap::BucketOf(uint64_t key) const {
+    return key == last ? 0 : HighestBit64(key ^ last) + 1;
+}
+
+void RadixHeap::Clear() {
+    for (std::vector<Item>& bucket : buckets) {
+        bucket.clear();
+    }
+    last = 0;
+    size = 0;
+}
+
+void RadixHeap::Push(uint64_t key, uint32_t vertex) {
+    Item item = { key, vertex };
+    buckets[BucketOf(key)].push_back(item);
+    size++;
+}
+
+void RadixHeap::Pop(uint64_t& key, uint32_t& vertex) {
+    if (buckets[0].empty()) {
+        // Наименьший ключ первой непустой корзины становится last: её
+        // элементы отличаются от него только младшими битами и расходятся
+        // по корзинам с меньшими номерами
+        int i = 1;
+        while (buckets[i].empty()) {
+            i++;
+        }
+        uint64_t smallest = buckets[i][0].key;
+        for (const Item& item : buckets[i]) {
+            smallest = item.key < smallest ? item.key : smallest;
+        }
+        last = smallest;
+        for (const Item& item : buckets[i]) {
+            buckets[BucketOf(item.key)].push_back(item);
+        }
+        buckets[i].clear();
+    }
+
+    Item item = buckets[0].back();
+    buckets[0].pop_back();
+    size--;
+    key = item.key;
+    vertex = item.vertex;
+}
+
+bool ShortestPath(const CsrGraph& graph, uint32_t source, uint32_t target, GraphScratch& scratch,
+    GraphPath& result, std::vector<uint32_t>* path) {
+    uint32_t n = graph.vertices;
+    if (source >= n || target >= n) {
+        return false;
+    }
+
+    if (scratch.visited.size() < n) {
+        scratch.distance.resize(n);
+        scratch.parent.resize(n);
+        scratch.visited.resize(n, 0);
+    }
+    if (++scratch.pass == 0) {
+        std::fill(scratch.visited.begin(), scratch.visited.end(), 0);
+        scratch.pass = 1;
+    }
+
+    uint32_t pass = scratch.pass;
+    uint64_t* distance = scratch.distance.data();
+    uint32_t* parent = scratch.parent.data();
+    uint32_t* visited = scratch.visited.data();
+    const uint32_t* offsets = graph.offsets.data();
+    const uint32_t* targets = graph.targets.data();
+
+    visited[source] = pass;
+    distance[source] = 0;
+    parent[source] = source;
+
+    if (graph.weights.empty()) {
+        // Расстояние вершины окончательно при первом обнаружении
+        std::vector<uint32_t>& queue = scratch.queue;
+        queue.clear();
+        queue.push_back(source);
+        bool found = source == target;
+        for (size_t head = 0; !found && head < queue.size(); head++) {
+            uint32_t v = queue[head];
+            for (uint32_t e = offsets[v]; e < offsets[v + 1]; e++) {
+                uint32_t u = targets[e];
+                if (visited[u] == pass) {
+                    continue;
+                }
+                visited[u] = pass;
+                distance[u] = distance[v] + 1;
+                parent[u] = v;
+                if (u == target) {
+                    found = true;
+                    break;
+                }
+                queue.push_back(u);
+            }
+        }
+    }
+    else {
+        const uint32_t* weights = graph.weights.data();
+        RadixHeap& heap = scratch.heap;
+        heap.Clear();
+        heap.Push(0, source);
+        while (!heap.Empty()) {
+            uint64_t key;
+            uint32_t v;
+            heap.Pop(key, v);
+            // Устаревшая запись: вершину уже достали с меньшим ключом
+            if (key != distance[v]) {
+                continue;
+            }
+            if (v == target) {
+                break;
+            }
+            for (uint32_t e = offsets[v]; e < offsets[v + 1]; e++) {
+                uint32_t u = targets[e];
+                uint64_t candidate = key + weights[e];
+                if (visited[u] != pass || candidate < distance[u]) {
+                    visited[u] = pass;
+                    distance[u] = candidate;
+                    parent[u] = v;
+                    heap.Push(candidate, u);
+                }
+            }
+        }
+    }
+
+    result.distance = GRAPH_UNREACHABLE;
+    result.hops = 0;
+    if (path) {
+        path->clear();
+    }
+    if (visited[target] != pass) {
+        return true;
+    }
+
+    result.distance = distance[target];
+    for (uint32_t v = target; v != source; v = parent[v]) {
+        result.hops++;
+        if (path) {
+            path->push_back(v);
+        }
+    }
+    if (path) {
+        path->push_back(source);
+        std::reverse(path->begin(), path->end());
+    }
+    return true;
+}
+
+GraphCache::GraphCache(size_t maxBytes) : capacity(maxBytes), bytes(0) {}
+
+size_t GraphCache::EntryBytes(const Entry& entry) {
+    size_t size = entry.graph ? entry.graph->Bytes() : 0;
+    for (const auto& piece : entry.pieces) {
+        size += piece.second.words.size() * sizeof(uint32_t);
+    }
+    return size;
+}
+
+void GraphCache::Evict(uint32_t keepHandle) {
+    while (bytes > capacity && entries.size() > 1 && entries.back().handle != keepHandle) {
+        bytes -= EntryBytes(entries.back());
+        entries.pop_back();
+    }
+}
+
+// Куски по порядку вершин: степени складываются в offsets, дуги и веса
+// ложатся подряд. null - сумма степеней не совпала с заявленным числом дуг
+std::shared_ptr<const CsrGraph> GraphCache::Build(const Entry& entry) {
+    std::shared_ptr<CsrGraph> graph(new CsrGraph());
+    graph->vertices = entry.vertices;
+    graph->offsets.resize((size_t)entry.vertices + 1);
+    graph->targets.resize(entry.edges);
+    if (entry.weighted) {
+        graph->weights.resize(entry.edges);
+    }
+
+    uint64_t edge = 0;
+    graph->offsets[0] = 0;
+    for (const auto& item : entry.pieces) {
+        const Piece& piece = item.second;
+        const uint32_t* degrees = piece.words.data();
+        size_t pieceEdges = 0;
+        for (uint32_t i = 0; i < piece.count; i++) {
+            pieceEdges += degrees[i];
+        }
+        if (edge + pieceEdges > entry.edges) {
+            return nullptr;
+        }
+
+        for (uint32_t i = 0; i < piece.count; i++) {
+            graph->offsets[(size_t)item.first + i + 1] = (uint32_t)(graph->offsets[item.first + i] + degrees[i]);
+        }
+        const uint32_t* ends = degrees + piece.count;
+        std::copy(ends, ends + pieceEdges, graph->targets.begin() + edge);
+        if (entry.weighted) {
+            std::copy(ends + pieceEdges, ends + 2 * pieceEdges, graph->weights.begin() + edge);
+        }
+        edge += pieceEdges;
+    }
+
+    if (edge != entry.edges) {
+        return nullptr;
+    }
+    return graph;
+}
+
+bool GraphCache::Load(const GraphHeader& header, const char* data, size_t dataSize, uint32_t& loadedVertices) {
+    if (header.vertices == 0 || header.weighted > 1 || header.count == 0 ||
+        header.firstVertex >= header.vertices || header.count > header.vertices - header.firstVertex) {
+        return false;
+    }
+    uint64_t edgeWords = header.weighted ? 2 : 1;
+    if (dataSize != ((uint64_t)header.count + header.pieceEdges * edgeWords) * sizeof(uint32_t) ||
+        ((uint64_t)header.vertices + 1 + header.edges * edgeWords) * sizeof(uint32_t) > capacity) {
+        return false;
+    }
+
+    Piece piece;
+    piece.count = header.count;
+    piece.words.resize(dataSize / sizeof(uint32_t));
+    memcpy(piece.words.data(), data, dataSize);
+
+    // Степени сходятся с числом дуг куска, концы дуг - вершины графа
+    uint64_t degreeSum = 0;
+    for (uint32_t i = 0; i < header.count; i++) {
+        degreeSum += piece.words[i];
+    }
+    if (degreeSum != header.pieceEdges) {
+        return false;
+    }
+    for (uint32_t e = 0; e < header.pieceEdges; e++) {
+        if (piece.words[header.count + e] >= header.vertices) {
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto it = entries.begin();
+    while (it != entries.end() && it->handle != header.handle) {
+        ++it;
+    }
+    if (it != entries.end() && (it->vertices != header.vertices || it->edges != header.edges ||
+        it->weighted != (header.weighted != 0))) {
+        bytes -= EntryBytes(*it);
+        entries.erase(it);
+        it = entries.end();
+    }
+
+    if (it == entries.end()) {
+        entries.push_front(Entry());
+    }
+    else {
+        entries.splice(entries.begin(), entries, it);
+    }
+    Entry& entry = entries.front();
+    bytes -= EntryBytes(entry);
+
+    // Новая загрузка или повторная загрузка уже собранного графа
+    if (it == entries.end() || entry.graph) {
+        entry.handle = header.handle;
+        entry.vertices = header.vertices;
+        entry.edges = header.edges;
+        entry.weighted = header.weighted != 0;
+        entry.loadedVertices = 0;
+        entry.pieces.clear();
+        entry.graph.reset();
+    }
+
+    // Повтор того же куска заменяет его, пересечение с другим - ошибка
+    auto next = entry.pieces.lower_bound(header.firstVertex);
+    bool same = next != entry.pieces.end() && next->first == header.firstVertex && next->second.count == header.count;
+    bool overlaps = !same && ((next != entry.pieces.end() && next->first < header.firstVertex + header.count) ||
+        (next != entry.pieces.begin() && std::prev(next)->first + std::prev(next)->second.count > header.firstVertex));
+    if (overlaps) {
+        bytes += EntryBytes(entry);
+        return false;
+    }
+    if (!same) {
+        entry.loadedVertices += header.count;
+    }
+    entry.pieces[header.firstVertex] = std::move(piece);
+
+    bool built = true;
+    if (entry.loadedVertices == entry.vertices) {
+        entry.graph = Build(entry);
+        entry.pieces.clear();
+        built = entry.graph != nullptr;
+        if (!built) {
+            entry.loadedVertices = 0;
+        }
+    }
+
+    loadedVertices = entry.loadedVertices;
+    bytes += EntryBytes(entry);
+    Evict(header.handle);
+    return built;
+}
+
+std::shared_ptr<const CsrGraph> GraphCache::Get(uint32_t handle) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->handle != handle) {
+            continue;
+        }
+        if (!it->graph) {
+            return nullptr;
+        }
+        entries.splice(entries.begin(), entries, it);
+        return entries.front().graph;
+    }
+    return nullptr;
+}
+
+bool GraphCache::Release(uint32_t handle) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->handle == handle) {
+            bytes -= EntryBytes(*it);
+            entries.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+#include "BufferPool.h"
+
+constexpr size_t GRAPH_CACHE_BYTES = 256 * 1024 * 1024;
+
+// Граф в формате CSR: дуги вершины v - [offsets[v], offsets[v + 1])
+struct CsrGraph {
+    uint32_t vertices;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> targets;
+    std::vector<uint32_t> weights;   // пусто - граф невзвешен
+
+    size_t Bytes() const {
+        return (offsets.size() + targets.size() + weights.size()) * sizeof(uint32_t);
+    }
+};
+
+// Монотонная очередь с приоритетом для Дейкстры: ключ элемента - номер
+// старшего бита, которым он отличается от последнего извлечённого, так
+// что каждый элемент переходит между корзинами не больше 64 раз
+class RadixHeap {
+private:
+    struct Item {
+        uint64_t key;
+        uint32_t vertex;
+    };
+
+    std::vector<Item> buckets[65];
+    uint64_t last;
+    size_t size;
+
+    int BucketOf(uint64_t key) const;
+
+public:
+    RadixHeap();
+
+    void Clear();
+    bool Empty() const { return size == 0; }
+    // key не меньше последнего извлечённого
+    void Push(uint64_t key, uint32_t vertex);
+    void Pop(uint64_t& key, uint32_t& vertex);
+};
+
+// Рабочие массивы поиска одного потока. Метка прохода отличает вершины,
+// посещённые в этом запросе, и массивы не очищаются между запросами
+struct GraphScratch {
+    std::vector<uint64_t> distance;
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> visited;   // номер прохода, в котором вершина достигнута
+    std::vector<uint32_t> queue;
+    std::vector<uint32_t> path;
+    uint32_t pass = 0;
+    RadixHeap heap;
+};
+
+// Кратчайший путь source -> target: BFS для невзвешенного графа, Дейкстра
+// с RadixHeap - для взвешенного; поиск останавливается на target.
+// path не null - туда вершины пути от source до target
+bool ShortestPath(const CsrGraph& graph, uint32_t source, uint32_t target, GraphScratch& scratch,
+    GraphPath& result, std::vector<uint32_t>* path);
+
+// Графы воркера по handle (LRU по объёму). Куски вершин приходят в любом
+// порядке, CSR строится после последнего. Общий для потоков: собранный
+// граф только читается
+class GraphCache {
+private:
+    struct Piece {
+        uint32_t count;                 // вершин
+        std::vector<uint32_t> words;    // степени, концы дуг, веса
+    };
+
+    struct Entry {
+        uint32_t handle;
+        uint32_t vertices;
+        uint32_t edges;
+        bool weighted;
+        uint32_t loadedVertices;
+        std::map<uint32_t, Piece> pieces;   // по первой вершине, до сборки
+        std::shared_ptr<const CsrGraph> graph;
+    };
+
+    std::list<Entry> entries;   // в начале - последние использованные
+    size_t capacity;
+    size_t bytes;
+    std::mutex lock;
+
+    static size_t EntryBytes(const Entry& entry);
+    static std::shared_ptr<const CsrGraph> Build(const Entry& entry);
+    void Evict(uint32_t keepHandle);
+
+public:
+    explicit GraphCache(size_t maxBytes = GRAPH_CACHE_BYTES);
+
+    // Кусок из LOAD; loadedVertices - сколько вершин графа уже есть.
+    // Заголовок с другими размерами под тем же handle начинает загрузку заново
+    bool Load(const GraphHeader& header, const char* data, size_t dataSize, uint32_t& loadedVertices);
+    // Полностью загруженный граф или nullptr
+    std::shared_ptr<const CsrGraph> Get(uint32_t handle);
+    bool Release(uint32_t handle);
+};
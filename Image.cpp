@@ -0,0 +1,292 @@
+#include "Image.h"
+#include <cstring>
+
+// Коэффициенты сепии в 16-битной фиксированной точке (доля * 65536).
+// Слагаемое - старшая половина произведения (x << 8) * k, как у
+// _mm_mulhi_epu16, сумма насыщается на 0xFFFF: все реализации
+// дают одинаковые байты
+static const uint16_t SEPIA_COEFFICIENTS[3][3] = {
+    { 25756, 50397, 12386 },    // R' = 0.393 R + 0.769 G + 0.189 B
+    { 22872, 44958, 11010 },    // G' = 0.349 R + 0.686 G + 0.168 B
+    { 17826, 34996, 8585 }      // B' = 0.272 R + 0.534 G + 0.131 B
+};
+
+// Обработка одной строки: width пикселей по bpp байт
+typedef void (*ImageRowFn)(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t bpp);
+
+static inline uint8_t SepiaChannel(uint32_t r, uint32_t g, uint32_t b, const uint16_t* k) {
+    uint32_t sum = (((r << 8) * k[0]) >> 16) + (((g << 8) * k[1]) >> 16) + (((b << 8) * k[2]) >> 16);
+    return (uint8_t)((sum > 0xFFFF ? 0xFFFF : sum) >> 8);
+}
+
+static void SepiaPixelsScalar(const uint8_t* src, uint8_t* dst, uint32_t from, uint32_t width, uint32_t bpp) {
+    for (uint32_t x = from; x < width; x++) {
+        const uint8_t* in = src + (size_t)x * bpp;
+        uint8_t* out = dst + (size_t)x * bpp;
+        uint32_t r = in[0], g = in[1], b = in[2];
+        out[0] = SepiaChannel(r, g, b, SEPIA_COEFFICIENTS[0]);
+        out[1] = SepiaChannel(r, g, b, SEPIA_COEFFICIENTS[1]);
+        out[2] = SepiaChannel(r, g, b, SEPIA_COEFFICIENTS[2]);
+        if (bpp == 4) {
+            out[3] = in[3];
+        }
+    }
+}
+
+// Инверсия побайтно с позиции from: альфа-канал не трогается
+static void InvertBytesScalar(const uint8_t* src, uint8_t* dst, size_t from, size_t bytes, uint32_t bpp) {
+    for (size_t i = from; i < bytes; i++) {
+        dst[i] = (bpp == 4 && i % 4 == 3) ? src[i] : (uint8_t)~src[i];
+    }
+}
+
+static void SepiaRowScalar(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t bpp) {
+    SepiaPixelsScalar(src, dst, 0, width, bpp);
+}
+
+static void InvertRowScalar(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t bpp) {
+    InvertBytesScalar(src, dst, 0, (size_t)width * bpp, bpp);
+}
+
+static bool ProcessRows(ImageRowFn row, PixelFormat format, const char* src, char* dst,
+    uint32_t width, uint32_t rows, uint32_t stride) {
+    if (format != PixelFormat::RGB24 && format != PixelFormat::RGBA32) {
+        return false;
+    }
+    uint32_t bpp = (uint32_t)format;
+    size_t rowBytes = (size_t)width * bpp;
+    if (rowBytes > stride) {
+        return false;
+    }
+
+    for (uint32_t y = 0; y < rows; y++) {
+        const uint8_t* in = (const uint8_t*)src + (size_t)y * stride;
+        uint8_t* out = (uint8_t*)dst + (size_t)y * stride;
+        row(in, out, width, bpp);
+        if (src != dst && stride > rowBytes) {
+            memcpy(out + rowBytes, in + rowBytes, stride - rowBytes);
+        }
+    }
+    return true;
+}
+
+bool ProcessImageRowsScalar(ImageOp op, PixelFormat format, const char* src, char* dst,
+    uint32_t width, uint32_t rows, uint32_t stride) {
+    return ProcessRows(op == ImageOp::SEPIA ? SepiaRowScalar : InvertRowScalar,
+        format, src, dst, width, rows, stride);
+}
+
+#ifdef SIMD_X86
+
+static inline uint32_t Load32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+static inline __m128i SepiaChannelSse2(__m128i r, __m128i g, __m128i b, const uint16_t* k) {
+    __m128i sum = _mm_adds_epu16(_mm_mulhi_epu16(r, _mm_set1_epi16((short)k[0])),
+        _mm_mulhi_epu16(g, _mm_set1_epi16((short)k[1])));
+    sum = _mm_adds_epu16(sum, _mm_mulhi_epu16(b, _mm_set1_epi16((short)k[2])));
+    return _mm_srli_epi16(sum, 8);
+}
+
+// Восемь пикселей RGBx в двух регистрах: каналы раскладываются по 16-битным
+// словам (значение << 8), четвёртый байт пикселя проходит без изменений
+static inline void SepiaPixelsSse2(__m128i& p0, __m128i& p1) {
+    const __m128i low = _mm_set1_epi32(0xFF);
+    __m128i r = _mm_slli_epi16(_mm_packs_epi32(_mm_and_si128(p0, low), _mm_and_si128(p1, low)), 8);
+    __m128i g = _mm_slli_epi16(_mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), low),
+        _mm_and_si128(_mm_srli_epi32(p1, 8), low)), 8);
+    __m128i b = _mm_slli_epi16(_mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), low),
+        _mm_and_si128(_mm_srli_epi32(p1, 16), low)), 8);
+    __m128i a = _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+
+    __m128i rg = _mm_or_si128(SepiaChannelSse2(r, g, b, SEPIA_COEFFICIENTS[0]),
+        _mm_slli_epi16(SepiaChannelSse2(r, g, b, SEPIA_COEFFICIENTS[1]), 8));
+    __m128i ba = _mm_or_si128(SepiaChannelSse2(r, g, b, SEPIA_COEFFICIENTS[2]), _mm_slli_epi16(a, 8));
+    p0 = _mm_unpacklo_epi16(rg, ba);
+    p1 = _mm_unpackhi_epi16(rg, ba);
+}
+
+static void SepiaRowSse2(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t bpp) {
+    uint32_t x = 0;
+    if (bpp == 4) {
+        for (; x + 8 <= width; x += 8) {
+            __m128i p0 = _mm_loadu_si128((const __m128i*)(src + (size_t)x * 4));
+            __m128i p1 = _mm_loadu_si128((const __m128i*)(src + (size_t)x * 4 + 16));
+            SepiaPixelsSse2(p0, p1);
+            _mm_storeu_si128((__m128i*)(dst + (size_t)x * 4), p0);
+            _mm_storeu_si128((__m128i*)(dst + (size_t)x * 4 + 16), p1);
+        }
+    }
+    else {
+        // Пиксель RGB читается четырьмя байтами вместе с R следующего; тот
+        // проходит как альфа и пишется обратно исходным, поэтому нужен
+        // ещё один пиксель за восьмёркой
+        for (; x + 9 <= width; x += 8) {
+            const uint8_t* in = src + (size_t)x * 3;
+            __m128i p0 = _mm_setr_epi32((int)Load32(in), (int)Load32(in + 3), (int)Load32(in + 6), (int)Load32(in + 9));
+            __m128i p1 = _mm_setr_epi32((int)Load32(in + 12), (int)Load32(in + 15), (int)Load32(in + 18), (int)Load32(in + 21));
+            SepiaPixelsSse2(p0, p1);
+
+            uint32_t pixels[8];
+            _mm_storeu_si128((__m128i*)pixels, p0);
+            _mm_storeu_si128((__m128i*)(pixels + 4), p1);
+            uint8_t* out = dst + (size_t)x * 3;
+            for (int i = 0; i < 8; i++) {
+                memcpy(out + i * 3, &pixels[i], 4);
+            }
+        }
+    }
+    SepiaPixelsScalar(src, dst, x, width, bpp);
+}
+
+static void InvertRowSse2(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t bpp) {
+    size_t bytes = (size_t)width * bpp;
+    const __m128i mask = _mm_set1_epi32(bpp == 4 ? 0x00FFFFFF : -1);
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(v, mask));
+    }
+    InvertBytesScalar(src, dst, i, bytes, bpp);
+}
+
+bool ProcessImageRowsSse2(ImageOp op, PixelFormat format, const char* src, char* dst,
+    uint32_t width, uint32_t rows, uint32_t stride) {
+    return ProcessRows(op == ImageOp::SEPIA ? SepiaRowSse2 : InvertRowSse2,
+        format, src, dst, width, rows, stride);
+}
+
+TARGET_AVX2
+static inline __m256i SepiaChannelAvx2(__m256i r, __m256i g, __m256i b, const uint16_t* k) {
+    __m256i sum = _mm256_adds_epu16(_mm256_mulhi_epu16(r, _mm256_set1_epi16((short)k[0])),
+        _mm256_mulhi_epu16(g, _mm256_set1_epi16((short)k[1])));
+    sum = _mm256_adds_epu16(sum, _mm256_mulhi_epu16(b, _mm256_set1_epi16((short)k[2])));
+    return _mm256_srli_epi16(sum, 8);
+}
+
+// То же, что SepiaPixelsSse2, для 16 пикселей. Упаковка и распаковка
+// AVX2 работают внутри 128-битных половин, порядок пикселей сохраняется
+TARGET_AVX2
+static inline void SepiaPixelsAvx2(__m256i& p0, __m256i& p1) {
+    const __m256i low = _mm256_set1_epi32(0xFF);
+    __m256i r = _mm256_slli_epi16(_mm256_packs_epi32(_mm256_and_si256(p0, low), _mm256_and_si256(p1, low)), 8);
+    __m256i g = _mm256_slli_epi16(_mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), low),
+        _mm256_and_si256(_mm256_srli_epi32(p1, 8), low)), 8);
+    __m256i b = _mm256_slli_epi16(_mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), low),
+        _mm256_and_si256(_mm256_srli_epi32(p1, 16), low)), 8);
+    __m256i a = _mm256_packs_epi32(_mm256_srli_epi32(p0, 24), _mm256_srli_epi32(p1, 24));
+
+    __m256i rg = _mm256_or_si256(SepiaChannelAvx2(r, g, b, SEPIA_COEFFICIENTS[0]),
+        _mm256_slli_epi16(SepiaChannelAvx2(r, g, b, SEPIA_COEFFICIENTS[1]), 8));
+    __m256i ba = _mm256_or_si256(SepiaChannelAvx2(r, g, b, SEPIA_COEFFICIENTS[2]), _mm256_slli_epi16(a, 8));
+    p0 = _mm256_unpacklo_epi16(rg, ba);
+    p1 = _mm256_unpackhi_epi16(rg, ba);
+}
+
+// Восемь пикселей RGB (24 байта) -> RGB0 по 32 бита; читает 28 байт
+TARGET_AVX2
+static inline __m256i ExpandRgbAvx2(const uint8_t* in) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)in)),
+        _mm_loadu_si128((const __m128i*)(in + 12)), 1);
+    return _mm256_shuffle_epi8(v, shuffle);
+}
+
+// Обратно восемь пикселей RGB: пишет ровно 24 байта
+TARGET_AVX2
+static inline void StoreRgbAvx2(uint8_t* out, __m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    v = _mm256_shuffle_epi8(v, shuffle);
+    __m128i low = _mm256_castsi256_si128(v);
+    __m128i high = _mm256_extracti128_si256(v, 1);
+    // Хвост первой записи (байты 12..15) тут же перекрывается второй
+    _mm_storeu_si128((__m128i*)out, low);
+    _mm_storel_epi64((__m128i*)(out + 12), high);
+    uint32_t last = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(high, 8));
+    memcpy(out + 20, &last, 4);
+}
+
+TARGET_AVX2
+static void SepiaRowAvx2(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t bpp) {
+    uint32_t x = 0;
+    if (bpp == 4) {
+        for (; x + 16 <= width; x += 16) {
+            __m256i p0 = _mm256_loadu_si256((const __m256i*)(src + (size_t)x * 4));
+            __m256i p1 = _mm256_loadu_si256((const __m256i*)(src + (size_t)x * 4 + 32));
+            SepiaPixelsAvx2(p0, p1);
+            _mm256_storeu_si256((__m256i*)(dst + (size_t)x * 4), p0);
+            _mm256_storeu_si256((__m256i*)(dst + (size_t)x * 4 + 32), p1);
+        }
+    }
+    else {
+        // Вторая восьмёрка читается до 52-го байта: нужно ещё два пикселя запаса
+        for (; x + 18 <= width; x += 16) {
+            const uint8_t* in = src + (size_t)x * 3;
+            __m256i p0 = ExpandRgbAvx2(in);
+            __m256i p1 = ExpandRgbAvx2(in + 24);
+            SepiaPixelsAvx2(p0, p1);
+            uint8_t* out = dst + (size_t)x * 3;
+            StoreRgbAvx2(out, p0);
+            StoreRgbAvx2(out + 24, p1);
+        }
+    }
+    SepiaPixelsScalar(src, dst, x, width, bpp);
+}
+
+TARGET_AVX2
+static void InvertRowAvx2(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t bpp) {
+    size_t bytes = (size_t)width * bpp;
+    const __m256i mask = _mm256_set1_epi32(bpp == 4 ? 0x00FFFFFF : -1);
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(v, mask));
+    }
+    InvertBytesScalar(src, dst, i, bytes, bpp);
+}
+
+bool ProcessImageRowsAvx2(ImageOp op, PixelFormat format, const char* src, char* dst,
+    uint32_t width, uint32_t rows, uint32_t stride) {
+    return ProcessRows(op == ImageOp::SEPIA ? SepiaRowAvx2 : InvertRowAvx2,
+        format, src, dst, width, rows, stride);
+}
+
+#else
+
+bool ProcessImageRowsSse2(ImageOp op, PixelFormat format, const char* src, char* dst,
+    uint32_t width, uint32_t rows, uint32_t stride) {
+    return ProcessImageRowsScalar(op, format, src, dst, width, rows, stride);
+}
+
+bool ProcessImageRowsAvx2(ImageOp op, PixelFormat format, const char* src, char* dst,
+    uint32_t width, uint32_t rows, uint32_t stride) {
+    return ProcessImageRowsScalar(op, format, src, dst, width, rows, stride);
+}
+
+#endif
+
+typedef bool (*ProcessImageRowsFn)(ImageOp, PixelFormat, const char*, char*, uint32_t, uint32_t, uint32_t);
+
+static ProcessImageRowsFn SelectProcessImageRows() {
+    switch (DetectSimdLevel()) {
+    case SimdLevel::AVX2:
+        return ProcessImageRowsAvx2;
+    case SimdLevel::SSE2:
+        return ProcessImageRowsSse2;
+    default:
+        return ProcessImageRowsScalar;
+    }
+}
+
+bool ProcessImageRows(ImageOp op, PixelFormat format, const char* src, char* dst,
+    uint32_t width, uint32_t rows, uint32_t stride) {
+    static const ProcessImageRowsFn impl = SelectProcessImageRows();
+    return impl(op, format, src, dst, width, rows, stride);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+#include "Simd.h"
+
+enum class ImageOp {
+    SEPIA,
+    INVERT
+};
+
+// rows строк по stride байт, в каждой width пикселей формата format.
+// Байты после последнего пикселя строки копируются как есть; src и dst
+// могут совпадать. false - неизвестный формат или stride меньше строки
+bool ProcessImageRows(ImageOp op, PixelFormat format, const char* src, char* dst,
+    uint32_t width, uint32_t rows, uint32_t stride);
+
+// Отдельные реализации (для бенчмарка); AVX2 и SSE2 вызывать только
+// если DetectSimdLevel() их поддерживает
+bool ProcessImageRowsScalar(ImageOp op, PixelFormat format, const char* src, char* dst,
+    uint32_t width, uint32_t rows, uint32_t stride);
+bool ProcessImageRowsSse2(ImageOp op, PixelFormat format, const char* src, char* dst,
+    uint32_t width, uint32_t rows, uint32_t stride);
+bool ProcessImageRowsAvx2(ImageOp op, PixelFormat format, const char* src, char* dst,
+    uint32_t width, uint32_t rows, uint32_t stride);
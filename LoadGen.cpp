@@ -0,0 +1,539 @@
+#include "LoadGen.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+constexpr int HISTOGRAM_SUB_BITS = 6;   // 64 корзины на степень двойки
+constexpr size_t HISTOGRAM_SUB_BUCKETS = 1u << HISTOGRAM_SUB_BITS;
+constexpr uint32_t LOAD_PATTERN_LENGTH = 4;
+constexpr uint32_t LOAD_IMAGE_WIDTH = 256;      // RGBA32: строка 1 КБ
+constexpr uint32_t LOAD_FOURIER_SIZE = 1024;    // комплексных отсчётов в преобразовании
+constexpr uint32_t LOAD_XOR_KEY_LENGTH = 16;
+
+struct LoadTaskType {
+    const char* name;
+    MessageType type;
+};
+
+static const LoadTaskType LOAD_TASK_TYPES[] = {
+    { "substring", MessageType::TASK_SUBSTRING },
+    { "crc32", MessageType::TASK_CRC32 },
+    { "sort", MessageType::TASK_SORT },
+    { "stats", MessageType::TASK_STATS },
+    { "rle", MessageType::TASK_RLE },
+    { "xor", MessageType::TASK_XOR },
+    { "invert", MessageType::TASK_INVERT },
+    { "fourier", MessageType::TASK_FOURIER }
+};
+
+static bool FindTaskType(const std::string& name, MessageType& type) {
+    for (const LoadTaskType& entry : LOAD_TASK_TYPES) {
+        if (name == entry.name) {
+            type = entry.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Число с необязательным суффиксом K, M, G (степени 1024)
+static bool ParseQuantity(const std::string& text, double& value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    value = strtod(text.c_str(), &end);
+    double scale = 1;
+    if (*end == 'K' || *end == 'k') {
+        scale = 1024.0;
+        end++;
+    }
+    else if (*end == 'M' || *end == 'm') {
+        scale = 1024.0 * 1024.0;
+        end++;
+    }
+    else if (*end == 'G' || *end == 'g') {
+        scale = 1024.0 * 1024.0 * 1024.0;
+        end++;
+    }
+    value *= scale;
+    return end != text.c_str() && *end == '\0' && std::isfinite(value) && value >= 0;
+}
+
+static bool ParseCount(const std::string& text, uint64_t& value) {
+    double quantity;
+    if (!ParseQuantity(text, quantity) || quantity != std::floor(quantity) || quantity > 1e18) {
+        return false;
+    }
+    value = (uint64_t)quantity;
+    return true;
+}
+
+static std::vector<std::string> Split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::string part;
+    std::istringstream stream(text);
+    while (std::getline(stream, part, separator)) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+// N | fixed:N | uniform:A:B | lognormal:MEDIAN:SIGMA
+static bool ParseDistribution(const std::string& text, SizeDistribution& size) {
+    std::vector<std::string> parts = Split(text, ':');
+    if (parts.size() == 1) {
+        size.kind = SizeDistribution::Kind::FIXED;
+        return ParseQuantity(parts[0], size.a) && size.a >= LOAD_MIN_PAYLOAD && size.a <= LOAD_MAX_PAYLOAD;
+    }
+    if (parts.size() == 2 && parts[0] == "fixed") {
+        size.kind = SizeDistribution::Kind::FIXED;
+        return ParseQuantity(parts[1], size.a) && size.a >= LOAD_MIN_PAYLOAD && size.a <= LOAD_MAX_PAYLOAD;
+    }
+    if (parts.size() == 3 && parts[0] == "uniform") {
+        size.kind = SizeDistribution::Kind::UNIFORM;
+        return ParseQuantity(parts[1], size.a) && ParseQuantity(parts[2], size.b) &&
+            size.a >= LOAD_MIN_PAYLOAD && size.a <= size.b && size.b <= LOAD_MAX_PAYLOAD;
+    }
+    if (parts.size() == 3 && parts[0] == "lognormal") {
+        size.kind = SizeDistribution::Kind::LOGNORMAL;
+        return ParseQuantity(parts[1], size.a) && ParseQuantity(parts[2], size.b) &&
+            size.a >= LOAD_MIN_PAYLOAD && size.a <= LOAD_MAX_PAYLOAD && size.b <= 4;
+    }
+    return false;
+}
+
+uint32_t SizeDistribution::Sample(std::mt19937_64& rng) const {
+    double value = a;
+    if (kind == Kind::UNIFORM) {
+        value = std::uniform_real_distribution<double>(a, b)(rng);
+    }
+    else if (kind == Kind::LOGNORMAL) {
+        value = std::lognormal_distribution<double>(std::log(a), b)(rng);
+    }
+    // Хвост логнормального обрезается пределами нагрузки
+    value = value < LOAD_MIN_PAYLOAD ? LOAD_MIN_PAYLOAD : value > LOAD_MAX_PAYLOAD ? LOAD_MAX_PAYLOAD : value;
+    return (uint32_t)value;
+}
+
+std::string SizeDistribution::Describe() const {
+    std::ostringstream out;
+    switch (kind) {
+    case Kind::FIXED:
+        out << "fixed:" << (uint64_t)a;
+        break;
+    case Kind::UNIFORM:
+        out << "uniform:" << (uint64_t)a << ":" << (uint64_t)b;
+        break;
+    case Kind::LOGNORMAL:
+        out << "lognormal:" << (uint64_t)a << ":" << b;
+        break;
+    }
+    return out.str();
+}
+
+bool ParseLoadSpec(int argc, char* argv[], LoadSpec& spec, std::string& error) {
+    SizeDistribution defaultSize;
+    std::map<std::string, SizeDistribution> sizes;
+    std::vector<std::pair<std::string, double>> weights;
+
+    for (int i = 0; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--poisson") {
+            spec.poisson = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            error = "missing value for " + option;
+            return false;
+        }
+        std::string value = argv[++i];
+        uint64_t count = 0;
+        bool ok = true;
+
+        if (option == "--workers") {
+            ok = ParseCount(value, count) && count >= 1 && count <= 1024;
+            spec.workers = (int)count;
+        }
+        else if (option == "--in-flight") {
+            ok = ParseCount(value, count) && count >= 1 && count <= 1024;
+            spec.inFlight = (int)count;
+        }
+        else if (option == "--tasks") {
+            ok = ParseCount(value, spec.tasks) && spec.tasks >= 1;
+        }
+        else if (option == "--warmup") {
+            ok = ParseCount(value, spec.warmup);
+        }
+        else if (option == "--rate") {
+            ok = ParseQuantity(value, spec.rate);
+        }
+        else if (option == "--concurrency") {
+            ok = ParseCount(value, count) && count <= 1u << 20;
+            spec.concurrency = (int)count;
+        }
+        else if (option == "--seed") {
+            ok = ParseCount(value, spec.seed);
+        }
+        else if (option == "--json") {
+            spec.jsonPath = value;
+        }
+        else if (option == "--trace") {
+            spec.tracePath = value;
+        }
+        else if (option == "--mix") {
+            for (const std::string& item : Split(value, ',')) {
+                size_t equals = item.find('=');
+                std::string name = item.substr(0, equals);
+                double weight = 1;
+                MessageType type;
+                if (!FindTaskType(name, type) ||
+                    (equals != std::string::npos && !ParseQuantity(item.substr(equals + 1), weight)) ||
+                    weight <= 0) {
+                    error = "bad mix entry '" + item + "'";
+                    return false;
+                }
+                for (const auto& other : weights) {
+                    if (other.first == name) {
+                        error = "duplicate mix entry '" + name + "'";
+                        return false;
+                    }
+                }
+                weights.push_back(std::make_pair(name, weight));
+            }
+        }
+        else if (option == "--size") {
+            // DIST для всех типов или type=DIST для одного
+            size_t equals = value.find('=');
+            SizeDistribution size;
+            MessageType type;
+            if (equals == std::string::npos) {
+                ok = ParseDistribution(value, defaultSize);
+            }
+            else if (FindTaskType(value.substr(0, equals), type) &&
+                ParseDistribution(value.substr(equals + 1), size)) {
+                sizes[value.substr(0, equals)] = size;
+            }
+            else {
+                ok = false;
+            }
+        }
+        else {
+            error = "unknown option " + option;
+            return false;
+        }
+
+        if (!ok) {
+            error = "bad value '" + value + "' for " + option;
+            return false;
+        }
+    }
+
+    if (spec.tasks + spec.warmup > LOAD_MAX_TASKS) {
+        error = "too many tasks";
+        return false;
+    }
+    if (weights.empty()) {
+        weights.push_back(std::make_pair(std::string("substring"), 1.0));
+    }
+
+    spec.mix.clear();
+    for (const auto& weight : weights) {
+        LoadMixEntry entry;
+        entry.name = weight.first;
+        FindTaskType(entry.name, entry.type);
+        entry.weight = weight.second;
+        auto size = sizes.find(entry.name);
+        entry.size = size != sizes.end() ? size->second : defaultSize;
+        spec.mix.push_back(entry);
+    }
+    return true;
+}
+
+void PrintLoadUsage(std::ostream& out) {
+    out << "Usage: Browser --bench [options]\n"
+        << "  --workers N         worker processes (default 4)\n"
+        << "  --in-flight N       tasks in flight per worker thread (default 4)\n"
+        << "  --tasks N           measured tasks (default 10000)\n"
+        << "  --warmup N          tasks run before measuring (default 1000)\n"
+        << "  --rate R            open loop: R tasks per second; 0 - closed loop (default)\n"
+        << "  --poisson           open loop: exponential inter-arrival times\n"
+        << "  --concurrency N     closed loop: tasks outstanding (default - all worker windows)\n"
+        << "  --mix T=W,...       task mix by weight; T is one of";
+    for (const LoadTaskType& entry : LOAD_TASK_TYPES) {
+        out << " " << entry.name;
+    }
+    out << " (default substring)\n"
+        << "  --size [T=]DIST     payload bytes: N, fixed:N, uniform:A:B, lognormal:MEDIAN:SIGMA;\n"
+        << "                      sizes take K/M suffixes (default 4K)\n"
+        << "  --seed N            random seed (default 1)\n"
+        << "  --json PATH         write results as JSON\n"
+        << "  --trace PATH        trace task stages, write Chrome trace events\n";
+}
+
+void FillLoadSource(std::vector<char>& source, std::mt19937_64& rng) {
+    source.resize(2 * (size_t)MAX_DATA_SIZE);
+    size_t i = 0;
+    while (i < source.size()) {
+        uint64_t bits = rng();
+        char letter = (char)('a' + (bits & 15));
+        // Каждая восьмая буква - серия до 64 повторов
+        size_t run = (bits >> 4 & 7) == 0 ? 3 + (size_t)(bits >> 8 & 63) : 1;
+        for (size_t k = 0; k < run && i < source.size(); k++) {
+            source[i++] = letter;
+        }
+    }
+}
+
+static const char* SourceSlice(const std::vector<char>& source, size_t size, std::mt19937_64& rng) {
+    size_t offset = (size_t)(rng() % (source.size() - size + 1));
+    return source.data() + offset;
+}
+
+void MakeLoadTask(MessageType type, uint32_t taskId, uint32_t size, const std::vector<char>& source,
+    std::mt19937_64& rng, TaskMessage& header, MessageBuffer& payload) {
+    uint32_t extraParam = 0;
+    payload.Clear();
+
+    switch (type) {
+    case MessageType::TASK_SUBSTRING: {
+        // Образец - из того же пула: вхождения есть
+        const char* pattern = SourceSlice(source, LOAD_PATTERN_LENGTH, rng);
+        payload.Append(SourceSlice(source, size, rng), size);
+        payload.Append(pattern, LOAD_PATTERN_LENGTH);
+        extraParam = LOAD_PATTERN_LENGTH;
+        break;
+    }
+    case MessageType::TASK_CRC32:
+        payload.Append(SourceSlice(source, size, rng), size);
+        extraParam = (uint32_t)CrcKind::CRC32C;
+        break;
+    case MessageType::TASK_SORT:
+        size &= ~3u;
+        payload.Append(SourceSlice(source, size, rng), size);
+        extraParam = (uint32_t)SortKey::UINT32;
+        break;
+    case MessageType::TASK_STATS:
+        size &= ~3u;
+        payload.Append(SourceSlice(source, size, rng), size);
+        extraParam = (uint32_t)SampleType::FLOAT32;
+        break;
+    case MessageType::TASK_RLE:
+        payload.Append(SourceSlice(source, size, rng), size);
+        extraParam = (uint32_t)RleOp::ENCODE;
+        break;
+    case MessageType::TASK_XOR: {
+        XorHeader xorHeader = {};
+        xorHeader.position = rng() >> 16;
+        payload.Append(&xorHeader, sizeof(xorHeader));
+        payload.Append(SourceSlice(source, LOAD_XOR_KEY_LENGTH, rng), LOAD_XOR_KEY_LENGTH);
+        payload.Append(SourceSlice(source, size, rng), size);
+        extraParam = LOAD_XOR_KEY_LENGTH;
+        break;
+    }
+    case MessageType::TASK_INVERT: {
+        uint32_t stride = LOAD_IMAGE_WIDTH * 4;
+        ImageTile tile = { LOAD_IMAGE_WIDTH, size / stride > 0 ? size / stride : 1 };
+        payload.Append(&tile, sizeof(tile));
+        payload.Append(SourceSlice(source, (size_t)tile.rows * stride, rng), (size_t)tile.rows * stride);
+        extraParam = MakeImageParam(PixelFormat::RGBA32, stride);
+        break;
+    }
+    case MessageType::TASK_FOURIER: {
+        size_t bytes = FourierInputSize(FourierMode::FORWARD, LOAD_FOURIER_SIZE);
+        FourierHeader fourier = { LOAD_FOURIER_SIZE, size / bytes > 0 ? (uint32_t)(size / bytes) : 1 };
+        payload.Append(&fourier, sizeof(fourier));
+        payload.Append(SourceSlice(source, fourier.count * bytes, rng), fourier.count * bytes);
+        extraParam = (uint32_t)FourierMode::FORWARD;
+        break;
+    }
+    default:
+        break;
+    }
+
+    header = MakeTaskHeader(type, taskId, (uint32_t)payload.Size(), extraParam);
+}
+
+LatencyHistogram::LatencyHistogram() : count(0), min(~0ull), max(0), sum(0) {}
+
+// Значения меньше 64 - в своих корзинах; дальше по 64 корзины на
+// [64 * 2^s, 128 * 2^s)
+size_t LatencyHistogram::BucketOf(uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return (size_t)value;
+    }
+    int bits = 0;
+    for (uint64_t v = value; v > 1; v >>= 1) {
+        bits++;
+    }
+    int shift = bits - HISTOGRAM_SUB_BITS;
+    return (size_t)(shift + 1) * HISTOGRAM_SUB_BUCKETS + (size_t)((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+uint64_t LatencyHistogram::BucketMiddle(size_t bucket) {
+    if (bucket < HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = (int)(bucket / HISTOGRAM_SUB_BUCKETS) - 1;
+    uint64_t mantissa = HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS;
+    return (mantissa << shift) + ((1ull << shift) >> 1);
+}
+
+void LatencyHistogram::Record(uint64_t nanoseconds) {
+    size_t bucket = BucketOf(nanoseconds);
+    if (bucket >= buckets.size()) {
+        buckets.resize(bucket + 1, 0);
+    }
+    buckets[bucket]++;
+    count++;
+    sum += (double)nanoseconds;
+    min = nanoseconds < min ? nanoseconds : min;
+    max = nanoseconds > max ? nanoseconds : max;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    if (other.buckets.size() > buckets.size()) {
+        buckets.resize(other.buckets.size(), 0);
+    }
+    for (size_t i = 0; i < other.buckets.size(); i++) {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    min = other.min < min ? other.min : min;
+    max = other.max > max ? other.max : max;
+}
+
+uint64_t LatencyHistogram::Percentile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    // Ранг: наименьшее значение, не меньше которого q всех
+    uint64_t rank = (uint64_t)std::ceil(q * (double)count);
+    rank = rank < 1 ? 1 : rank > count ? count : rank;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t value = BucketMiddle(i);
+            return value < min ? min : value > max ? max : value;
+        }
+    }
+    return max;
+}
+
+static const double LOAD_PERCENTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+static const char* const LOAD_PERCENTILE_NAMES[] = { "p50", "p90", "p99", "p99.9" };
+
+static double Micros(uint64_t nanoseconds) {
+    return nanoseconds / 1000.0;
+}
+
+static void PrintResultLine(std::ostream& out, const std::string& name, const LoadResult& result, double seconds) {
+    out << std::left << std::setw(10) << name << std::right << std::setw(9) << result.completed
+        << std::setw(7) << result.errors << std::setw(11) << (seconds > 0 ? result.completed / seconds : 0.0)
+        << std::setw(9) << (seconds > 0 ? result.bytesIn / seconds / (1024 * 1024) : 0.0);
+    for (double q : LOAD_PERCENTILES) {
+        out << std::setw(10) << Micros(result.latency.Percentile(q));
+    }
+    out << std::setw(10) << Micros(result.latency.Max()) << std::endl;
+}
+
+void PrintLoadReport(std::ostream& out, const LoadSpec& spec, const LoadReport& report) {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+
+    out << "\n=== Load results: " << spec.tasks << " tasks in " << report.seconds << " s ===" << std::endl;
+    out << std::left << std::setw(10) << "type" << std::right << std::setw(9) << "done" << std::setw(7) << "errors"
+        << std::setw(11) << "tasks/s" << std::setw(9) << "MB/s";
+    for (const char* name : LOAD_PERCENTILE_NAMES) {
+        out << std::setw(10) << name;
+    }
+    out << std::setw(10) << "max" << "  (latency, us)" << std::endl;
+
+    out << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < spec.mix.size(); i++) {
+        PrintResultLine(out, spec.mix[i].name, report.types[i], report.seconds);
+    }
+    if (spec.mix.size() > 1) {
+        PrintResultLine(out, "all", report.total, report.seconds);
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+static void WriteLatencyJson(std::ostream& out, const LatencyHistogram& latency) {
+    out << "{\"min\": " << Micros(latency.Min()) << ", \"mean\": " << latency.Mean() / 1000.0;
+    for (size_t i = 0; i < 4; i++) {
+        out << ", \"" << LOAD_PERCENTILE_NAMES[i] << "\": " << Micros(latency.Percentile(LOAD_PERCENTILES[i]));
+    }
+    out << ", \"max\": " << Micros(latency.Max()) << "}";
+}
+
+static void WriteResultJson(std::ostream& out, const LoadResult& result, double seconds, const char* indent) {
+    out << "{\n"
+        << indent << "  \"completed\": " << result.completed << ",\n"
+        << indent << "  \"errors\": " << result.errors << ",\n"
+        << indent << "  \"bytes_in\": " << result.bytesIn << ",\n"
+        << indent << "  \"bytes_out\": " << result.bytesOut << ",\n"
+        << indent << "  \"tasks_per_s\": " << (seconds > 0 ? result.completed / seconds : 0.0) << ",\n"
+        << indent << "  \"mb_per_s\": " << (seconds > 0 ? result.bytesIn / seconds / (1024 * 1024) : 0.0) << ",\n"
+        << indent << "  \"latency_us\": ";
+    WriteLatencyJson(out, result.latency);
+    out << "\n"
+        << indent << "}";
+}
+
+// Имена типов и распределения - из фиксированного набора, экранировать нечего
+bool WriteLoadReport(const std::string& path, const LoadSpec& spec, const LoadReport& report) {
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    out << std::setprecision(9);
+
+    out << "{\n"
+        << "  \"config\": {\n"
+        << "    \"workers\": " << spec.workers << ",\n"
+        << "    \"in_flight\": " << spec.inFlight << ",\n"
+        << "    \"tasks\": " << spec.tasks << ",\n"
+        << "    \"warmup\": " << spec.warmup << ",\n"
+        << "    \"loop\": \"" << (spec.rate > 0 ? "open" : "closed") << "\",\n"
+        << "    \"rate\": " << spec.rate << ",\n"
+        << "    \"arrivals\": \"" << (spec.poisson ? "poisson" : "fixed") << "\",\n"
+        << "    \"concurrency\": " << report.concurrency << ",\n"
+        << "    \"seed\": " << spec.seed << ",\n"
+        << "    \"mix\": [";
+    for (size_t i = 0; i < spec.mix.size(); i++) {
+        out << (i ? ", " : "") << "{\"type\": \"" << spec.mix[i].name << "\", \"weight\": " << spec.mix[i].weight
+            << ", \"size\": \"" << spec.mix[i].size.Describe() << "\"}";
+    }
+    out << "]\n"
+        << "  },\n"
+        << "  \"seconds\": " << report.seconds << ",\n"
+        << "  \"total\": ";
+    WriteResultJson(out, report.total, report.seconds, "  ");
+    out << ",\n"
+        << "  \"types\": {";
+    for (size_t i = 0; i < spec.mix.size(); i++) {
+        out << (i ? "," : "") << "\n    \"" << spec.mix[i].name << "\": ";
+        WriteResultJson(out, report.types[i], report.seconds, "    ");
+    }
+    out << "\n  }";
+    if (!report.stages.empty()) {
+        out << ",\n"
+            << "  \"stages_us\": {";
+        for (size_t i = 0; i < report.stages.size(); i++) {
+            out << (i ? "," : "") << "\n    \"" << report.stages[i].first << "\": ";
+            WriteLatencyJson(out, report.stages[i].second);
+        }
+        out << "\n  }";
+    }
+    out << "\n}\n";
+    return (bool)out;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <random>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+#include "BufferPool.h"
+
+constexpr uint32_t LOAD_MIN_PAYLOAD = 64;
+constexpr uint32_t LOAD_MAX_PAYLOAD = MAX_DATA_SIZE - 4096;   // с запасом на заголовки задач
+constexpr uint64_t LOAD_MAX_TASKS = 0x40000000u;              // taskId ниже STREAM_TASK_BASE
+
+// Размер полезной нагрузки задачи: FIXED - a; UNIFORM - равномерно на
+// [a, b]; LOGNORMAL - медиана a, сигма логарифма b
+struct SizeDistribution {
+    enum class Kind {
+        FIXED,
+        UNIFORM,
+        LOGNORMAL
+    };
+    Kind kind = Kind::FIXED;
+    double a = 4096;
+    double b = 0;
+
+    uint32_t Sample(std::mt19937_64& rng) const;
+    std::string Describe() const;
+};
+
+struct LoadMixEntry {
+    std::string name;
+    MessageType type;
+    double weight;
+    SizeDistribution size;
+};
+
+// Параметры Browser --bench
+struct LoadSpec {
+    int workers = 4;
+    int inFlight = 4;
+    uint64_t tasks = 10000;      // измеряемых, после прогрева
+    uint64_t warmup = 1000;
+    double rate = 0;             // задач в секунду; 0 - замкнутый цикл
+    bool poisson = false;        // открытый цикл: экспоненциальные интервалы вместо равных
+    int concurrency = 0;         // замкнутый цикл: задач в полёте; 0 - сумма окон воркеров
+    uint64_t seed = 1;
+    std::vector<LoadMixEntry> mix;
+    std::string jsonPath;
+    std::string tracePath;       // не пусто - трассировка этапов и файл trace-событий Chrome
+};
+
+// argv без имени программы и --bench. false - error объясняет, что не так
+bool ParseLoadSpec(int argc, char* argv[], LoadSpec& spec, std::string& error);
+void PrintLoadUsage(std::ostream& out);
+
+// Пул байт, из которого нарезаются нагрузки: буквы a..p с сериями,
+// чтобы были и вхождения образцов, и что сжимать RLE; как float - конечные
+void FillLoadSource(std::vector<char>& source, std::mt19937_64& rng);
+
+// Задача типа type с нагрузкой около size байт из source
+void MakeLoadTask(MessageType type, uint32_t taskId, uint32_t size, const std::vector<char>& source,
+    std::mt19937_64& rng, TaskMessage& header, MessageBuffer& payload);
+
+// Гистограмма задержек в наносекундах: по 64 корзины на каждую степень
+// двойки, процентили с относительной погрешностью не больше 1/64
+class LatencyHistogram {
+private:
+    std::vector<uint64_t> buckets;
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+
+    static size_t BucketOf(uint64_t value);
+    static uint64_t BucketMiddle(size_t bucket);
+
+public:
+    LatencyHistogram();
+
+    void Record(uint64_t nanoseconds);
+    void Merge(const LatencyHistogram& other);
+
+    uint64_t Count() const { return count; }
+    uint64_t Min() const { return count ? min : 0; }
+    uint64_t Max() const { return max; }
+    double Mean() const { return count ? sum / count : 0.0; }
+    // q из [0, 1]
+    uint64_t Percentile(double q) const;
+};
+
+struct LoadResult {
+    LatencyHistogram latency;
+    uint64_t completed = 0;
+    uint64_t errors = 0;
+    uint64_t bytesIn = 0;     // полезной нагрузки задач
+    uint64_t bytesOut = 0;    // ответов
+};
+
+struct LoadReport {
+    std::vector<LoadResult> types;   // по spec.mix
+    LoadResult total;
+    double seconds = 0;              // от прихода первой измеряемой задачи до последнего ответа
+    int concurrency = 0;             // замкнутый цикл
+    std::vector<std::pair<std::string, LatencyHistogram>> stages;   // при трассировке
+};
+
+void PrintLoadReport(std::ostream& out, const LoadSpec& spec, const LoadReport& report);
+bool WriteLoadReport(const std::string& path, const LoadSpec& spec, const LoadReport& report);
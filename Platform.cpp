@@ -0,0 +1,112 @@
+#include "Platform.h"
+#include <iostream>
+
+#ifdef _WIN32
+
+bool LaunchProcess(const std::string& executable, const std::vector<std::string>& args,
+    ProcessHandle& handle, unsigned long& processId) {
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    ZeroMemory(&pi, sizeof(pi));
+
+    std::string cmdLine = executable;
+    for (const std::string& arg : args) {
+        cmdLine += " " + arg;
+    }
+
+    std::vector<char> cmdLineCopy(cmdLine.begin(), cmdLine.end());
+    cmdLineCopy.push_back('\0');
+
+    if (!CreateProcessA(
+        NULL,
+        cmdLineCopy.data(),
+        NULL,
+        NULL,
+        FALSE,
+        CREATE_NO_WINDOW,
+        NULL,
+        NULL,
+        &si,
+        &pi
+    )) {
+        std::cerr << "Failed to start " << executable << ". Error: " << GetLastError() << std::endl;
+        return false;
+    }
+
+    CloseHandle(pi.hThread);
+    handle = pi.hProcess;
+    processId = pi.dwProcessId;
+    return true;
+}
+
+void WaitProcess(ProcessHandle& handle) {
+    if (handle != INVALID_PROCESS_HANDLE) {
+        WaitForSingleObject(handle, INFINITE);
+        CloseHandle(handle);
+        handle = INVALID_PROCESS_HANDLE;
+    }
+}
+
+void CloseProcess(ProcessHandle& handle) {
+    if (handle != INVALID_PROCESS_HANDLE) {
+        CloseHandle(handle);
+        handle = INVALID_PROCESS_HANDLE;
+    }
+}
+
+void SleepMs(unsigned int milliseconds) {
+    Sleep(milliseconds);
+}
+
+#else
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+
+extern char** environ;
+
+bool LaunchProcess(const std::string& executable, const std::vector<std::string>& args,
+    ProcessHandle& handle, unsigned long& processId) {
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(executable.c_str()));
+    for (const std::string& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    int err = posix_spawn(&pid, executable.c_str(), NULL, NULL, argv.data(), environ);
+    if (err != 0) {
+        std::cerr << "Failed to start " << executable << ". Error: " << strerror(err) << std::endl;
+        return false;
+    }
+
+    handle = pid;
+    processId = (unsigned long)pid;
+    return true;
+}
+
+void WaitProcess(ProcessHandle& handle) {
+    if (handle != INVALID_PROCESS_HANDLE) {
+        int status;
+        while (waitpid(handle, &status, 0) < 0 && errno == EINTR) {
+        }
+        handle = INVALID_PROCESS_HANDLE;
+    }
+}
+
+void CloseProcess(ProcessHandle& handle) {
+    handle = INVALID_PROCESS_HANDLE;
+}
+
+void SleepMs(unsigned int milliseconds) {
+    usleep(milliseconds * 1000);
+}
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE ProcessHandle;
+#define INVALID_PROCESS_HANDLE INVALID_HANDLE_VALUE
+#else
+#include <sys/types.h>
+#include <unistd.h>
+typedef pid_t ProcessHandle;
+#define INVALID_PROCESS_HANDLE ((pid_t)-1)
+#endif
+
+// Запуск и ожидание дочерних процессов
+bool LaunchProcess(const std::string& executable, const std::vector<std::string>& args,
+    ProcessHandle& handle, unsigned long& processId);
+void WaitProcess(ProcessHandle& handle);
+void CloseProcess(ProcessHandle& handle);
+
+void SleepMs(unsigned int milliseconds);
+
+inline unsigned long CurrentProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return (unsigned long)getpid();
+#endif
+}
+
+// Монотонные наносекунды для отметок трассировки. Начало отсчёта у
+// процессов может не совпадать: смещение оценивает Browser
+inline uint64_t TraceTime(std::chrono::steady_clock::time_point time) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+inline uint64_t TraceClock() {
+    return TraceTime(std::chrono::steady_clock::now());
+}
+
+// Путь к исполняемому файлу воркера рядом с Browser
+inline std::string GetWorkerExecutable() {
+#ifdef _WIN32
+    return "Worker.exe";
+#else
+    return "./Worker";
+#endif
+}
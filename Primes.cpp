@@ -0,0 +1,296 @@
+#include "Primes.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+constexpr uint64_t SEGMENT_BITS = SIEVE_SEGMENT_BYTES * 8;
+constexpr uint64_t BASE_PRIMES_MIN_LIMIT = 1 << 16;
+constexpr size_t MAX_GAP_BYTES = 3;     // разности простых до 2^50 меньше 2^15
+
+static inline int PopCount64(uint64_t mask) {
+#ifdef _MSC_VER
+    return (int)__popcnt64(mask);
+#else
+    return __builtin_popcountll(mask);
+#endif
+}
+
+static inline int LowestBit64(uint64_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+static uint64_t ISqrt(uint64_t value) {
+    uint64_t root = (uint64_t)std::sqrt((double)value);
+    while (root * root > value) {
+        root--;
+    }
+    while ((root + 1) * (root + 1) <= value) {
+        root++;
+    }
+    return root;
+}
+
+// Разность соседних простых: 1 (только 2 -> 3) кодируется нулём,
+// остальные чётны и делятся пополам
+static inline size_t EncodeGap(uint8_t* out, uint64_t gap) {
+    uint64_t code = gap == 1 ? 0 : gap / 2;
+    size_t length = 0;
+    while (code >= 0x80) {
+        out[length++] = (uint8_t)(code | 0x80);
+        code >>= 7;
+    }
+    out[length++] = (uint8_t)code;
+    return length;
+}
+
+static void AppendGap(MessageBuffer& out, uint64_t gap) {
+    uint8_t encoded[10];
+    out.Append(encoded, EncodeGap(encoded, gap));
+}
+
+BasePrimes::BasePrimes() : limit(0) {}
+
+std::shared_ptr<const std::vector<uint32_t>> BasePrimes::UpTo(uint64_t upTo) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (primes && upTo <= limit) {
+        return primes;
+    }
+
+    // Растём с запасом, чтобы соседние диапазоны не пересобирали таблицу
+    uint64_t newLimit = upTo > limit * 2 ? upTo : limit * 2;
+    if (newLimit < BASE_PRIMES_MIN_LIMIT) {
+        newLimit = BASE_PRIMES_MIN_LIMIT;
+    }
+
+    // Простое решето по нечётным: composite[i] для числа 2i + 1
+    std::vector<char> composite(newLimit / 2 + 1, 0);
+    std::shared_ptr<std::vector<uint32_t>> table = std::make_shared<std::vector<uint32_t>>();
+    for (uint64_t i = 1; 2 * i + 1 <= newLimit; i++) {
+        if (composite[i]) {
+            continue;
+        }
+        uint64_t prime = 2 * i + 1;
+        table->push_back((uint32_t)prime);
+        for (uint64_t j = prime * prime / 2; 2 * j + 1 <= newLimit; j += prime) {
+            composite[j] = 1;
+        }
+    }
+
+    primes = table;
+    limit = newLimit;
+    return primes;
+}
+
+bool SievePrimes(uint64_t lo, uint64_t hi, BasePrimes& base, SieveScratch& scratch,
+    uint64_t& count, MessageBuffer* list) {
+    count = 0;
+    if (hi > PRIME_MAX_VALUE || lo > hi) {
+        return false;
+    }
+
+    PrimeListHeader header;
+    header.count = 0;
+    header.first = 0;
+    header.last = 0;
+    size_t headerOffset = 0;
+    if (list) {
+        headerOffset = list->Size();
+        list->Resize(headerOffset + sizeof(header));
+    }
+
+    if (lo <= 2 && 2 < hi) {
+        count = 1;
+        header.first = 2;
+        header.last = 2;
+    }
+
+    // Бит i сегмента - нечётное число start + 2 * (segment + i)
+    uint64_t start = lo < 3 ? 3 : (lo | 1);
+    if (start < hi) {
+        uint64_t total = (hi - start + 1) / 2;
+        uint64_t root = ISqrt(hi - 1);
+        std::shared_ptr<const std::vector<uint32_t>> snapshot = base.UpTo(root);
+        const std::vector<uint32_t>& primes = *snapshot;
+        size_t used = std::upper_bound(primes.begin(), primes.end(), (uint32_t)root) - primes.begin();
+
+        // Первое нечётное кратное не меньше p^2: меньшие кратные уже
+        // вычеркнуты меньшими простыми
+        std::vector<uint64_t>& next = scratch.next;
+        next.resize(used);
+        for (size_t j = 0; j < used; j++) {
+            uint64_t prime = primes[j];
+            uint64_t multiple = prime * prime;
+            if (multiple < start) {
+                multiple = (start + prime - 1) / prime * prime;
+                if ((multiple & 1) == 0) {
+                    multiple += prime;
+                }
+            }
+            next[j] = (multiple - start) / 2;
+        }
+
+        std::vector<uint64_t>& bits = scratch.bits;
+        bits.resize(SEGMENT_BITS / 64);
+
+        for (uint64_t segment = 0; segment < total; segment += SEGMENT_BITS) {
+            uint64_t length = total - segment < SEGMENT_BITS ? total - segment : SEGMENT_BITS;
+            uint64_t end = segment + length;
+            size_t words = (size_t)((length + 63) / 64);
+            memset(bits.data(), 0, words * sizeof(uint64_t));
+
+            uint64_t largest = start + 2 * (end - 1);
+            for (size_t j = 0; j < used; j++) {
+                uint64_t prime = primes[j];
+                if (prime * prime > largest) {
+                    break;
+                }
+                // Шаг 2p по числам - p по индексам нечётных
+                uint64_t index = next[j];
+                for (; index < end; index += prime) {
+                    uint64_t bit = index - segment;
+                    bits[bit >> 6] |= 1ull << (bit & 63);
+                }
+                next[j] = index;
+            }
+
+            if (length & 63) {
+                bits[words - 1] |= ~0ull << (length & 63);
+            }
+
+            if (!list) {
+                for (size_t w = 0; w < words; w++) {
+                    count += PopCount64(~bits[w]);
+                }
+                continue;
+            }
+
+            // Место под худший случай, потом обрезка до записанного
+            uint64_t found = 0;
+            for (size_t w = 0; w < words; w++) {
+                found += PopCount64(~bits[w]);
+            }
+            size_t offset = list->Size();
+            list->Resize(offset + found * MAX_GAP_BYTES);
+            uint8_t* out = (uint8_t*)list->Data() + offset;
+            size_t written = 0;
+
+            for (size_t w = 0; w < words; w++) {
+                uint64_t open = ~bits[w];
+                while (open) {
+                    uint64_t prime = start + 2 * (segment + w * 64 + LowestBit64(open));
+                    open &= open - 1;
+                    if (count == 0) {
+                        header.first = prime;
+                    }
+                    else {
+                        written += EncodeGap(out + written, prime - header.last);
+                    }
+                    header.last = prime;
+                    count++;
+                }
+            }
+            list->Resize(offset + written);
+        }
+    }
+
+    if (list) {
+        header.count = count;
+        if (count == 0) {
+            header.first = 0;
+            header.last = 0;
+        }
+        memcpy(list->Data() + headerOffset, &header, sizeof(header));
+    }
+    return true;
+}
+
+PrimeListBuilder::PrimeListBuilder() : nextIndex(0), failed(false) {
+    header.count = 0;
+    header.first = 0;
+    header.last = 0;
+}
+
+bool PrimeListBuilder::Add(uint64_t index, MessageBuffer part) {
+    if (failed || part.Size() < sizeof(PrimeListHeader)) {
+        failed = true;
+        return false;
+    }
+    pending[index] = std::move(part);
+
+    auto it = pending.begin();
+    while (it != pending.end() && it->first == nextIndex) {
+        PrimeListHeader partHeader;
+        memcpy(&partHeader, it->second.Data(), sizeof(partHeader));
+
+        if (partHeader.count > 0) {
+            // Первое простое части становится разностью от последнего
+            // простого предыдущих частей
+            if (header.count == 0) {
+                header.first = partHeader.first;
+            }
+            else {
+                AppendGap(gaps, partHeader.first - header.last);
+            }
+            gaps.Append(it->second.Data() + sizeof(partHeader), it->second.Size() - sizeof(partHeader));
+            header.last = partHeader.last;
+            header.count += partHeader.count;
+        }
+
+        it = pending.erase(it);
+        nextIndex++;
+    }
+    return true;
+}
+
+void PrimeListBuilder::Finish(MessageBuffer& list) const {
+    list.Clear();
+    list.Reserve(sizeof(header) + gaps.Size());
+    list.Append(&header, sizeof(header));
+    list.Append(gaps.Data(), gaps.Size());
+}
+
+bool DecodePrimeList(const char* data, size_t size, std::vector<uint64_t>& primes) {
+    PrimeListHeader header;
+    primes.clear();
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.count == 0) {
+        return size == sizeof(header);
+    }
+
+    const uint8_t* cursor = (const uint8_t*)data + sizeof(header);
+    const uint8_t* end = (const uint8_t*)data + size;
+    uint64_t prime = header.first;
+    primes.push_back(prime);
+
+    for (uint64_t i = 1; i < header.count; i++) {
+        uint64_t code = 0;
+        int shift = 0;
+        while (true) {
+            if (cursor == end || shift > 56) {
+                return false;
+            }
+            uint8_t byte = *cursor++;
+            code |= (uint64_t)(byte & 0x7F) << shift;
+            shift += 7;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        prime += code == 0 ? 1 : code * 2;
+        primes.push_back(prime);
+    }
+    return cursor == end && prime == header.last;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+
+constexpr size_t SIEVE_SEGMENT_BYTES = 32 * 1024;  // сегмент помещается в L1
+
+// Нечётные простые для просеивания. Таблица только растёт; читатели
+// получают снимок и просеивают без блокировки
+class BasePrimes {
+private:
+    std::shared_ptr<const std::vector<uint32_t>> primes;
+    uint64_t limit;
+    std::mutex lock;
+
+public:
+    BasePrimes();
+
+    // Все нечётные простые не больше upTo (upTo < 2^32)
+    std::shared_ptr<const std::vector<uint32_t>> UpTo(uint64_t upTo);
+};
+
+// Рабочие массивы сегментированного решета одного потока
+struct SieveScratch {
+    std::vector<uint64_t> bits;   // сегмент: бит на нечётное число, 1 - составное
+    std::vector<uint64_t> next;   // индекс следующего кратного каждого базового простого
+};
+
+// Простые в [lo, hi), hi <= PRIME_MAX_VALUE. Память - сегмент и массив
+// по базовым простым, от длины диапазона не зависит. list не null -
+// дописывает туда PrimeListHeader и разности
+bool SievePrimes(uint64_t lo, uint64_t hi, BasePrimes& base, SieveScratch& scratch,
+    uint64_t& count, MessageBuffer* list);
+
+// Склейка списков частей диапазона по порядку в один список того же
+// формата; части, пришедшие раньше предыдущих, ждут в pending
+class PrimeListBuilder {
+private:
+    std::map<uint64_t, MessageBuffer> pending;
+    uint64_t nextIndex;
+    PrimeListHeader header;
+    MessageBuffer gaps;
+    bool failed;
+
+public:
+    PrimeListBuilder();
+
+    bool Add(uint64_t index, MessageBuffer part);
+    // Готовый список: PrimeListHeader, затем разности
+    void Finish(MessageBuffer& list) const;
+
+    uint64_t Count() const { return header.count; }
+    uint64_t Reduced() const { return nextIndex; }
+};
+
+bool DecodePrimeList(const char* data, size_t size, std::vector<uint64_t>& primes);
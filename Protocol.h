@@ -0,0 +1,533 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "BufferPool.h"
+
+constexpr int MAX_DATA_SIZE = 1024 * 1024; // 1MB
+constexpr uint32_t MAX_FRAME_SIZE = 16 * MAX_DATA_SIZE; // пакет результатов
+
+enum class MessageType : uint32_t {
+    TASK_SEPIA = 1,
+    TASK_PRIMES = 2,
+    TASK_SORT = 3,
+    TASK_CRC32 = 4,
+    TASK_STATS = 5,
+    TASK_XOR = 6,
+    TASK_SUBSTRING = 7,   // Наш вариант
+    TASK_MATRIX_MULT = 8,
+    TASK_FACTORIAL = 9,
+    TASK_HISTOGRAM = 10,
+    TASK_FOURIER = 11,
+    TASK_RLE = 12,
+    TASK_GRAPH_PATH = 13,
+    TASK_INVERT = 14,
+    TASK_BATCH = 100,     // data: подряд идущие TaskMessage, extraParam = их число
+    TERMINATE = 999
+};
+
+// Структура для передачи задачи
+#pragma pack(push, 1)
+struct TaskMessage {
+    MessageType type;
+    uint32_t taskId;
+    uint32_t dataSize;
+    uint32_t extraParam;
+    uint32_t flags;   // TASK_FLAG_*
+    char data[1]; // гибкий массив
+};
+#pragma pack(pop)
+
+// Структура для результата
+#pragma pack(push, 1)
+struct ResultMessage {
+    uint32_t taskId;
+    uint32_t resultSize;
+    uint32_t flags;   // RESULT_FLAG_*
+    char data[1]; // гибкий массив
+};
+#pragma pack(pop)
+
+// Флаги задачи
+constexpr uint32_t TASK_FLAG_SHM_PAYLOAD = 1u << 0; // data содержит ShmDescriptor
+constexpr uint32_t TASK_FLAG_MULTI_PATTERN = 1u << 1; // TASK_SUBSTRING с несколькими образцами
+constexpr uint32_t TASK_FLAG_STREAM_CHUNK = 1u << 2;  // TASK_SUBSTRING по фрагменту потока
+constexpr uint32_t TASK_FLAG_RLE = 1u << 3;           // data - кадр RLE полезной нагрузки
+constexpr uint32_t TASK_FLAG_TRACE = 1u << 4;         // data начинается с TraceStamps
+
+constexpr uint32_t MAX_PATTERNS = 1024;
+
+// Флаги результата
+constexpr uint32_t RESULT_FLAG_BATCH = 1u << 0;     // data: подряд идущие ResultMessage
+constexpr uint32_t RESULT_FLAG_IN_PLACE = 1u << 1;  // результат записан поверх полезной нагрузки в кольце
+constexpr uint32_t RESULT_FLAG_RLE = 1u << 2;       // data - кадр RLE ответа
+constexpr uint32_t RESULT_FLAG_CACHED = 1u << 3;    // не с провода: ответ из кэша Browser
+constexpr uint32_t RESULT_FLAG_TRACE = 1u << 4;     // data начинается с TraceStamps
+
+// Идентификаторы пакетов не пересекаются с taskId
+constexpr uint32_t BATCH_ID_BIT = 0x80000000u;
+
+// Ссылка на полезную нагрузку в разделяемом кольце воркера
+#pragma pack(push, 1)
+struct ShmDescriptor {
+    uint64_t offset;  // смещение от начала области данных кольца
+    uint32_t size;
+};
+#pragma pack(pop)
+
+// Трассировка (TASK_FLAG_TRACE): перед данными задачи - TraceStamps с
+// отметками Browser, остальные поля нулевые; флаги SHM_PAYLOAD и RLE
+// описывают то, что идёт после. Воркер дописывает свои отметки и
+// возвращает структуру перед данными ответа с RESULT_FLAG_TRACE, в том
+// числе в пакете. Отметки - наносекунды TraceClock() своего процесса
+#pragma pack(push, 1)
+struct TraceStamps {
+    uint64_t enqueued;        // Browser: задача поставлена в очередь
+    uint64_t sent;            // Browser: задача отдана диспетчеру
+    uint64_t received;        // воркер: кадр прочитан из канала
+    uint64_t computeStart;
+    uint64_t computeEnd;
+    uint64_t replied;         // воркер: ответ уходит в канал
+};
+#pragma pack(pop)
+
+// Отметки не входят в MAX_DATA_SIZE: задача предельного размера
+// остаётся допустимой и с трассировкой
+inline uint32_t MaxTaskDataSize(uint32_t flags) {
+    return (uint32_t)MAX_DATA_SIZE + ((flags & TASK_FLAG_TRACE) ? (uint32_t)sizeof(TraceStamps) : 0);
+}
+
+// Первый кадр воркера после подключения: готовность и возможности
+constexpr uint32_t WORKER_HELLO_MAGIC = 0x4F4C4548; // "HELO"
+constexpr uint32_t PROTOCOL_VERSION = 3;
+
+// Возможности воркера
+constexpr uint32_t WORKER_CAP_SHM_RING = 1u << 0;   // кольцо разделяемой памяти открыто
+constexpr uint32_t WORKER_CAP_BATCH = 1u << 1;      // понимает TASK_BATCH
+constexpr uint32_t WORKER_CAP_MULTI_PATTERN = 1u << 2; // TASK_FLAG_MULTI_PATTERN
+constexpr uint32_t WORKER_CAP_STREAM_CHUNK = 1u << 3;  // TASK_FLAG_STREAM_CHUNK
+constexpr uint32_t WORKER_CAP_RLE = 1u << 4;           // TASK_FLAG_RLE
+constexpr uint32_t WORKER_CAP_TRACE = 1u << 5;         // TASK_FLAG_TRACE
+
+#pragma pack(push, 1)
+struct WorkerHello {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t workerId;
+    uint32_t processId;
+    uint32_t capabilities;  // WORKER_CAP_*
+    uint32_t maxDataSize;
+    uint64_t taskTypes;     // бит на каждый поддерживаемый MessageType
+    uint32_t computeThreads; // задач, выполняемых одновременно
+};
+#pragma pack(pop)
+
+inline uint64_t TaskTypeBit(MessageType type) {
+    uint32_t value = (uint32_t)type;
+    return value < 64 ? (1ull << value) : 0;
+}
+
+// Фрагмент потока (TASK_FLAG_STREAM_CHUNK): data как у TASK_SUBSTRING, текст -
+// ядро фрагмента и ещё patternLen-1 байт следующего. Результат: uint32_t
+// число записей, затем записи. Запись d - ответ для случая, когда последнее
+// вхождение предыдущего фрагмента заходит в ядро на d байт
+#pragma pack(push, 1)
+struct ChunkEntry {
+    uint32_t count;
+    uint32_t spill;   // на сколько байт последнее вхождение заходит в следующий фрагмент
+};
+#pragma pack(pop)
+
+// TASK_SEPIA, TASK_INVERT: extraParam = формат | шаг строки << 8,
+// data: ImageTile, затем rows строк по stride байт. Результат в том же
+// виде; для нагрузки из кольца - RESULT_FLAG_IN_PLACE без данных
+enum class PixelFormat : uint32_t {
+    RGB24 = 3,    // байты R, G, B
+    RGBA32 = 4    // R, G, B, A; альфа не меняется
+};
+
+#pragma pack(push, 1)
+struct ImageTile {
+    uint32_t width;   // пикселей в строке
+    uint32_t rows;
+};
+#pragma pack(pop)
+
+constexpr uint32_t MAX_IMAGE_STRIDE = 0xFFFFFF;
+
+inline uint32_t MakeImageParam(PixelFormat format, uint32_t stride) {
+    return (uint32_t)format | (stride << 8);
+}
+
+inline PixelFormat ImageParamFormat(uint32_t extraParam) {
+    return (PixelFormat)(extraParam & 0xFF);
+}
+
+inline uint32_t ImageParamStride(uint32_t extraParam) {
+    return extraParam >> 8;
+}
+
+// TASK_SORT: extraParam = тип ключа, data: ключи подряд. Результат - те же
+// ключи по возрастанию; для нагрузки из кольца - RESULT_FLAG_IN_PLACE без данных
+enum class SortKey : uint32_t {
+    UINT32 = 0,
+    INT32 = 1,
+    FLOAT32 = 2,
+    UINT64 = 3,
+    INT64 = 4,
+    FLOAT64 = 5
+};
+
+inline size_t SortKeySize(SortKey type) {
+    switch (type) {
+    case SortKey::UINT32:
+    case SortKey::INT32:
+    case SortKey::FLOAT32:
+        return 4;
+    case SortKey::UINT64:
+    case SortKey::INT64:
+    case SortKey::FLOAT64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+// TASK_CRC32: extraParam = вид CRC, data: байты. Результат: uint32_t CRC
+// как у crc32() из zlib - начальное значение 0, ответ уже инвертирован,
+// поэтому CRC частей склеиваются через Crc32Combine
+enum class CrcKind : uint32_t {
+    CRC32 = 0,    // IEEE 802.3, zlib, PNG
+    CRC32C = 1    // Castagnoli, iSCSI, ext4
+};
+
+// TASK_PRIMES: extraParam = режим, data: PrimeRange. Результат для COUNT -
+// uint64_t число простых в [lo, hi); для LIST - PrimeListHeader и разности
+// соседних простых в LEB128: (p[i] - p[i-1]) / 2, для пары 2, 3 - ноль
+enum class PrimeMode : uint32_t {
+    COUNT = 0,
+    LIST = 1
+};
+
+#pragma pack(push, 1)
+struct PrimeRange {
+    uint64_t lo;
+    uint64_t hi;
+};
+
+struct PrimeListHeader {
+    uint64_t count;
+    uint64_t first;   // 0, если простых нет
+    uint64_t last;
+};
+#pragma pack(pop)
+
+constexpr uint64_t PRIME_MAX_VALUE = 1ull << 50;       // базовые простые до 2^25
+constexpr uint64_t PRIME_LIST_MAX_SPAN = 1ull << 24;   // список одной задачи не больше ~1 МБ
+
+// TASK_MATRIX_MULT: extraParam = операция, data: MatrixHeader, затем
+// элементы по строкам. LOAD_B - строки [firstRow, firstRow + rows) матрицы
+// B размером inner x cols, воркер хранит её упакованной под handle;
+// результат - uint32_t число загруженных строк. MULTIPLY - блок A
+// rows x inner; результат - блок C = A x B размером rows x cols.
+// RELEASE - только заголовок; результат - uint32_t 1, если B была в кэше
+enum class MatrixOp : uint32_t {
+    LOAD_B = 0,
+    MULTIPLY = 1,
+    RELEASE = 2
+};
+
+enum class MatrixType : uint32_t {
+    FLOAT32 = 0,
+    FLOAT64 = 1
+};
+
+#pragma pack(push, 1)
+struct MatrixHeader {
+    uint32_t handle;     // B в кэше воркера
+    uint32_t type;       // MatrixType
+    uint32_t rows;       // строк в data
+    uint32_t inner;      // столбцов A, строк B
+    uint32_t cols;       // столбцов B и C
+    uint32_t firstRow;   // LOAD_B: номер первой строки B в data
+};
+#pragma pack(pop)
+
+inline size_t MatrixTypeSize(MatrixType type) {
+    return type == MatrixType::FLOAT64 ? sizeof(double) : sizeof(float);
+}
+
+// TASK_FOURIER: extraParam = режим, data: FourierHeader, затем count
+// преобразований длины size подряд. Комплексный отсчёт - пара float
+// (re, im). FORWARD, INVERSE: size комплексных в size комплексных;
+// REAL_FORWARD: size вещественных в size / 2 + 1 комплексных, REAL_INVERSE -
+// обратно. Прямые без нормировки, обратные делят на size. Результат - тот же
+// FourierHeader и count результатов подряд
+enum class FourierMode : uint32_t {
+    FORWARD = 0,
+    INVERSE = 1,
+    REAL_FORWARD = 2,
+    REAL_INVERSE = 3
+};
+
+#pragma pack(push, 1)
+struct FourierHeader {
+    uint32_t size;    // степень двойки; для вещественных не меньше 2
+    uint32_t count;
+};
+#pragma pack(pop)
+
+constexpr uint32_t FOURIER_MAX_SIZE = 1u << 16;
+
+enum class SampleType : uint32_t {
+    UINT8 = 0,
+    FLOAT32 = 1,
+    FLOAT64 = 2
+};
+
+inline size_t SampleTypeSize(SampleType type) {
+    return type == SampleType::FLOAT64 ? sizeof(double) : type == SampleType::FLOAT32 ? sizeof(float) : 1;
+}
+
+// TASK_STATS: extraParam = SampleType, data: значения подряд. Результат -
+// StatsPartial; частичные результаты сливаются формулой Чана (MergeStats)
+#pragma pack(push, 1)
+struct StatsPartial {
+    uint64_t count;
+    double mean;
+    double m2;      // сумма квадратов отклонений от mean
+    double min;
+    double max;
+};
+#pragma pack(pop)
+
+// TASK_HISTOGRAM: extraParam = SampleType, data: HistogramSpec, затем
+// значения. UINT8 - 256 корзин по значению байта, lo и hi не используются;
+// для остальных - bins равных корзин на [lo, hi). Результат: uint64_t на
+// корзину, затем число значений ниже lo и не ниже hi (NaN - туда же).
+// Частичные гистограммы складываются
+#pragma pack(push, 1)
+struct HistogramSpec {
+    uint32_t bins;
+    double lo;
+    double hi;
+};
+#pragma pack(pop)
+
+constexpr uint32_t HISTOGRAM_MAX_BINS = 1u << 16;
+
+// TASK_RLE: extraParam = операция. ENCODE: data - байты, результат - кадр
+// RLE. DECODE: data - кадр RLE, результат - исходные байты. Тот же кадр
+// передаётся вместо полезной нагрузки с TASK_FLAG_RLE и вместо ответа с
+// RESULT_FLAG_RLE. После RleHeader идут токены: 0x00..0x7F - c + 1 байт
+// как есть; 0x80..0xFE - байт, повторённый c - 0x80 + 3 раз; 0xFF - LEB128
+// (длина - 130), затем байт. Распакованная полезная нагрузка и результат
+// DECODE - не больше MAX_DATA_SIZE
+enum class RleOp : uint32_t {
+    ENCODE = 0,
+    DECODE = 1
+};
+
+#pragma pack(push, 1)
+struct RleHeader {
+    uint32_t rawSize;
+    uint32_t encodedSize;   // байт токенов после заголовка
+};
+#pragma pack(pop)
+
+// TASK_GRAPH_PATH: extraParam = операция. LOAD - data: GraphHeader, затем
+// uint32_t степени вершин [firstVertex, firstVertex + count), их дуги
+// (uint32_t концы) и, если граф взвешен, uint32_t веса дуг. Воркер
+// собирает CSR под handle; результат - uint32_t число загруженных вершин.
+// PATH - data: GraphQueryHeader, затем count пар GraphQuery; результат -
+// GraphPath на каждый запрос, с GRAPH_QUERY_WITH_PATH за ним hops + 1
+// вершин пути от source до target. RELEASE - только GraphHeader;
+// результат - uint32_t 1, если граф был в кэше
+enum class GraphOp : uint32_t {
+    LOAD = 0,
+    PATH = 1,
+    RELEASE = 2
+};
+
+#pragma pack(push, 1)
+struct GraphHeader {
+    uint32_t handle;        // граф в кэше воркера
+    uint32_t vertices;      // всего вершин
+    uint32_t edges;         // всего дуг
+    uint32_t weighted;      // 1 - у дуг есть веса
+    uint32_t firstVertex;   // LOAD: первая вершина куска
+    uint32_t count;         // LOAD: вершин в куске
+    uint32_t pieceEdges;    // LOAD: дуг в куске
+};
+
+struct GraphQueryHeader {
+    uint32_t handle;
+    uint32_t count;         // запросов
+    uint32_t flags;         // GRAPH_QUERY_*
+};
+
+struct GraphQuery {
+    uint32_t source;
+    uint32_t target;
+};
+
+struct GraphPath {
+    uint64_t distance;      // сумма весов или число дуг; GRAPH_UNREACHABLE - пути нет
+    uint32_t hops;          // дуг в пути
+};
+#pragma pack(pop)
+
+constexpr uint32_t GRAPH_QUERY_WITH_PATH = 1u << 0;
+constexpr uint64_t GRAPH_UNREACHABLE = ~0ull;
+
+// TASK_FACTORIAL: extraParam = FactorialFormat, data: FactorialRange.
+// Произведение целых из [lo, hi), 1 <= lo <= hi <= FACTORIAL_MAX_N + 1.
+// LIMBS - FactorialResult, затем limbs uint32_t от младшего без старших
+// нулей: значение = limbs * 2^shift. DECIMAL - десятичная запись ASCII
+enum class FactorialFormat : uint32_t {
+    LIMBS = 0,
+    DECIMAL = 1
+};
+
+#pragma pack(push, 1)
+struct FactorialRange {
+    uint64_t lo;
+    uint64_t hi;
+};
+
+struct FactorialResult {
+    uint64_t shift;     // степень двойки, вынесенная из произведения
+    uint32_t limbs;
+};
+#pragma pack(pop)
+
+constexpr uint64_t FACTORIAL_MAX_N = 1ull << 24;
+
+// TASK_XOR: extraParam = длина ключа, 0 - поток ключа от счётчика (XorCounter
+// с seed). data: XorHeader, ключ, затем байты; байт i - позиция position + i
+// потока. Результат - байты после XOR; нагрузка из кольца меняется на месте
+// (RESULT_FLAG_IN_PLACE). XOR_FLAG_SHARED - байтов в data нет, это
+// [offset, offset + size) общего буфера buffer, воркер меняет их на месте;
+// результат - uint64_t size. XOR_FLAG_UNMAP - только заголовок, воркер
+// закрывает отображение buffer; результат - uint32_t 1, если оно было
+#pragma pack(push, 1)
+struct XorHeader {
+    uint64_t position;
+    uint64_t seed;
+    uint32_t flags;     // XOR_FLAG_*
+    uint32_t buffer;    // общий буфер
+    uint64_t offset;
+    uint64_t size;
+};
+#pragma pack(pop)
+
+constexpr uint32_t XOR_FLAG_SHARED = 1u << 0;
+constexpr uint32_t XOR_FLAG_UNMAP = 1u << 1;
+constexpr uint32_t XOR_MAX_KEY_LENGTH = 256 * 1024;
+
+// Байт на одно преобразование
+inline size_t FourierInputSize(FourierMode mode, uint32_t size) {
+    switch (mode) {
+    case FourierMode::REAL_FORWARD:
+        return (size_t)size * sizeof(float);
+    case FourierMode::REAL_INVERSE:
+        return ((size_t)size / 2 + 1) * 2 * sizeof(float);
+    default:
+        return (size_t)size * 2 * sizeof(float);
+    }
+}
+
+inline size_t FourierOutputSize(FourierMode mode, uint32_t size) {
+    switch (mode) {
+    case FourierMode::REAL_FORWARD:
+        return ((size_t)size / 2 + 1) * 2 * sizeof(float);
+    case FourierMode::REAL_INVERSE:
+        return (size_t)size * sizeof(float);
+    default:
+        return (size_t)size * 2 * sizeof(float);
+    }
+}
+
+// Размеры заголовков на проводе (без гибкого массива)
+constexpr uint32_t TASK_HEADER_SIZE = offsetof(TaskMessage, data);
+constexpr uint32_t RESULT_HEADER_SIZE = offsetof(ResultMessage, data);
+
+// Вспомогательные функции
+inline TaskMessage MakeTaskHeader(MessageType type, uint32_t taskId,
+    uint32_t dataSize, uint32_t extraParam = 0) {
+    TaskMessage header;
+    header.type = type;
+    header.taskId = taskId;
+    header.dataSize = dataSize;
+    header.extraParam = extraParam;
+    header.flags = 0;
+    return header;
+}
+
+inline ResultMessage MakeResultHeader(uint32_t taskId, uint32_t resultSize, uint32_t flags = 0) {
+    ResultMessage header;
+    header.taskId = taskId;
+    header.resultSize = resultSize;
+    header.flags = flags;
+    return header;
+}
+
+// TASK_SUBSTRING с TASK_FLAG_MULTI_PATTERN, extraParam = число образцов.
+// data: текст, образцы подряд, затем uint32_t длины образцов.
+// Результат: uint32_t число вхождений на каждый образец
+inline void AppendMultiPatternPayload(MessageBuffer& out, const std::string& text,
+    const std::vector<std::string>& patterns) {
+    out.Append(text.data(), text.size());
+    for (const std::string& pattern : patterns) {
+        out.Append(pattern.data(), pattern.size());
+    }
+    for (const std::string& pattern : patterns) {
+        uint32_t length = (uint32_t)pattern.size();
+        out.Append(&length, sizeof(length));
+    }
+}
+
+// Имена каналов, сокетов и разделяемой памяти содержат instance - PID
+// Browser, который передаёт его воркерам в командной строке: два Browser
+// не делят имён
+inline std::string GetInputPipeName(uint32_t instance, int workerId) {
+    return std::string("\\\\.\\pipe\\worker_in_") + std::to_string(instance) + "_" + std::to_string(workerId);
+}
+
+inline std::string GetOutputPipeName(uint32_t instance, int workerId) {
+    return std::string("\\\\.\\pipe\\worker_out_") + std::to_string(instance) + "_" + std::to_string(workerId);
+}
+
+inline std::string GetSocketPath(uint32_t instance, int workerId) {
+    return std::string("/tmp/namedpipes_") + std::to_string(instance) + "_worker_" + std::to_string(workerId) + ".sock";
+}
+
+inline std::string GetRingName(uint32_t instance, int workerId) {
+#ifdef _WIN32
+    return std::string("Local\\WorkerRing_") + std::to_string(instance) + "_" + std::to_string(workerId);
+#else
+    return std::string("/namedpipes_") + std::to_string(instance) + "_ring_" + std::to_string(workerId);
+#endif
+}
+
+// Общий буфер Browser и воркеров с номером id
+inline std::string GetSharedBufferName(uint32_t instance, uint32_t id) {
+#ifdef _WIN32
+    return std::string("Local\\SharedBuffer_") + std::to_string(instance) + "_" + std::to_string(id);
+#else
+    return std::string("/namedpipes_") + std::to_string(instance) + "_buffer_" + std::to_string(id);
+#endif
+}
+
+inline std::string GetMutexName(int workerId) {
+    return std::string("Global\\WorkerMutex_") + std::to_string(workerId);
+}
+
+inline std::string GetEventName(int workerId) {
+    return std::string("Global\\WorkerEvent_") + std::to_string(workerId);
+}
@@ -0,0 +1,222 @@
+#include "ResultCache.h"
+#include <cstring>
+
+constexpr uint64_t XXH_PRIME1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t XXH_PRIME2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t XXH_PRIME3 = 0x165667B19E3779F9ull;
+constexpr uint64_t XXH_PRIME4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t XXH_PRIME5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t Rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t Read64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t Read32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t XxhRound(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME2;
+    return Rotl64(acc, 31) * XXH_PRIME1;
+}
+
+static inline uint64_t XxhMerge(uint64_t acc, uint64_t lane) {
+    acc ^= XxhRound(0, lane);
+    return acc * XXH_PRIME1 + XXH_PRIME4;
+}
+
+// Четыре независимых накопителя по 8 байт: умножения цепочек перекрываются
+uint64_t HashPayload(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + XXH_PRIME1 + XXH_PRIME2;
+        uint64_t v2 = seed + XXH_PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = XxhRound(v1, Read64(p));
+            v2 = XxhRound(v2, Read64(p + 8));
+            v3 = XxhRound(v3, Read64(p + 16));
+            v4 = XxhRound(v4, Read64(p + 24));
+        }
+        h = Rotl64(v1, 1) + Rotl64(v2, 7) + Rotl64(v3, 12) + Rotl64(v4, 18);
+        h = XxhMerge(h, v1);
+        h = XxhMerge(h, v2);
+        h = XxhMerge(h, v3);
+        h = XxhMerge(h, v4);
+    }
+    else {
+        h = seed + XXH_PRIME5;
+    }
+    h += (uint64_t)size;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= XxhRound(0, Read64(p));
+        h = Rotl64(h, 27) * XXH_PRIME1 + XXH_PRIME4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)Read32(p) * XXH_PRIME1;
+        h = Rotl64(h, 23) * XXH_PRIME2 + XXH_PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * XXH_PRIME5;
+        h = Rotl64(h, 11) * XXH_PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME2;
+    h ^= h >> 29;
+    h *= XXH_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+bool ResultKey::operator<(const ResultKey& other) const {
+    if (hash != other.hash) {
+        return hash < other.hash;
+    }
+    if (size != other.size) {
+        return size < other.size;
+    }
+    if (type != other.type) {
+        return type < other.type;
+    }
+    if (extraParam != other.extraParam) {
+        return extraParam < other.extraParam;
+    }
+    return flags < other.flags;
+}
+
+ResultKey MakeResultKey(const TaskMessage& header, const MessageBuffer& payload) {
+    ResultKey key;
+    key.type = header.type;
+    key.extraParam = header.extraParam;
+    key.flags = header.flags;
+    key.size = (uint32_t)payload.Size();
+    key.hash = HashPayload(payload.Data(), payload.Size());
+    return key;
+}
+
+static bool SamePayload(const MessageBuffer& a, const MessageBuffer& b) {
+    return a.Size() == b.Size() && (a.Size() == 0 || memcmp(a.Data(), b.Data(), a.Size()) == 0);
+}
+
+ResultCache::ResultCache(size_t maxBytes) : capacity(maxBytes) {}
+
+void ResultCache::SetCapacity(size_t maxBytes) {
+    capacity = maxBytes;
+    while (!entries.empty() && stats.bytes > capacity) {
+        Entry& victim = entries.back();
+        stats.bytes -= victim.request.Size() + victim.data.Size() + RESULT_CACHE_ENTRY_OVERHEAD;
+        stats.entries--;
+        stats.evictions++;
+        index.erase(victim.key);
+        entries.pop_back();
+    }
+}
+
+CacheOutcome ResultCache::Begin(const ResultKey& key, const MessageBuffer& request, uint32_t taskId,
+    MessageBuffer& data, uint32_t& flags) {
+    auto cached = index.find(key);
+    if (cached != index.end() && SamePayload(cached->second->request, request)) {
+        // В голову списка: вытесняется последним
+        entries.splice(entries.begin(), entries, cached->second);
+        const Entry& entry = *cached->second;
+        data.Clear();
+        data.Append(entry.data.Data(), entry.data.Size());
+        flags = entry.flags;
+        stats.hits++;
+        return CacheOutcome::HIT;
+    }
+
+    auto leader = pendingByKey.find(key);
+    if (leader != pendingByKey.end()) {
+        Pending& running = pending[leader->second];
+        if (SamePayload(running.request, request)) {
+            running.followers.push_back(taskId);
+            stats.joined++;
+            return CacheOutcome::JOINED;
+        }
+        // Коллизия хеша с задачей в полёте: ключ занят ею
+        stats.misses++;
+        return CacheOutcome::MISS;
+    }
+
+    Pending& entry = pending[taskId];
+    entry.key = key;
+    entry.request.Clear();
+    entry.request.Append(request.Data(), request.Size());
+    entry.followers.clear();
+    pendingByKey[key] = taskId;
+    stats.misses++;
+    return CacheOutcome::MISS;
+}
+
+void ResultCache::Abandon(uint32_t taskId) {
+    auto it = pending.find(taskId);
+    if (it == pending.end()) {
+        return;
+    }
+    pendingByKey.erase(it->second.key);
+    pending.erase(it);
+    stats.misses--;
+}
+
+void ResultCache::Store(const ResultKey& key, const MessageBuffer& request, const MessageBuffer& data,
+    uint32_t flags) {
+    size_t cost = request.Size() + data.Size() + RESULT_CACHE_ENTRY_OVERHEAD;
+    // Запись на четверть кэша вытеснила бы слишком много соседей; при
+    // коллизии хеша остаётся прежняя
+    if (cost > capacity / 4 || index.count(key)) {
+        return;
+    }
+
+    entries.emplace_front();
+    Entry& entry = entries.front();
+    entry.key = key;
+    entry.request.Append(request.Data(), request.Size());
+    entry.flags = flags;
+    entry.data.Append(data.Data(), data.Size());
+    index[key] = entries.begin();
+    stats.entries++;
+    stats.bytes += cost;
+
+    SetCapacity(capacity);
+}
+
+bool ResultCache::Complete(uint32_t taskId, bool ok, const MessageBuffer& data, uint32_t flags,
+    std::vector<uint32_t>& followers) {
+    auto it = pending.find(taskId);
+    if (it == pending.end()) {
+        return false;
+    }
+
+    followers = std::move(it->second.followers);
+    if (ok && capacity > 0) {
+        Store(it->second.key, it->second.request, data, flags);
+    }
+    pendingByKey.erase(it->second.key);
+    pending.erase(it);
+    return true;
+}
+
+void ResultCache::Clear() {
+    entries.clear();
+    index.clear();
+    pending.clear();
+    pendingByKey.clear();
+    stats.entries = 0;
+    stats.bytes = 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+#include "BufferPool.h"
+
+constexpr size_t RESULT_CACHE_BYTES = 16 * 1024 * 1024;
+constexpr size_t RESULT_CACHE_ENTRY_OVERHEAD = 128;  // ключ, узлы списка и карты; без копии нагрузки
+
+// 64-битный xxHash
+uint64_t HashPayload(const void* data, size_t size, uint64_t seed = 0);
+
+// Всё, от чего зависит ответ воркера: тип, параметры и содержимое
+// нагрузки. Нагрузка представлена длиной и хешем; при совпадении ключей
+// кэш сравнивает и сами байты, так что коллизия хеша - только промах
+struct ResultKey {
+    MessageType type;
+    uint32_t extraParam;
+    uint32_t flags;
+    uint32_t size;
+    uint64_t hash;
+
+    bool operator<(const ResultKey& other) const;
+};
+
+ResultKey MakeResultKey(const TaskMessage& header, const MessageBuffer& payload);
+
+struct ResultCacheStats {
+    uint64_t hits = 0;       // ответ отдан из кэша
+    uint64_t misses = 0;     // задача ушла воркеру
+    uint64_t joined = 0;     // дождалась такой же задачи в полёте
+    uint64_t evictions = 0;
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+};
+
+enum class CacheOutcome {
+    HIT,      // ответ уже в data и flags
+    JOINED,   // ответ придёт вместе с ответом такой же задачи в полёте
+    MISS      // задачу надо выполнить; она ведущая для следующих таких же
+};
+
+// Кэш ответов с вытеснением давно не использованных по суммарному
+// объёму. Совпадающие задачи в полёте выполняются один раз: первая
+// ведущая, остальные ждут её ответа
+class ResultCache {
+private:
+    struct Entry {
+        ResultKey key;
+        MessageBuffer request;    // нагрузка задачи
+        uint32_t flags;
+        MessageBuffer data;
+    };
+    std::list<Entry> entries;   // от недавних к давним
+    std::map<ResultKey, std::list<Entry>::iterator> index;
+
+    struct Pending {
+        ResultKey key;
+        MessageBuffer request;
+        std::vector<uint32_t> followers;
+    };
+    std::map<uint32_t, Pending> pending;       // по taskId ведущей
+    std::map<ResultKey, uint32_t> pendingByKey;
+
+    size_t capacity;
+    ResultCacheStats stats;
+
+    void Store(const ResultKey& key, const MessageBuffer& request, const MessageBuffer& data, uint32_t flags);
+
+public:
+    explicit ResultCache(size_t maxBytes = 0);
+
+    // 0 - кэш выключен; меньший объём вытесняет лишнее сразу
+    void SetCapacity(size_t maxBytes);
+    bool Enabled() const { return capacity > 0; }
+
+    // request - нагрузка, по которой построен key. Задача с тем же ключом,
+    // но другой нагрузкой выполняется без кэша: MISS, но не ведущая
+    CacheOutcome Begin(const ResultKey& key, const MessageBuffer& request, uint32_t taskId,
+        MessageBuffer& data, uint32_t& flags);
+    // Ведущая не ушла воркеру; ждущих у неё быть ещё не может
+    void Abandon(uint32_t taskId);
+    // Ответ ведущей taskId: удачный сохраняется, в followers - taskId
+    // ждавших его задач. false - taskId не ведущая
+    bool Complete(uint32_t taskId, bool ok, const MessageBuffer& data, uint32_t flags,
+        std::vector<uint32_t>& followers);
+    void Clear();
+
+    const ResultCacheStats& Stats() const { return stats; }
+};
@@ -0,0 +1,261 @@
+#include "Rle.h"
+#include <cstring>
+
+constexpr size_t RLE_MAX_LITERAL = 128;
+constexpr size_t RLE_MAX_SHORT_RUN = 129;    // длиннее - с продолжением LEB128
+constexpr uint8_t RLE_RUN = 0x80;
+constexpr uint8_t RLE_LONG_RUN = 0xFF;
+
+static size_t NextRunScalar(const uint8_t* p, size_t i, size_t n) {
+    for (; i + 2 < n; i++) {
+        if (p[i] == p[i + 1] && p[i] == p[i + 2]) {
+            return i;
+        }
+    }
+    return n;
+}
+
+static size_t RunEndScalar(const uint8_t* p, size_t i, size_t n) {
+    uint8_t value = p[i];
+    while (i < n && p[i] == value) {
+        i++;
+    }
+    return i;
+}
+
+static size_t RunTokenSize(size_t length) {
+    if (length <= RLE_MAX_SHORT_RUN) {
+        return 2;
+    }
+    size_t size = 3;
+    for (size_t extra = (length - RLE_MAX_SHORT_RUN - 1) >> 7; extra > 0; extra >>= 7) {
+        size++;
+    }
+    return size;
+}
+
+// Общий ход кодирования; поиск серий - векторный или скалярный.
+// Литералы копируются memcpy, к каждому байту цикл не прикасается
+template <size_t (*NextRun)(const uint8_t*, size_t, size_t), size_t (*RunEnd)(const uint8_t*, size_t, size_t)>
+static bool Encode(const char* data, size_t size, MessageBuffer& out, size_t limit) {
+    size_t bound = RleMaxEncodedSize(size);
+    size_t capacity = bound < limit ? bound : limit;
+    if (size > UINT32_MAX || capacity < sizeof(RleHeader)) {
+        return false;
+    }
+
+    size_t start = out.Size();
+    out.Resize(start + capacity);
+    char* base = out.Data() + start;
+    char* w = base + sizeof(RleHeader);
+    char* end = base + capacity;
+    const uint8_t* p = (const uint8_t*)data;
+
+    size_t i = 0;
+    while (i < size) {
+        size_t run = NextRun(p, i, size);
+        while (i < run) {
+            size_t length = run - i < RLE_MAX_LITERAL ? run - i : RLE_MAX_LITERAL;
+            if ((size_t)(end - w) < length + 1) {
+                out.Resize(start);
+                return false;
+            }
+            *w++ = (char)(length - 1);
+            memcpy(w, p + i, length);
+            w += length;
+            i += length;
+        }
+        if (run == size) {
+            break;
+        }
+
+        size_t runEnd = RunEnd(p, run, size);
+        size_t length = runEnd - run;
+        if ((size_t)(end - w) < RunTokenSize(length)) {
+            out.Resize(start);
+            return false;
+        }
+        if (length <= RLE_MAX_SHORT_RUN) {
+            *w++ = (char)(RLE_RUN + length - RLE_MIN_RUN);
+        }
+        else {
+            *w++ = (char)RLE_LONG_RUN;
+            size_t extra = length - RLE_MAX_SHORT_RUN - 1;
+            do {
+                uint8_t group = (uint8_t)(extra & 0x7F);
+                extra >>= 7;
+                *w++ = (char)(group | (extra > 0 ? 0x80 : 0));
+            } while (extra > 0);
+        }
+        *w++ = (char)p[run];
+        i = runEnd;
+    }
+
+    RleHeader header;
+    header.rawSize = (uint32_t)size;
+    header.encodedSize = (uint32_t)(w - base - sizeof(header));
+    memcpy(base, &header, sizeof(header));
+    out.Resize(start + (w - base));
+    return true;
+}
+
+bool RleEncodeScalar(const char* data, size_t size, MessageBuffer& out, size_t limit) {
+    return Encode<NextRunScalar, RunEndScalar>(data, size, out, limit);
+}
+
+#ifdef SIMD_X86
+
+static inline int LowestBit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Начало серии из трёх одинаковых байтов: сравнение со сдвигами на 1 и 2
+static TARGET_AVX2 size_t NextRunAvx2(const uint8_t* p, size_t i, size_t n) {
+    for (; i + 34 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(p + i + 1));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(p + i + 2));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, b), _mm256_cmpeq_epi8(a, c)));
+        if (mask != 0) {
+            return i + LowestBit(mask);
+        }
+    }
+    return NextRunScalar(p, i, n);
+}
+
+static TARGET_AVX2 size_t RunEndAvx2(const uint8_t* p, size_t i, size_t n) {
+    uint8_t first = p[i];
+    __m256i value = _mm256_set1_epi8((char)first);
+    for (; i + 32 <= n; i += 32) {
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i)), value));
+        if (mask != 0) {
+            return i + LowestBit(mask);
+        }
+    }
+    while (i < n && p[i] == first) {
+        i++;
+    }
+    return i;
+}
+
+bool RleEncodeAvx2(const char* data, size_t size, MessageBuffer& out, size_t limit) {
+    return Encode<NextRunAvx2, RunEndAvx2>(data, size, out, limit);
+}
+
+#else
+
+bool RleEncodeAvx2(const char* data, size_t size, MessageBuffer& out, size_t limit) {
+    return RleEncodeScalar(data, size, out, limit);
+}
+
+#endif
+
+bool RleEncode(const char* data, size_t size, MessageBuffer& out, size_t limit) {
+    static const bool avx2 = DetectSimdLevel() == SimdLevel::AVX2;
+    if (avx2) {
+        return RleEncodeAvx2(data, size, out, limit);
+    }
+    return RleEncodeScalar(data, size, out, limit);
+}
+
+// Серии - memset, литералы - memcpy: оба векторизованы библиотекой
+bool RleDecode(const char* frame, size_t frameSize, size_t maxSize, MessageBuffer& out) {
+    RleHeader header;
+    if (frameSize < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, frame, sizeof(header));
+    if (header.encodedSize != frameSize - sizeof(header) || header.rawSize > maxSize) {
+        return false;
+    }
+
+    size_t start = out.Size();
+    out.Resize(start + header.rawSize);
+    char* w = out.Data() + start;
+    char* wend = w + header.rawSize;
+    const uint8_t* in = (const uint8_t*)frame + sizeof(header);
+    const uint8_t* end = in + header.encodedSize;
+
+    while (in < end) {
+        uint8_t control = *in++;
+        if (control < RLE_RUN) {
+            size_t length = (size_t)control + 1;
+            if ((size_t)(end - in) < length || (size_t)(wend - w) < length) {
+                break;
+            }
+            memcpy(w, in, length);
+            w += length;
+            in += length;
+            continue;
+        }
+
+        uint64_t length = (uint64_t)control - RLE_RUN + RLE_MIN_RUN;
+        if (control == RLE_LONG_RUN) {
+            uint64_t extra = 0;
+            int shift = 0;
+            uint8_t group = 0x80;
+            while ((group & 0x80) && in < end && shift < 35) {
+                group = *in++;
+                extra |= (uint64_t)(group & 0x7F) << shift;
+                shift += 7;
+            }
+            if (group & 0x80) {
+                break;
+            }
+            length = extra + RLE_MAX_SHORT_RUN + 1;
+        }
+        if (in == end || (uint64_t)(wend - w) < length) {
+            break;
+        }
+        memset(w, *in++, (size_t)length);
+        w += length;
+    }
+
+    if (in != end || w != wend) {
+        out.Resize(start);
+        return false;
+    }
+    return true;
+}
+
+double EstimateRleRatio(const char* data, size_t size) {
+    if (size == 0) {
+        return 1.0;
+    }
+
+    // Окна равномерно по сообщению: маски и разреженные массивы редко
+    // меняют характер на коротком отрезке
+    size_t windows = RLE_SAMPLE_WINDOWS;
+    size_t window = RLE_SAMPLE_WINDOW;
+    if (size <= windows * window) {
+        windows = 1;
+        window = size;
+    }
+    size_t step = windows > 1 ? (size - window) / (windows - 1) : 0;
+
+    const uint8_t* p = (const uint8_t*)data;
+    size_t cost = 0;
+    for (size_t w = 0; w < windows; w++) {
+        const uint8_t* sample = p + w * step;
+        size_t i = 0;
+        while (i < window) {
+            size_t run = NextRunScalar(sample, i, window);
+            size_t literal = run - i;
+            cost += literal + (literal + RLE_MAX_LITERAL - 1) / RLE_MAX_LITERAL;
+            if (run == window) {
+                break;
+            }
+            i = RunEndScalar(sample, run, window);
+            cost += 2;
+        }
+    }
+    return (double)cost / (windows * window);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+#include "BufferPool.h"
+#include "Simd.h"
+
+constexpr size_t RLE_MIN_RUN = 3;             // короче - дешевле литералом
+constexpr size_t RLE_SAMPLE_WINDOW = 256;     // окно выборки для оценки сжатия
+constexpr size_t RLE_SAMPLE_WINDOWS = 8;
+constexpr size_t RLE_MIN_MESSAGE = 1024;      // меньшие сообщения не сжимаются
+constexpr double RLE_MAX_RATIO = 0.75;        // сжатие должно убрать хотя бы четверть
+
+// Худший случай: литералы по 128 байт с управляющим байтом
+inline size_t RleMaxEncodedSize(size_t size) {
+    return sizeof(RleHeader) + size + (size + 127) / 128;
+}
+
+// Дописывает кадр RLE (RleHeader и токены) в конец out. limit - наибольший
+// допустимый размер кадра: при превышении кодирование прерывается,
+// out возвращается к прежнему размеру и результат false
+bool RleEncode(const char* data, size_t size, MessageBuffer& out, size_t limit = SIZE_MAX);
+
+// Отдельные реализации (для бенчмарка); Avx2 вызывать только при AVX2
+bool RleEncodeScalar(const char* data, size_t size, MessageBuffer& out, size_t limit = SIZE_MAX);
+bool RleEncodeAvx2(const char* data, size_t size, MessageBuffer& out, size_t limit = SIZE_MAX);
+
+// Дописывает исходные байты кадра в конец out. false - кадр повреждён
+// или распаковывается больше чем в maxSize байт; out тогда не меняется
+bool RleDecode(const char* frame, size_t frameSize, size_t maxSize, MessageBuffer& out);
+
+// Размер кадра по выборке из RLE_SAMPLE_WINDOWS окон, в долях исходного
+double EstimateRleRatio(const char* data, size_t size);
+
+// Сжимать ли сообщение перед отправкой по каналу: дёшево, без кодирования
+inline bool RleWorthTrying(const char* data, size_t size) {
+    return size >= RLE_MIN_MESSAGE && EstimateRleRatio(data, size) <= RLE_MAX_RATIO;
+}
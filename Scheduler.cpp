@@ -0,0 +1,219 @@
+#include "Scheduler.h"
+
+// Накладные расходы одной задачи (кадр, системные вызовы) в единицах стоимости
+constexpr uint64_t TASK_OVERHEAD_COST = 256;
+
+Scheduler::Scheduler() : inFlightBudget(DEFAULT_IN_FLIGHT_BUDGET), pendingCount(0), stolenCount(0) {}
+
+void Scheduler::Configure(int numWorkers, uint64_t budget) {
+    inFlightBudget = budget;
+    // Очереди с задачами только перемещаются: вектор строится заново
+    workers = std::vector<WorkerQueue>(numWorkers);
+    for (WorkerQueue& worker : workers) {
+        worker.queuedCost = 0;
+        worker.inFlightCost = 0;
+        worker.taskTypes = ~0ull;
+        worker.parallelism = 1;
+        worker.alive = true;
+    }
+    pendingCount = 0;
+    stolenCount = 0;
+}
+
+void Scheduler::SetTaskTypes(int workerId, uint64_t taskTypes) {
+    workers[workerId].taskTypes = taskTypes;
+}
+
+void Scheduler::SetParallelism(int workerId, uint32_t threads) {
+    workers[workerId].parallelism = threads > 0 ? threads : 1;
+}
+
+uint64_t Scheduler::EstimateCost(MessageType type, uint32_t payloadSize) {
+    uint64_t weight;
+
+    switch (type) {
+    case MessageType::TASK_SUBSTRING:
+    case MessageType::TASK_CRC32:
+    case MessageType::TASK_XOR:
+    case MessageType::TASK_INVERT:
+    case MessageType::TASK_STATS:
+    case MessageType::TASK_HISTOGRAM:
+        weight = 1;
+        break;
+    case MessageType::TASK_RLE:
+    case MessageType::TASK_SEPIA:
+        weight = 4;
+        break;
+    case MessageType::TASK_SORT:
+    case MessageType::TASK_GRAPH_PATH:
+        weight = 8;
+        break;
+    case MessageType::TASK_FOURIER:
+        weight = 16;
+        break;
+    case MessageType::TASK_MATRIX_MULT:
+    case MessageType::TASK_PRIMES:
+    case MessageType::TASK_FACTORIAL:
+        weight = 64;
+        break;
+    default:
+        weight = 1;
+        break;
+    }
+
+    return TASK_OVERHEAD_COST + weight * payloadSize;
+}
+
+uint64_t Scheduler::OutstandingWork(int workerId) const {
+    const WorkerQueue& worker = workers[workerId];
+    return worker.queuedCost + worker.inFlightCost;
+}
+
+int Scheduler::LeastLoaded(MessageType type) const {
+    int best = -1;
+    uint64_t bestWork = 0;
+
+    for (int i = 0; i < (int)workers.size(); i++) {
+        if (!workers[i].alive || !(workers[i].taskTypes & TaskTypeBit(type))) {
+            continue;
+        }
+        // Работа на один вычислительный поток воркера
+        uint64_t work = OutstandingWork(i) / workers[i].parallelism;
+        if (best == -1 || work < bestWork) {
+            best = i;
+            bestWork = work;
+        }
+    }
+
+    return best;
+}
+
+int Scheduler::MostBacklogged(int thief) const {
+    int best = -1;
+    uint64_t bestCost = 0;
+
+    for (int i = 0; i < (int)workers.size(); i++) {
+        if (i == thief || workers[i].queue.empty() || workers[i].queue.front().pinned) {
+            continue;
+        }
+        if (!(workers[thief].taskTypes & TaskTypeBit(workers[i].queue.front().header.type))) {
+            continue;
+        }
+        // Очередь мёртвого воркера уже перераспределена, здесь только живые
+        if (workers[i].queuedCost > bestCost) {
+            best = i;
+            bestCost = workers[i].queuedCost;
+        }
+    }
+
+    return best;
+}
+
+int Scheduler::Enqueue(ScheduledTask task) {
+    int workerId = LeastLoaded(task.header.type);
+    if (workerId == -1) {
+        return -1;
+    }
+
+    if (task.cost == 0) {
+        task.cost = EstimateCost(task.header.type, task.header.dataSize);
+    }
+
+    WorkerQueue& worker = workers[workerId];
+    worker.queuedCost += task.cost;
+    worker.queue.push_back(std::move(task));
+    pendingCount++;
+    return workerId;
+}
+
+int Scheduler::EnqueueTo(int workerId, ScheduledTask task) {
+    WorkerQueue& worker = workers[workerId];
+    if (!worker.alive || !(worker.taskTypes & TaskTypeBit(task.header.type))) {
+        return -1;
+    }
+
+    if (task.cost == 0) {
+        task.cost = EstimateCost(task.header.type, task.header.dataSize);
+    }
+
+    task.pinned = true;
+    worker.queuedCost += task.cost;
+    worker.queue.push_back(std::move(task));
+    pendingCount++;
+    return workerId;
+}
+
+bool Scheduler::NextFor(int workerId, ScheduledTask& task) {
+    WorkerQueue& worker = workers[workerId];
+    if (!worker.alive) {
+        return false;
+    }
+
+    // Воркер и так занят надолго: задачи в его окне ждали бы, лучше
+    // оставить их в очереди, откуда их заберёт освободившийся воркер
+    if (!worker.inFlight.empty() && worker.inFlightCost >= inFlightBudget * worker.parallelism) {
+        return false;
+    }
+
+    WorkerQueue* source = &worker;
+    if (worker.queue.empty()) {
+        // Своя очередь пуста: забираем самую старую задачу у самого загруженного
+        int victim = MostBacklogged(workerId);
+        if (victim == -1) {
+            return false;
+        }
+        source = &workers[victim];
+        stolenCount++;
+    }
+
+    task = std::move(source->queue.front());
+    source->queue.pop_front();
+    source->queuedCost -= task.cost;
+    pendingCount--;
+    return true;
+}
+
+void Scheduler::OnDispatched(int workerId, uint32_t taskId, uint64_t cost) {
+    WorkerQueue& worker = workers[workerId];
+    worker.inFlight.push_back(std::make_pair(taskId, cost));
+    worker.inFlightCost += cost;
+}
+
+void Scheduler::OnCompleted(int workerId, uint32_t taskId) {
+    WorkerQueue& worker = workers[workerId];
+
+    for (size_t i = 0; i < worker.inFlight.size(); i++) {
+        if (worker.inFlight[i].first == taskId) {
+            worker.inFlightCost -= worker.inFlight[i].second;
+            worker.inFlight[i] = worker.inFlight.back();
+            worker.inFlight.pop_back();
+            return;
+        }
+    }
+}
+
+void Scheduler::MarkDead(int workerId, std::vector<uint32_t>& lost) {
+    WorkerQueue& worker = workers[workerId];
+    if (!worker.alive) {
+        return;
+    }
+
+    worker.alive = false;
+    worker.inFlight.clear();
+    worker.inFlightCost = 0;
+
+    std::deque<ScheduledTask> orphans;
+    orphans.swap(worker.queue);
+    pendingCount -= orphans.size();
+    worker.queuedCost = 0;
+
+    // Закреплённые задачи тоже уходят другим и выполняются там заново;
+    // задачи, которые никто не примет, отправитель завершает ошибкой
+    for (ScheduledTask& task : orphans) {
+        uint32_t taskId = task.header.taskId;
+        task.pinned = false;
+        if (Enqueue(std::move(task)) == -1) {
+            lost.push_back(taskId);
+        }
+    }
+}
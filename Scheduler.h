@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <cstdint>
+
+#include "Protocol.h"
+
+// Задача в очереди планировщика
+struct ScheduledTask {
+    TaskMessage header;
+    MessageBuffer payload;
+    uint64_t cost;
+    std::chrono::steady_clock::time_point enqueued;
+    bool pinned = false;   // поставлена через EnqueueTo, не перекрадывается
+};
+
+constexpr uint64_t DEFAULT_IN_FLIGHT_BUDGET = 64 * 1024;
+
+// Планировщик: у каждого воркера своя очередь, задача ставится туда,
+// где меньше всего невыполненной работы, простаивающий воркер
+// забирает задачи у самого загруженного
+class Scheduler {
+private:
+    struct WorkerQueue {
+        std::deque<ScheduledTask> queue;
+        uint64_t queuedCost;
+        uint64_t inFlightCost;
+        std::vector<std::pair<uint32_t, uint64_t>> inFlight; // taskId, cost
+        uint64_t taskTypes;   // типы задач, заявленные воркером в WorkerHello
+        uint32_t parallelism; // задач, выполняемых воркером одновременно
+        bool alive;
+    };
+
+    std::vector<WorkerQueue> workers;
+    uint64_t inFlightBudget;   // сколько работы держать в окне воркера
+    size_t pendingCount;
+    uint64_t stolenCount;
+
+    int LeastLoaded(MessageType type) const;
+    int MostBacklogged(int thief) const;
+
+public:
+    Scheduler();
+
+    void Configure(int numWorkers, uint64_t budget = DEFAULT_IN_FLIGHT_BUDGET);
+
+    void SetTaskTypes(int workerId, uint64_t taskTypes);
+    // Окно и доля нагрузки воркера растут с числом его вычислительных потоков
+    void SetParallelism(int workerId, uint32_t threads);
+
+    // Оценка стоимости: размер полезной нагрузки x вес типа задачи
+    static uint64_t EstimateCost(MessageType type, uint32_t payloadSize);
+
+    // Номер воркера или -1, если задачу некому выполнить
+    int Enqueue(ScheduledTask task);
+    // В очередь конкретного воркера: задача зависит от его состояния
+    // (например, от загруженной в него матрицы)
+    int EnqueueTo(int workerId, ScheduledTask task);
+    bool NextFor(int workerId, ScheduledTask& task);
+    void OnDispatched(int workerId, uint32_t taskId, uint64_t cost);
+    void OnCompleted(int workerId, uint32_t taskId);
+    // Очередь мёртвого воркера уходит живым; в lost - taskId задач, которые
+    // не принял никто
+    void MarkDead(int workerId, std::vector<uint32_t>& lost);
+
+    uint64_t OutstandingWork(int workerId) const;
+    size_t Pending() const { return pendingCount; }
+    uint64_t Stolen() const { return stolenCount; }
+};
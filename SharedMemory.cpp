@@ -0,0 +1,305 @@
+#include "SharedMemory.h"
+#include <iostream>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+constexpr uint64_t SHM_ALIGNMENT = 64;
+constexpr uint64_t SHM_DATA_OFFSET = 64;
+
+SharedRegion::SharedRegion() : base(nullptr), size(0), owner(false) {
+#ifdef _WIN32
+    hMapping = NULL;
+#endif
+}
+
+SharedRegion::~SharedRegion() {
+    Close();
+}
+
+#ifdef _WIN32
+
+bool SharedRegion::Create(const std::string& regionName, size_t regionSize) {
+    name = regionName;
+    hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+        (DWORD)((uint64_t)regionSize >> 32), (DWORD)regionSize, name.c_str());
+    if (hMapping == NULL) {
+        std::cerr << "Failed to create shared memory " << name
+            << ". Error: " << GetLastError() << std::endl;
+        return false;
+    }
+    // Существующая область принадлежит другому процессу: не подключаемся к ней
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        std::cerr << "Shared memory " << name << " already exists" << std::endl;
+        CloseHandle(hMapping);
+        hMapping = NULL;
+        return false;
+    }
+
+    base = MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, regionSize);
+    if (!base) {
+        std::cerr << "Failed to map shared memory " << name
+            << ". Error: " << GetLastError() << std::endl;
+        Close();
+        return false;
+    }
+
+    size = regionSize;
+    owner = true;
+    return true;
+}
+
+bool SharedRegion::Open(const std::string& regionName) {
+    name = regionName;
+    hMapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+    if (hMapping == NULL) {
+        return false;
+    }
+
+    base = MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!base) {
+        Close();
+        return false;
+    }
+
+    // Размер отображения, а не заголовка кольца: область может быть и общим буфером
+    MEMORY_BASIC_INFORMATION info;
+    if (VirtualQuery(base, &info, sizeof(info)) == 0) {
+        Close();
+        return false;
+    }
+    size = (size_t)info.RegionSize;
+    owner = false;
+    return true;
+}
+
+void SharedRegion::Close() {
+    if (base) {
+        UnmapViewOfFile(base);
+        base = nullptr;
+    }
+    if (hMapping != NULL) {
+        CloseHandle(hMapping);
+        hMapping = NULL;
+    }
+    size = 0;
+}
+
+#else
+
+bool SharedRegion::Create(const std::string& regionName, size_t regionSize) {
+    name = regionName;
+
+    // EEXIST - имя занято другим процессом; чужая область не удаляется
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        std::cerr << "Failed to create shared memory " << name
+            << ". Error: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (ftruncate(fd, (off_t)regionSize) < 0) {
+        std::cerr << "Failed to size shared memory " << name
+            << ". Error: " << strerror(errno) << std::endl;
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    void* mapped = mmap(NULL, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory " << name
+            << ". Error: " << strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    base = mapped;
+    size = regionSize;
+    owner = true;
+    return true;
+}
+
+bool SharedRegion::Open(const std::string& regionName) {
+    name = regionName;
+
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    base = mapped;
+    size = (size_t)st.st_size;
+    owner = false;
+    return true;
+}
+
+void SharedRegion::Close() {
+    if (base) {
+        munmap(base, size);
+        base = nullptr;
+    }
+    if (owner) {
+        shm_unlink(name.c_str());
+        owner = false;
+    }
+    size = 0;
+}
+
+#endif
+
+ShmRing::ShmRing() : data(nullptr), capacity(0), head(0), tail(0) {}
+
+bool ShmRing::Create(const std::string& name, size_t size) {
+    if (!region.Create(name, size)) {
+        return false;
+    }
+
+    ShmRingHeader* header = (ShmRingHeader*)region.Data();
+    header->magic = SHM_RING_MAGIC;
+    header->reserved = 0;
+    header->capacity = size - SHM_DATA_OFFSET;
+    header->dataOffset = SHM_DATA_OFFSET;
+
+    data = region.Data() + SHM_DATA_OFFSET;
+    capacity = header->capacity;
+    head = 0;
+    tail = 0;
+    allocations.clear();
+    return true;
+}
+
+void ShmRing::Close() {
+    region.Close();
+    data = nullptr;
+    capacity = 0;
+    allocations.clear();
+}
+
+char* ShmRing::Allocate(uint32_t taskId, uint32_t size, ShmDescriptor& descriptor) {
+    if (!data) {
+        return nullptr;
+    }
+
+    uint64_t aligned = (size + SHM_ALIGNMENT - 1) & ~(SHM_ALIGNMENT - 1);
+    uint64_t position = head % capacity;
+    uint64_t padding = 0;
+
+    // Полезная нагрузка всегда непрерывна: хвост кольца пропускаем
+    if (position + aligned > capacity) {
+        padding = capacity - position;
+        position = 0;
+    }
+
+    if (head + padding + aligned - tail > capacity) {
+        return nullptr;
+    }
+
+    head += padding + aligned;
+
+    descriptor.offset = position;
+    descriptor.size = size;
+
+    Allocation allocation;
+    allocation.taskId = taskId;
+    allocation.descriptor = descriptor;
+    allocation.end = head;
+    allocation.released = false;
+    allocations.push_back(allocation);
+
+    return data + position;
+}
+
+bool ShmRing::Lookup(uint32_t taskId, ShmDescriptor& descriptor) const {
+    for (const Allocation& allocation : allocations) {
+        if (allocation.taskId == taskId && !allocation.released) {
+            descriptor = allocation.descriptor;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ShmRing::Release(uint32_t taskId) {
+    for (Allocation& allocation : allocations) {
+        if (allocation.taskId == taskId && !allocation.released) {
+            allocation.released = true;
+            break;
+        }
+    }
+
+    while (!allocations.empty() && allocations.front().released) {
+        tail = allocations.front().end;
+        allocations.pop_front();
+    }
+}
+
+void ShmRing::ReleaseAll() {
+    allocations.clear();
+    tail = head;
+}
+
+ShmRingView::ShmRingView() : data(nullptr), capacity(0) {}
+
+bool ShmRingView::Open(const std::string& name) {
+    if (!region.Open(name)) {
+        return false;
+    }
+
+    const ShmRingHeader* header = (const ShmRingHeader*)region.Data();
+    if (region.Size() < sizeof(ShmRingHeader) || header->magic != SHM_RING_MAGIC ||
+        header->dataOffset + header->capacity > region.Size()) {
+        region.Close();
+        return false;
+    }
+
+    data = region.Data() + header->dataOffset;
+    capacity = header->capacity;
+    return true;
+}
+
+char* ShmRingView::Resolve(const ShmDescriptor& descriptor) const {
+    if (!data || descriptor.offset > capacity || descriptor.size > capacity - descriptor.offset) {
+        return nullptr;
+    }
+    return data + descriptor.offset;
+}
+
+std::shared_ptr<SharedRegion> SharedBufferMap::Get(uint32_t id) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto it = regions.find(id);
+    if (it != regions.end()) {
+        return it->second;
+    }
+    std::shared_ptr<SharedRegion> region(new SharedRegion());
+    if (!region->Open(GetSharedBufferName(instance, id))) {
+        return nullptr;
+    }
+    regions[id] = region;
+    return region;
+}
+
+bool SharedBufferMap::Unmap(uint32_t id) {
+    std::lock_guard<std::mutex> guard(lock);
+    return regions.erase(id) > 0;
+}
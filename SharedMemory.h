@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "Protocol.h"
+
+constexpr size_t SHM_RING_SIZE = 8 * 1024 * 1024;  // на одного воркера
+constexpr uint32_t SHM_THRESHOLD = 16 * 1024;      // меньше - передаём через канал
+constexpr uint32_t SHM_RING_MAGIC = 0x474E4952;    // "RING"
+
+// Именованная область разделяемой памяти
+class SharedRegion {
+private:
+    std::string name;
+    void* base;
+    size_t size;
+    bool owner;
+#ifdef _WIN32
+    HANDLE hMapping;
+#endif
+
+public:
+    SharedRegion();
+    ~SharedRegion();
+
+    SharedRegion(const SharedRegion&) = delete;
+    SharedRegion& operator=(const SharedRegion&) = delete;
+
+    bool Create(const std::string& regionName, size_t regionSize);
+    bool Open(const std::string& regionName);
+    void Close();
+
+    char* Data() const { return (char*)base; }
+    size_t Size() const { return size; }
+};
+
+// Заголовок кольца в начале области
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t capacity;    // размер области данных
+    uint64_t dataOffset;  // начало области данных от начала региона
+};
+
+// Кольцо одного производителя (Browser) и одного потребителя (Worker).
+// Место освобождается, когда Browser получает результат задачи,
+// поэтому воркер может отвечать в любом порядке
+class ShmRing {
+private:
+    struct Allocation {
+        uint32_t taskId;
+        ShmDescriptor descriptor;
+        uint64_t end;
+        bool released;
+    };
+
+    SharedRegion region;
+    char* data;
+    uint64_t capacity;
+    uint64_t head;
+    uint64_t tail;
+    std::deque<Allocation> allocations;
+
+public:
+    ShmRing();
+
+    bool Create(const std::string& name, size_t size);
+    void Close();
+
+    // Резервирует место под полезную нагрузку задачи
+    char* Allocate(uint32_t taskId, uint32_t size, ShmDescriptor& descriptor);
+    bool Lookup(uint32_t taskId, ShmDescriptor& descriptor) const;
+    // Содержимое места: воркер мог записать результат поверх нагрузки
+    const char* Slot(const ShmDescriptor& descriptor) const { return data + descriptor.offset; }
+    void Release(uint32_t taskId);
+    void ReleaseAll();
+
+    bool IsOpen() const { return data != nullptr; }
+};
+
+// Сторона воркера: доступ к полезным нагрузкам по дескрипторам
+class ShmRingView {
+private:
+    SharedRegion region;
+    char* data;
+    uint64_t capacity;
+
+public:
+    ShmRingView();
+
+    bool Open(const std::string& name);
+    char* Resolve(const ShmDescriptor& descriptor) const;
+    bool IsOpen() const { return data != nullptr; }
+};
+
+// Сторона воркера: общие буферы Browser по номеру, отображаются при первом
+// обращении. Задача держит shared_ptr, и Unmap не снимает отображение,
+// пока она работает с буфером
+class SharedBufferMap {
+private:
+    std::map<uint32_t, std::shared_ptr<SharedRegion>> regions;
+    std::mutex lock;
+    uint32_t instance;    // PID Browser: часть имени буфера
+
+public:
+    SharedBufferMap() : instance(0) {}
+
+    // До первого Get
+    void SetInstance(uint32_t browserInstance) { instance = browserInstance; }
+    std::shared_ptr<SharedRegion> Get(uint32_t id);
+    bool Unmap(uint32_t id);
+};
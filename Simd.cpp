@@ -0,0 +1,90 @@
+#include "Simd.h"
+
+#ifdef SIMD_X86
+
+#ifndef _MSC_VER
+#include <cpuid.h>
+#endif
+
+static uint64_t ReadXcr0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static void Cpuid(int leaf, int subleaf, uint32_t regs[4]) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for (int i = 0; i < 4; i++) {
+        regs[i] = (uint32_t)info[i];
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+SimdLevel DetectSimdLevel() {
+    uint32_t regs[4];
+    Cpuid(0, 0, regs);
+    uint32_t maxLeaf = regs[0];
+
+    Cpuid(1, 0, regs);
+    bool sse2 = (regs[3] & (1u << 26)) != 0;
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+
+    // AVX2 нужна и поддержка процессора, и сохранение YMM в ОС
+    if (maxLeaf >= 7 && osxsave && avx && (ReadXcr0() & 6) == 6) {
+        Cpuid(7, 0, regs);
+        if (regs[1] & (1u << 5)) {
+            return SimdLevel::AVX2;
+        }
+    }
+
+    return sse2 ? SimdLevel::SSE2 : SimdLevel::SCALAR;
+}
+
+uint32_t DetectCpuFeatures() {
+    uint32_t regs[4];
+    Cpuid(1, 0, regs);
+
+    uint32_t features = 0;
+    if (regs[2] & (1u << 20)) {
+        features |= CPU_FEATURE_SSE42;
+    }
+    if (regs[2] & (1u << 1)) {
+        features |= CPU_FEATURE_PCLMUL;
+    }
+    if (regs[2] & (1u << 12)) {
+        features |= CPU_FEATURE_FMA;
+    }
+    return features;
+}
+
+#else
+
+SimdLevel DetectSimdLevel() {
+    return SimdLevel::SCALAR;
+}
+
+uint32_t DetectCpuFeatures() {
+    return 0;
+}
+
+#endif
+
+const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX2:
+        return "AVX2";
+    case SimdLevel::SSE2:
+        return "SSE2";
+    default:
+        return "scalar";
+    }
+}
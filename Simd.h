@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_SSE42
+#define TARGET_PCLMUL
+#define TARGET_FMA
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#define TARGET_PCLMUL __attribute__((target("pclmul,sse4.2")))
+#define TARGET_FMA __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+// Набор инструкций, выбранный по CPUID при первом вызове
+enum class SimdLevel {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+SimdLevel DetectSimdLevel();
+const char* SimdLevelName(SimdLevel level);
+
+// Расширения вне линейки SimdLevel
+constexpr uint32_t CPU_FEATURE_SSE42 = 1u << 0;    // инструкция crc32 (CRC32C)
+constexpr uint32_t CPU_FEATURE_PCLMUL = 1u << 1;   // умножение без переносов
+constexpr uint32_t CPU_FEATURE_FMA = 1u << 2;      // a * b + c за одну инструкцию (с AVX2)
+
+uint32_t DetectCpuFeatures();
@@ -0,0 +1,288 @@
+#include "Sort.h"
+#include <algorithm>
+#include <random>
+
+constexpr size_t RADIX_MIN_COUNT = 256;    // меньше - сравнениями
+constexpr size_t SAMPLE_OVERSAMPLING = 32; // ключей выборки на корзину
+
+static inline void FromSortableBits(uint32_t bits, uint32_t& key) {
+    key = bits;
+}
+
+static inline void FromSortableBits(uint32_t bits, int32_t& key) {
+    key = (int32_t)(bits ^ 0x80000000u);
+}
+
+static inline void FromSortableBits(uint32_t bits, float& key) {
+    bits ^= (bits & 0x80000000u) ? 0x80000000u : 0xFFFFFFFFu;
+    memcpy(&key, &bits, sizeof(key));
+}
+
+static inline void FromSortableBits(uint64_t bits, uint64_t& key) {
+    key = bits;
+}
+
+static inline void FromSortableBits(uint64_t bits, int64_t& key) {
+    key = (int64_t)(bits ^ 0x8000000000000000ull);
+}
+
+static inline void FromSortableBits(uint64_t bits, double& key) {
+    bits ^= (bits & 0x8000000000000000ull) ? 0x8000000000000000ull : ~0ull;
+    memcpy(&key, &bits, sizeof(key));
+}
+
+// Ключи переводятся в беззнаковые при первом проходе (он же считает
+// гистограммы всех разрядов), сортируются и переводятся обратно при записи в dst
+template <typename Key>
+static void RadixSortTyped(const char* src, char* dst, size_t count, SortScratch& scratch) {
+    typedef decltype(SortableBits(Key())) Bits;
+    constexpr int DIGITS = sizeof(Bits);
+
+    scratch.keys.Resize(count * sizeof(Bits));
+    Bits* from = (Bits*)scratch.keys.Data();
+
+    size_t histogram[DIGITS][256];
+    memset(histogram, 0, sizeof(histogram));
+    for (size_t i = 0; i < count; i++) {
+        Key key;
+        memcpy(&key, src + i * sizeof(Key), sizeof(Key));
+        Bits bits = SortableBits(key);
+        from[i] = bits;
+        for (int d = 0; d < DIGITS; d++) {
+            histogram[d][(bits >> (d * 8)) & 0xFF]++;
+        }
+    }
+
+    if (count < RADIX_MIN_COUNT) {
+        std::sort(from, from + count);
+    }
+    else {
+        scratch.swap.Resize(count * sizeof(Bits));
+        Bits* to = (Bits*)scratch.swap.Data();
+
+        for (int d = 0; d < DIGITS; d++) {
+            size_t* digit = histogram[d];
+            int shift = d * 8;
+            // Разряд одинаков у всех ключей: проход ничего не меняет
+            if (digit[(from[0] >> shift) & 0xFF] == count) {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (int b = 0; b < 256; b++) {
+                size_t bucketSize = digit[b];
+                digit[b] = offset;
+                offset += bucketSize;
+            }
+            for (size_t i = 0; i < count; i++) {
+                Bits bits = from[i];
+                to[digit[(bits >> shift) & 0xFF]++] = bits;
+            }
+            std::swap(from, to);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Key key;
+        FromSortableBits(from[i], key);
+        memcpy(dst + i * sizeof(Key), &key, sizeof(Key));
+    }
+}
+
+bool RadixSortKeys(SortKey type, const char* src, char* dst, size_t count, SortScratch& scratch) {
+    switch (type) {
+    case SortKey::UINT32:
+        RadixSortTyped<uint32_t>(src, dst, count, scratch);
+        return true;
+    case SortKey::INT32:
+        RadixSortTyped<int32_t>(src, dst, count, scratch);
+        return true;
+    case SortKey::FLOAT32:
+        RadixSortTyped<float>(src, dst, count, scratch);
+        return true;
+    case SortKey::UINT64:
+        RadixSortTyped<uint64_t>(src, dst, count, scratch);
+        return true;
+    case SortKey::INT64:
+        RadixSortTyped<int64_t>(src, dst, count, scratch);
+        return true;
+    case SortKey::FLOAT64:
+        RadixSortTyped<double>(src, dst, count, scratch);
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Дерево проигравших: в узле 1..k-1 - серия, проигравшая в этом узле,
+// в loser[0] - общий победитель. Серия-победитель после выдачи ключа
+// переигрывает только свой путь к корню. Листья - узлы k..2k-1
+template <typename Key>
+static void MergeTyped(const std::vector<KeyRun>& runs, char* out) {
+    typedef decltype(SortableBits(Key())) Bits;
+    size_t k = runs.size();
+    Key* output = (Key*)out;
+
+    std::vector<const Key*> cursor(k);
+    std::vector<const Key*> end(k);
+    std::vector<Bits> head(k);
+    std::vector<char> done(k);
+    size_t total = 0;
+    for (size_t i = 0; i < k; i++) {
+        cursor[i] = (const Key*)runs[i].data;
+        end[i] = cursor[i] + runs[i].count;
+        done[i] = runs[i].count == 0;
+        head[i] = done[i] ? 0 : SortableBits(*cursor[i]);
+        total += runs[i].count;
+    }
+
+    // Равные ключи - в порядке серий
+    auto beats = [&](size_t a, size_t b) {
+        if (done[a]) {
+            return false;
+        }
+        if (done[b]) {
+            return true;
+        }
+        return head[a] < head[b] || (head[a] == head[b] && a < b);
+    };
+
+    std::vector<size_t> loser(k);
+    std::vector<size_t> winner(2 * k);
+    for (size_t i = 0; i < k; i++) {
+        winner[k + i] = i;
+    }
+    for (size_t node = k - 1; node >= 1; node--) {
+        size_t a = winner[2 * node];
+        size_t b = winner[2 * node + 1];
+        winner[node] = beats(a, b) ? a : b;
+        loser[node] = beats(a, b) ? b : a;
+    }
+    loser[0] = winner[1];
+
+    for (size_t produced = 0; produced < total; produced++) {
+        size_t run = loser[0];
+        output[produced] = *cursor[run]++;
+        if (cursor[run] == end[run]) {
+            done[run] = 1;
+        }
+        else {
+            head[run] = SortableBits(*cursor[run]);
+        }
+
+        for (size_t node = (run + k) / 2; node >= 1; node /= 2) {
+            if (beats(loser[node], run)) {
+                std::swap(loser[node], run);
+            }
+        }
+        loser[0] = run;
+    }
+}
+
+bool MergeKeyRuns(SortKey type, const std::vector<KeyRun>& runs, char* out) {
+    size_t keySize = SortKeySize(type);
+    if (keySize == 0) {
+        return false;
+    }
+    if (runs.size() <= 1) {
+        if (!runs.empty()) {
+            memmove(out, runs[0].data, runs[0].count * keySize);
+        }
+        return true;
+    }
+
+    switch (type) {
+    case SortKey::UINT32:
+        MergeTyped<uint32_t>(runs, out);
+        break;
+    case SortKey::INT32:
+        MergeTyped<int32_t>(runs, out);
+        break;
+    case SortKey::FLOAT32:
+        MergeTyped<float>(runs, out);
+        break;
+    case SortKey::UINT64:
+        MergeTyped<uint64_t>(runs, out);
+        break;
+    case SortKey::INT64:
+        MergeTyped<int64_t>(runs, out);
+        break;
+    case SortKey::FLOAT64:
+        MergeTyped<double>(runs, out);
+        break;
+    }
+    return true;
+}
+
+template <typename Key>
+static void PartitionTyped(const char* src, size_t count, size_t buckets, char* dst,
+    std::vector<size_t>& counts, uint64_t seed) {
+    typedef decltype(SortableBits(Key())) Bits;
+    const Key* keys = (const Key*)src;
+    Key* output = (Key*)dst;
+
+    // Разделитель b - каждый SAMPLE_OVERSAMPLING-й ключ отсортированной выборки
+    std::mt19937_64 rng(seed);
+    std::vector<Bits> sample(buckets * SAMPLE_OVERSAMPLING);
+    for (Bits& bits : sample) {
+        bits = SortableBits(keys[rng() % count]);
+    }
+    std::sort(sample.begin(), sample.end());
+
+    std::vector<Bits> splitters(buckets - 1);
+    for (size_t b = 1; b < buckets; b++) {
+        splitters[b - 1] = sample[b * SAMPLE_OVERSAMPLING];
+    }
+
+    // Равные разделителю ключи уходят в одну корзину; корзина из
+    // одинаковых ключей может оказаться сколь угодно большой
+    auto bucketOf = [&splitters](const Key& key) {
+        return (size_t)(std::upper_bound(splitters.begin(), splitters.end(), SortableBits(key)) - splitters.begin());
+    };
+
+    counts.assign(buckets, 0);
+    for (size_t i = 0; i < count; i++) {
+        counts[bucketOf(keys[i])]++;
+    }
+
+    std::vector<size_t> offsets(buckets);
+    size_t offset = 0;
+    for (size_t b = 0; b < buckets; b++) {
+        offsets[b] = offset;
+        offset += counts[b];
+    }
+    for (size_t i = 0; i < count; i++) {
+        output[offsets[bucketOf(keys[i])]++] = keys[i];
+    }
+}
+
+bool PartitionKeys(SortKey type, const char* src, size_t count, size_t buckets, char* dst,
+    std::vector<size_t>& counts, uint64_t seed) {
+    if (buckets == 0 || count == 0) {
+        counts.assign(buckets, 0);
+        return SortKeySize(type) != 0;
+    }
+
+    switch (type) {
+    case SortKey::UINT32:
+        PartitionTyped<uint32_t>(src, count, buckets, dst, counts, seed);
+        return true;
+    case SortKey::INT32:
+        PartitionTyped<int32_t>(src, count, buckets, dst, counts, seed);
+        return true;
+    case SortKey::FLOAT32:
+        PartitionTyped<float>(src, count, buckets, dst, counts, seed);
+        return true;
+    case SortKey::UINT64:
+        PartitionTyped<uint64_t>(src, count, buckets, dst, counts, seed);
+        return true;
+    case SortKey::INT64:
+        PartitionTyped<int64_t>(src, count, buckets, dst, counts, seed);
+        return true;
+    case SortKey::FLOAT64:
+        PartitionTyped<double>(src, count, buckets, dst, counts, seed);
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "Protocol.h"
+
+// Беззнаковое представление ключа с тем же порядком: у знаковых
+// инвертируется старший бит, у отрицательных чисел с плавающей точкой -
+// все биты. NaN оказываются по краям, порядок полный
+inline uint32_t SortableBits(uint32_t key) {
+    return key;
+}
+
+inline uint32_t SortableBits(int32_t key) {
+    return (uint32_t)key ^ 0x80000000u;
+}
+
+inline uint32_t SortableBits(float key) {
+    uint32_t bits;
+    memcpy(&bits, &key, sizeof(bits));
+    return bits ^ ((uint32_t)((int32_t)bits >> 31) | 0x80000000u);
+}
+
+inline uint64_t SortableBits(uint64_t key) {
+    return key;
+}
+
+inline uint64_t SortableBits(int64_t key) {
+    return (uint64_t)key ^ 0x8000000000000000ull;
+}
+
+inline uint64_t SortableBits(double key) {
+    uint64_t bits;
+    memcpy(&bits, &key, sizeof(bits));
+    return bits ^ ((uint64_t)((int64_t)bits >> 63) | 0x8000000000000000ull);
+}
+
+// Буферы поразрядной сортировки; переиспользуются между задачами
+struct SortScratch {
+    MessageBuffer keys;
+    MessageBuffer swap;
+};
+
+// LSD-сортировка по байтам. src и dst могут совпадать и не обязаны быть
+// выровнены. Проходы по разрядам, одинаковым у всех ключей, пропускаются.
+// false - неизвестный тип ключа
+bool RadixSortKeys(SortKey type, const char* src, char* dst, size_t count, SortScratch& scratch);
+
+// Отсортированная серия ключей
+struct KeyRun {
+    const char* data;
+    size_t count;
+};
+
+// Слияние серий в out (не пересекается с сериями) деревом проигравших:
+// log2(k) сравнений на ключ
+bool MergeKeyRuns(SortKey type, const std::vector<KeyRun>& runs, char* out);
+
+// Раскладка по buckets корзинам по разделителям из случайной выборки
+// (sample sort): корзины лежат в dst подряд по возрастанию ключей,
+// counts - их размеры. Внутри корзины порядок исходный
+bool PartitionKeys(SortKey type, const char* src, size_t count, size_t buckets, char* dst,
+    std::vector<size_t>& counts, uint64_t seed);
@@ -0,0 +1,379 @@
+#include "Stats.h"
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+constexpr size_t HISTOGRAM_FLUSH = 1u << 24;   // значений до сброса подтаблиц: uint32_t не переполнится
+constexpr size_t HISTOGRAM_BATCH = 1024;       // номера корзин считаются пачкой, затем инкременты
+
+StatsPartial EmptyStats() {
+    StatsPartial stats;
+    stats.count = 0;
+    stats.mean = 0;
+    stats.m2 = 0;
+    stats.min = std::numeric_limits<double>::infinity();
+    stats.max = -std::numeric_limits<double>::infinity();
+    return stats;
+}
+
+void MergeStats(StatsPartial& into, const StatsPartial& part) {
+    if (part.count == 0) {
+        return;
+    }
+    if (into.count == 0) {
+        into = part;
+        return;
+    }
+
+    double a = (double)into.count;
+    double b = (double)part.count;
+    double n = a + b;
+    double delta = part.mean - into.mean;
+
+    into.mean += delta * (b / n);
+    into.m2 += part.m2 + delta * delta * (a * (b / n));
+    into.min = part.min < into.min ? part.min : into.min;
+    into.max = part.max > into.max ? part.max : into.max;
+    into.count += part.count;
+}
+
+template <typename T>
+static inline double LoadSample(const char* p) {
+    T value;
+    memcpy(&value, p, sizeof(value));
+    return (double)value;
+}
+
+template <typename T>
+static void StatsBlocksScalar(const char* data, size_t count, StatsPartial& stats) {
+    for (size_t start = 0; start < count; start += STATS_BLOCK) {
+        size_t n = count - start < STATS_BLOCK ? count - start : STATS_BLOCK;
+        const char* p = data + start * sizeof(T);
+
+        StatsPartial block = EmptyStats();
+        double sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            double x = LoadSample<T>(p + i * sizeof(T));
+            sum += x;
+            block.min = x < block.min ? x : block.min;
+            block.max = x > block.max ? x : block.max;
+        }
+        block.count = n;
+        block.mean = sum / n;
+
+        // Блок ещё в L1: отклонения от его среднего без второго чтения памяти
+        for (size_t i = 0; i < n; i++) {
+            double d = LoadSample<T>(p + i * sizeof(T)) - block.mean;
+            block.m2 += d * d;
+        }
+        MergeStats(stats, block);
+    }
+}
+
+void ComputeStatsScalar(SampleType type, const char* data, size_t count, StatsPartial& stats) {
+    switch (type) {
+    case SampleType::FLOAT64:
+        StatsBlocksScalar<double>(data, count, stats);
+        break;
+    case SampleType::FLOAT32:
+        StatsBlocksScalar<float>(data, count, stats);
+        break;
+    default:
+        StatsBlocksScalar<uint8_t>(data, count, stats);
+        break;
+    }
+}
+
+// Номер в подтаблице: 0 - ниже lo, 1..bins - корзины, bins + 1 - не ниже hi
+static inline uint32_t BinIndex(double x, const HistogramSpec& spec, double scale) {
+    if (x < spec.lo) {
+        return 0;
+    }
+    if (!(x < spec.hi)) {
+        return spec.bins + 1;
+    }
+    uint32_t bin = (uint32_t)((x - spec.lo) * scale);
+    return bin < spec.bins ? bin + 1 : spec.bins;
+}
+
+static void FoldTables(const HistogramSpec& spec, HistogramScratch& scratch, uint64_t* counts) {
+    size_t stride = (size_t)spec.bins + 2;
+    for (uint32_t t = 0; t < HISTOGRAM_SUBTABLES; t++) {
+        const uint32_t* table = scratch.tables.data() + t * stride;
+        for (uint32_t bin = 0; bin < spec.bins; bin++) {
+            counts[bin] += table[bin + 1];
+        }
+        counts[spec.bins] += table[0];
+        counts[spec.bins + 1] += table[spec.bins + 1];
+    }
+    std::fill(scratch.tables.begin(), scratch.tables.end(), 0);
+}
+
+// Байты: по одному значению в каждую из четырёх подтаблиц
+static void ByteHistogram(const uint8_t* p, size_t count, uint32_t* tables, size_t stride) {
+    uint32_t* t0 = tables + 1;
+    uint32_t* t1 = tables + stride + 1;
+    uint32_t* t2 = tables + 2 * stride + 1;
+    uint32_t* t3 = tables + 3 * stride + 1;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        t0[p[i]]++;
+        t1[p[i + 1]]++;
+        t2[p[i + 2]]++;
+        t3[p[i + 3]]++;
+    }
+    for (; i < count; i++) {
+        t0[p[i]]++;
+    }
+}
+
+static void IncrementBins(const uint32_t* indices, size_t count, uint32_t* tables, size_t stride) {
+    uint32_t* t0 = tables;
+    uint32_t* t1 = tables + stride;
+    uint32_t* t2 = tables + 2 * stride;
+    uint32_t* t3 = tables + 3 * stride;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        t0[indices[i]]++;
+        t1[indices[i + 1]]++;
+        t2[indices[i + 2]]++;
+        t3[indices[i + 3]]++;
+    }
+    for (; i < count; i++) {
+        t0[indices[i]]++;
+    }
+}
+
+template <typename T>
+static void BinIndicesScalar(const char* data, size_t count, const HistogramSpec& spec, uint32_t* indices) {
+    double scale = spec.bins / (spec.hi - spec.lo);
+    for (size_t i = 0; i < count; i++) {
+        indices[i] = BinIndex(LoadSample<T>(data + i * sizeof(T)), spec, scale);
+    }
+}
+
+bool IsHistogramSpecValid(SampleType type, const HistogramSpec& spec) {
+    if (type == SampleType::UINT8) {
+        return spec.bins == 256;
+    }
+    return type <= SampleType::FLOAT64 && spec.bins > 0 && spec.bins <= HISTOGRAM_MAX_BINS && spec.lo < spec.hi;
+}
+
+typedef void (*BinIndicesFn)(const char*, size_t, const HistogramSpec&, uint32_t*);
+
+static bool Histogram(SampleType type, const HistogramSpec& spec, const char* data, size_t count,
+    HistogramScratch& scratch, uint64_t* counts, BinIndicesFn binIndices) {
+    if (!IsHistogramSpecValid(type, spec)) {
+        return false;
+    }
+
+    size_t stride = (size_t)spec.bins + 2;
+    size_t sampleSize = SampleTypeSize(type);
+    scratch.tables.assign(HISTOGRAM_SUBTABLES * stride, 0);
+    scratch.indices.resize(HISTOGRAM_BATCH);
+
+    for (size_t start = 0; start < count; start += HISTOGRAM_FLUSH) {
+        size_t n = count - start < HISTOGRAM_FLUSH ? count - start : HISTOGRAM_FLUSH;
+        const char* p = data + start * sampleSize;
+
+        if (type == SampleType::UINT8) {
+            ByteHistogram((const uint8_t*)p, n, scratch.tables.data(), stride);
+        }
+        else {
+            for (size_t batch = 0; batch < n; batch += HISTOGRAM_BATCH) {
+                size_t m = n - batch < HISTOGRAM_BATCH ? n - batch : HISTOGRAM_BATCH;
+                binIndices(p + batch * sampleSize, m, spec, scratch.indices.data());
+                IncrementBins(scratch.indices.data(), m, scratch.tables.data(), stride);
+            }
+        }
+        FoldTables(spec, scratch, counts);
+    }
+    return true;
+}
+
+bool ComputeHistogramScalar(SampleType type, const HistogramSpec& spec, const char* data, size_t count,
+    HistogramScratch& scratch, uint64_t* counts) {
+    BinIndicesFn binIndices = type == SampleType::FLOAT64 ? BinIndicesScalar<double> : BinIndicesScalar<float>;
+    return Histogram(type, spec, data, count, scratch, counts, binIndices);
+}
+
+#ifdef SIMD_X86
+
+static TARGET_AVX2 inline __m256d Load4(const char* p, double*) {
+    return _mm256_loadu_pd((const double*)p);
+}
+
+static TARGET_AVX2 inline __m256d Load4(const char* p, float*) {
+    return _mm256_cvtps_pd(_mm_loadu_ps((const float*)p));
+}
+
+static TARGET_AVX2 inline __m256d Load4(const char* p, uint8_t*) {
+    int32_t bytes;
+    memcpy(&bytes, p, sizeof(bytes));
+    return _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes)));
+}
+
+static TARGET_AVX2 inline double HorizontalSum(__m256d v) {
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+static TARGET_AVX2 inline double HorizontalMin(__m256d v) {
+    __m128d pair = _mm_min_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_min_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+static TARGET_AVX2 inline double HorizontalMax(__m256d v) {
+    __m128d pair = _mm_max_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+// Вычисления в double по четыре значения; два аккумулятора суммы
+// скрывают задержку сложения
+template <typename T>
+static TARGET_AVX2 void StatsBlocksAvx2(const char* data, size_t count, StatsPartial& stats) {
+    T* tag = nullptr;
+
+    for (size_t start = 0; start < count; start += STATS_BLOCK) {
+        size_t n = count - start < STATS_BLOCK ? count - start : STATS_BLOCK;
+        const char* p = data + start * sizeof(T);
+
+        __m256d sum0 = _mm256_setzero_pd();
+        __m256d sum1 = _mm256_setzero_pd();
+        __m256d lo = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+        __m256d hi = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256d a = Load4(p + i * sizeof(T), tag);
+            __m256d b = Load4(p + (i + 4) * sizeof(T), tag);
+            sum0 = _mm256_add_pd(sum0, a);
+            sum1 = _mm256_add_pd(sum1, b);
+            lo = _mm256_min_pd(lo, _mm256_min_pd(a, b));
+            hi = _mm256_max_pd(hi, _mm256_max_pd(a, b));
+        }
+        size_t vectorEnd = i;
+
+        StatsPartial block = EmptyStats();
+        double sum = HorizontalSum(_mm256_add_pd(sum0, sum1));
+        block.min = HorizontalMin(lo);
+        block.max = HorizontalMax(hi);
+        for (; i < n; i++) {
+            double x = LoadSample<T>(p + i * sizeof(T));
+            sum += x;
+            block.min = x < block.min ? x : block.min;
+            block.max = x > block.max ? x : block.max;
+        }
+        block.count = n;
+        block.mean = sum / n;
+
+        __m256d mean = _mm256_set1_pd(block.mean);
+        __m256d m2a = _mm256_setzero_pd();
+        __m256d m2b = _mm256_setzero_pd();
+        for (i = 0; i < vectorEnd; i += 8) {
+            __m256d a = _mm256_sub_pd(Load4(p + i * sizeof(T), tag), mean);
+            __m256d b = _mm256_sub_pd(Load4(p + (i + 4) * sizeof(T), tag), mean);
+            m2a = _mm256_add_pd(m2a, _mm256_mul_pd(a, a));
+            m2b = _mm256_add_pd(m2b, _mm256_mul_pd(b, b));
+        }
+        block.m2 = HorizontalSum(_mm256_add_pd(m2a, m2b));
+        for (; i < n; i++) {
+            double d = LoadSample<T>(p + i * sizeof(T)) - block.mean;
+            block.m2 += d * d;
+        }
+        MergeStats(stats, block);
+    }
+}
+
+void ComputeStatsAvx2(SampleType type, const char* data, size_t count, StatsPartial& stats) {
+    switch (type) {
+    case SampleType::FLOAT64:
+        StatsBlocksAvx2<double>(data, count, stats);
+        break;
+    case SampleType::FLOAT32:
+        StatsBlocksAvx2<float>(data, count, stats);
+        break;
+    default:
+        StatsBlocksAvx2<uint8_t>(data, count, stats);
+        break;
+    }
+}
+
+// Номера корзин по четыре: ветвления BinIndex заменены смешиванием масок
+template <typename T>
+static TARGET_AVX2 void BinIndicesAvx2(const char* data, size_t count, const HistogramSpec& spec, uint32_t* indices) {
+    T* tag = nullptr;
+    double scale = spec.bins / (spec.hi - spec.lo);
+    __m256d vlo = _mm256_set1_pd(spec.lo);
+    __m256d vhi = _mm256_set1_pd(spec.hi);
+    __m256d vscale = _mm256_set1_pd(scale);
+    __m256d zero = _mm256_setzero_pd();
+    __m256d one = _mm256_set1_pd(1.0);
+    __m256d lastBin = _mm256_set1_pd(spec.bins - 1.0);
+    __m256d overflow = _mm256_set1_pd(spec.bins + 1.0);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d x = Load4(data + i * sizeof(T), tag);
+        __m256d bin = _mm256_mul_pd(_mm256_sub_pd(x, vlo), vscale);
+        bin = _mm256_add_pd(_mm256_min_pd(_mm256_max_pd(bin, zero), lastBin), one);
+        bin = _mm256_blendv_pd(bin, zero, _mm256_cmp_pd(x, vlo, _CMP_LT_OQ));
+        bin = _mm256_blendv_pd(bin, overflow, _mm256_cmp_pd(x, vhi, _CMP_NLT_UQ));
+        _mm_storeu_si128((__m128i*)(indices + i), _mm256_cvttpd_epi32(bin));
+    }
+    for (; i < count; i++) {
+        indices[i] = BinIndex(LoadSample<T>(data + i * sizeof(T)), spec, scale);
+    }
+}
+
+bool ComputeHistogramAvx2(SampleType type, const HistogramSpec& spec, const char* data, size_t count,
+    HistogramScratch& scratch, uint64_t* counts) {
+    BinIndicesFn binIndices = type == SampleType::FLOAT64 ? BinIndicesAvx2<double> : BinIndicesAvx2<float>;
+    return Histogram(type, spec, data, count, scratch, counts, binIndices);
+}
+
+#else
+
+void ComputeStatsAvx2(SampleType type, const char* data, size_t count, StatsPartial& stats) {
+    ComputeStatsScalar(type, data, count, stats);
+}
+
+bool ComputeHistogramAvx2(SampleType type, const HistogramSpec& spec, const char* data, size_t count,
+    HistogramScratch& scratch, uint64_t* counts) {
+    return ComputeHistogramScalar(type, spec, data, count, scratch, counts);
+}
+
+#endif
+
+void ComputeStats(SampleType type, const char* data, size_t count, StatsPartial& stats) {
+    static const bool avx2 = DetectSimdLevel() == SimdLevel::AVX2;
+    if (avx2) {
+        ComputeStatsAvx2(type, data, count, stats);
+    }
+    else {
+        ComputeStatsScalar(type, data, count, stats);
+    }
+}
+
+bool ComputeHistogram(SampleType type, const HistogramSpec& spec, const char* data, size_t count,
+    HistogramScratch& scratch, uint64_t* counts) {
+    static const bool avx2 = DetectSimdLevel() == SimdLevel::AVX2;
+    if (avx2) {
+        return ComputeHistogramAvx2(type, spec, data, count, scratch, counts);
+    }
+    return ComputeHistogramScalar(type, spec, data, count, scratch, counts);
+}
+
+StatsReducer::StatsReducer() : nextIndex(0), stats(EmptyStats()) {}
+
+void StatsReducer::Add(uint64_t index, const StatsPartial& part) {
+    pending[index] = part;
+
+    auto it = pending.begin();
+    while (it != pending.end() && it->first == nextIndex) {
+        MergeStats(stats, it->second);
+        it = pending.erase(it);
+        nextIndex++;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+#include "Simd.h"
+
+constexpr size_t STATS_BLOCK = 1024;        // блок в L1: среднее, затем отклонения от него
+constexpr uint32_t HISTOGRAM_SUBTABLES = 4; // соседние значения - в разные таблицы
+
+StatsPartial EmptyStats();
+
+// Слияние по Чану: точное для count, min, max, без потери точности
+// для mean и m2 при любом разбиении
+void MergeStats(StatsPartial& into, const StatsPartial& part);
+
+inline double StatsVariance(const StatsPartial& stats) {
+    return stats.count > 0 ? stats.m2 / stats.count : 0.0;
+}
+
+// Статистика count значений за один проход по памяти: каждый блок
+// STATS_BLOCK считается в два прохода по L1 и вливается по Чану.
+// Данные не обязаны быть выровнены
+void ComputeStats(SampleType type, const char* data, size_t count, StatsPartial& stats);
+
+// Отдельные реализации (для бенчмарка); Avx2 вызывать только при AVX2
+void ComputeStatsScalar(SampleType type, const char* data, size_t count, StatsPartial& stats);
+void ComputeStatsAvx2(SampleType type, const char* data, size_t count, StatsPartial& stats);
+
+// Таблицы гистограммы одного потока; переиспользуются
+struct HistogramScratch {
+    std::vector<uint32_t> tables;   // HISTOGRAM_SUBTABLES x (bins + 2)
+    std::vector<uint32_t> indices;
+    std::vector<uint64_t> counts;   // для вызывающего: ответ задачи
+};
+
+bool IsHistogramSpecValid(SampleType type, const HistogramSpec& spec);
+
+// Добавляет к counts (bins + 2 элемента в порядке TASK_HISTOGRAM).
+// Подряд идущие значения попадают в разные подтаблицы: одинаковые
+// значения не ждут, пока запишется предыдущий инкремент той же ячейки
+bool ComputeHistogram(SampleType type, const HistogramSpec& spec, const char* data, size_t count,
+    HistogramScratch& scratch, uint64_t* counts);
+
+bool ComputeHistogramScalar(SampleType type, const HistogramSpec& spec, const char* data, size_t count,
+    HistogramScratch& scratch, uint64_t* counts);
+bool ComputeHistogramAvx2(SampleType type, const HistogramSpec& spec, const char* data, size_t count,
+    HistogramScratch& scratch, uint64_t* counts);
+
+// Слияние статистик кусков потока по порядку: результат не зависит от
+// того, в каком порядке пришли ответы
+class StatsReducer {
+private:
+    std::map<uint64_t, StatsPartial> pending;
+    uint64_t nextIndex;
+    StatsPartial stats;
+
+public:
+    StatsReducer();
+
+    void Add(uint64_t index, const StatsPartial& part);
+
+    const StatsPartial& Stats() const { return stats; }
+    uint64_t Reduced() const { return nextIndex; }
+};
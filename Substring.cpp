@@ -0,0 +1,300 @@
+#include "Substring.h"
+#include <cstring>
+
+uint32_t CountSubstringScalar(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, size_t* lastMatchEnd) {
+    if (lastMatchEnd) {
+        *lastMatchEnd = 0;
+    }
+    if (patternLength == 0 || patternLength > textLength) {
+        return 0;
+    }
+
+    uint32_t count = 0;
+    const char* pos = text;
+    const char* lastStart = text + (textLength - patternLength);
+
+    while (pos <= lastStart) {
+        pos = (const char*)memchr(pos, pattern[0], lastStart - pos + 1);
+        if (!pos) {
+            break;
+        }
+        if (memcmp(pos + 1, pattern + 1, patternLength - 1) == 0) {
+            count++;
+            pos += patternLength;
+            if (lastMatchEnd) {
+                *lastMatchEnd = pos - text;
+            }
+        }
+        else {
+            pos++;
+        }
+    }
+    return count;
+}
+
+#ifdef SIMD_X86
+
+static inline int LowestBit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+static inline int PopCount(uint32_t mask) {
+#ifdef _MSC_VER
+    return (int)__popcnt(mask);
+#else
+    return __builtin_popcount(mask);
+#endif
+}
+
+// Кандидаты из маски блока проверяются по порядку; next - первая позиция,
+// с которой может начаться следующее непересекающееся вхождение
+static inline void CheckCandidates(uint32_t mask, size_t blockStart, const char* text,
+    const char* pattern, size_t patternLength, size_t& next, uint32_t& count) {
+    // Первый и последний байты уже совпали
+    size_t middle = patternLength - 2;
+
+    while (mask != 0) {
+        size_t pos = blockStart + LowestBit(mask);
+        mask &= mask - 1;
+        if (pos < next) {
+            continue;
+        }
+        if (memcmp(text + pos + 1, pattern + 1, middle) == 0) {
+            count++;
+            next = pos + patternLength;
+        }
+    }
+}
+
+// Хвост после векторного цикла: i - первая непросмотренная позиция,
+// next - конец последнего найденного вхождения (0, если их не было)
+static uint32_t FinishTail(const char* text, size_t textLength, const char* pattern, size_t patternLength,
+    size_t i, size_t next, size_t* lastMatchEnd) {
+    size_t tailStart = next < i ? i : next;
+    size_t tailEnd;
+    uint32_t count = CountSubstringScalar(text + tailStart, textLength - tailStart,
+        pattern, patternLength, &tailEnd);
+    if (lastMatchEnd) {
+        *lastMatchEnd = count > 0 ? tailStart + tailEnd : next;
+    }
+    return count;
+}
+
+static uint32_t FinishSingleByte(const char* text, size_t i, size_t textLength, char byte, size_t* lastMatchEnd) {
+    uint32_t count = 0;
+    for (; i < textLength; i++) {
+        count += text[i] == byte;
+    }
+
+    if (lastMatchEnd) {
+        *lastMatchEnd = 0;
+        for (size_t pos = textLength; pos > 0; pos--) {
+            if (text[pos - 1] == byte) {
+                *lastMatchEnd = pos;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+// Фильтр по первому и последнему байту образца: сравнение целиком
+// только там, где совпали оба
+uint32_t CountSubstringSse2(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, size_t* lastMatchEnd) {
+    if (lastMatchEnd) {
+        *lastMatchEnd = 0;
+    }
+    if (patternLength == 0 || patternLength > textLength) {
+        return 0;
+    }
+
+    size_t limit = textLength - patternLength + 1; // число возможных начал
+    size_t i = 0;
+    uint32_t count = 0;
+
+    if (patternLength == 1) {
+        // Вхождения одного байта не пересекаются: считаем совпадения
+        // в байтовых счётчиках и сворачиваем их через SAD до переполнения
+        const __m128i needle = _mm_set1_epi8(pattern[0]);
+        const __m128i zero = _mm_setzero_si128();
+        while (i + 16 <= limit) {
+            __m128i counters = zero;
+            for (int k = 0; k < 255 && i + 16 <= limit; k++, i += 16) {
+                __m128i block = _mm_loadu_si128((const __m128i*)(text + i));
+                counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(needle, block));
+            }
+            __m128i sums = _mm_sad_epu8(counters, zero);
+            count += (uint32_t)(_mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4));
+        }
+        return count + FinishSingleByte(text, i, textLength, pattern[0], lastMatchEnd);
+    }
+
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[patternLength - 1]);
+    size_t next = 0;
+
+    while (i + 16 <= limit) {
+        if (i < next) {
+            i = next;
+            continue;
+        }
+
+        __m128i blockFirst = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i blockLast = _mm_loadu_si128((const __m128i*)(text + i + patternLength - 1));
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast));
+
+        CheckCandidates((uint32_t)_mm_movemask_epi8(eq), i, text, pattern, patternLength, next, count);
+        i += 16;
+    }
+
+    return count + FinishTail(text, textLength, pattern, patternLength, i, next, lastMatchEnd);
+}
+
+TARGET_AVX2
+uint32_t CountSubstringAvx2(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, size_t* lastMatchEnd) {
+    if (lastMatchEnd) {
+        *lastMatchEnd = 0;
+    }
+    if (patternLength == 0 || patternLength > textLength) {
+        return 0;
+    }
+
+    size_t limit = textLength - patternLength + 1;
+    size_t i = 0;
+    uint32_t count = 0;
+
+    if (patternLength == 1) {
+        const __m256i needle = _mm256_set1_epi8(pattern[0]);
+        for (; i + 32 <= limit; i += 32) {
+            __m256i block = _mm256_loadu_si256((const __m256i*)(text + i));
+            count += PopCount((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(needle, block)));
+        }
+        return count + FinishSingleByte(text, i, textLength, pattern[0], lastMatchEnd);
+    }
+
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[patternLength - 1]);
+    size_t next = 0;
+
+    while (i + 32 <= limit) {
+        if (i < next) {
+            i = next;
+            continue;
+        }
+
+        __m256i blockFirst = _mm256_loadu_si256((const __m256i*)(text + i));
+        __m256i blockLast = _mm256_loadu_si256((const __m256i*)(text + i + patternLength - 1));
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast));
+
+        CheckCandidates((uint32_t)_mm256_movemask_epi8(eq), i, text, pattern, patternLength, next, count);
+        i += 32;
+    }
+
+    return count + FinishTail(text, textLength, pattern, patternLength, i, next, lastMatchEnd);
+}
+
+#else
+
+uint32_t CountSubstringSse2(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, size_t* lastMatchEnd) {
+    return CountSubstringScalar(text, textLength, pattern, patternLength, lastMatchEnd);
+}
+
+uint32_t CountSubstringAvx2(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, size_t* lastMatchEnd) {
+    return CountSubstringScalar(text, textLength, pattern, patternLength, lastMatchEnd);
+}
+
+#endif
+
+typedef uint32_t (*CountSubstringFn)(const char*, size_t, const char*, size_t, size_t*);
+
+static CountSubstringFn SelectCountSubstring() {
+    switch (DetectSimdLevel()) {
+    case SimdLevel::AVX2:
+        return CountSubstringAvx2;
+    case SimdLevel::SSE2:
+        return CountSubstringSse2;
+    default:
+        return CountSubstringScalar;
+    }
+}
+
+uint32_t CountSubstring(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, size_t* lastMatchEnd) {
+    static const CountSubstringFn impl = SelectCountSubstring();
+    return impl(text, textLength, pattern, patternLength, lastMatchEnd);
+}
+
+// Есть ли у образца собственная грань: только тогда два вхождения
+// могут перекрываться
+static bool HasBorder(const char* pattern, size_t patternLength) {
+    std::vector<size_t> prefix(patternLength, 0);
+    for (size_t i = 1; i < patternLength; i++) {
+        size_t k = prefix[i - 1];
+        while (k > 0 && pattern[i] != pattern[k]) {
+            k = prefix[k - 1];
+        }
+        if (pattern[i] == pattern[k]) {
+            k++;
+        }
+        prefix[i] = k;
+    }
+    return patternLength > 0 && prefix[patternLength - 1] > 0;
+}
+
+static ChunkEntry CountChunkFrom(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, size_t entry) {
+    size_t core = textLength > patternLength - 1 ? textLength - (patternLength - 1) : 0;
+    size_t end = 0;
+
+    ChunkEntry result;
+    result.count = entry < textLength ?
+        CountSubstring(text + entry, textLength - entry, pattern, patternLength, &end) : 0;
+    end += entry;
+    result.spill = result.count > 0 && end > core ? (uint32_t)(end - core) : 0;
+    return result;
+}
+
+void CountSubstringChunk(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, std::vector<ChunkEntry>& entries) {
+    entries.clear();
+    if (patternLength == 0) {
+        entries.push_back(ChunkEntry{ 0, 0 });
+        return;
+    }
+
+    entries.push_back(CountChunkFrom(text, textLength, pattern, patternLength, 0));
+
+    size_t overlap = patternLength - 1;
+    if (overlap == 0 || !HasBorder(pattern, patternLength)) {
+        return;
+    }
+
+    // Заход на d байт меняет ответ, только если первое вхождение
+    // начинается раньше d
+    size_t first = overlap;
+    for (size_t pos = 0; pos < overlap && pos + patternLength <= textLength; pos++) {
+        if (memcmp(text + pos, pattern, patternLength) == 0) {
+            first = pos;
+            break;
+        }
+    }
+    if (first == overlap) {
+        return;
+    }
+
+    for (size_t entry = 1; entry <= overlap; entry++) {
+        entries.push_back(entry <= first ? entries[0] :
+            CountChunkFrom(text, textLength, pattern, patternLength, entry));
+    }
+}
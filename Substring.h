@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+#include "Simd.h"
+
+// Число непересекающихся вхождений pattern в text. Строки задаются
+// длиной и могут содержать нулевые байты; данные не копируются.
+// lastMatchEnd - конец последнего засчитанного вхождения (0, если их нет)
+uint32_t CountSubstring(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, size_t* lastMatchEnd = nullptr);
+
+// Фрагмент потока: text - ядро и patternLength-1 байт следующего фрагмента.
+// Для образцов, вхождения которых не перекрываются, хватает одной записи;
+// иначе по записи на каждый возможный заход предыдущего вхождения
+void CountSubstringChunk(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, std::vector<ChunkEntry>& entries);
+
+// Отдельные реализации (для бенчмарка); AVX2 и SSE2 вызывать только
+// если DetectSimdLevel() их поддерживает
+uint32_t CountSubstringScalar(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, size_t* lastMatchEnd = nullptr);
+uint32_t CountSubstringSse2(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, size_t* lastMatchEnd = nullptr);
+uint32_t CountSubstringAvx2(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength, size_t* lastMatchEnd = nullptr);
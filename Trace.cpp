@@ -0,0 +1,249 @@
+#include "Trace.h"
+#include <fstream>
+#include <iomanip>
+
+static const char* const TRACE_STAGE_NAMES[] = { "queue", "send", "wait", "compute", "reply", "return" };
+constexpr int TRACE_STAGES = (int)TraceStage::COUNT;
+
+const char* TraceStageName(TraceStage stage) {
+    return stage < TraceStage::COUNT ? TRACE_STAGE_NAMES[(int)stage] : "total";
+}
+
+static const char* TaskTypeName(MessageType type) {
+    switch (type) {
+    case MessageType::TASK_SEPIA: return "sepia";
+    case MessageType::TASK_PRIMES: return "primes";
+    case MessageType::TASK_SORT: return "sort";
+    case MessageType::TASK_CRC32: return "crc32";
+    case MessageType::TASK_STATS: return "stats";
+    case MessageType::TASK_XOR: return "xor";
+    case MessageType::TASK_SUBSTRING: return "substring";
+    case MessageType::TASK_MATRIX_MULT: return "matrix";
+    case MessageType::TASK_FACTORIAL: return "factorial";
+    case MessageType::TASK_HISTOGRAM: return "histogram";
+    case MessageType::TASK_FOURIER: return "fourier";
+    case MessageType::TASK_RLE: return "rle";
+    case MessageType::TASK_GRAPH_PATH: return "graph";
+    case MessageType::TASK_INVERT: return "invert";
+    default: return "task";
+    }
+}
+
+TaskTracer::TaskTracer() : enabled(false), dropped(0) {}
+
+void TaskTracer::OnSent(uint32_t taskId, MessageType type) {
+    sent[taskId] = type;
+}
+
+void TaskTracer::OnCompleted(const Completion& completion) {
+    auto it = sent.find(completion.taskId);
+    if (it == sent.end() || completion.workerId < 0) {
+        return;
+    }
+    MessageType type = it->second;
+    sent.erase(it);
+    if (!(completion.flags & RESULT_FLAG_TRACE)) {
+        return;
+    }
+
+    // t1, t4 - часы Browser, t2, t3 - воркера
+    const TraceStamps& stamps = completion.trace;
+    int64_t t1 = (int64_t)stamps.sent;
+    int64_t t2 = (int64_t)stamps.received;
+    int64_t t3 = (int64_t)stamps.replied;
+    int64_t t4 = (int64_t)completion.received;
+    int64_t roundTrip = (t4 - t1) - (t3 - t2);
+
+    if ((size_t)completion.workerId >= offsets.size()) {
+        offsets.resize(completion.workerId + 1);
+    }
+    ClockOffset& clock = offsets[completion.workerId];
+    if (roundTrip >= 0 && (uint64_t)roundTrip < clock.bestRoundTrip) {
+        clock.bestRoundTrip = (uint64_t)roundTrip;
+        clock.offset = ((t2 - t1) + (t3 - t4)) / 2;
+    }
+
+    if (records.size() >= TRACE_MAX_RECORDS) {
+        dropped++;
+        return;
+    }
+    Record record;
+    record.taskId = completion.taskId;
+    record.type = type;
+    record.workerId = completion.workerId;
+    record.stamps = stamps;
+    record.received = completion.received;
+    records.push_back(record);
+}
+
+void TaskTracer::DropBefore(uint32_t first) {
+    size_t kept = 0;
+    for (const Record& record : records) {
+        if (record.taskId >= first) {
+            records[kept++] = record;
+        }
+    }
+    records.resize(kept);
+}
+
+void TaskTracer::Clear() {
+    records.clear();
+    sent.clear();
+    offsets.clear();
+    dropped = 0;
+}
+
+int64_t TaskTracer::Offset(int workerId) const {
+    return workerId >= 0 && (size_t)workerId < offsets.size() ? offsets[workerId].offset : 0;
+}
+
+// Ошибка оценки смещения может переставить соседние отметки: каждая
+// не раньше предыдущей и не позже ответа
+void TaskTracer::Stages(const Record& record, uint64_t stages[TRACE_STAGES], uint64_t& start) const {
+    int64_t offset = Offset(record.workerId);
+    const TraceStamps& stamps = record.stamps;
+    int64_t times[TRACE_STAGES + 1] = {
+        (int64_t)stamps.enqueued,
+        (int64_t)stamps.sent,
+        (int64_t)stamps.received - offset,
+        (int64_t)stamps.computeStart - offset,
+        (int64_t)stamps.computeEnd - offset,
+        (int64_t)stamps.replied - offset,
+        (int64_t)record.received
+    };
+    for (int i = 1; i <= TRACE_STAGES; i++) {
+        times[i] = times[i] < times[i - 1] ? times[i - 1] : times[i];
+    }
+    for (int i = TRACE_STAGES - 1; i > 0; i--) {
+        times[i] = times[i] > times[i + 1] ? times[i + 1] : times[i];
+    }
+
+    start = (uint64_t)times[0];
+    for (int i = 0; i < TRACE_STAGES; i++) {
+        stages[i] = (uint64_t)(times[i + 1] - times[i]);
+    }
+}
+
+void TaskTracer::Breakdown(std::vector<LatencyHistogram>& stages) const {
+    stages.assign(TRACE_STAGES + 1, LatencyHistogram());
+    for (const Record& record : records) {
+        uint64_t durations[TRACE_STAGES];
+        uint64_t start;
+        Stages(record, durations, start);
+        uint64_t total = 0;
+        for (int i = 0; i < TRACE_STAGES; i++) {
+            stages[i].Record(durations[i]);
+            total += durations[i];
+        }
+        stages[TRACE_STAGES].Record(total);
+    }
+}
+
+void TaskTracer::PrintBreakdown(std::ostream& out) const {
+    std::vector<LatencyHistogram> stages;
+    Breakdown(stages);
+    double totalMean = stages[TRACE_STAGES].Mean();
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(1);
+
+    out << "\n=== Stage breakdown: " << records.size() << " traced tasks";
+    if (dropped > 0) {
+        out << ", " << dropped << " not kept";
+    }
+    out << " ===" << std::endl;
+    out << std::left << std::setw(10) << "stage" << std::right << std::setw(10) << "mean" << std::setw(10) << "p50"
+        << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "max" << std::setw(8) << "share"
+        << "  (us)" << std::endl;
+    for (int i = 0; i <= TRACE_STAGES; i++) {
+        const LatencyHistogram& stage = stages[i];
+        out << std::left << std::setw(10) << TraceStageName((TraceStage)i) << std::right
+            << std::setw(10) << stage.Mean() / 1000.0 << std::setw(10) << stage.Percentile(0.5) / 1000.0
+            << std::setw(10) << stage.Percentile(0.9) / 1000.0 << std::setw(10) << stage.Percentile(0.99) / 1000.0
+            << std::setw(10) << stage.Max() / 1000.0
+            << std::setw(7) << (totalMean > 0 ? 100.0 * stage.Mean() / totalMean : 0.0) << "%" << std::endl;
+    }
+
+    // Средние этапов по типам задач
+    std::map<MessageType, std::vector<double>> byType;
+    for (const Record& record : records) {
+        uint64_t durations[TRACE_STAGES];
+        uint64_t start;
+        Stages(record, durations, start);
+        std::vector<double>& sums = byType[record.type];
+        sums.resize(TRACE_STAGES + 1, 0.0);
+        for (int i = 0; i < TRACE_STAGES; i++) {
+            sums[i] += (double)durations[i];
+        }
+        sums[TRACE_STAGES] += 1;
+    }
+    if (byType.size() > 1) {
+        out << std::left << std::setw(10) << "mean by" << std::right;
+        for (int i = 0; i < TRACE_STAGES; i++) {
+            out << std::setw(10) << TRACE_STAGE_NAMES[i];
+        }
+        out << std::endl;
+        for (const auto& entry : byType) {
+            out << std::left << std::setw(10) << TaskTypeName(entry.first) << std::right;
+            for (int i = 0; i < TRACE_STAGES; i++) {
+                out << std::setw(10) << entry.second[i] / entry.second[TRACE_STAGES] / 1000.0;
+            }
+            out << std::endl;
+        }
+    }
+
+    out << "Clock offsets (worker - browser, us):";
+    for (size_t i = 0; i < offsets.size(); i++) {
+        out << " " << i << ": " << offsets[i].offset / 1000.0;
+    }
+    out << std::endl;
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool TaskTracer::WriteChromeTrace(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    out << std::fixed << std::setprecision(3);
+
+    uint64_t base = ~0ull;
+    for (const Record& record : records) {
+        base = record.stamps.enqueued < base ? record.stamps.enqueued : base;
+    }
+
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+    out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 0, \"args\": {\"name\": \"Browser\"}}";
+    for (size_t i = 0; i < offsets.size(); i++) {
+        out << ",\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << i + 1
+            << ", \"args\": {\"name\": \"Worker " << i << "\", \"clock_offset_us\": " << offsets[i].offset / 1000.0
+            << "}}";
+    }
+
+    // Вложенные асинхронные интервалы: b и e с одним id, этапы внутри задачи
+    for (const Record& record : records) {
+        uint64_t durations[TRACE_STAGES];
+        uint64_t start;
+        Stages(record, durations, start);
+
+        const char* name = TaskTypeName(record.type);
+        double at = (start - base) / 1000.0;
+        out << ",\n{\"name\": \"" << name << "\", \"cat\": \"task\", \"ph\": \"b\", \"id\": " << record.taskId
+            << ", \"pid\": " << record.workerId + 1 << ", \"tid\": 0, \"ts\": " << at
+            << ", \"args\": {\"taskId\": " << record.taskId << "}}";
+        for (int i = 0; i < TRACE_STAGES; i++) {
+            out << ",\n{\"name\": \"" << TRACE_STAGE_NAMES[i] << "\", \"cat\": \"task\", \"ph\": \"b\", \"id\": "
+                << record.taskId << ", \"pid\": " << record.workerId + 1 << ", \"tid\": 0, \"ts\": " << at << "}";
+            at += durations[i] / 1000.0;
+            out << ",\n{\"name\": \"" << TRACE_STAGE_NAMES[i] << "\", \"cat\": \"task\", \"ph\": \"e\", \"id\": "
+                << record.taskId << ", \"pid\": " << record.workerId + 1 << ", \"tid\": 0, \"ts\": " << at << "}";
+        }
+        out << ",\n{\"name\": \"" << name << "\", \"cat\": \"task\", \"ph\": \"e\", \"id\": " << record.taskId
+            << ", \"pid\": " << record.workerId + 1 << ", \"tid\": 0, \"ts\": " << at << "}";
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include <cstdint>
+
+#include "Protocol.h"
+#include "Dispatcher.h"
+#include "LoadGen.h"
+
+constexpr size_t TRACE_MAX_RECORDS = 1u << 20;   // дальше записи только считаются
+
+// Этапы задачи в часах Browser, подряд от постановки до ответа
+enum class TraceStage {
+    QUEUE,      // очередь планировщика
+    SEND,       // пакет диспетчера, канал или кольцо, чтение воркером
+    WAIT,       // очередь вычислительных потоков воркера
+    COMPUTE,
+    REPLY,      // очередь записи ответов воркера
+    RETURN,     // канал обратно, разбор диспетчером
+    COUNT
+};
+
+const char* TraceStageName(TraceStage stage);
+
+// Отметки задач с TASK_FLAG_TRACE. Смещение часов воркера оценивается
+// как в NTP: по выборке с наименьшей задержкой туда и обратно
+// за вычетом времени внутри воркера
+class TaskTracer {
+private:
+    struct Record {
+        uint32_t taskId;
+        MessageType type;
+        int workerId;
+        TraceStamps stamps;
+        uint64_t received;    // Browser
+    };
+
+    struct ClockOffset {
+        int64_t offset = 0;   // часы воркера минус часы Browser
+        uint64_t bestRoundTrip = ~0ull;
+    };
+
+    bool enabled;
+    std::vector<Record> records;
+    std::map<uint32_t, MessageType> sent;
+    std::vector<ClockOffset> offsets;
+    uint64_t dropped;
+
+    // Отметки записи в часах Browser, этапы не короче нуля
+    void Stages(const Record& record, uint64_t stages[(int)TraceStage::COUNT], uint64_t& start) const;
+
+public:
+    TaskTracer();
+
+    void Enable(bool enable) { enabled = enable; }
+    bool Enabled() const { return enabled; }
+
+    void OnSent(uint32_t taskId, MessageType type);
+    // Ответ на задачу после OnSent; с RESULT_FLAG_TRACE отметки
+    // из completion.trace сохраняются
+    void OnCompleted(const Completion& completion);
+    // Забыть задачи с taskId меньше first (прогрев); оценки смещений остаются
+    void DropBefore(uint32_t first);
+    void Clear();
+
+    size_t Count() const { return records.size(); }
+    int64_t Offset(int workerId) const;
+
+    // Гистограмма на этап и на задачу целиком (последняя)
+    void Breakdown(std::vector<LatencyHistogram>& stages) const;
+    void PrintBreakdown(std::ostream& out) const;
+    // Файл trace-событий Chrome (chrome://tracing, Perfetto): задача -
+    // асинхронный интервал в процессе своего воркера, этапы вложены в него
+    bool WriteChromeTrace(const std::string& path) const;
+};
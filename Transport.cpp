@@ -0,0 +1,471 @@
+#include "Transport.h"
+#include "Protocol.h"
+#include <iostream>
+#include <cstring>
+
+#ifdef _WIN32
+
+constexpr size_t SEND_COALESCE_LIMIT = 64 * 1024;
+constexpr DWORD PIPE_BUFFER_SIZE = 64 * 1024;
+
+NamedPipeTransport::NamedPipeTransport(HANDLE hSend, HANDLE hReceive, bool overlapped)
+    : hSendPipe(hSend), hReceivePipe(hReceive), overlappedReceive(overlapped), hReceiveEvent(NULL) {}
+
+NamedPipeTransport::~NamedPipeTransport() {
+    Close();
+}
+
+bool NamedPipeTransport::WriteAll(const void* data, size_t size) {
+    const char* src = (const char*)data;
+    while (size > 0) {
+        DWORD bytesWritten;
+        if (!WriteFile(hSendPipe, src, (DWORD)size, &bytesWritten, NULL) || bytesWritten == 0) {
+            return false;
+        }
+        src += bytesWritten;
+        size -= bytesWritten;
+    }
+    return true;
+}
+
+bool NamedPipeTransport::Send(const IoSlice* slices, size_t count) {
+    if (count == 1) {
+        return WriteAll(slices[0].data, slices[0].size);
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += slices[i].size;
+    }
+
+    // WriteFileGather не работает с каналами: мелкие кадры склеиваем
+    // в один WriteFile, крупные пишем по фрагментам без копирования
+    if (total <= SEND_COALESCE_LIMIT) {
+        staging.resize(total);
+        size_t offset = 0;
+        for (size_t i = 0; i < count; i++) {
+            memcpy(staging.data() + offset, slices[i].data, slices[i].size);
+            offset += slices[i].size;
+        }
+        return WriteAll(staging.data(), total);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!WriteAll(slices[i].data, slices[i].size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t NamedPipeTransport::ReceiveSome(void* buffer, size_t size) {
+    DWORD bytesRead;
+
+    // Канал в байтовом режиме: ReadFile отдаёт то, что уже есть в канале
+    if (!overlappedReceive) {
+        if (!ReadFile(hReceivePipe, buffer, (DWORD)size, &bytesRead, NULL)) {
+            return 0;
+        }
+        return bytesRead;
+    }
+
+    if (hReceiveEvent == NULL) {
+        hReceiveEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        if (hReceiveEvent == NULL) {
+            return 0;
+        }
+    }
+
+    OVERLAPPED overlapped;
+    ZeroMemory(&overlapped, sizeof(overlapped));
+    // Младший бит события: завершение не попадает в порт диспетчера
+    overlapped.hEvent = (HANDLE)((ULONG_PTR)hReceiveEvent | 1);
+
+    if (!ReadFile(hReceivePipe, buffer, (DWORD)size, NULL, &overlapped) &&
+        GetLastError() != ERROR_IO_PENDING) {
+        return 0;
+    }
+
+    if (!GetOverlappedResult(hReceivePipe, &overlapped, &bytesRead, TRUE)) {
+        return 0;
+    }
+    return bytesRead;
+}
+
+void NamedPipeTransport::Close() {
+    if (hSendPipe != INVALID_HANDLE_VALUE) {
+        CloseHandle(hSendPipe);
+        hSendPipe = INVALID_HANDLE_VALUE;
+    }
+    if (hReceivePipe != INVALID_HANDLE_VALUE) {
+        CloseHandle(hReceivePipe);
+        hReceivePipe = INVALID_HANDLE_VALUE;
+    }
+    if (hReceiveEvent != NULL) {
+        CloseHandle(hReceiveEvent);
+        hReceiveEvent = NULL;
+    }
+}
+
+TransportEndpoint::TransportEndpoint()
+    : workerId(-1), hInputPipe(INVALID_HANDLE_VALUE), hOutputPipe(INVALID_HANDLE_VALUE) {}
+
+TransportEndpoint::~TransportEndpoint() {
+    Close();
+}
+
+bool TransportEndpoint::Create(uint32_t instance, int id) {
+    workerId = id;
+
+    SECURITY_ATTRIBUTES sa;
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.bInheritHandle = TRUE;
+    sa.lpSecurityDescriptor = NULL;
+
+    std::string inputPipeName = GetInputPipeName(instance, workerId);
+    std::string outputPipeName = GetOutputPipeName(instance, workerId);
+
+    // FILE_FLAG_FIRST_PIPE_INSTANCE: канал с таким именем уже есть - ошибка,
+    // а не второй экземпляр чужого канала
+
+    hInputPipe = CreateNamedPipeA(
+        inputPipeName.c_str(),
+        PIPE_ACCESS_OUTBOUND | FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+        1,
+        PIPE_BUFFER_SIZE,
+        PIPE_BUFFER_SIZE,
+        0,
+        &sa
+    );
+
+    if (hInputPipe == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to create input pipe for worker " << workerId
+            << ". Error: " << GetLastError() << std::endl;
+        return false;
+    }
+
+    hOutputPipe = CreateNamedPipeA(
+        outputPipeName.c_str(),
+        PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+        1,
+        PIPE_BUFFER_SIZE,
+        PIPE_BUFFER_SIZE,
+        0,
+        &sa
+    );
+
+    if (hOutputPipe == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to create output pipe for worker " << workerId
+            << ". Error: " << GetLastError() << std::endl;
+        CloseHandle(hInputPipe);
+        hInputPipe = INVALID_HANDLE_VALUE;
+        return false;
+    }
+
+    return true;
+}
+
+std::unique_ptr<Transport> TransportEndpoint::Accept(int timeoutMs) {
+    OVERLAPPED overlapped;
+    ZeroMemory(&overlapped, sizeof(overlapped));
+    overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (overlapped.hEvent == NULL) {
+        return nullptr;
+    }
+
+    // Воркер открывает канал задач раньше канала результатов, поэтому
+    // ждём канал результатов: он открыт с FILE_FLAG_OVERLAPPED и
+    // ожидание можно ограничить по времени
+    bool connected = true;
+    DWORD err = ERROR_SUCCESS;
+    if (!ConnectNamedPipe(hOutputPipe, &overlapped)) {
+        err = GetLastError();
+        if (err == ERROR_IO_PENDING) {
+            DWORD waitResult = WaitForSingleObject(overlapped.hEvent,
+                timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs);
+            if (waitResult != WAIT_OBJECT_0) {
+                CancelIo(hOutputPipe);
+                err = WAIT_TIMEOUT;
+            }
+            DWORD unused;
+            connected = GetOverlappedResult(hOutputPipe, &overlapped, &unused, TRUE) != FALSE &&
+                waitResult == WAIT_OBJECT_0;
+        }
+        else if (err != ERROR_PIPE_CONNECTED) {
+            connected = false;
+        }
+    }
+    CloseHandle(overlapped.hEvent);
+
+    if (!connected) {
+        std::cerr << "Failed to connect to worker " << workerId
+            << " output pipe. Error: " << err << std::endl;
+        return nullptr;
+    }
+
+    if (!ConnectNamedPipe(hInputPipe, NULL)) {
+        err = GetLastError();
+        if (err != ERROR_PIPE_CONNECTED) {
+            std::cerr << "Failed to connect to worker " << workerId
+                << " input pipe. Error: " << err << std::endl;
+            return nullptr;
+        }
+    }
+
+    std::unique_ptr<Transport> transport(new NamedPipeTransport(hInputPipe, hOutputPipe, true));
+    hInputPipe = INVALID_HANDLE_VALUE;
+    hOutputPipe = INVALID_HANDLE_VALUE;
+    return transport;
+}
+
+void TransportEndpoint::Close() {
+    if (hInputPipe != INVALID_HANDLE_VALUE) {
+        CloseHandle(hInputPipe);
+        hInputPipe = INVALID_HANDLE_VALUE;
+    }
+    if (hOutputPipe != INVALID_HANDLE_VALUE) {
+        CloseHandle(hOutputPipe);
+        hOutputPipe = INVALID_HANDLE_VALUE;
+    }
+}
+
+static HANDLE OpenPipe(const std::string& name, DWORD access) {
+    while (true) {
+        HANDLE hPipe = CreateFileA(
+            name.c_str(),
+            access,
+            0,
+            NULL,
+            OPEN_EXISTING,
+            0,
+            NULL
+        );
+
+        if (hPipe != INVALID_HANDLE_VALUE) {
+            return hPipe;
+        }
+
+        if (GetLastError() != ERROR_PIPE_BUSY) {
+            return INVALID_HANDLE_VALUE;
+        }
+
+        WaitNamedPipeA(name.c_str(), 5000);
+    }
+}
+
+std::unique_ptr<Transport> ConnectToBrowser(uint32_t instance, int workerId) {
+    HANDLE hInputPipe = OpenPipe(GetInputPipeName(instance, workerId), GENERIC_READ);
+    if (hInputPipe == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    HANDLE hOutputPipe = OpenPipe(GetOutputPipeName(instance, workerId), GENERIC_WRITE);
+    if (hOutputPipe == INVALID_HANDLE_VALUE) {
+        CloseHandle(hInputPipe);
+        return nullptr;
+    }
+
+    return std::unique_ptr<Transport>(new NamedPipeTransport(hOutputPipe, hInputPipe, false));
+}
+
+#else
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+
+constexpr int MAX_SLICES = 16;
+constexpr int CONNECT_TIMEOUT_MS = 5000;
+
+UnixSocketTransport::UnixSocketTransport(int socketFd) : fd(socketFd) {}
+
+UnixSocketTransport::~UnixSocketTransport() {
+    Close();
+}
+
+bool UnixSocketTransport::Send(const IoSlice* slices, size_t count) {
+    if (count > MAX_SLICES) {
+        return false;
+    }
+
+    iovec iov[MAX_SLICES];
+    int iovCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (slices[i].size > 0) {
+            iov[iovCount].iov_base = const_cast<void*>(slices[i].data);
+            iov[iovCount].iov_len = slices[i].size;
+            iovCount++;
+        }
+    }
+
+    iovec* current = iov;
+    while (iovCount > 0) {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = current;
+        msg.msg_iovlen = iovCount;
+
+        ssize_t written = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        while (iovCount > 0 && (size_t)written >= current->iov_len) {
+            written -= current->iov_len;
+            current++;
+            iovCount--;
+        }
+        if (iovCount > 0) {
+            current->iov_base = (char*)current->iov_base + written;
+            current->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+size_t UnixSocketTransport::ReceiveSome(void* buffer, size_t size) {
+    while (true) {
+        ssize_t bytesRead = recv(fd, buffer, size, 0);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        return bytesRead > 0 ? (size_t)bytesRead : 0;
+    }
+}
+
+void UnixSocketTransport::Close() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+TransportEndpoint::TransportEndpoint() : workerId(-1), listenFd(-1) {}
+
+TransportEndpoint::~TransportEndpoint() {
+    Close();
+}
+
+bool TransportEndpoint::Create(uint32_t instance, int id) {
+    workerId = id;
+    std::string socketPath = GetSocketPath(instance, workerId);
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long: " << socketPath << std::endl;
+        return false;
+    }
+    memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        std::cerr << "Failed to create socket for worker " << workerId
+            << ". Error: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Чужой файл по этому пути не удаляется: bind вернёт EADDRINUSE
+    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "Failed to bind " << socketPath
+            << ". Error: " << strerror(errno) << std::endl;
+        Close();
+        return false;
+    }
+    path = socketPath;
+
+    if (listen(listenFd, 1) < 0) {
+        std::cerr << "Failed to listen on " << path
+            << ". Error: " << strerror(errno) << std::endl;
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+std::unique_ptr<Transport> TransportEndpoint::Accept(int timeoutMs) {
+    pollfd pfd;
+    pfd.fd = listenFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ready;
+    do {
+        ready = poll(&pfd, 1, timeoutMs);
+    } while (ready < 0 && errno == EINTR);
+
+    if (ready <= 0) {
+        std::cerr << "Worker " << workerId << " did not connect in time" << std::endl;
+        return nullptr;
+    }
+
+    int fd;
+    do {
+        fd = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+
+    if (fd < 0) {
+        std::cerr << "Failed to accept worker " << workerId
+            << ". Error: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    Close();
+    return std::unique_ptr<Transport>(new UnixSocketTransport(fd));
+}
+
+void TransportEndpoint::Close() {
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+    // Удаляется только сокет, созданный этим endpoint
+    if (!path.empty()) {
+        unlink(path.c_str());
+        path.clear();
+    }
+}
+
+std::unique_ptr<Transport> ConnectToBrowser(uint32_t instance, int workerId) {
+    std::string path = GetSocketPath(instance, workerId);
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return nullptr;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    for (int waited = 0; waited < CONNECT_TIMEOUT_MS; waited += 10) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return nullptr;
+        }
+
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0) {
+            return std::unique_ptr<Transport>(new UnixSocketTransport(fd));
+        }
+
+        int err = errno;
+        close(fd);
+        if (err != ENOENT && err != ECONNREFUSED && err != EINTR) {
+            return nullptr;
+        }
+        usleep(10 * 1000);
+    }
+
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE NativeHandle;
+#else
+typedef int NativeHandle;
+#endif
+
+// Фрагмент данных для записи одним вызовом (аналог iovec)
+struct IoSlice {
+    const void* data;
+    size_t size;
+};
+
+// Двунаправленный канал между Browser и одним воркером
+class Transport {
+public:
+    virtual ~Transport() {}
+
+    // Записывает все фрагменты как один непрерывный кадр
+    virtual bool Send(const IoSlice* slices, size_t count) = 0;
+    // Читает то, что уже пришло, но не больше size байт и не меньше
+    // одного; 0 - канал закрыт
+    virtual size_t ReceiveSome(void* buffer, size_t size) = 0;
+    virtual void Close() = 0;
+
+    // Дескриптор входящего направления для диспетчера
+    virtual NativeHandle ReceiveHandle() const = 0;
+
+    bool SendFrame(const void* header, size_t headerSize, const void* payload, size_t payloadSize) {
+        IoSlice slices[2] = { { header, headerSize }, { payload, payloadSize } };
+        return Send(slices, payloadSize > 0 ? 2 : 1);
+    }
+
+    // Читает ровно size байт
+    bool Receive(void* buffer, size_t size) {
+        char* dst = (char*)buffer;
+        while (size > 0) {
+            size_t bytesRead = ReceiveSome(dst, size);
+            if (bytesRead == 0) {
+                return false;
+            }
+            dst += bytesRead;
+            size -= bytesRead;
+        }
+        return true;
+    }
+};
+
+#ifdef _WIN32
+
+// Пара именованных каналов: один на отправку, второй на приём
+class NamedPipeTransport : public Transport {
+private:
+    HANDLE hSendPipe;
+    HANDLE hReceivePipe;
+    bool overlappedReceive; // приёмный канал открыт с FILE_FLAG_OVERLAPPED
+    HANDLE hReceiveEvent;
+    std::vector<char> staging;
+
+    bool WriteAll(const void* data, size_t size);
+
+public:
+    NamedPipeTransport(HANDLE hSend, HANDLE hReceive, bool overlapped);
+    ~NamedPipeTransport();
+
+    bool Send(const IoSlice* slices, size_t count) override;
+    size_t ReceiveSome(void* buffer, size_t size) override;
+    void Close() override;
+    NativeHandle ReceiveHandle() const override { return hReceivePipe; }
+};
+
+#else
+
+// Unix-domain сокет; кадры уходят одним writev
+class UnixSocketTransport : public Transport {
+private:
+    int fd;
+
+public:
+    explicit UnixSocketTransport(int socketFd);
+    ~UnixSocketTransport();
+
+    bool Send(const IoSlice* slices, size_t count) override;
+    size_t ReceiveSome(void* buffer, size_t size) override;
+    void Close() override;
+    NativeHandle ReceiveHandle() const override { return fd; }
+};
+
+#endif
+
+// Серверная точка подключения, которую Browser создаёт до запуска воркера
+class TransportEndpoint {
+private:
+    int workerId;
+#ifdef _WIN32
+    HANDLE hInputPipe;
+    HANDLE hOutputPipe;
+#else
+    int listenFd;
+    std::string path;   // сокет, созданный bind; пусто - удалять нечего
+#endif
+
+public:
+    TransportEndpoint();
+    ~TransportEndpoint();
+
+    // instance - PID Browser, входит в имена каналов и путь сокета
+    bool Create(uint32_t instance, int workerId);
+    // Ждёт подключения воркера не дольше timeoutMs (-1 - без ограничения)
+    std::unique_ptr<Transport> Accept(int timeoutMs = -1);
+    void Close();
+};
+
+// Подключение со стороны воркера
+std::unique_ptr<Transport> ConnectToBrowser(uint32_t instance, int workerId);
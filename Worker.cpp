@@ -1,141 +1,847 @@
-#include <windows.h>
-#include <string>
-#include <iostream>
-#include <cstring>
+#include "Worker.h"
 
-struct TaskMessage {
-    uint32_t type;
-    uint32_t taskId;
-    uint32_t dataSize;
-    char data[1];
-};
-
-struct ResultMessage {
-    uint32_t taskId;
-    uint32_t resultSize;
-    char data[1];
-};
+static const char* ResolvePayload(const TaskMessage& header, const char* data,
+    const ShmRingView& ring, uint32_t& payloadSize) {
+    payloadSize = header.dataSize;
+    if (!(header.flags & TASK_FLAG_SHM_PAYLOAD)) {
+        return data;
+    }
 
-uint32_t CountSubstring(const char* text, const char* pattern) {
-    if (!text || !pattern || pattern[0] == '\0') return 0;
+    ShmDescriptor descriptor;
+    payloadSize = 0;
+    if (header.dataSize != sizeof(descriptor)) {
+        return nullptr;
+    }
 
-    uint32_t count = 0;
-    const char* pos = text;
-    size_t len = strlen(pattern);
+    memcpy(&descriptor, data, sizeof(descriptor));
+    const char* payload = ring.Resolve(descriptor);
+    if (payload) {
+        payloadSize = descriptor.size;
+    }
+    return payload;
+}
 
-    while ((pos = strstr(pos, pattern)) != nullptr) {
-        count++;
-        pos += len;
+// extraParam = длина образца: текст, затем образец, оба без терминаторов.
+// extraParam = 0: старый формат "text\0pattern\0"
+static bool SplitSubstringPayload(const TaskMessage& header, const char* payload, uint32_t payloadSize,
+    const char*& text, size_t& textLength, const char*& pattern, size_t& patternLength) {
+    if (header.extraParam > 0) {
+        if (header.extraParam > payloadSize) {
+            return false;
+        }
+        patternLength = header.extraParam;
+        textLength = payloadSize - patternLength;
+        text = payload;
+        pattern = payload + textLength;
+        return true;
     }
-    return count;
+
+    const char* end = payload + payloadSize;
+    text = payload;
+    textLength = strnlen(text, payloadSize);
+    pattern = textLength < payloadSize ? text + textLength + 1 : end;
+    patternLength = strnlen(pattern, end - pattern);
+    return true;
 }
 
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: Worker.exe <worker_id>" << std::endl;
-        return 1;
+constexpr uint32_t MULTI_PATTERN_SIMD_LIMIT = 16;
+
+// Несколько образцов за один приём текста: до MULTI_PATTERN_SIMD_LIMIT
+// образцов - отдельными проходами CountSubstring, больше - автоматом из кэша
+static void CountMultiPattern(const TaskMessage& header, const char* payload, uint32_t payloadSize,
+    WorkerContext& context, TaskScratch& scratch, MessageBuffer& out) {
+    uint32_t patternCount = header.extraParam;
+    if (patternCount == 0 || patternCount > MAX_PATTERNS ||
+        (uint64_t)patternCount * sizeof(uint32_t) > payloadSize) {
+        return;
     }
 
-    int workerId = atoi(argv[1]);
+    const char* lengthTable = payload + payloadSize - patternCount * sizeof(uint32_t);
+    uint64_t patternBytes = 0;
+    std::vector<PatternRef>& patterns = scratch.patterns;
+    patterns.resize(patternCount);
+    for (uint32_t i = 0; i < patternCount; i++) {
+        uint32_t length;
+        memcpy(&length, lengthTable + i * sizeof(uint32_t), sizeof(length));
+        patterns[i].length = length;
+        patternBytes += length;
+    }
 
-    std::string inputPipeName = "\\\\.\\pipe\\worker_in_" + std::to_string(workerId);
-    std::string outputPipeName = "\\\\.\\pipe\\worker_out_" + std::to_string(workerId);
+    if (patternBytes > (uint64_t)(lengthTable - payload)) {
+        return;
+    }
 
-    HANDLE hInputPipe = INVALID_HANDLE_VALUE;
-    HANDLE hOutputPipe = INVALID_HANDLE_VALUE;
+    const char* patternData = lengthTable - patternBytes;
+    const char* cursor = patternData;
+    for (PatternRef& pattern : patterns) {
+        pattern.data = cursor;
+        cursor += pattern.length;
+    }
 
-    while (true) {
-        hInputPipe = CreateFileA(
-            inputPipeName.c_str(),
-            GENERIC_READ,
-            0,
-            NULL,
-            OPEN_EXISTING,
-            0,
-            NULL
-        );
+    // Счётчики пишутся прямо в ответ
+    size_t countsOffset = out.Size();
+    out.Resize(countsOffset + patternCount * sizeof(uint32_t));
+    uint32_t* counts = (uint32_t*)(out.Data() + countsOffset);
+    size_t textLength = patternData - payload;
 
-        if (hInputPipe != INVALID_HANDLE_VALUE) break;
+    if (patternCount <= MULTI_PATTERN_SIMD_LIMIT) {
+        // Несколько векторных проходов по кэшу быстрее обхода автомата
+        for (uint32_t i = 0; i < patternCount; i++) {
+            counts[i] = CountSubstring(payload, textLength, patterns[i].data, patterns[i].length);
+        }
+    }
+    else {
+        // Ключ кэша - образцы вместе с таблицей длин, они лежат подряд
+        std::shared_ptr<AhoCorasick> automaton = context.automata.Get(patternData,
+            payload + payloadSize - patternData, patterns);
+        if (!automaton) {
+            out.Resize(countsOffset);
+            return;
+        }
+        automaton->Count(payload, textLength, counts);
+    }
+}
 
-        if (GetLastError() != ERROR_PIPE_BUSY) {
-            return 1;
+// TASK_SEPIA, TASK_INVERT. Плитка из кольца обрабатывается на месте, Browser
+// забирает её оттуда сам; иначе плитка копируется в ответ. false - ответ пустой
+static bool ProcessImageTask(const TaskMessage& header, const char* payload, uint32_t payloadSize,
+    MessageBuffer& out, uint32_t& resultFlags) {
+    ImageTile tile;
+    if (payloadSize < sizeof(tile)) {
+        return false;
+    }
+    memcpy(&tile, payload, sizeof(tile));
+
+    uint32_t stride = ImageParamStride(header.extraParam);
+    if ((uint64_t)tile.rows * stride != payloadSize - sizeof(tile)) {
+        return false;
+    }
+
+    ImageOp op = header.type == MessageType::TASK_SEPIA ? ImageOp::SEPIA : ImageOp::INVERT;
+    PixelFormat format = ImageParamFormat(header.extraParam);
+    const char* rows = payload + sizeof(tile);
+
+    if (header.flags & TASK_FLAG_SHM_PAYLOAD) {
+        // Область кольца отображена на запись, до ответа Browser её не трогает
+        char* slot = const_cast<char*>(rows);
+        if (!ProcessImageRows(op, format, rows, slot, tile.width, tile.rows, stride)) {
+            return false;
         }
+        resultFlags |= RESULT_FLAG_IN_PLACE;
+        return true;
+    }
+
+    size_t offset = out.Size();
+    out.Resize(offset + payloadSize);
+    memcpy(out.Data() + offset, &tile, sizeof(tile));
+    if (!ProcessImageRows(op, format, rows, out.Data() + offset + sizeof(tile), tile.width, tile.rows, stride)) {
+        out.Resize(offset);
+        return false;
+    }
+    return true;
+}
 
-        WaitNamedPipeA(inputPipeName.c_str(), 5000);
+// TASK_SORT: ключи из кольца сортируются на месте, остальные - сразу в ответ
+static bool SortTask(const TaskMessage& header, const char* payload, uint32_t payloadSize,
+    TaskScratch& scratch, MessageBuffer& out, uint32_t& resultFlags) {
+    SortKey type = (SortKey)header.extraParam;
+    size_t keySize = SortKeySize(type);
+    if (keySize == 0 || payloadSize % keySize != 0) {
+        return false;
     }
+    size_t count = payloadSize / keySize;
 
-    while (true) {
-        hOutputPipe = CreateFileA(
-            outputPipeName.c_str(),
-            GENERIC_WRITE,
-            0,
-            NULL,
-            OPEN_EXISTING,
-            0,
-            NULL
-        );
+    if (header.flags & TASK_FLAG_SHM_PAYLOAD) {
+        RadixSortKeys(type, payload, const_cast<char*>(payload), count, scratch.sort);
+        resultFlags |= RESULT_FLAG_IN_PLACE;
+        return true;
+    }
 
-        if (hOutputPipe != INVALID_HANDLE_VALUE) break;
+    size_t offset = out.Size();
+    out.Resize(offset + payloadSize);
+    return RadixSortKeys(type, payload, out.Data() + offset, count, scratch.sort);
+}
+
+// Считает или перечисляет простые диапазона; при ошибке out не меняется
+static bool PrimesTask(const TaskMessage& header, const char* payload, uint32_t payloadSize,
+    WorkerContext& context, TaskScratch& scratch, MessageBuffer& out) {
+    PrimeRange range;
+    if (payloadSize != sizeof(range) || header.extraParam > (uint32_t)PrimeMode::LIST) {
+        return false;
+    }
+    memcpy(&range, payload, sizeof(range));
 
-        if (GetLastError() != ERROR_PIPE_BUSY) {
-            CloseHandle(hInputPipe);
-            return 1;
+    uint64_t count;
+    if ((PrimeMode)header.extraParam == PrimeMode::COUNT) {
+        if (!SievePrimes(range.lo, range.hi, context.primes, scratch.sieve, count, nullptr)) {
+            return false;
         }
+        out.Append(&count, sizeof(count));
+        return true;
+    }
 
-        WaitNamedPipeA(outputPipeName.c_str(), 5000);
+    if (range.hi < range.lo || range.hi - range.lo > PRIME_LIST_MAX_SPAN) {
+        return false;
+    }
+    size_t offset = out.Size();
+    if (!SievePrimes(range.lo, range.hi, context.primes, scratch.sieve, count, &out)) {
+        out.Resize(offset);
+        return false;
     }
+    return true;
+}
 
-    while (true) {
-        TaskMessage header;
-        DWORD bytesRead;
+// Загрузка B в кэш, умножение блока A на неё или освобождение
+static bool MatrixTask(const TaskMessage& header, const char* payload, uint32_t payloadSize,
+    WorkerContext& context, TaskScratch& scratch, MessageBuffer& out) {
+    MatrixHeader matrix;
+    if (payloadSize < sizeof(matrix) || header.extraParam > (uint32_t)MatrixOp::RELEASE) {
+        return false;
+    }
+    memcpy(&matrix, payload, sizeof(matrix));
+    if (matrix.type > (uint32_t)MatrixType::FLOAT64) {
+        return false;
+    }
+    MatrixType type = (MatrixType)matrix.type;
+    const char* data = payload + sizeof(matrix);
+    uint64_t dataSize = payloadSize - sizeof(matrix);
 
-        if (!ReadFile(hInputPipe, &header, sizeof(TaskMessage), &bytesRead, NULL)) {
-            break;
+    switch ((MatrixOp)header.extraParam) {
+    case MatrixOp::LOAD_B: {
+        uint32_t loadedRows;
+        if (dataSize != (uint64_t)matrix.rows * matrix.cols * MatrixTypeSize(type) ||
+            !context.matrices.Load(matrix, data, loadedRows)) {
+            return false;
         }
+        out.Append(&loadedRows, sizeof(loadedRows));
+        return true;
+    }
+    case MatrixOp::MULTIPLY: {
+        if (matrix.rows == 0 || dataSize != (uint64_t)matrix.rows * matrix.inner * MatrixTypeSize(type)) {
+            return false;
+        }
+        std::shared_ptr<const PackedMatrix> b = context.matrices.Get(matrix.handle, type, matrix.inner, matrix.cols);
+        if (!b) {
+            return false;
+        }
+        MultiplyPacked(data, matrix.rows, *b, scratch.gemm, out);
+        return true;
+    }
+    default: {
+        uint32_t released = context.matrices.Release(matrix.handle) ? 1 : 0;
+        out.Append(&released, sizeof(released));
+        return true;
+    }
+    }
+}
 
-        uint32_t totalSize = sizeof(TaskMessage) + header.dataSize;
-        TaskMessage* fullTask = (TaskMessage*)malloc(totalSize);
-        memcpy(fullTask, &header, sizeof(TaskMessage));
+// Пакет преобразований одной длины. Комплексные из кольца - на месте,
+// как плитки изображения
+static bool FourierTask(const TaskMessage& header, const char* payload, uint32_t payloadSize,
+    WorkerContext& context, TaskScratch& scratch, MessageBuffer& out, uint32_t& resultFlags) {
+    FourierHeader fourier;
+    if (payloadSize < sizeof(fourier) || header.extraParam > (uint32_t)FourierMode::REAL_INVERSE) {
+        return false;
+    }
+    memcpy(&fourier, payload, sizeof(fourier));
+
+    FourierMode mode = (FourierMode)header.extraParam;
+    if (!IsFourierSizeValid(mode, fourier.size) ||
+        (uint64_t)fourier.count * FourierInputSize(mode, fourier.size) != payloadSize - sizeof(fourier)) {
+        return false;
+    }
+    const char* data = payload + sizeof(fourier);
+
+    if ((header.flags & TASK_FLAG_SHM_PAYLOAD) && (mode == FourierMode::FORWARD || mode == FourierMode::INVERSE)) {
+        char* slot = const_cast<char*>(data);
+        if (!FourierTransform(mode, fourier.size, fourier.count, data, slot, context.fftPlans, scratch.fft)) {
+            return false;
+        }
+        resultFlags |= RESULT_FLAG_IN_PLACE;
+        return true;
+    }
 
-        if (header.dataSize > 0) {
-            if (!ReadFile(hInputPipe, fullTask->data, header.dataSize, &bytesRead, NULL)) {
-                free(fullTask);
-                break;
+    size_t offset = out.Size();
+    out.Resize(offset + sizeof(fourier) + fourier.count * FourierOutputSize(mode, fourier.size));
+    memcpy(out.Data() + offset, &fourier, sizeof(fourier));
+    if (!FourierTransform(mode, fourier.size, fourier.count, data, out.Data() + offset + sizeof(fourier),
+        context.fftPlans, scratch.fft)) {
+        out.Resize(offset);
+        return false;
+    }
+    return true;
+}
+
+// Частичная статистика или гистограмма куска; кольцо не трогают
+static bool StatsTask(const TaskMessage& header, const char* payload, uint32_t payloadSize, MessageBuffer& out) {
+    if (header.extraParam > (uint32_t)SampleType::FLOAT64) {
+        return false;
+    }
+    SampleType type = (SampleType)header.extraParam;
+    size_t sampleSize = SampleTypeSize(type);
+    if (payloadSize % sampleSize != 0) {
+        return false;
+    }
+
+    StatsPartial stats = EmptyStats();
+    ComputeStats(type, payload, payloadSize / sampleSize, stats);
+    out.Append(&stats, sizeof(stats));
+    return true;
+}
+
+static bool HistogramTask(const TaskMessage& header, const char* payload, uint32_t payloadSize,
+    TaskScratch& scratch, MessageBuffer& out) {
+    HistogramSpec spec;
+    if (payloadSize < sizeof(spec) || header.extraParam > (uint32_t)SampleType::FLOAT64) {
+        return false;
+    }
+    memcpy(&spec, payload, sizeof(spec));
+
+    SampleType type = (SampleType)header.extraParam;
+    size_t sampleSize = SampleTypeSize(type);
+    uint32_t dataSize = payloadSize - sizeof(spec);
+    if (!IsHistogramSpecValid(type, spec) || dataSize % sampleSize != 0) {
+        return false;
+    }
+
+    size_t offset = out.Size();
+    out.Resize(offset + ((size_t)spec.bins + 2) * sizeof(uint64_t));
+    std::vector<uint64_t>& counts = scratch.histogram.counts;
+    counts.assign((size_t)spec.bins + 2, 0);
+    ComputeHistogram(type, spec, payload + sizeof(spec), dataSize / sampleSize, scratch.histogram, counts.data());
+    memcpy(out.Data() + offset, counts.data(), counts.size() * sizeof(uint64_t));
+    return true;
+}
+
+// Загрузка куска графа, пакет запросов путей к нему или освобождение
+static bool GraphTask(const TaskMessage& header, const char* payload, uint32_t payloadSize,
+    WorkerContext& context, TaskScratch& scratch, MessageBuffer& out) {
+    GraphHeader graph;
+    switch ((GraphOp)header.extraParam) {
+    case GraphOp::LOAD: {
+        uint32_t loadedVertices;
+        if (payloadSize < sizeof(graph)) {
+            return false;
+        }
+        memcpy(&graph, payload, sizeof(graph));
+        if (!context.graphs.Load(graph, payload + sizeof(graph), payloadSize - sizeof(graph), loadedVertices)) {
+            return false;
+        }
+        out.Append(&loadedVertices, sizeof(loadedVertices));
+        return true;
+    }
+    case GraphOp::PATH: {
+        GraphQueryHeader query;
+        if (payloadSize < sizeof(query)) {
+            return false;
+        }
+        memcpy(&query, payload, sizeof(query));
+        if ((uint64_t)query.count * sizeof(GraphQuery) != payloadSize - sizeof(query)) {
+            return false;
+        }
+        std::shared_ptr<const CsrGraph> resident = context.graphs.Get(query.handle);
+        if (!resident) {
+            return false;
+        }
+
+        size_t offset = out.Size();
+        bool withPath = (query.flags & GRAPH_QUERY_WITH_PATH) != 0;
+        std::vector<uint32_t>* path = withPath ? &scratch.graph.path : nullptr;
+        for (uint32_t i = 0; i < query.count; i++) {
+            GraphQuery pair;
+            GraphPath result;
+            memcpy(&pair, payload + sizeof(query) + i * sizeof(pair), sizeof(pair));
+            if (!ShortestPath(*resident, pair.source, pair.target, scratch.graph, result, path)) {
+                out.Resize(offset);
+                return false;
             }
+            out.Append(&result, sizeof(result));
+            if (withPath) {
+                out.Append(path->data(), path->size() * sizeof(uint32_t));
+            }
+        }
+        return true;
+    }
+    case GraphOp::RELEASE: {
+        if (payloadSize != sizeof(graph)) {
+            return false;
+        }
+        memcpy(&graph, payload, sizeof(graph));
+        uint32_t released = context.graphs.Release(graph.handle) ? 1 : 0;
+        out.Append(&released, sizeof(released));
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Кодирование или распаковка куска потока; кольцо не трогают
+static bool RleTask(const TaskMessage& header, const char* payload, uint32_t payloadSize, MessageBuffer& out) {
+    switch ((RleOp)header.extraParam) {
+    case RleOp::ENCODE:
+        return RleEncode(payload, payloadSize, out);
+    case RleOp::DECODE:
+        return RleDecode(payload, payloadSize, MAX_DATA_SIZE, out);
+    default:
+        return false;
+    }
+}
+
+// Произведение части диапазона факториала в limbs или десятичной записью;
+// ответ не больше MAX_DATA_SIZE, при ошибке out не меняется
+static bool FactorialTask(const TaskMessage& header, const char* payload, uint32_t payloadSize, MessageBuffer& out) {
+    FactorialRange range;
+    if (payloadSize != sizeof(range) || header.extraParam > (uint32_t)FactorialFormat::DECIMAL) {
+        return false;
+    }
+    memcpy(&range, payload, sizeof(range));
+    if (range.lo < 1 || range.hi < range.lo || range.hi > FACTORIAL_MAX_N + 1) {
+        return false;
+    }
+
+    // Заведомо не помещающийся ответ не считается
+    bool decimal = (FactorialFormat)header.extraParam == FactorialFormat::DECIMAL;
+    double bits = RangeProductBits(range.lo, range.hi);
+    double estimate = decimal ? bits * 0.30103 : bits / 8 + sizeof(FactorialResult);
+    if (estimate > MAX_DATA_SIZE) {
+        return false;
+    }
+
+    BigInt product;
+    RangeProduct(range.lo, range.hi, product);
+    if (decimal) {
+        std::string digits;
+        BigToDecimal(product, digits);
+        if (digits.size() > MAX_DATA_SIZE) {
+            return false;
+        }
+        out.Append(digits.data(), digits.size());
+        return true;
+    }
+
+    FactorialResult result;
+    result.shift = product.shift;
+    result.limbs = (uint32_t)product.limbs.size();
+    if (sizeof(result) + product.limbs.size() * sizeof(uint32_t) > MAX_DATA_SIZE) {
+        return false;
+    }
+    out.Append(&result, sizeof(result));
+    out.Append(product.limbs.data(), product.limbs.size() * sizeof(uint32_t));
+    return true;
+}
+
+// XOR с повторяющимся ключом или потоком от счётчика. Байты общего буфера
+// и нагрузки из кольца меняются на месте, в ответ они не копируются
+static bool XorTask(const TaskMessage& header, const char* payload, uint32_t payloadSize,
+    WorkerContext& context, MessageBuffer& out, uint32_t& resultFlags) {
+    XorHeader xorHeader;
+    uint32_t keyLength = header.extraParam;
+    if (payloadSize < sizeof(xorHeader) || keyLength > XOR_MAX_KEY_LENGTH ||
+        payloadSize - sizeof(xorHeader) < keyLength) {
+        return false;
+    }
+    memcpy(&xorHeader, payload, sizeof(xorHeader));
+    const uint8_t* key = (const uint8_t*)payload + sizeof(xorHeader);
+    const char* bytes = payload + sizeof(xorHeader) + keyLength;
+    size_t size = payloadSize - sizeof(xorHeader) - keyLength;
+
+    if (xorHeader.flags & XOR_FLAG_UNMAP) {
+        uint32_t released = context.buffers.Unmap(xorHeader.buffer) ? 1 : 0;
+        out.Append(&released, sizeof(released));
+        return true;
+    }
+
+    std::shared_ptr<SharedRegion> buffer;
+    char* target;
+    if (xorHeader.flags & XOR_FLAG_SHARED) {
+        buffer = context.buffers.Get(xorHeader.buffer);
+        if (!buffer || size != 0 || xorHeader.offset > buffer->Size() ||
+            xorHeader.size > buffer->Size() - xorHeader.offset) {
+            return false;
+        }
+        target = buffer->Data() + xorHeader.offset;
+        bytes = target;
+        size = (size_t)xorHeader.size;
+    }
+    else if (header.flags & TASK_FLAG_SHM_PAYLOAD) {
+        // Область кольца отображена на запись, до ответа Browser её не трогает
+        target = const_cast<char*>(bytes);
+        resultFlags |= RESULT_FLAG_IN_PLACE;
+    }
+    else {
+        size_t offset = out.Size();
+        out.Resize(offset + size);
+        target = out.Data() + offset;
+    }
+
+    if (keyLength > 0) {
+        XorRepeating(bytes, target, size, key, keyLength, xorHeader.position);
+    }
+    else {
+        XorCounter(bytes, target, size, xorHeader.seed, xorHeader.position);
+    }
+
+    if (xorHeader.flags & XOR_FLAG_SHARED) {
+        out.Append(&xorHeader.size, sizeof(xorHeader.size));
+    }
+    return true;
+}
+
+// Ответ сжимается, если выборка обещает выигрыш; кадр, не уложившийся
+// в RLE_MAX_RATIO, отбрасывается и ответ уходит как есть
+static void PackResult(size_t resultOffset, TaskScratch& scratch, MessageBuffer& out, uint32_t& resultFlags) {
+    const char* result = out.Data() + resultOffset;
+    size_t resultSize = out.Size() - resultOffset;
+    if (!RleWorthTrying(result, resultSize)) {
+        return;
+    }
+
+    scratch.packed.Clear();
+    if (RleEncode(result, resultSize, scratch.packed, (size_t)(resultSize * RLE_MAX_RATIO))) {
+        out.Resize(resultOffset);
+        out.Append(scratch.packed.Data(), scratch.packed.Size());
+        resultFlags |= RESULT_FLAG_RLE;
+    }
+}
+
+// Дописывает ResultMessage задачи в конец out; received - время чтения
+// кадра задачи для TraceStamps
+static void ExecuteTask(const TaskMessage& frameHeader, const char* data, uint64_t received,
+    WorkerContext& context, TaskScratch& scratch, MessageBuffer& out) {
+    size_t headerOffset = out.Size();
+    out.Resize(headerOffset + RESULT_HEADER_SIZE);
+
+    // Отметки снимаются с начала data и возвращаются перед ответом
+    TaskMessage header = frameHeader;
+    TraceStamps trace;
+    bool traced = (header.flags & TASK_FLAG_TRACE) && header.dataSize >= sizeof(trace);
+    size_t resultOffset = out.Size();
+    if (traced) {
+        memcpy(&trace, data, sizeof(trace));
+        data += sizeof(trace);
+        header.dataSize -= sizeof(trace);
+        trace.received = received;
+        trace.computeStart = TraceClock();
+        out.Append(&trace, sizeof(trace));
+        resultOffset = out.Size();
+    }
+    header.flags &= ~TASK_FLAG_TRACE;
+
+    uint32_t payloadSize;
+    const char* payload = ResolvePayload(header, data, context.ring, payloadSize);
+    if (payload && (header.flags & TASK_FLAG_RLE)) {
+        scratch.unpacked.Clear();
+        bool unpacked = !(header.flags & TASK_FLAG_SHM_PAYLOAD) &&
+            RleDecode(payload, payloadSize, MAX_DATA_SIZE, scratch.unpacked);
+        payload = unpacked ? scratch.unpacked.Data() : nullptr;
+        payloadSize = unpacked ? (uint32_t)scratch.unpacked.Size() : 0;
+    }
+
+    const char* text;
+    size_t textLength;
+    const char* pattern;
+    size_t patternLength;
+    uint32_t resultFlags = 0;
+
+    if ((header.type == MessageType::TASK_SEPIA || header.type == MessageType::TASK_INVERT) && payload) {
+        ProcessImageTask(header, payload, payloadSize, out, resultFlags);
+    }
+    else if (header.type == MessageType::TASK_SORT && payload) {
+        SortTask(header, payload, payloadSize, scratch, out, resultFlags);
+    }
+    else if (header.type == MessageType::TASK_CRC32 && payload &&
+        header.extraParam <= (uint32_t)CrcKind::CRC32C) {
+        uint32_t crc = Crc32((CrcKind)header.extraParam, 0, payload, payloadSize);
+        out.Append(&crc, sizeof(crc));
+    }
+    else if (header.type == MessageType::TASK_PRIMES && payload) {
+        PrimesTask(header, payload, payloadSize, context, scratch, out);
+    }
+    else if (header.type == MessageType::TASK_MATRIX_MULT && payload) {
+        MatrixTask(header, payload, payloadSize, context, scratch, out);
+    }
+    else if (header.type == MessageType::TASK_FOURIER && payload) {
+        FourierTask(header, payload, payloadSize, context, scratch, out, resultFlags);
+    }
+    else if (header.type == MessageType::TASK_STATS && payload) {
+        StatsTask(header, payload, payloadSize, out);
+    }
+    else if (header.type == MessageType::TASK_HISTOGRAM && payload) {
+        HistogramTask(header, payload, payloadSize, scratch, out);
+    }
+    else if (header.type == MessageType::TASK_RLE && payload) {
+        RleTask(header, payload, payloadSize, out);
+    }
+    else if (header.type == MessageType::TASK_GRAPH_PATH && payload) {
+        GraphTask(header, payload, payloadSize, context, scratch, out);
+    }
+    else if (header.type == MessageType::TASK_FACTORIAL && payload) {
+        FactorialTask(header, payload, payloadSize, out);
+    }
+    else if (header.type == MessageType::TASK_XOR && payload) {
+        XorTask(header, payload, payloadSize, context, out, resultFlags);
+    }
+    else if (header.type == MessageType::TASK_SUBSTRING && payload &&
+        (header.flags & TASK_FLAG_MULTI_PATTERN)) {
+        CountMultiPattern(header, payload, payloadSize, context, scratch, out);
+    }
+    else if (header.type == MessageType::TASK_SUBSTRING && payload &&
+        (header.flags & TASK_FLAG_STREAM_CHUNK) &&
+        SplitSubstringPayload(header, payload, payloadSize, text, textLength, pattern, patternLength)) {
+        std::vector<ChunkEntry>& entries = scratch.entries;
+        CountSubstringChunk(text, textLength, pattern, patternLength, entries);
+
+        uint32_t entryCount = (uint32_t)entries.size();
+        out.Append(&entryCount, sizeof(entryCount));
+        out.Append(entries.data(), entries.size() * sizeof(ChunkEntry));
+    }
+    else if (header.type == MessageType::TASK_SUBSTRING && payload &&
+        SplitSubstringPayload(header, payload, payloadSize, text, textLength, pattern, patternLength)) {
+        uint32_t count = CountSubstring(text, textLength, pattern, patternLength);
+        out.Append(&count, sizeof(count));
+    }
+
+    // Ответ TASK_RLE уже сжат или нужен как есть
+    if (header.type != MessageType::TASK_RLE) {
+        PackResult(resultOffset, scratch, out, resultFlags);
+    }
+
+    if (traced) {
+        trace.computeEnd = TraceClock();
+        memcpy(out.Data() + resultOffset - sizeof(trace), &trace, sizeof(trace));
+        resultFlags |= RESULT_FLAG_TRACE;
+    }
+
+    ResultMessage result = MakeResultHeader(header.taskId,
+        (uint32_t)(out.Size() - headerOffset - RESULT_HEADER_SIZE), resultFlags);
+    memcpy(out.Data() + headerOffset, &result, RESULT_HEADER_SIZE);
+}
+
+TaskReader::TaskReader(Transport& source) : transport(source), consumed(0) {
+    staging.Reserve(TASK_READ_SIZE);
+}
+
+bool TaskReader::Fill() {
+    size_t buffered = staging.Size() - consumed;
+    if (consumed > 0) {
+        memmove(staging.Data(), staging.Data() + consumed, buffered);
+        consumed = 0;
+    }
+
+    staging.Resize(TASK_READ_SIZE);
+    size_t bytesRead = transport.ReceiveSome(staging.Data() + buffered, TASK_READ_SIZE - buffered);
+    staging.Resize(buffered + bytesRead);
+    return bytesRead > 0;
+}
+
+bool TaskReader::Next(TaskMessage& header, MessageBuffer& payload) {
+    while (staging.Size() - consumed < TASK_HEADER_SIZE) {
+        if (!Fill()) {
+            return false;
         }
+    }
 
-        ResultMessage* result = nullptr;
-        uint32_t resultSize = 0;
+    memcpy(&header, staging.Data() + consumed, TASK_HEADER_SIZE);
+    consumed += TASK_HEADER_SIZE;
 
-        if (fullTask->type == 7) {
-            const char* dataPtr = fullTask->data;
-            std::string text(dataPtr);
-            dataPtr += text.length() + 1;
-            std::string pattern(dataPtr);
+    if (header.dataSize > MaxTaskDataSize(header.flags)) {
+        return false;
+    }
 
-            uint32_t count = CountSubstring(text.c_str(), pattern.c_str());
-            resultSize = sizeof(uint32_t);
-            result = (ResultMessage*)malloc(sizeof(ResultMessage) + resultSize);
-            result->taskId = fullTask->taskId;
-            result->resultSize = resultSize;
-            memcpy(result->data, &count, resultSize);
+    // Начало полезной нагрузки уже прочитано вместе с заголовком,
+    // остаток читается сразу на место
+    size_t buffered = staging.Size() - consumed;
+    if (buffered > header.dataSize) {
+        buffered = header.dataSize;
+    }
+
+    payload.Clear();
+    payload.Resize(header.dataSize);
+    if (buffered > 0) {
+        memcpy(payload.Data(), staging.Data() + consumed, buffered);
+        consumed += buffered;
+    }
+
+    return transport.Receive(payload.Data() + buffered, header.dataSize - buffered);
+}
+
+// Ответ на кадр: ResultMessage задачи или пакет ответов на подзадачи
+static void ExecuteFrame(const WorkerJob& job, WorkerContext& context, TaskScratch& scratch,
+    MessageBuffer& results) {
+    if (job.header.type != MessageType::TASK_BATCH) {
+        ExecuteTask(job.header, job.frame.Data(), job.received, context, scratch, results);
+        return;
+    }
+
+    results.Resize(RESULT_HEADER_SIZE);
+
+    const char* cursor = job.frame.Data();
+    const char* end = job.frame.Data() + job.frame.Size();
+    for (uint32_t i = 0; i < job.header.extraParam && (size_t)(end - cursor) >= TASK_HEADER_SIZE; i++) {
+        TaskMessage sub;
+        memcpy(&sub, cursor, TASK_HEADER_SIZE);
+        cursor += TASK_HEADER_SIZE;
+        if (sub.dataSize > (size_t)(end - cursor)) {
+            break;
         }
-        else if (fullTask->type == 999) {
+        ExecuteTask(sub, cursor, job.received, context, scratch, results);
+        cursor += sub.dataSize;
+    }
+
+    ResultMessage batch = MakeResultHeader(job.header.taskId,
+        (uint32_t)(results.Size() - RESULT_HEADER_SIZE), RESULT_FLAG_BATCH);
+    memcpy(results.Data(), &batch, RESULT_HEADER_SIZE);
+}
+
+static void ComputeLoop(BlockingQueue<WorkerJob>& jobs, BlockingQueue<MessageBuffer>& results,
+    WorkerContext& context) {
+    TaskScratch scratch;
+    WorkerJob job;
+
+    while (jobs.Pop(job)) {
+        MessageBuffer result;
+        ExecuteFrame(job, context, scratch, result);
+        job.frame.Release();
+        results.Push(std::move(result));
+    }
+}
+
+// Отметка отправки в ответах с RESULT_FLAG_TRACE, в пакете - в каждом
+static void StampReplies(MessageBuffer& frame, uint64_t now) {
+    ResultMessage header;
+    memcpy(&header, frame.Data(), RESULT_HEADER_SIZE);
+    char* cursor = frame.Data();
+    char* end = frame.Data() + frame.Size();
+    if (header.flags & RESULT_FLAG_BATCH) {
+        cursor += RESULT_HEADER_SIZE;
+    }
+
+    while ((size_t)(end - cursor) >= RESULT_HEADER_SIZE) {
+        ResultMessage result;
+        memcpy(&result, cursor, RESULT_HEADER_SIZE);
+        if (result.flags & RESULT_FLAG_BATCH) {
             break;
         }
+        if ((result.flags & RESULT_FLAG_TRACE) && result.resultSize >= sizeof(TraceStamps)) {
+            memcpy(cursor + RESULT_HEADER_SIZE + offsetof(TraceStamps, replied), &now, sizeof(now));
+        }
+        cursor += RESULT_HEADER_SIZE + result.resultSize;
+    }
+}
 
-        free(fullTask);
+// Готовые ответы уходят в порядке завершения, по несколько за одну запись
+static void WriteLoop(Transport& transport, BlockingQueue<MessageBuffer>& results, int workerId) {
+    std::vector<MessageBuffer> ready;
+    IoSlice slices[MAX_WRITE_BATCH];
+    bool failed = false;
 
-        if (result) {
-            DWORD bytesWritten;
-            WriteFile(hOutputPipe, result, sizeof(ResultMessage) + result->resultSize, &bytesWritten, NULL);
-            free(result);
+    while (results.PopSome(ready, MAX_WRITE_BATCH) > 0) {
+        // После ошибки записи ответы только выбираются, чтобы не держать вычисления
+        if (!failed) {
+            uint64_t now = TraceClock();
+            for (size_t i = 0; i < ready.size(); i++) {
+                StampReplies(ready[i], now);
+                slices[i].data = ready[i].Data();
+                slices[i].size = ready[i].Size();
+            }
+            if (!transport.Send(slices, ready.size())) {
+                std::cerr << "Worker " << workerId << ": failed to send results" << std::endl;
+                failed = true;
+            }
         }
+        ready.clear();
+    }
+}
 
-        FlushFileBuffers(hOutputPipe);
+int main(int argc, char* argv[]) {
+    if (argc != 3 && argc != 4) {
+        std::cerr << "Usage: Worker.exe <worker_id> <browser_pid> [compute_threads]" << std::endl;
+        return 1;
+    }
+
+    int workerId = atoi(argv[1]);
+    uint32_t instance = (uint32_t)strtoul(argv[2], nullptr, 10);
+
+    int computeThreads = argc == 4 ? atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+    if (computeThreads < 1) {
+        computeThreads = 1;
+    }
+    if (computeThreads > MAX_COMPUTE_THREADS) {
+        computeThreads = MAX_COMPUTE_THREADS;
     }
 
-    CloseHandle(hInputPipe);
-    CloseHandle(hOutputPipe);
+    std::unique_ptr<Transport> transport = ConnectToBrowser(instance, workerId);
+    if (!transport) {
+        std::cerr << "Worker " << workerId << ": failed to connect to Browser" << std::endl;
+        return 1;
+    }
+
+    WorkerContext context;
+    context.buffers.SetInstance(instance);
+    if (!context.ring.Open(GetRingName(instance, workerId))) {
+        std::cerr << "Worker " << workerId << ": shared memory ring unavailable" << std::endl;
+    }
+
+    WorkerHello hello;
+    hello.magic = WORKER_HELLO_MAGIC;
+    hello.version = PROTOCOL_VERSION;
+    hello.workerId = (uint32_t)workerId;
+    hello.processId = (uint32_t)CurrentProcessId();
+    hello.capabilities = WORKER_CAP_BATCH | WORKER_CAP_MULTI_PATTERN | WORKER_CAP_STREAM_CHUNK |
+        WORKER_CAP_RLE | WORKER_CAP_TRACE | (context.ring.IsOpen() ? WORKER_CAP_SHM_RING : 0);
+    hello.maxDataSize = MAX_DATA_SIZE;
+    hello.taskTypes = TaskTypeBit(MessageType::TASK_SUBSTRING) |
+        TaskTypeBit(MessageType::TASK_SEPIA) | TaskTypeBit(MessageType::TASK_INVERT) |
+        TaskTypeBit(MessageType::TASK_SORT) | TaskTypeBit(MessageType::TASK_CRC32) |
+        TaskTypeBit(MessageType::TASK_PRIMES) | TaskTypeBit(MessageType::TASK_MATRIX_MULT) |
+        TaskTypeBit(MessageType::TASK_FOURIER) | TaskTypeBit(MessageType::TASK_STATS) |
+        TaskTypeBit(MessageType::TASK_HISTOGRAM) | TaskTypeBit(MessageType::TASK_RLE) |
+        TaskTypeBit(MessageType::TASK_GRAPH_PATH) | TaskTypeBit(MessageType::TASK_FACTORIAL) |
+        TaskTypeBit(MessageType::TASK_XOR);
+    hello.computeThreads = (uint32_t)computeThreads;
+
+    if (!transport->SendFrame(&hello, sizeof(hello), nullptr, 0)) {
+        std::cerr << "Worker " << workerId << ": failed to send READY" << std::endl;
+        return 1;
+    }
+
+    // Поток main читает канал, вычислительные потоки выполняют кадры,
+    // поток записи отправляет ответы по мере готовности
+    BlockingQueue<WorkerJob> jobs(computeThreads * JOBS_PER_THREAD);
+    BlockingQueue<MessageBuffer> results;
+
+    std::vector<std::thread> computePool;
+    for (int i = 0; i < computeThreads; i++) {
+        computePool.emplace_back(ComputeLoop, std::ref(jobs), std::ref(results), std::ref(context));
+    }
+    std::thread writer(WriteLoop, std::ref(*transport), std::ref(results), workerId);
+
+    TaskReader reader(*transport);
+
+    while (true) {
+        WorkerJob job;
+
+        if (!reader.Next(job.header, job.frame)) {
+            break;
+        }
+        job.received = TraceClock();
+
+        if (job.header.type == MessageType::TERMINATE) {
+            break;
+        }
+
+        jobs.Push(std::move(job));
+    }
+
+    // Принятые задачи досчитываются и отправляются до закрытия канала
+    jobs.Close();
+    for (std::thread& thread : computePool) {
+        thread.join();
+    }
+    results.Close();
+    writer.join();
+
+    transport->Close();
     return 0;
-}   
\ No newline at end of file
+}
@@ -1,116 +1,81 @@
 #pragma once
 
-#include <windows.h>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <cstring>
-
-constexpr int MAX_DATA_SIZE = 1024 * 1024;
-
-enum class MessageType : uint32_t {
-    TASK_SEPIA = 1,
-    TASK_PRIMES = 2,
-    TASK_SORT = 3,
-    TASK_CRC32 = 4,
-    TASK_STATS = 5,
-    TASK_XOR = 6,
-    TASK_SUBSTRING = 7,
-    TASK_MATRIX_MULT = 8,
-    TASK_FACTORIAL = 9,
-    TASK_HISTOGRAM = 10,
-    TASK_FOURIER = 11,
-    TASK_RLE = 12,
-    TASK_GRAPH_PATH = 13,
-    TASK_INVERT = 14,
-    TERMINATE = 999
+#include <memory>
+#include <thread>
+
+#include "Protocol.h"
+#include "Platform.h"
+#include "Transport.h"
+#include "SharedMemory.h"
+#include "Substring.h"
+#include "AhoCorasick.h"
+#include "Image.h"
+#include "Sort.h"
+#include "Crc32.h"
+#include "Primes.h"
+#include "Gemm.h"
+#include "Fft.h"
+#include "Stats.h"
+#include "Rle.h"
+#include "Graph.h"
+#include "BigInt.h"
+#include "Xor.h"
+#include "BufferPool.h"
+#include "BlockingQueue.h"
+
+constexpr size_t TASK_READ_SIZE = 64 * 1024;
+constexpr int MAX_COMPUTE_THREADS = 64;
+constexpr size_t JOBS_PER_THREAD = 2;     // очередь задач перед вычислительными потоками
+constexpr size_t MAX_WRITE_BATCH = 16;    // результатов за одну запись в канал
+
+// Состояние процесса воркера, общее для всех потоков
+struct WorkerContext {
+    ShmRingView ring;
+    AutomatonCache automata;
+    BasePrimes primes;
+    MatrixCache matrices;
+    FftPlanCache fftPlans;
+    GraphCache graphs;
+    SharedBufferMap buffers;
 };
 
-#pragma pack(push, 1)
-struct TaskMessage {
-    MessageType type;
-    uint32_t taskId;
-    uint32_t dataSize;
-    uint32_t extraParam;
-    char data[1];
+// Рабочие массивы одного вычислительного потока: память выделяется один раз
+struct TaskScratch {
+    std::vector<PatternRef> patterns;
+    std::vector<ChunkEntry> entries;
+    SortScratch sort;
+    SieveScratch sieve;
+    GemmScratch gemm;
+    std::vector<FftComplex> fft;
+    HistogramScratch histogram;
+    GraphScratch graph;
+    MessageBuffer unpacked;     // полезная нагрузка с TASK_FLAG_RLE
+    MessageBuffer packed;       // ответ, сжатый перед отправкой
 };
-#pragma pack(pop)
 
-#pragma pack(push, 1)
-struct ResultMessage {
-    uint32_t taskId;
-    uint32_t resultSize;
-    char data[1];
+// Кадр задачи (одиночной или TASK_BATCH) от потока чтения к вычислительному
+struct WorkerJob {
+    TaskMessage header;
+    MessageBuffer frame;
+    uint64_t received;      // TraceClock() после чтения кадра
 };
-#pragma pack(pop)
-
-inline std::string GetInputPipeName(int workerId) {
-    return std::string("\\\\.\\pipe\\worker_in_") + std::to_string(workerId);
-}
-
-inline std::string GetOutputPipeName(int workerId) {
-    return std::string("\\\\.\\pipe\\worker_out_") + std::to_string(workerId);
-}
-
-inline std::string GetMutexName(int workerId) {
-    return std::string("Global\\WorkerMutex_") + std::to_string(workerId);
-}
-
-inline std::string GetEventName(int workerId) {
-    return std::string("Global\\WorkerEvent_") + std::to_string(workerId);
-}
 
-inline bool WriteToPipe(HANDLE hPipe, const void* data, DWORD size) {
-    DWORD bytesWritten;
-    return WriteFile(hPipe, data, size, &bytesWritten, NULL) &&
-        bytesWritten == size;
-}
-
-inline bool ReadFromPipe(HANDLE hPipe, void* buffer, DWORD size) {
-    DWORD bytesRead;
-    return ReadFile(hPipe, buffer, size, &bytesRead, NULL) &&
-        bytesRead == size;
-}
-
-inline ResultMessage* CreateResultMessage(uint32_t taskId,
-    const void* data, uint32_t dataSize) {
-    uint32_t totalSize = sizeof(ResultMessage) + dataSize;
-    ResultMessage* msg = (ResultMessage*)malloc(totalSize);
-    if (msg) {
-        msg->taskId = taskId;
-        msg->resultSize = dataSize;
-        if (data && dataSize > 0) {
-            memcpy(msg->data, data, dataSize);
-        }
-    }
-    return msg;
-}
-
-inline void FreeResultMessage(ResultMessage* msg) {
-    free(msg);
-}
-
-//  Worker
-class Worker {
+// Чтение кадров задач: мелкие кадры разбираются из одного чтения канала,
+// полезная нагрузка крупных дочитывается прямо в буфер из пула
+class TaskReader {
 private:
-    int workerId;
-    HANDLE hInputPipe;
-    HANDLE hOutputPipe;
-    HANDLE hResultMutex; 
-    HANDLE hTaskEvent;
-    bool isRunning;
+    Transport& transport;
+    MessageBuffer staging;
+    size_t consumed;
 
-    bool ConnectToPipes();
-    bool OpenSyncObjects();
-    void ProcessLoop();
-    void ProcessTask(const TaskMessage* task);
-    uint32_t CountSubstringOccurrences(const char* text, const char* pattern);
+    bool Fill();
 
 public:
-    Worker(int id);
-    ~Worker();
+    explicit TaskReader(Transport& source);
 
-    bool Initialize();
-    void Run();
-    void Stop();
-};
\ No newline at end of file
+    bool Next(TaskMessage& header, MessageBuffer& payload);
+};
@@ -0,0 +1,213 @@
+#include "Xor.h"
+#include <vector>
+#include <cstring>
+
+constexpr size_t XOR_EXPANDED_PERIOD = 4096;   // ключ короче - период кратен 32
+constexpr uint32_t PHILOX_M = 0xD256D193u;
+constexpr uint32_t PHILOX_W = 0x9E3779B9u;
+constexpr int PHILOX_ROUNDS = 10;
+
+// Ключ, повторённый подряд: ext[i] = key[i % keyLength], за периодом ещё
+// 32 байта, чтобы загрузка с любой фазы периода не требовала склейки.
+// Период - кратное keyLength; для коротких ключей он кратен 32, и фаза
+// после шага в вектор возвращается к нулю точно
+static size_t ExpandKey(const uint8_t* key, size_t keyLength, std::vector<uint8_t>& ext) {
+    size_t a = keyLength;
+    size_t b = 32;
+    while (b != 0) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    size_t lcm = keyLength / a * 32;
+    size_t period = lcm <= XOR_EXPANDED_PERIOD ? lcm : keyLength;
+
+    ext.resize(period + 32);
+    for (size_t i = 0; i < ext.size(); i += keyLength) {
+        size_t length = ext.size() - i < keyLength ? ext.size() - i : keyLength;
+        memcpy(ext.data() + i, key, length);
+    }
+    return period;
+}
+
+void XorRepeatingScalar(const char* src, char* dst, size_t size, const uint8_t* key, size_t keyLength,
+    uint64_t position) {
+    if (keyLength == 0) {
+        memmove(dst, src, size);
+        return;
+    }
+    std::vector<uint8_t> ext;
+    size_t period = ExpandKey(key, keyLength, ext);
+    size_t phase = (size_t)(position % keyLength);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t value;
+        uint64_t mask;
+        memcpy(&value, src + i, sizeof(value));
+        memcpy(&mask, ext.data() + phase, sizeof(mask));
+        value ^= mask;
+        memcpy(dst + i, &value, sizeof(value));
+        phase += 8;
+        if (phase >= period) {
+            phase -= period;
+        }
+    }
+    for (; i < size; i++, phase++) {
+        dst[i] = (char)(src[i] ^ ext[phase]);
+    }
+}
+
+static inline uint64_t PhiloxBlock(uint64_t counter, uint64_t seed) {
+    uint32_t c0 = (uint32_t)counter;
+    uint32_t c1 = (uint32_t)(counter >> 32) ^ (uint32_t)(seed >> 32);
+    uint32_t key = (uint32_t)seed;
+    for (int round = 0; round < PHILOX_ROUNDS; round++) {
+        uint64_t product = (uint64_t)PHILOX_M * c0;
+        c0 = (uint32_t)(product >> 32) ^ key ^ c1;
+        c1 = (uint32_t)product;
+        key += PHILOX_W;
+    }
+    return c0 | (uint64_t)c1 << 32;
+}
+
+// Байты от позиции q до конца её блока, не больше size; возвращает их число
+static size_t XorPartialBlock(const char* src, char* dst, size_t size, uint64_t seed, uint64_t q) {
+    uint64_t block = PhiloxBlock(q >> 3, seed);
+    size_t offset = (size_t)(q & 7);
+    size_t count = 8 - offset < size ? 8 - offset : size;
+    for (size_t k = 0; k < count; k++) {
+        dst[k] = (char)(src[k] ^ (uint8_t)(block >> (8 * (offset + k))));
+    }
+    return count;
+}
+
+void XorCounterScalar(const char* src, char* dst, size_t size, uint64_t seed, uint64_t position) {
+    size_t i = 0;
+    if (position & 7) {
+        i = XorPartialBlock(src, dst, size, seed, position);
+    }
+    uint64_t block = (position + i) >> 3;
+    for (; i + 8 <= size; i += 8, block++) {
+        uint64_t value;
+        memcpy(&value, src + i, sizeof(value));
+        value ^= PhiloxBlock(block, seed);
+        memcpy(dst + i, &value, sizeof(value));
+    }
+    if (i < size) {
+        XorPartialBlock(src + i, dst + i, size - i, seed, position + i);
+    }
+}
+
+#ifdef SIMD_X86
+
+// Возвращает фазу после последнего полного вектора; хвост - за вызывающим
+static TARGET_AVX2 size_t RepeatingBlocksAvx2(const char* src, char* dst, size_t blocks, const uint8_t* mask,
+    size_t period, size_t phase) {
+    for (size_t b = 0; b < blocks; b++) {
+        __m256i value = _mm256_loadu_si256((const __m256i*)(src + 32 * b));
+        __m256i keyBytes = _mm256_loadu_si256((const __m256i*)(mask + phase));
+        _mm256_storeu_si256((__m256i*)(dst + 32 * b), _mm256_xor_si256(value, keyBytes));
+        phase += 32;
+        if (phase >= period) {
+            phase -= period;
+        }
+    }
+    return phase;
+}
+
+void XorRepeatingAvx2(const char* src, char* dst, size_t size, const uint8_t* key, size_t keyLength,
+    uint64_t position) {
+    if (keyLength == 0) {
+        memmove(dst, src, size);
+        return;
+    }
+    std::vector<uint8_t> ext;
+    size_t period = ExpandKey(key, keyLength, ext);
+    size_t blocks = size / 32;
+    size_t phase = RepeatingBlocksAvx2(src, dst, blocks, ext.data(), period, (size_t)(position % keyLength));
+    for (size_t i = blocks * 32; i < size; i++, phase++) {
+        dst[i] = (char)(src[i] ^ ext[phase]);
+    }
+}
+
+// Четыре блока в векторе, четыре вектора за шаг: цепочки умножений
+// раундов независимы и перекрываются. src выровнен на границу блока,
+// обрабатывает целые шаги по 128 байт, возвращает их объём
+static TARGET_AVX2 size_t CounterStepsAvx2(const char* src, char* dst, size_t size, uint64_t seed, uint64_t position) {
+    __m256i keys[PHILOX_ROUNDS];
+    uint32_t key = (uint32_t)seed;
+    for (int round = 0; round < PHILOX_ROUNDS; round++) {
+        keys[round] = _mm256_set1_epi64x((long long)key);
+        key += PHILOX_W;
+    }
+    const __m256i multiplier = _mm256_set1_epi64x((long long)PHILOX_M);
+    const __m256i seedHigh = _mm256_set1_epi64x((long long)(seed & 0xFFFFFFFF00000000ull));
+    const __m256i step = _mm256_set1_epi64x(4);
+    __m256i counter = _mm256_add_epi64(_mm256_set1_epi64x((long long)(position >> 3)),
+        _mm256_set_epi64x(3, 2, 1, 0));
+
+    size_t i = 0;
+    for (; i + 128 <= size; i += 128) {
+        __m256i v[4];
+        for (int l = 0; l < 4; l++) {
+            v[l] = _mm256_xor_si256(counter, seedHigh);
+            counter = _mm256_add_epi64(counter, step);
+        }
+        for (int round = 0; round < PHILOX_ROUNDS; round++) {
+            for (int l = 0; l < 4; l++) {
+                __m256i product = _mm256_mul_epu32(v[l], multiplier);
+                __m256i c0 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(product, 32),
+                    _mm256_srli_epi64(v[l], 32)), keys[round]);
+                v[l] = _mm256_or_si256(c0, _mm256_slli_epi64(product, 32));
+            }
+        }
+        for (int l = 0; l < 4; l++) {
+            __m256i value = _mm256_loadu_si256((const __m256i*)(src + i + 32 * l));
+            _mm256_storeu_si256((__m256i*)(dst + i + 32 * l), _mm256_xor_si256(value, v[l]));
+        }
+    }
+    return i;
+}
+
+void XorCounterAvx2(const char* src, char* dst, size_t size, uint64_t seed, uint64_t position) {
+    size_t i = 0;
+    if (position & 7) {
+        i = XorPartialBlock(src, dst, size, seed, position);
+    }
+    i += CounterStepsAvx2(src + i, dst + i, size - i, seed, position + i);
+    if (i < size) {
+        XorCounterScalar(src + i, dst + i, size - i, seed, position + i);
+    }
+}
+
+#else
+
+void XorRepeatingAvx2(const char* src, char* dst, size_t size, const uint8_t* key, size_t keyLength,
+    uint64_t position) {
+    XorRepeatingScalar(src, dst, size, key, keyLength, position);
+}
+
+void XorCounterAvx2(const char* src, char* dst, size_t size, uint64_t seed, uint64_t position) {
+    XorCounterScalar(src, dst, size, seed, position);
+}
+
+#endif
+
+void XorRepeating(const char* src, char* dst, size_t size, const uint8_t* key, size_t keyLength, uint64_t position) {
+    static const bool avx2 = DetectSimdLevel() == SimdLevel::AVX2;
+    if (avx2) {
+        XorRepeatingAvx2(src, dst, size, key, keyLength, position);
+        return;
+    }
+    XorRepeatingScalar(src, dst, size, key, keyLength, position);
+}
+
+void XorCounter(const char* src, char* dst, size_t size, uint64_t seed, uint64_t position) {
+    static const bool avx2 = DetectSimdLevel() == SimdLevel::AVX2;
+    if (avx2) {
+        XorCounterAvx2(src, dst, size, seed, position);
+        return;
+    }
+    XorCounterScalar(src, dst, size, seed, position);
+}
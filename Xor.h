@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "Protocol.h"
+#include "Simd.h"
+
+// dst[i] = src[i] ^ key[(position + i) % keyLength]; src и dst могут
+// совпадать. position - смещение src в потоке: куски потока
+// обрабатываются независимо и в любом порядке
+void XorRepeating(const char* src, char* dst, size_t size, const uint8_t* key, size_t keyLength, uint64_t position);
+
+// dst[i] = src[i] ^ байт (position + i) потока ключа: блок j из 8 байт -
+// Philox2x32-10 от счётчика j и seed. Маскирование, не шифрование
+void XorCounter(const char* src, char* dst, size_t size, uint64_t seed, uint64_t position);
+
+// Отдельные реализации (для бенчмарка); Avx2 вызывать только при AVX2
+void XorRepeatingScalar(const char* src, char* dst, size_t size, const uint8_t* key, size_t keyLength,
+    uint64_t position);
+void XorRepeatingAvx2(const char* src, char* dst, size_t size, const uint8_t* key, size_t keyLength,
+    uint64_t position);
+void XorCounterScalar(const char* src, char* dst, size_t size, uint64_t seed, uint64_t position);
+void XorCounterAvx2(const char* src, char* dst, size_t size, uint64_t seed, uint64_t position);